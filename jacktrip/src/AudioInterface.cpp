@@ -332,8 +332,13 @@ void AudioInterface::appendProcessPlugin(ProcessPlugin* plugin)
 //*******************************************************************************
 AudioInterface::samplingRateT AudioInterface::getSampleRateType() const
 {
-  uint32_t rate = getSampleRate();
+  return getSampleRateTypeFromRate( getSampleRate() );
+}
+
 
+//*******************************************************************************
+AudioInterface::samplingRateT AudioInterface::getSampleRateTypeFromRate(uint32_t rate)
+{
   if      ( rate == 22050 ) {
     return AudioInterface::SR22; }
   else if ( rate == 32000 ) {
@@ -346,7 +351,7 @@ AudioInterface::samplingRateT AudioInterface::getSampleRateType() const
     return AudioInterface::SR88; }
   else if ( rate == 96000 ) {
     return AudioInterface::SR96; }
-  else if ( rate == 19200 ) {
+  else if ( rate == 192000 ) {
     return AudioInterface::SR192; }
 
   return AudioInterface::UNDEF;
@@ -182,6 +182,11 @@ public:
    * \return Sample Rate in Hz
    */
   static int getSampleRateFromType(samplingRateT rate_type);
+  /** \brief Helper function to get the samplingRateT for a sample rate in Hz
+   * \param rate Sample Rate in Hz
+   * \return AudioInterface::samplingRateT enum type, UNDEF if not supported
+   */
+  static samplingRateT getSampleRateTypeFromRate(uint32_t rate);
   //------------------------------------------------------------------
 
 
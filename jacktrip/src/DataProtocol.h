@@ -64,13 +64,14 @@ class JackTrip; // forward declaration
  * This base class defines most of the common method to setup and connect
  * sockets using the individual protocols (UDP, TCP, SCTP, etc).
  *
- * The class has to be constructed using one of two modes (runModeT):\n
+ * The class has to be constructed using one of three modes (runModeT):\n
  * - SENDER
  * - RECEIVER
+ * - DUPLEX
  *
  * This has to be specified as a constructor argument. When using, create two instances
  * of the class, one to receive and one to send packets. Each instance will run on a
- * separate thread.
+ * separate thread. A DUPLEX instance does both on one thread (and socket).
  *
  * Redundancy and forward error correction should be implemented on each
  * Transport protocol, cause they depend on the protocol itself
@@ -103,18 +104,19 @@ public:
     EMPTY    ///< Empty Header
   };
 
-  /// \brief Enum to define class modes, SENDER or RECEIVER
+  /// \brief Enum to define class modes, SENDER, RECEIVER or DUPLEX
   enum runModeT {
     SENDER, ///< Set class as a Sender (send packets)
-    RECEIVER ///< Set class as a Receiver (receives packets)
+    RECEIVER, ///< Set class as a Receiver (receives packets)
+    DUPLEX ///< Set class as a Sender and Receiver (one thread for both)
   };
   //---------------------------------------------------------
 
 
   /** \brief The class constructor 
    * \param jacktrip Pointer to the JackTrip class that connects all classes (mediator)
-   * \param runmode Sets the run mode, use either DataProtocol::SENDER or
-   * DataProtocol::RECEIVER
+   * \param runmode Sets the run mode, use either DataProtocol::SENDER,
+   * DataProtocol::RECEIVER or DataProtocol::DUPLEX
    * \param headertype packetHeaderTypeT header type to use for packets
    * \param bind_port Port number to bind for this socket (this is the receive or send port depending on the runmode)
    * \param peer_port Peer port number (this is the receive or send port depending on the runmode)
@@ -128,8 +130,8 @@ public:
   
   /** \brief Implements the thread loop
    *
-   * Depending on the runmode, with will run a DataProtocol::SENDER thread or
-   * DataProtocol::RECEIVER thread
+   * Depending on the runmode, with will run a DataProtocol::SENDER thread,
+   * DataProtocol::RECEIVER thread or DataProtocol::DUPLEX thread
    */
   virtual void run() = 0;
 
@@ -139,6 +141,12 @@ public:
     mStopped = true;
   }
 
+  /** \brief Tells the thread that the audio interface wrote a buffer to send
+   * (called from the audio callback, it doesn't block). Only the DUPLEX
+   * thread waits for it, the SENDER blocks on the ring buffer.
+   */
+  virtual void wakeUp() {}
+
   /** \brief Sets the size of the audio part of the packets
    * \param size_bytes Size in bytes
    */
@@ -174,7 +182,7 @@ signals:
 protected:
 
   /** \brief Get the Run Mode of the object
-   * \return SENDER or RECEIVER
+   * \return SENDER, RECEIVER or DUPLEX
    */
   runModeT getRunMode() const { return mRunMode; }
 
@@ -191,7 +199,7 @@ private:
 
   int mLocalPort; ///< Local Port number to Bind
   int mPeerPort; ///< Peer Port number to Bind
-  const runModeT mRunMode; ///< Run mode, either SENDER or RECEIVER
+  const runModeT mRunMode; ///< Run mode, either SENDER, RECEIVER or DUPLEX
   
   struct sockaddr_in mLocalIPv4Addr; ///< Local IPv4 Address struct
   struct sockaddr_in mPeerIPv4Addr; ///< Peer IPv4 Address struct
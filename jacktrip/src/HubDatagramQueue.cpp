@@ -0,0 +1,161 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file HubDatagramQueue.cpp
+ * \date October 2026
+ */
+
+#include "HubDatagramQueue.h"
+
+#include <cstring>
+#include <stdexcept>
+
+
+//*******************************************************************************
+HubDatagramQueue::HubDatagramQueue(int Capacity) :
+  mCapacity( (Capacity / 8) * 8 ),
+  mRing(NULL),
+  mWritePosition(0),
+  mReadPosition(0),
+  mHoldPosition(0),
+  mNumHeld(0),
+  mDropped(0)
+{
+  if ( mCapacity < recordSize(1) * 2 ) {
+    throw std::invalid_argument("HubDatagramQueue: capacity too small");
+  }
+  mRing = new int8_t[mCapacity];
+}
+
+
+//*******************************************************************************
+HubDatagramQueue::~HubDatagramQueue()
+{
+  delete[] mRing;
+}
+
+
+//*******************************************************************************
+bool HubDatagramQueue::push(const int8_t* datagram, int size, uint32_t address,
+                            uint16_t port, uint64_t arrival_time)
+{
+  const int record_size = recordSize(size);
+  int write = mWritePosition;
+  const int read = mReadPosition.fetchAndAddAcquire(0);
+
+  // The data of a record is never split: if it doesn't fit at the end of the
+  // ring, the end is marked and the record goes at the start. One byte is
+  // always left free, so write == read means empty.
+  if ( write >= read ) {
+    if ( ((write + record_size) == mCapacity) && (read == 0) ) { mDropped++; return false; }
+    if ( (write + record_size) > mCapacity ) {
+      if ( record_size >= read ) { mDropped++; return false; }
+      if ( (mCapacity - write) >= static_cast<int>(sizeof(int32_t)) ) {
+        reinterpret_cast<Record*>(mRing + write)->Size = -1; }
+      write = 0;
+    }
+  }
+  else if ( (write + record_size) >= read ) {
+    mDropped++;
+    return false;
+  }
+
+  Record* record = reinterpret_cast<Record*>(mRing + write);
+  record->Size = size;
+  record->Address = address;
+  record->Port = port;
+  record->Reserved = 0;
+  record->ArrivalTime = arrival_time;
+  std::memcpy(mRing + write + sizeof(Record), datagram, size);
+
+  // Publish the record (ordered, so the reader sees the data first)
+  int next = write + record_size;
+  if ( next == mCapacity ) { next = 0; }
+  mWritePosition.fetchAndStoreOrdered(next);
+  return true;
+}
+
+
+//*******************************************************************************
+int HubDatagramQueue::pop(int8_t* datagram, int max_size, uint32_t& address,
+                          uint16_t& port, uint64_t& arrival_time)
+{
+  int8_t* data = NULL;
+  int size = hold(data, max_size, address, port, arrival_time);
+  if ( size > 0 ) { std::memcpy(datagram, data, size); }
+  // The space is freed right away, unless older datagrams are held
+  if ( mNumHeld == 1 ) { release(); }
+  return size;
+}
+
+
+//*******************************************************************************
+int HubDatagramQueue::hold(int8_t*& datagram, int max_size, uint32_t& address,
+                           uint16_t& port, uint64_t& arrival_time)
+{
+  int read = mHoldPosition;
+  const int write = mWritePosition.fetchAndAddAcquire(0);
+  if ( read == write ) { return 0; }
+
+  // End of the used part of the ring
+  if ( ((mCapacity - read) < static_cast<int>(sizeof(int32_t))) ||
+       (reinterpret_cast<const Record*>(mRing + read)->Size == -1) ) {
+    read = 0;
+    if ( read == write ) {
+      mHoldPosition = 0;
+      if ( mNumHeld == 0 ) { mReadPosition.fetchAndStoreOrdered(0); }
+      return 0;
+    }
+  }
+
+  const Record* record = reinterpret_cast<const Record*>(mRing + read);
+  int size = record->Size;
+  address = record->Address;
+  port = record->Port;
+  arrival_time = record->ArrivalTime;
+  datagram = mRing + read + sizeof(Record);
+
+  int next = read + recordSize(size);
+  if ( next == mCapacity ) { next = 0; }
+  mHoldPosition = next;
+  mNumHeld++;
+  return (size <= max_size) ? size : -1;
+}
+
+
+//*******************************************************************************
+void HubDatagramQueue::release()
+{
+  if ( mNumHeld == 0 ) { return; }
+  mNumHeld = 0;
+  mReadPosition.fetchAndStoreOrdered(mHoldPosition);
+}
@@ -0,0 +1,132 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file HubDatagramQueue.h
+ * \date October 2026
+ */
+
+#ifndef __HUBDATAGRAMQUEUE_H__
+#define __HUBDATAGRAMQUEUE_H__
+
+#include <QAtomicInt>
+#include <stdint.h>
+
+#include "jacktrip_types.h"
+
+
+/** \brief Lock-free queue of datagrams, with one writer thread and one reader thread
+ *
+ * The HubSocket receive thread pushes the datagrams of a client, and the
+ * HubEngine of the client room pops them at the start of each period. The
+ * datagrams are stored one after the other in a byte ring, each one after a
+ * small header with its size, source address and arrival time, so small and large
+ * datagrams share the same memory. When the queue is full, new datagrams are
+ * dropped (the engine is not reading, the client will time out).
+ *
+ * The reader can also hold the datagrams in the ring (see hold), to use them
+ * in place until release() instead of copying them out.
+ */
+class HubDatagramQueue
+{
+public:
+  /** \brief The class constructor
+   * \param Capacity Size of the ring, in bytes
+   */
+  HubDatagramQueue(int Capacity);
+  virtual ~HubDatagramQueue();
+
+  /** \brief Adds a datagram (writer thread only)
+   * \param datagram Datagram data
+   * \param size Datagram size, in bytes
+   * \param address Source IPv4 address
+   * \param port Source port
+   * \param arrival_time Arrival time of the datagram, in usec
+   * \return false if there's no space for the datagram
+   */
+  bool push(const int8_t* datagram, int size, uint32_t address, uint16_t port,
+            uint64_t arrival_time);
+
+  /** \brief Takes the oldest datagram (reader thread only)
+   * \param datagram Buffer for the datagram data
+   * \param max_size Size of the buffer; larger datagrams are discarded
+   * \param address Source IPv4 address of the datagram
+   * \param port Source port of the datagram
+   * \param arrival_time Arrival time of the datagram, in usec
+   * \return Datagram size, 0 if the queue is empty, -1 if it didn't fit in the buffer
+   */
+  int pop(int8_t* datagram, int max_size, uint32_t& address, uint16_t& port,
+          uint64_t& arrival_time);
+  /** \brief Takes the oldest datagram without copying it (reader thread only).
+   * The datagram stays in the ring, the writer can't reuse its space until
+   * release().
+   * \param datagram Returns the datagram data, in the ring
+   * \param max_size Larger datagrams are discarded
+   * \param address Source IPv4 address of the datagram
+   * \param port Source port of the datagram
+   * \param arrival_time Arrival time of the datagram, in usec
+   * \return Datagram size, 0 if the queue is empty, -1 if it's larger than max_size
+   */
+  int hold(int8_t*& datagram, int max_size, uint32_t& address, uint16_t& port,
+           uint64_t& arrival_time);
+  /// \brief Gives the space of the held datagrams back to the writer (reader thread only)
+  void release();
+
+  /// \brief Datagrams dropped because the queue was full
+  uint32_t getDropped() const { return mDropped; }
+
+
+private:
+
+  /// \brief Header of each datagram in the ring
+  struct Record
+  {
+    int32_t Size; ///< Datagram size, -1 marks the end of the used part of the ring
+    uint32_t Address; ///< Source IPv4 address
+    uint16_t Port; ///< Source port
+    uint16_t Reserved; ///< Padding
+    uint64_t ArrivalTime; ///< Arrival time, in usec
+  };
+
+  /// \brief Space used by a datagram in the ring (header + data, aligned to 8 bytes)
+  static int recordSize(int size)
+  { return ( (static_cast<int>(sizeof(Record)) + size + 7) / 8 ) * 8; }
+
+  const int mCapacity; ///< Size of mRing
+  int8_t* mRing; ///< Byte ring
+  QAtomicInt mWritePosition; ///< Next write offset (written by the writer only)
+  QAtomicInt mReadPosition; ///< Start of the space the reader uses (written by the reader only)
+  int mHoldPosition; ///< Next read offset, after the held datagrams (reader only)
+  int mNumHeld; ///< Datagrams held (reader only)
+  uint32_t mDropped; ///< Datagrams dropped
+};
+
+#endif //__HUBDATAGRAMQUEUE_H__
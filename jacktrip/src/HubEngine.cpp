@@ -0,0 +1,2046 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file HubEngine.cpp
+ * \date October 2026
+ */
+
+#include "HubEngine.h"
+#include "HubSocket.h"
+#include "UdpMasterListener.h"
+#include "PacketHeader.h"
+#include "JackTrip.h"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+
+#include <QMutexLocker>
+#include <QVarLengthArray>
+#include <QHostAddress>
+
+#if defined ( __LINUX__ )
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using std::cout; using std::endl;
+
+/// Size of the buffer to read client datagrams (largest UDP datagram)
+const int gHubMaxDatagramSize = 65536;
+
+
+//*******************************************************************************
+// Monotonic time in nanoseconds
+static uint64_t monotonicNsec()
+{
+#if defined ( __LINUX__ )
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ( static_cast<uint64_t>(now.tv_sec) * 1000000000ULL ) + now.tv_nsec;
+#else
+  return PacketHeader::usecTime() * 1000ULL;
+#endif
+}
+
+
+//*******************************************************************************
+// CPU time of the calling thread in nanoseconds (wall time if there's no
+// thread CPU clock)
+static uint64_t threadCpuNsec()
+{
+#if defined ( __LINUX__ )
+  struct timespec now;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return ( static_cast<uint64_t>(now.tv_sec) * 1000000000ULL ) + now.tv_nsec;
+#else
+  return monotonicNsec();
+#endif
+}
+
+
+//*******************************************************************************
+HubEngine::HubEngine(uint32_t SampleRate, uint32_t BufferSize, int QueueLength,
+                     int NumWorkers, int PoolSize, bool Forwarding) :
+  mSampleRate(SampleRate),
+  mBufferSize(BufferSize),
+  mQueueLength(QueueLength),
+  mForwarding(Forwarding),
+  mMaxPeriodFrames(BufferSize * gHubLongPeriodFactor),
+  mPeriodFrames(BufferSize),
+  mClockStartNsec(0),
+  mPeriodCount(0),
+  mClockFrames(0),
+  mLatePeriods(0),
+  mGainRampPeriods(1),
+  mCpu(-1),
+  mAppliedCpu(-1),
+  mLoadAverage(0.0),
+  mLoad(0),
+  mSlackUsec(0),
+  mMinSlackUsec( static_cast<int>((static_cast<uint64_t>(BufferSize) * 1000000) / SampleRate) ),
+  mMissedDeadlines(0),
+  mPeriodTime(0),
+  mSessionLoad(0),
+  mOverloadLevel(FULL_QUALITY),
+  mOverloadLevelTime(0),
+  mLowLoadTime(0),
+  mSrcTapsPerPhase(gDefaultSrcTapsPerPhase),
+  mSessionsByID(gMaxThreads, NULL),
+  mPoolSize(PoolSize),
+  mMixer(BufferSize, BufferSize * gHubLongPeriodFactor),
+  mScheduler(NumWorkers),
+  mTaskCosts(gMaxThreads, 1),
+  mAudienceCosts(gHubAudienceMaxFormats, 1),
+  mNumListeners(0),
+  mMeterFrames(0),
+  mNextMeterTime(0),
+  mMeterReadings(gHubMeterMaxReadings),
+  mNumMeterReadings(0),
+  mMeterSequence(0),
+  mEvents(gHubEventQueueSize),
+  mDroppedEvents(0),
+  mUdpMasterListener(NULL),
+  mHubSocket(NULL),
+  mStopped(false)
+{
+  if ( (mSampleRate == 0) || (mBufferSize == 0) || (mQueueLength < 1) ) {
+    throw std::invalid_argument("HubEngine: invalid audio settings");
+  }
+  for (int i = 0; i < mScheduler.getNumThreads(); i++) {
+    mDatagrams.append(new int8_t[gHubMaxDatagramSize]); }
+  int ramp_periods = static_cast<int>( (gHubGainRampTime * mSampleRate) / mBufferSize );
+  if ( ramp_periods > 1 ) { mGainRampPeriods = ramp_periods; }
+
+  // Sessions for the common client settings (up to gHubPoolNumChannels
+  // channels and gHubPoolBufferSize samples, any bit resolution, the hub
+  // sample rate), so adding and removing clients is just taking and
+  // returning a pointer. A forwarding engine only needs the packets.
+  mSessions.reserve(gMaxThreads);
+  mSessionPool.reserve(mPoolSize);
+  int pool_frames = ( static_cast<int>(mBufferSize) > gHubPoolBufferSize ) ?
+        static_cast<int>(mBufferSize) : gHubPoolBufferSize;
+  for (int i = 0; i < mPoolSize; i++) {
+    HubSession* session = allocateSession();
+    if ( mForwarding ) { reserveForwardPackets(session); }
+    else {
+      reserveSessionBuffers(session, gHubPoolNumChannels, pool_frames, sizeof(int32_t),
+                            gHubPoolRedundancy, pool_frames, mMaxPeriodFrames);
+    }
+    mSessionPool.append(session);
+  }
+}
+
+
+//*******************************************************************************
+HubEngine::~HubEngine()
+{
+  stop();
+  wait();
+  // The engine thread is done, its last events (the released sessions) are printed here
+  printEvents();
+  for (int i = 0; i < mDatagrams.size(); i++) { delete[] mDatagrams[i]; }
+  for (int i = 0; i < mSessionPool.size(); i++) { freeSession(mSessionPool[i]); }
+}
+
+
+//*******************************************************************************
+void HubEngine::addSession(int id, HubChannel* channel, const HubClientSettings* settings,
+                           bool trunk)
+{
+  HubClientSettings pending_settings;
+  if ( settings != NULL ) { pending_settings = *settings; }
+  else { std::memset(&pending_settings, 0, sizeof(pending_settings)); }
+  QMutexLocker locker(&mPendingMutex);
+  mPendingAddIDs.append(id);
+  mPendingAddChannels.append(channel);
+  mPendingAddSettings.append(pending_settings);
+  mPendingAddTrunks.append(trunk);
+}
+
+
+//*******************************************************************************
+void HubEngine::removeSession(int id)
+{
+  QMutexLocker locker(&mPendingMutex);
+  mPendingRemoveIDs.append(id);
+}
+
+
+//*******************************************************************************
+void HubEngine::setListenerGains(int listener_id, const QVector<HubGainMessageEntry>& gains)
+{
+  QMutexLocker locker(&mPendingMutex);
+  mPendingGainIDs.append(listener_id);
+  mPendingGains.append(gains);
+}
+
+
+//*******************************************************************************
+void HubEngine::addListener(uint32_t address, uint16_t port, const HubClientSettings& settings)
+{
+  const uint64_t now = PacketHeader::usecTime();
+  HubAudienceListener listener;
+  listener.Address = address;
+  listener.Port = port;
+  listener.LastJoinTime = now;
+  {
+    QMutexLocker locker(&mPendingMutex);
+    mPendingListeners.append(listener);
+    mPendingListenerSettings.append(settings);
+  }
+
+  // A listener is new if it didn't join within the time the engine keeps it.
+  // Only as many listeners as the audience can have are remembered.
+  const uint64_t timeout = static_cast<uint64_t>(gTimeOutMultiThreadedServer) * 1000;
+  const quint64 key = (static_cast<quint64>(address) << 16) | port;
+  QHash<quint64, uint64_t>::iterator known = mListenerJoinTimes.find(key);
+  bool joined = true;
+  if ( known != mListenerJoinTimes.end() ) {
+    joined = ( (now - known.value()) > timeout );
+    known.value() = now;
+  }
+  else {
+    if ( mListenerJoinTimes.size() >= gHubAudienceMaxListeners ) {
+      for (QHash<quint64, uint64_t>::iterator it = mListenerJoinTimes.begin();
+           it != mListenerJoinTimes.end(); ) {
+        if ( (now - it.value()) > timeout ) { it = mListenerJoinTimes.erase(it); }
+        else { ++it; }
+      }
+    }
+    if ( mListenerJoinTimes.size() < gHubAudienceMaxListeners ) {
+      mListenerJoinTimes.insert(key, now); }
+  }
+  if ( joined ) {
+    cout << "JackTrip HUB SERVER: Audience listener "
+         << QHostAddress(address).toString().toStdString() << ":" << port << " joined" << endl;
+  }
+}
+
+
+//*******************************************************************************
+void HubEngine::run()
+{
+  mStopped = false;
+  // Set realtime priority (function in jacktrip_globals.h)
+  set_crossplatform_realtime_priority();
+
+  cout << "JackTrip HUB SERVER: Engine running at " << mSampleRate << " Hz, "
+       << mBufferSize << " samples per period"
+       << (mForwarding ? ", forwarding the client packets" : "") << endl;
+  cout << gPrintSeparator << endl;
+
+  mClockStartNsec = monotonicNsec();
+  mPeriodCount = 0;
+  mClockFrames = 0;
+  mOverloadLevelTime = PacketHeader::usecTime();
+  mNextMeterTime = mOverloadLevelTime + (gHubMeterInterval * 1000ULL);
+  while ( !mStopped )
+  {
+    applyCpuAffinity();
+    processPendingRequests();
+    processStemRequests();
+    updateOverloadLevel();
+
+    // Read the client packets and pull one period of input from each client
+    uint64_t now = PacketHeader::usecTime();
+    mPeriodTime = now;
+    // Each task only touches its own session (and channel)
+    computeTaskCosts();
+    mScheduler.run(receiveTask, this, mTaskCosts.constData(), mSessions.size());
+    // The tasks only record their events in their session
+    for (int i = 0; i < mSessions.size(); i++) {
+      if ( mSessions[i]->PendingEvents != 0 ) { queueSessionEvents(mSessions[i]); }
+    }
+
+    processSessions();
+    if ( now >= mNextMeterTime ) {
+      publishLevels();
+      mNextMeterTime = now + (gHubMeterInterval * 1000ULL);
+    }
+
+    mScheduler.run(sendTask, this, mTaskCosts.constData(), mSessions.size());
+    accountSessionLoads();
+    // The audience gets the room mix once it's complete
+    for (int i = 0; i < mAudienceFormats.size(); i++) {
+      mAudienceCosts[i] = 1 + mAudienceFormats[i]->Audience.size(); }
+    mScheduler.run(audienceTask, this, mAudienceCosts.constData(), mAudienceFormats.size());
+
+    // Release the clients that stopped sending packets (a trunk takes its
+    // stems with it)
+    for (int i = mSessions.size()-1; i >= 0; i--) {
+      if ( i >= mSessions.size() ) { continue; }
+      if ( (now - mSessions[i]->LastPacketTime) >
+           (static_cast<uint64_t>(gTimeOutMultiThreadedServer) * 1000) ) {
+        queueEvent(SESSION_TIMEOUT, mSessions[i]->ID);
+        releaseSession(i);
+      }
+    }
+    releaseIdleListeners(now);
+
+    waitForNextPeriod();
+  }
+
+  // Sessions belong to this thread, so they're deleted here
+  while ( !mSessions.isEmpty() ) { releaseSession(mSessions.size()-1); }
+  while ( !mAudienceFormats.isEmpty() ) {
+    deleteSession(mAudienceFormats.last());
+    mAudienceFormats.remove(mAudienceFormats.size() - 1);
+  }
+  mNumListeners = 0;
+  cout << "JackTrip HUB SERVER: Engine stopped (" << mLatePeriods
+       << " late periods, " << mMissedDeadlines << " missed deadlines, "
+       << mScheduler.getStolenTasks() << " stolen tasks)" << endl;
+}
+
+
+//*******************************************************************************
+void HubEngine::processPendingRequests()
+{
+  // Never block the audio loop, try again on the next period if busy
+  if ( !mPendingMutex.tryLock() ) { return; }
+
+  for (int i = 0; i < mPendingRemoveIDs.size(); i++) {
+    for (int j = 0; j < mSessions.size(); j++) {
+      if ( mSessions[j]->ID == mPendingRemoveIDs[i] ) {
+        releaseSession(j);
+        break;
+      }
+    }
+  }
+  mPendingRemoveIDs.clear();
+
+  for (int i = 0; i < mPendingAddIDs.size(); i++) {
+    // Only stems have no channel, and the engine creates them itself
+    HubSession* session = (mPendingAddChannels[i] != NULL) ?
+          createSession(mPendingAddIDs[i], mPendingAddChannels[i]) : NULL;
+    if ( session == NULL ) {
+      if ( mHubSocket != NULL ) { mHubSocket->removeChannel(mPendingAddChannels[i]); }
+      if ( mUdpMasterListener != NULL ) {
+        mUdpMasterListener->releaseThread(mPendingAddIDs[i]); }
+      continue;
+    }
+    session->IsTrunk = mPendingAddTrunks[i];
+    // Clients that joined with their settings get audio from this period
+    if ( (mPendingAddSettings[i].BufferSize > 0) &&
+         setupSession(session, mPendingAddSettings[i]) ) {
+      session->Connected = true;
+    }
+    mSessions.append(session);
+    mSessionsByID[session->ID] = session;
+  }
+  mPendingAddIDs.clear();
+  mPendingAddChannels.clear();
+  mPendingAddSettings.clear();
+  mPendingAddTrunks.clear();
+
+  for (int i = 0; i < mPendingGainIDs.size(); i++) {
+    int id = mPendingGainIDs[i];
+    if ( (id >= 0) && (id < mSessionsByID.size()) && (mSessionsByID[id] != NULL) ) {
+      applyListenerGains(mSessionsByID[id], mPendingGains[i].constData(),
+                         mPendingGains[i].size());
+    }
+  }
+  mPendingGainIDs.clear();
+  mPendingGains.clear();
+
+  for (int i = 0; i < mPendingListeners.size(); i++) {
+    addPendingListener(mPendingListeners[i], mPendingListenerSettings[i]); }
+  mPendingListeners.clear();
+  mPendingListenerSettings.clear();
+
+  mPendingMutex.unlock();
+}
+
+
+//*******************************************************************************
+void HubEngine::addPendingListener(const HubAudienceListener& listener,
+                                   const HubClientSettings& settings)
+{
+  uint32_t peer_sample_rate = AudioInterface::getSampleRateFromType
+      ( static_cast<AudioInterface::samplingRateT>(settings.SamplingRate) );
+  // A listener that joins again is kept, or moved if it changed its format
+  for (int i = 0; i < mAudienceFormats.size(); i++) {
+    HubSession* format = mAudienceFormats[i];
+    for (int j = 0; j < format->Audience.size(); j++) {
+      HubAudienceListener& known = format->Audience[j];
+      if ( (known.Address != listener.Address) || (known.Port != listener.Port) ) { continue; }
+      if ( (format->NumChans == settings.NumChannels) &&
+           (format->PeerBufferSize == settings.BufferSize) &&
+           (format->PeerSampleRate == peer_sample_rate) &&
+           ((format->BitResolution*8) == settings.BitResolution) &&
+           (format->Redundancy == settings.Redundancy) ) {
+        known.LastJoinTime = listener.LastJoinTime;
+        return;
+      }
+      format->Audience.remove(j);
+      mNumListeners--;
+      break;
+    }
+  }
+  if ( mNumListeners >= gHubAudienceMaxListeners ) { return; }
+
+  HubSession* format = NULL;
+  for (int i = 0; (i < mAudienceFormats.size()) && (format == NULL); i++) {
+    HubSession* candidate = mAudienceFormats[i];
+    if ( (candidate->NumChans == settings.NumChannels) &&
+         (candidate->PeerBufferSize == settings.BufferSize) &&
+         (candidate->PeerSampleRate == peer_sample_rate) &&
+         ((candidate->BitResolution*8) == settings.BitResolution) &&
+         (candidate->Redundancy == settings.Redundancy) ) {
+      format = candidate;
+    }
+  }
+  // First listener of the format: a session (from the pool) that only sends
+  if ( format == NULL ) {
+    if ( mAudienceFormats.size() >= gHubAudienceMaxFormats ) {
+      queueEvent(AUDIENCE_FULL, -1);
+      return;
+    }
+    format = createSession(-1, NULL);
+    format->IsAudience = true;
+    bool set_up = setupSession(format, settings);
+    queueSessionEvents(format);
+    if ( !set_up ) {
+      deleteSession(format);
+      return;
+    }
+    format->Connected = true;
+    mAudienceFormats.append(format);
+  }
+  format->Audience.append(listener);
+  mNumListeners++;
+}
+
+
+//*******************************************************************************
+void HubEngine::releaseIdleListeners(uint64_t now)
+{
+  const uint64_t timeout = static_cast<uint64_t>(gTimeOutMultiThreadedServer) * 1000;
+  for (int i = mAudienceFormats.size()-1; i >= 0; i--) {
+    HubSession* format = mAudienceFormats[i];
+    for (int j = format->Audience.size()-1; j >= 0; j--) {
+      uint64_t join_time = format->Audience[j].LastJoinTime;
+      if ( (now > join_time) && ((now - join_time) > timeout) ) {
+        format->Audience.remove(j);
+        mNumListeners--;
+      }
+    }
+    if ( format->Audience.isEmpty() ) {
+      mAudienceFormats.remove(i);
+      deleteSession(format);
+    }
+  }
+}
+
+
+//*******************************************************************************
+void HubEngine::processStemRequests()
+{
+  // The requests are taken first, adding and releasing stems changes mSessions
+  QVarLengthArray<int, 16> client_ids;
+  for (int i = 0; i < mSessions.size(); i++) {
+    if ( !mSessions[i]->StemRequest.isEmpty() ) { client_ids.append(mSessions[i]->ID); }
+  }
+
+  for (int i = 0; i < client_ids.size(); i++) {
+    HubSession* client = mSessionsByID[client_ids[i]];
+    if ( client == NULL ) { continue; }
+    QVector<uint16_t> request = client->StemRequest;
+    client->StemRequest.clear();
+    int trunk_id = request[0];
+    HubSession* trunk = (trunk_id < mSessionsByID.size()) ? mSessionsByID[trunk_id] : NULL;
+    if ( (trunk == NULL) || !trunk->IsTrunk ) { continue; }
+
+    // Reply with the local IDs of the stems, the client can set their gains
+    int8_t* reply = mDatagrams[0];
+    HubStemMessageHeader* header = reinterpret_cast<HubStemMessageHeader*>(reply);
+    header->Magic = gHubStemReplyMagic;
+    header->TrunkID = trunk_id;
+    header->NumStems = request.size() - 1;
+    setTrunkStems(trunk, request.constData() + 1, request.size() - 1,
+                  reinterpret_cast<uint16_t*>(reply + sizeof(HubStemMessageHeader)));
+    mHubSocket->sendDatagram(reply, sizeof(HubStemMessageHeader) +
+                             ((request.size() - 1) * sizeof(uint16_t)),
+                             client->PeerAddress, client->PeerPort);
+  }
+}
+
+
+//*******************************************************************************
+void HubEngine::setTrunkStems(HubSession* trunk, const uint16_t* source_ids, int num_stems,
+                              uint16_t* stem_ids)
+{
+  // Stems that are not wanted anymore
+  for (int i = trunk->Stems.size()-1; i >= 0; i--) {
+    int j = 0;
+    while ( (j < num_stems) && (source_ids[j] != trunk->Stems[i]->StemSourceID) ) { j++; }
+    if ( j == num_stems ) { releaseSession(mSessions.indexOf(trunk->Stems[i])); }
+  }
+
+  for (int i = 0; i < num_stems; i++) {
+    stem_ids[i] = 0xffff;
+    int j = 0;
+    while ( (j < trunk->Stems.size()) &&
+            (trunk->Stems[j]->StemSourceID != source_ids[i]) ) { j++; }
+    if ( j < trunk->Stems.size() ) {
+      stem_ids[i] = trunk->Stems[j]->ID;
+      continue;
+    }
+    // Stems have IDs without a source, the trunk receives them
+    int id = (mUdpMasterListener != NULL) ?
+          mUdpMasterListener->isNewAddress(trunk->PeerAddress, 0) : -1;
+    if ( id < 0 ) { continue; }
+    HubSession* stem = createSession(id, NULL);
+    if ( stem == NULL ) {
+      mUdpMasterListener->releaseThread(id);
+      continue;
+    }
+    // Set up with the first stem packet
+    stem->StemTrunk = trunk;
+    stem->StemSourceID = source_ids[i];
+    mSessions.append(stem);
+    mSessionsByID[id] = stem;
+    trunk->Stems.append(stem);
+    stem_ids[i] = id;
+  }
+
+  trunk->StemRequestTime = 0;
+  updateTrunkGains(trunk);
+}
+
+
+//*******************************************************************************
+void HubEngine::updateTrunkGains(HubSession* trunk)
+{
+  // The peer hub plays its stems on their own, they're not in its sub-mix
+  // (nor sent back to it)
+  QVarLengthArray<HubGainMessageEntry, 64> gains;
+  HubGainMessageEntry entry;
+  entry.Reserved = 0;
+  entry.Gain = 0.0f;
+  for (int i = 0; i < trunk->Stems.size(); i++) {
+    entry.SourceID = trunk->Stems[i]->ID;
+    gains.append(entry);
+  }
+  for (int i = 0; i < trunk->StemSources.size(); i++) {
+    entry.SourceID = trunk->StemSources[i];
+    gains.append(entry);
+  }
+  applyListenerGains(trunk, gains.constData(), gains.size());
+}
+
+
+//*******************************************************************************
+HubSession* HubEngine::createSession(int id, HubChannel* channel)
+{
+  if ( (id < -1) || (id >= mSessionsByID.size()) ) { return NULL; }
+  HubSession* session = NULL;
+  if ( !mSessionPool.isEmpty() ) {
+    session = mSessionPool.last();
+    mSessionPool.remove(mSessionPool.size() - 1);
+  }
+  else {
+    session = allocateSession();
+  }
+  session->ID = id;
+  session->Channel = channel;
+  // Until the first packet, send to the address and port of the handshake (the
+  // port only changes if the client registers another one, a benign race).
+  // Stems have no channel, their trunk receives them.
+  session->PeerAddress = (channel != NULL) ? channel->Address : 0;
+  session->PeerPort = (channel != NULL) ? channel->Port : 0;
+  session->Connected = false;
+  session->LastPacketTime = PacketHeader::usecTime();
+  if ( channel != NULL ) {
+    channel->Budget.setBudget(gHubIngressDefaultPackets, gHubIngressDefaultBytes,
+                              getPeriodUsec());
+  }
+  session->NumChans = 0;
+  session->PeerBufferSize = 0;
+  session->PeerSampleRate = 0;
+  session->BitResolution = AudioInterface::BIT16;
+  session->PeerPacketSize = 0;
+  session->Redundancy = 1;
+  session->LastSeqNum = 0;
+  session->TimelineStarted = false;
+  session->LastArrivalTime = 0;
+  session->Jitter = 0.0;
+  session->QueueTarget = 0;
+  session->QueueDepth = 0.0;
+  session->ConvertFrames = 0;
+  session->InFifoCapacity = 0;
+  session->InFifoFrames = 0;
+  session->SendSeqNum = 0;
+  session->CustomMix = -1;
+  session->HearsOwnInput = false;
+  session->IsTrunk = false;
+  session->StemTrunk = NULL;
+  session->StemSourceID = -1;
+  session->StemRequestTime = 0;
+  session->ForwardHeader.Magic = gHubForwardMagic;
+  session->ForwardHeader.SourceID = id;
+  session->ForwardHeader.Reserved = 0;
+  session->NumForwardPackets = 0;
+  session->IsAudience = false;
+  session->Underruns = 0;
+  session->Overflows = 0;
+  session->LostPackets = 0;
+  session->LatePackets = 0;
+  session->IngressDrops = 0;
+  session->IngressOffender = false;
+  session->PendingEvents = 0;
+  session->CpuNsec = 0;
+  session->CpuLoad = 0.0;
+
+  if ( id >= 0 ) { queueEvent(SESSION_WAITING, id); }
+  return session;
+}
+
+
+//*******************************************************************************
+void HubEngine::deleteSession(HubSession* session)
+{
+  // No more datagrams go to the channel once it's removed
+  if ( mHubSocket != NULL ) { mHubSocket->removeChannel(session->Channel); }
+  session->Channel = NULL;
+  session->Gains.clear();
+  session->Stems.clear();
+  session->StemSources.clear();
+  session->StemRequest.clear();
+  session->Audience.clear();
+  if ( mSessionPool.size() < mPoolSize ) { mSessionPool.append(session); }
+  else { freeSession(session); }
+}
+
+
+//*******************************************************************************
+HubSession* HubEngine::allocateSession()
+{
+  HubSession* session = new HubSession;
+  session->DecodeBuffer = NULL;
+  session->InConverter = NULL;
+  session->ConvertBuffer = NULL;
+  session->InFifo = NULL;
+  session->InBuffer = NULL;
+  session->OutBuffer = NULL;
+  session->OutConverter = NULL;
+  session->OutAudio = NULL;
+  session->OutReblocker = NULL;
+  session->OutDatagram = NULL;
+  session->DecodeBufferSize = 0;
+  session->ConvertBufferSize = 0;
+  session->InFifoSize = 0;
+  session->InBufferSize = 0;
+  session->OutBufferSize = 0;
+  session->OutAudioSize = 0;
+  session->OutDatagramSize = 0;
+  session->NumForwardPackets = 0;
+  return session;
+}
+
+
+//*******************************************************************************
+void HubEngine::freeSession(HubSession* session)
+{
+  delete[] session->DecodeBuffer;
+  delete session->InConverter;
+  delete[] session->ConvertBuffer;
+  delete[] session->InFifo;
+  delete[] session->InBuffer;
+  delete[] session->OutBuffer;
+  delete session->OutConverter;
+  delete[] session->OutAudio;
+  delete session->OutReblocker;
+  delete[] session->OutDatagram;
+  for (int i = 0; i < session->ForwardPackets.size(); i++) {
+    delete session->ForwardPackets[i]; }
+  delete session;
+}
+
+
+//*******************************************************************************
+// Makes buffer hold at least size elements, reallocating only if it's too
+// small. The contents are not kept.
+template <typename T>
+static void reserveBuffer(T*& buffer, int& allocated_size, int size)
+{
+  if ( allocated_size >= size ) { return; }
+  delete[] buffer;
+  buffer = new T[size];
+  std::memset(buffer, 0, sizeof(T) * size); // touch the pages now, not in the first period
+  allocated_size = size;
+}
+
+
+//*******************************************************************************
+void HubEngine::reserveSessionBuffers(HubSession* session, int num_chans, int peer_frames,
+                                      int bytes_per_sample, int redundancy,
+                                      int max_in_frames, int max_out_frames)
+{
+  // Sized for the longest period, so the period can change without allocating
+  const int period_frames = mMaxPeriodFrames;
+  int convert_frames = (max_in_frames > max_out_frames) ? max_in_frames : max_out_frames;
+  int packet_size = sizeof(DefaultHeaderStruct) + (peer_frames * bytes_per_sample * num_chans);
+
+  reserveBuffer(session->DecodeBuffer, session->DecodeBufferSize, num_chans * peer_frames);
+  reserveBuffer(session->ConvertBuffer, session->ConvertBufferSize, num_chans * convert_frames);
+  reserveBuffer(session->InFifo, session->InFifoSize, num_chans * getInFifoCapacity(max_in_frames));
+  reserveBuffer(session->InBuffer, session->InBufferSize, num_chans * period_frames);
+  reserveBuffer(session->OutBuffer, session->OutBufferSize, num_chans * period_frames);
+  reserveBuffer(session->OutAudio, session->OutAudioSize,
+                num_chans * max_out_frames * bytes_per_sample);
+  reserveBuffer(session->OutDatagram, session->OutDatagramSize, packet_size * redundancy);
+  if ( (session->OutReblocker == NULL) ||
+       !session->OutReblocker->reset(num_chans, bytes_per_sample, peer_frames, max_out_frames) ) {
+    delete session->OutReblocker;
+    session->OutReblocker = new PacketReblocker(num_chans, bytes_per_sample,
+                                                peer_frames, max_out_frames);
+  }
+}
+
+
+//*******************************************************************************
+void HubEngine::reserveForwardPackets(HubSession* session)
+{
+  while ( session->ForwardPackets.size() < gHubForwardPackets ) {
+    HubPacket* packet = new HubPacket;
+    packet->Size = 0;
+    packet->Data = NULL;
+    session->ForwardPackets.append(packet);
+  }
+}
+
+
+//*******************************************************************************
+void HubEngine::releaseSession(int index)
+{
+  HubSession* session = mSessions[index];
+  int id = session->ID;
+  // The stems of a trunk go with it
+  if ( !session->Stems.isEmpty() ) {
+    while ( !session->Stems.isEmpty() ) {
+      releaseSession(mSessions.indexOf(session->Stems.last())); }
+    index = mSessions.indexOf(session);
+  }
+  // A released stem is not muted in the sub-mix anymore (its ID can be reused)
+  HubSession* trunk = session->StemTrunk;
+  if ( trunk != NULL ) {
+    trunk->Stems.remove(trunk->Stems.indexOf(session));
+    trunk->StemRequestTime = 0;
+    updateTrunkGains(trunk);
+  }
+  if ( session->Connected ) { session->PendingEvents |= (1 << SESSION_REMOVED); }
+  queueSessionEvents(session);
+  mSessions.remove(index);
+  mSessionsByID[id] = NULL;
+  deleteSession(session);
+  if ( mUdpMasterListener != NULL ) { mUdpMasterListener->releaseThread(id); }
+}
+
+
+//*******************************************************************************
+void HubEngine::receiveTask(void* context, int task, int worker)
+{
+  HubEngine* engine = static_cast<HubEngine*>(context);
+  HubSession* session = engine->mSessions[task];
+  // Stems are received by their trunk
+  if ( session->StemTrunk != NULL ) { return; }
+  uint64_t start_nsec = threadCpuNsec();
+  engine->receiveSession(session, engine->mPeriodTime, engine->mDatagrams[worker]);
+  if ( session->Connected && !engine->mForwarding ) { engine->pullSessionInput(session); }
+  for (int i = 0; i < session->Stems.size(); i++) {
+    if ( session->Stems[i]->Connected ) { engine->pullSessionInput(session->Stems[i]); }
+  }
+  session->CpuNsec += threadCpuNsec() - start_nsec;
+}
+
+
+//*******************************************************************************
+void HubEngine::sendTask(void* context, int task, int worker)
+{
+  HubEngine* engine = static_cast<HubEngine*>(context);
+  HubSession* session = engine->mSessions[task];
+  // Stems only receive, they're heard in the mix
+  if ( !session->Connected || (session->StemTrunk != NULL) ) { return; }
+  uint64_t start_nsec = threadCpuNsec();
+  if ( engine->mForwarding ) { engine->forwardSession(session); }
+  else { engine->sendSession(session); }
+  if ( session->IsTrunk ) { engine->sendStems(session, engine->mDatagrams[worker]); }
+  session->CpuNsec += threadCpuNsec() - start_nsec;
+}
+
+
+//*******************************************************************************
+void HubEngine::audienceTask(void* context, int task, int /*worker*/)
+{
+  HubEngine* engine = static_cast<HubEngine*>(context);
+  engine->sendSession(engine->mAudienceFormats[task]);
+}
+
+
+//*******************************************************************************
+void HubEngine::computeTaskCosts()
+{
+  // Relative cost: channels, times 4 with sample rate conversion, plus the
+  // (slower) 24 bits conversion. Forwarding is only I/O, the same for everyone.
+  for (int i = 0; i < mSessions.size(); i++) {
+    const HubSession* session = mSessions[i];
+    if ( (session->StemTrunk != NULL) || mForwarding ) { mTaskCosts[i] = 1; continue; }
+    int cost = 1 + ( session->NumChans * ((session->InConverter != NULL) ? 4 : 1) );
+    if ( session->BitResolution == AudioInterface::BIT24 ) { cost += session->NumChans; }
+    // A trunk also decodes its stems and encodes the ones of the peer hub
+    if ( session->IsTrunk ) {
+      cost += (session->Stems.size() + session->StemSources.size()) * session->NumChans; }
+    mTaskCosts[i] = cost;
+  }
+}
+
+
+//*******************************************************************************
+void HubEngine::accountSessionLoads()
+{
+  // CPU time of the period, smoothed over about 64 periods as the engine load
+  uint64_t period_nsec = (static_cast<uint64_t>(mPeriodFrames) * 1000000000ULL) / mSampleRate;
+  double total_load = 0.0;
+  int num_connected = 0;
+  for (int i = 0; i < mSessions.size(); i++) {
+    HubSession* session = mSessions[i];
+    session->CpuLoad +=
+        ( (static_cast<double>(session->CpuNsec) / period_nsec) - session->CpuLoad ) / 64.0;
+    session->CpuNsec = 0;
+    if ( session->Connected && (session->StemTrunk == NULL) ) {
+      total_load += session->CpuLoad;
+      num_connected++;
+    }
+  }
+  mSessionLoad = (num_connected == 0) ? 0 :
+      static_cast<int>( (total_load * 1000.0) / num_connected );
+}
+
+
+//*******************************************************************************
+void HubEngine::updateOverloadLevel()
+{
+  // One step at a time: down after gHubOverloadHoldTime over gHubOverloadLoad,
+  // up after gHubRecoverTime under gHubRecoverLoad, so the level doesn't flap
+  uint64_t now = PacketHeader::usecTime();
+  int level = mOverloadLevel;
+  int new_level = level;
+  // With the long period the load is a fraction of a longer period, it's
+  // compared as if the period was back to normal
+  int recover_load = (level >= LONG_PERIOD) ? (mLoad * gHubLongPeriodFactor) : mLoad;
+  if ( recover_load < gHubRecoverLoad ) {
+    if ( mLowLoadTime == 0 ) { mLowLoadTime = now; }
+  }
+  else { mLowLoadTime = 0; }
+
+  if ( (mLoad > gHubOverloadLoad) && (level < LONG_PERIOD) &&
+       ((now - mOverloadLevelTime) > (static_cast<uint64_t>(gHubOverloadHoldTime) * 1000)) ) {
+    new_level = level + 1;
+  }
+  else if ( (mLowLoadTime != 0) && (level > FULL_QUALITY) &&
+            ((now - mLowLoadTime) > (static_cast<uint64_t>(gHubRecoverTime) * 1000)) &&
+            ((now - mOverloadLevelTime) > (static_cast<uint64_t>(gHubRecoverTime) * 1000)) ) {
+    new_level = level - 1;
+  }
+  if ( new_level == level ) { return; }
+
+  // Custom mixes are dropped by computeCustomMixes, the other steps are applied here
+  if ( (level < LOW_RESOLUTION_SRC) != (new_level < LOW_RESOLUTION_SRC) ) {
+    mSrcTapsPerPhase = (new_level >= LOW_RESOLUTION_SRC) ?
+          gHubLowSrcTapsPerPhase : gDefaultSrcTapsPerPhase;
+    for (int i = 0; i < mSessions.size(); i++) {
+      if ( mSessions[i]->Connected && (mSessions[i]->InConverter != NULL) ) {
+        createSessionConverters(mSessions[i]); }
+    }
+    for (int i = 0; i < mAudienceFormats.size(); i++) {
+      if ( mAudienceFormats[i]->OutConverter != NULL ) {
+        createSessionConverters(mAudienceFormats[i]); }
+    }
+  }
+  if ( (level < LONG_PERIOD) != (new_level < LONG_PERIOD) ) {
+    setPeriodFrames( (new_level >= LONG_PERIOD) ? mMaxPeriodFrames : static_cast<int>(mBufferSize) );
+  }
+
+  mOverloadLevel = new_level;
+  mOverloadLevelTime = now;
+  mLowLoadTime = 0;
+  queueEvent(OVERLOAD_LEVEL, -1, new_level, level, mLoad/10);
+}
+
+
+//*******************************************************************************
+void HubEngine::createSessionConverters(HubSession* session)
+{
+  // Called on setup and when the degradation level changes, not every period
+  delete session->InConverter;
+  delete session->OutConverter;
+  session->InConverter = NULL;
+  session->OutConverter = NULL;
+  if ( session->PeerSampleRate == mSampleRate ) { return; }
+  session->InConverter = new SampleRateConverter(session->NumChans, session->PeerSampleRate,
+                                                 mSampleRate, session->PeerBufferSize,
+                                                 mSrcTapsPerPhase);
+  session->OutConverter = new SampleRateConverter(session->NumChans, mSampleRate,
+                                                  session->PeerSampleRate, mMaxPeriodFrames,
+                                                  mSrcTapsPerPhase);
+}
+
+
+//*******************************************************************************
+void HubEngine::setPeriodFrames(int period_frames)
+{
+  int delta = period_frames - mPeriodFrames;
+  mPeriodFrames = period_frames;
+  mMixer.setBufferSize(period_frames);
+
+  // Longer period: silence in front of each queue, so it can give a whole
+  // period. Shorter period: the extra (oldest) frames are dropped.
+  for (int i = 0; i < mSessions.size(); i++) {
+    HubSession* session = mSessions[i];
+    if ( !session->Connected ) { continue; }
+    const int capacity = session->InFifoCapacity;
+    int shift = delta;
+    if ( shift < -session->InFifoFrames ) { shift = -session->InFifoFrames; }
+    if ( (session->InFifoFrames + shift) > capacity ) { shift = capacity - session->InFifoFrames; }
+    for (int j = 0; j < session->NumChans; j++) {
+      sample_t* channel = session->InFifo + (j*capacity);
+      if ( shift > 0 ) {
+        std::memmove(channel + shift, channel, sizeof(sample_t) * session->InFifoFrames);
+        std::memset(channel, 0, sizeof(sample_t) * shift);
+      }
+      else if ( shift < 0 ) {
+        std::memmove(channel, channel - shift,
+                     sizeof(sample_t) * (session->InFifoFrames + shift));
+      }
+    }
+    session->InFifoFrames += shift;
+    session->QueueDepth += shift;
+  }
+}
+
+
+//*******************************************************************************
+void HubEngine::receiveSession(HubSession* session, uint64_t now, int8_t* datagram)
+{
+  HubDatagramQueue& queue = session->Channel->Queue;
+  uint32_t peer_address;
+  uint16_t peer_port;
+  uint64_t arrival_time;
+  int size;
+  // The packets of the previous period are relayed already, their space in
+  // the queue is given back to the socket thread
+  session->NumForwardPackets = 0;
+  queue.release();
+  // A forwarding engine relays the datagrams from the queue, without copying them
+  int8_t* const buffer = datagram;
+  while ( (size = ( mForwarding ?
+                    queue.hold(datagram, gHubMaxDatagramSize, peer_address, peer_port,
+                               arrival_time) :
+                    queue.pop(buffer, gHubMaxDatagramSize, peer_address, peer_port,
+                              arrival_time) )) != 0 ) {
+    if ( size < 0 ) { continue; } // too large
+
+    // Custom mix request from the client
+    const HubGainMessageHeader* gain_message =
+        reinterpret_cast<const HubGainMessageHeader*>(datagram);
+    if ( (size >= static_cast<int>(sizeof(HubGainMessageHeader))) &&
+         (gain_message->Magic == gHubGainMessageMagic) &&
+         (size == static_cast<int>( sizeof(HubGainMessageHeader) +
+                                    (gain_message->NumGains * sizeof(HubGainMessageEntry)) )) ) {
+      if ( session->Connected ) {
+        applyListenerGains(session, reinterpret_cast<const HubGainMessageEntry*>
+                           (datagram + sizeof(HubGainMessageHeader)),
+                           gain_message->NumGains);
+      }
+      continue;
+    }
+
+    // Stem subscription: of a client, applied by the engine thread, or of
+    // the peer hub of a trunk
+    const HubStemMessageHeader* stem_message =
+        reinterpret_cast<const HubStemMessageHeader*>(datagram);
+    if ( (size >= static_cast<int>(sizeof(HubStemMessageHeader))) &&
+         (stem_message->Magic == gHubStemMessageMagic) &&
+         (size == static_cast<int>( sizeof(HubStemMessageHeader) +
+                                    (stem_message->NumStems * sizeof(uint16_t)) )) ) {
+      const uint16_t* ids = reinterpret_cast<const uint16_t*>
+          (datagram + sizeof(HubStemMessageHeader));
+      int num_stems = (stem_message->NumStems < gHubTrunkMaxStems) ?
+            stem_message->NumStems : gHubTrunkMaxStems;
+      if ( session->IsTrunk ) {
+        session->StemSources.resize(num_stems);
+        for (int i = 0; i < num_stems; i++) { session->StemSources[i] = ids[i]; }
+        updateTrunkGains(session);
+      }
+      else {
+        session->StemRequest.resize(num_stems + 1);
+        session->StemRequest[0] = stem_message->TrunkID;
+        for (int i = 0; i < num_stems; i++) { session->StemRequest[i+1] = ids[i]; }
+      }
+      continue;
+    }
+
+    // Stems the trunk subscribed to
+    if ( session->IsTrunk && (size >= static_cast<int>(sizeof(HubStemHeader))) &&
+         (reinterpret_cast<const HubStemHeader*>(datagram)->Magic == gHubStemMagic) ) {
+      receiveStem(session, datagram, size, now);
+      continue;
+    }
+
+    if ( size < static_cast<int>(sizeof(DefaultHeaderStruct)) ) { continue; }
+    if ( !updateSessionSettings(session, datagram, size) ) { continue; }
+    // The HubSocket only queues datagrams from the client source. We reply to
+    // the same address and port (NAT traversal), which can change if the
+    // client registers a new one.
+    session->PeerAddress = peer_address;
+    session->PeerPort = peer_port;
+    if ( size < session->PeerPacketSize ) { continue; }
+    session->LastPacketTime = now;
+    if ( mForwarding ) {
+      storeForwardPacket(session, datagram, size);
+      continue;
+    }
+
+    // Late (reordered) or repeated datagram, its audio is in the queue already
+    uint16_t newer_seq_num =
+        reinterpret_cast<DefaultHeaderStruct*>(datagram)->SeqNumber;
+    if ( session->TimelineStarted &&
+         (static_cast<int16_t>(newer_seq_num - session->LastSeqNum) <= 0) ) {
+      session->LatePackets++;
+      continue;
+    }
+    // Interarrival jitter (RFC 3550): the packets are one client buffer apart
+    // on the client timeline. It goes up as in the RFC but down 16 times
+    // slower, so the playout delay keeps covering the occasional late packet.
+    if ( session->TimelineStarted ) {
+      double peer_period_usec = (session->PeerBufferSize * 1000000.0) / session->PeerSampleRate;
+      double transit_delta = std::fabs(
+          static_cast<double>( static_cast<int64_t>(arrival_time - session->LastArrivalTime) ) -
+          ( static_cast<int16_t>(newer_seq_num - session->LastSeqNum) * peer_period_usec ) );
+      session->Jitter += (transit_delta - session->Jitter) /
+          ( (transit_delta > session->Jitter) ? 16.0 : 256.0 );
+    }
+    session->LastArrivalTime = arrival_time;
+
+    // Redundancy, same algorithm as UdpDataProtocol::receivePacketRedundancy
+    int num_packets = size / session->PeerPacketSize;
+    uint16_t current_seq_num = newer_seq_num;
+    int redun_last_index = 0;
+    for (int i = 1; i < num_packets; i++) {
+      if ( current_seq_num == static_cast<uint16_t>(session->LastSeqNum+1) ) { break; }
+      redun_last_index = i;
+      current_seq_num = reinterpret_cast<DefaultHeaderStruct*>
+          (datagram + (i*session->PeerPacketSize))->SeqNumber;
+    }
+    // Packets lost beyond the redundancy
+    if ( session->TimelineStarted ) {
+      int lost = static_cast<int16_t>( current_seq_num -
+                                       static_cast<uint16_t>(session->LastSeqNum + 1) );
+      if ( lost > 0 ) { concealPackets(session, lost); }
+    }
+    session->LastSeqNum = newer_seq_num;
+    session->TimelineStarted = true;
+    for (int i = redun_last_index; i >= 0; i--) {
+      decodePacket(session, datagram + (i*session->PeerPacketSize));
+    }
+  }
+
+  // The socket thread drops what's over the client budget, here it's only reported
+  uint32_t ingress_drops = session->Channel->Budget.getDroppedPackets();
+  if ( ingress_drops != session->IngressDrops ) {
+    session->IngressDrops = ingress_drops;
+    if ( !session->IngressOffender ) {
+      session->IngressOffender = true;
+      session->PendingEvents |= (1 << SESSION_OFFENDER);
+    }
+  }
+}
+
+
+//*******************************************************************************
+bool HubEngine::updateSessionSettings(HubSession* session, const int8_t* datagram, int size)
+{
+  const DefaultHeaderStruct* header = reinterpret_cast<const DefaultHeaderStruct*>(datagram);
+  // A client that restarts and resumes its session can come back with other
+  // audio settings, the session is set up again (keeping its mix)
+  if ( session->Connected &&
+       ( (header->BufferSize != session->PeerBufferSize) ||
+         (header->NumChannels != session->NumChans) ||
+         ((header->BitResolution/8) != session->BitResolution) ||
+         (static_cast<uint32_t>( AudioInterface::getSampleRateFromType
+           ( static_cast<AudioInterface::samplingRateT>(header->SamplingRate) ) ) !=
+          session->PeerSampleRate) ) ) {
+    session->Connected = false;
+  }
+  if ( session->Connected ) { return true; }
+
+  HubClientSettings settings;
+  settings.BufferSize = header->BufferSize;
+  settings.SamplingRate = header->SamplingRate;
+  settings.BitResolution = header->BitResolution;
+  settings.NumChannels = header->NumChannels;
+  settings.Redundancy = 1;
+  int packet_size = sizeof(DefaultHeaderStruct) +
+      (settings.BufferSize * (settings.BitResolution/8) * settings.NumChannels);
+  if ( size < packet_size ) { return false; }
+  if ( packet_size > static_cast<int>(sizeof(DefaultHeaderStruct)) ) {
+    settings.Redundancy = size / packet_size; }
+  if ( !setupSession(session, settings) ) { return false; }
+  session->Connected = true;
+  return true;
+}
+
+
+//*******************************************************************************
+void HubEngine::receiveStem(HubSession* trunk, const int8_t* datagram, int size, uint64_t now)
+{
+  const HubStemHeader* stem_header = reinterpret_cast<const HubStemHeader*>(datagram);
+  HubSession* stem = NULL;
+  for (int i = 0; i < trunk->Stems.size(); i++) {
+    if ( trunk->Stems[i]->StemSourceID == stem_header->SourceID ) {
+      stem = trunk->Stems[i];
+      break;
+    }
+  }
+  // Not subscribed (anymore)
+  if ( stem == NULL ) { return; }
+
+  // One packet, without redundancy
+  const int8_t* packet = datagram + sizeof(HubStemHeader);
+  int packet_size = size - static_cast<int>(sizeof(HubStemHeader));
+  if ( packet_size < static_cast<int>(sizeof(DefaultHeaderStruct)) ) { return; }
+  if ( !updateSessionSettings(stem, packet, packet_size) ) { return; }
+  if ( packet_size < stem->PeerPacketSize ) { return; }
+  stem->LastPacketTime = now;
+  stem->LastSeqNum = reinterpret_cast<const DefaultHeaderStruct*>(packet)->SeqNumber;
+  decodePacket(stem, packet);
+}
+
+
+//*******************************************************************************
+bool HubEngine::checkClientSettings(const HubClientSettings& settings)
+{
+  int bytes_per_sample = settings.BitResolution / 8;
+  uint32_t peer_sample_rate = AudioInterface::getSampleRateFromType
+      ( static_cast<AudioInterface::samplingRateT>(settings.SamplingRate) );
+  if ( (settings.BufferSize <= 0) || (settings.NumChannels <= 0) ||
+       (peer_sample_rate == 0) || (bytes_per_sample < 1) || (bytes_per_sample > 4) ||
+       (settings.Redundancy < 1) ) {
+    return false;
+  }
+  // The redundant datagrams have to fit in one UDP datagram
+  int packet_size = sizeof(DefaultHeaderStruct) +
+      (settings.BufferSize * bytes_per_sample * settings.NumChannels);
+  return ( (packet_size * settings.Redundancy) <= gHubMaxDatagramSize );
+}
+
+
+//*******************************************************************************
+bool HubEngine::setupSession(HubSession* session, const HubClientSettings& settings)
+{
+  // Called by the session tasks too, the events are only recorded
+  if ( !checkClientSettings(settings) ) {
+    session->PendingEvents |= (1 << SESSION_UNSUPPORTED);
+    return false;
+  }
+  int bytes_per_sample = settings.BitResolution / 8;
+  uint32_t peer_sample_rate = AudioInterface::getSampleRateFromType
+      ( static_cast<AudioInterface::samplingRateT>(settings.SamplingRate) );
+
+  session->NumChans = settings.NumChannels;
+  session->PeerBufferSize = settings.BufferSize;
+  session->PeerSampleRate = peer_sample_rate;
+  session->BitResolution = static_cast<AudioInterface::audioBitResolutionT>(bytes_per_sample);
+  session->PeerPacketSize = sizeof(DefaultHeaderStruct) +
+      (session->PeerBufferSize * bytes_per_sample * session->NumChans);
+  session->Redundancy = settings.Redundancy;
+
+  const int num_chans = session->NumChans;
+  const int period_frames = mPeriodFrames;
+  // Forwarding: the datagrams are relayed from the input queue, no audio buffers
+  if ( mForwarding ) { reserveForwardPackets(session); }
+  else {
+    int max_in_frames = session->PeerBufferSize;
+    int max_out_frames = mMaxPeriodFrames;
+    // Converters depend on the client rate, they're not pooled
+    createSessionConverters(session);
+    if ( session->InConverter != NULL ) {
+      max_in_frames = session->InConverter->getMaxOutputFrames(session->PeerBufferSize);
+      max_out_frames = session->OutConverter->getMaxOutputFrames(mMaxPeriodFrames);
+    }
+    session->ConvertFrames = (max_in_frames > max_out_frames) ? max_in_frames : max_out_frames;
+
+    // A pooled session already has large enough buffers
+    reserveSessionBuffers(session, num_chans, session->PeerBufferSize, bytes_per_sample,
+                          session->Redundancy, max_in_frames, max_out_frames);
+    // The input queue starts half full, as the RingBuffer
+    session->InFifoCapacity = getInFifoCapacity(max_in_frames);
+    std::memset(session->InFifo, 0, sizeof(sample_t) * num_chans * session->InFifoCapacity);
+    session->InFifoFrames = getQueueTarget();
+    // The room playout delay until the jitter of the client is known
+    session->TimelineStarted = false;
+    session->Jitter = (session->PeerBufferSize * 1000000.0) / peer_sample_rate;
+    session->QueueTarget = getQueueTarget();
+    session->QueueDepth = session->QueueTarget;
+    std::memset(session->InBuffer, 0, sizeof(sample_t) * num_chans * period_frames);
+    std::memset(session->OutBuffer, 0, sizeof(sample_t) * num_chans * period_frames);
+    std::memset(session->OutDatagram, 0, session->PeerPacketSize * session->Redundancy);
+    session->Levels.resize(num_chans);
+    std::memset(session->Levels.data(), 0, sizeof(HubLevel) * num_chans);
+  }
+
+  // Receive budget: the datagrams the client sends in one hub period (at
+  // least one), with some headroom, plus a few control datagrams
+  int datagram_size = session->PeerPacketSize * session->Redundancy;
+  int datagrams = static_cast<int>(
+        ( (static_cast<uint64_t>(mBufferSize) * peer_sample_rate) +
+          (static_cast<uint64_t>(mSampleRate) * session->PeerBufferSize) - 1 ) /
+        (static_cast<uint64_t>(mSampleRate) * session->PeerBufferSize) );
+  int budget_packets = (datagrams * gHubIngressHeadroom) + gHubIngressExtraPackets;
+  int budget_bytes = budget_packets * datagram_size;
+  if ( session->IsTrunk ) {
+    // The peer hub also sends up to gHubTrunkMaxStems stems, one packet per period each
+    int stem_packets = datagrams * gHubIngressHeadroom * gHubTrunkMaxStems;
+    budget_packets += stem_packets;
+    budget_bytes += stem_packets * (sizeof(HubStemHeader) + session->PeerPacketSize);
+  }
+  // Stems have no channel, they're in the budget of their trunk
+  if ( session->Channel != NULL ) {
+    session->Channel->Budget.setBudget(budget_packets, budget_bytes, getPeriodUsec()); }
+
+  session->PendingEvents |= (1 << SESSION_CONNECTED);
+  return true;
+}
+
+
+//*******************************************************************************
+void HubEngine::concealPackets(HubSession* session, int num_packets)
+{
+  // As many frames as the lost packets had at the hub rate, but not above the
+  // playout delay: if the queue ran out meanwhile, the underrun played silence already
+  int frames = static_cast<int>( (static_cast<int64_t>(num_packets) * session->PeerBufferSize *
+                                  mSampleRate) / session->PeerSampleRate );
+  int space = session->QueueTarget - session->InFifoFrames;
+  if ( frames > space ) { frames = space; }
+  session->LostPackets += num_packets;
+  if ( frames <= 0 ) { return; }
+
+  const int capacity = session->InFifoCapacity;
+  for (int i = 0; i < session->NumChans; i++) {
+    std::memset(session->InFifo + (i*capacity) + session->InFifoFrames, 0,
+                sizeof(sample_t) * frames);
+  }
+  session->InFifoFrames += frames;
+}
+
+
+//*******************************************************************************
+void HubEngine::updateQueueTarget(HubSession* session)
+{
+  // One period, plus half a client packet (the queue depth before the pull
+  // goes up and down by a packet), plus the jitter margin
+  int packet_frames = static_cast<int>( (static_cast<int64_t>(session->PeerBufferSize) *
+                                         mSampleRate) / session->PeerSampleRate );
+  int jitter_frames = static_cast<int>( std::ceil( (gHubJitterMargin * session->Jitter *
+                                                    mSampleRate) / 1000000.0 ) );
+  int min_target = mPeriodFrames + (packet_frames / 2);
+  int target = min_target + jitter_frames;
+  int room_target = getQueueTarget() + (packet_frames / 2);
+  if ( target > room_target ) { target = room_target; }
+  if ( target < min_target ) { target = min_target; }
+  session->QueueTarget = target;
+}
+
+
+//*******************************************************************************
+void HubEngine::decodePacket(HubSession* session, const int8_t* full_packet)
+{
+  const int num_chans = session->NumChans;
+  const int peer_frames = session->PeerBufferSize;
+  const int bytes_per_sample = session->BitResolution;
+  const int8_t* audio_part = full_packet + sizeof(DefaultHeaderStruct);
+  for (int i = 0; i < num_chans*peer_frames; i++) {
+    AudioInterface::fromBitToSampleConversion(audio_part + (i*bytes_per_sample),
+                                              session->DecodeBuffer + i,
+                                              session->BitResolution);
+  }
+
+  // Convert to the hub sample rate
+  const sample_t* input = session->DecodeBuffer;
+  int num_frames = peer_frames;
+  int input_stride = peer_frames;
+  if ( session->InConverter != NULL ) {
+    QVarLengthArray<const sample_t*, 16> in_channels(num_chans);
+    QVarLengthArray<sample_t*, 16> out_channels(num_chans);
+    for (int i = 0; i < num_chans; i++) {
+      in_channels[i] = session->DecodeBuffer + (i*peer_frames);
+      out_channels[i] = session->ConvertBuffer + (i*session->ConvertFrames);
+    }
+    num_frames = session->InConverter->process(in_channels.data(), peer_frames,
+                                               out_channels.data());
+    input = session->ConvertBuffer;
+    input_stride = session->ConvertFrames;
+  }
+
+  // Queue overflow: drop the oldest frames down to the playout delay
+  const int capacity = session->InFifoCapacity;
+  if ( (session->InFifoFrames + num_frames) > capacity ) {
+    int keep = session->QueueTarget;
+    if ( (keep + num_frames) > capacity ) { keep = capacity - num_frames; }
+    int drop = session->InFifoFrames - keep;
+    for (int i = 0; i < num_chans; i++) {
+      sample_t* channel = session->InFifo + (i*capacity);
+      std::memmove(channel, channel + drop, sizeof(sample_t) * keep);
+    }
+    session->InFifoFrames = keep;
+    session->Overflows++;
+  }
+
+  for (int i = 0; i < num_chans; i++) {
+    std::memcpy(session->InFifo + (i*capacity) + session->InFifoFrames,
+                input + (i*input_stride), sizeof(sample_t) * num_frames);
+  }
+  session->InFifoFrames += num_frames;
+}
+
+
+//*******************************************************************************
+void HubEngine::pullSessionInput(HubSession* session)
+{
+  const int num_chans = session->NumChans;
+  const int buffer_size = mPeriodFrames;
+  const int capacity = session->InFifoCapacity;
+  updateQueueTarget(session);
+
+  if ( session->InFifoFrames < buffer_size ) {
+    // Underrun: play silence and re-build the queue to the playout delay with
+    // silence in front of what's left, so the client keeps its latency
+    std::memset(session->InBuffer, 0, sizeof(sample_t) * num_chans * buffer_size);
+    session->QueueDepth = session->QueueTarget;
+    int pad = session->QueueTarget - session->InFifoFrames;
+    if ( pad > 0 ) {
+      for (int i = 0; i < num_chans; i++) {
+        sample_t* channel = session->InFifo + (i*capacity);
+        std::memmove(channel + pad, channel, sizeof(sample_t) * session->InFifoFrames);
+        std::memset(channel, 0, sizeof(sample_t) * pad);
+      }
+      session->InFifoFrames += pad;
+    }
+    session->Underruns++;
+    return;
+  }
+
+  // Keep the queue at the playout delay: one frame dropped (skip 1) or
+  // repeated (skip -1) per period, instead of waiting for an overflow or an
+  // underrun. The smoothed depth follows the correction right away.
+  session->QueueDepth += (session->InFifoFrames - session->QueueDepth) / 64.0;
+  const double deadband = (mPeriodFrames / 16) + 1;
+  int skip = 0;
+  if ( (session->QueueDepth > (session->QueueTarget + deadband)) &&
+       (session->InFifoFrames > buffer_size) ) { skip = 1; }
+  else if ( session->QueueDepth < (session->QueueTarget - deadband) ) { skip = -1; }
+  session->QueueDepth -= skip;
+
+  const int remaining = session->InFifoFrames - (buffer_size + skip);
+  for (int i = 0; i < num_chans; i++) {
+    sample_t* channel = session->InFifo + (i*capacity);
+    sample_t* in_buffer = session->InBuffer + (i*buffer_size);
+    if ( skip < 0 ) {
+      in_buffer[0] = channel[0];
+      std::memcpy(in_buffer + 1, channel, sizeof(sample_t) * (buffer_size - 1));
+    }
+    else {
+      std::memcpy(in_buffer, channel + skip, sizeof(sample_t) * buffer_size);
+    }
+    std::memmove(channel, channel + (buffer_size + skip), sizeof(sample_t) * remaining);
+  }
+  session->InFifoFrames = remaining;
+}
+
+
+//*******************************************************************************
+void HubEngine::processSessions()
+{
+  // A forwarding engine relays the packets as they are, there's no mix
+  if ( mForwarding ) {
+    referenceForwardPackets();
+    return;
+  }
+
+  // The bus has as many channels as the client with more channels
+  int num_bus_chans = 1;
+  for (int i = 0; i < mSessions.size(); i++) {
+    if ( mSessions[i]->Connected && (mSessions[i]->NumChans > num_bus_chans) ) {
+      num_bus_chans = mSessions[i]->NumChans; }
+  }
+
+  // Every client is added once, the feeds are computed in sendSession. The
+  // levels are measured in the same pass, the bus ones with the last client.
+  mMixer.clearBus(num_bus_chans);
+  if ( mBusLevels.size() < num_bus_chans ) {
+    int old_size = mBusLevels.size();
+    mBusLevels.resize(num_bus_chans);
+    std::memset(mBusLevels.data() + old_size, 0, sizeof(HubLevel) * (num_bus_chans - old_size));
+  }
+  int last_session = -1;
+  for (int i = 0; i < mSessions.size(); i++) {
+    if ( mSessions[i]->Connected ) { last_session = i; }
+  }
+  for (int i = 0; i <= last_session; i++) {
+    if ( mSessions[i]->Connected ) {
+      mMixer.addToBus(mSessions[i]->InBuffer, mSessions[i]->NumChans, mSessions[i]->Levels.data(),
+                      (i == last_session) ? mBusLevels.data() : NULL);
+    }
+  }
+  mMeterFrames += mPeriodFrames;
+
+  computeCustomMixes();
+}
+
+
+//*******************************************************************************
+void HubEngine::publishLevels()
+{
+  // Nothing measured (forwarding engine)
+  if ( mMeterFrames == 0 ) { return; }
+  const double inv_frames = 1.0 / mMeterFrames;
+  HubMeterReading* readings = mMeterReadings.data();
+
+  // Seqlock: the readers retry if the sequence is odd or changed during their copy
+  mMeterSequence.fetchAndAddOrdered(1);
+  int num_readings = 0;
+  for (int i = 0; (i < mMixer.getNumBusChannels()) && (num_readings < gHubMeterMaxReadings); i++) {
+    HubMeterReading& reading = readings[num_readings++];
+    reading.SessionID = -1;
+    reading.Channel = i;
+    reading.Peak = mBusLevels[i].Peak;
+    reading.Rms = std::sqrt(mBusLevels[i].SumSquares * inv_frames);
+  }
+  for (int i = 0; i < mSessions.size(); i++) {
+    const HubSession* session = mSessions[i];
+    if ( !session->Connected ) { continue; }
+    for (int j = 0; (j < session->NumChans) && (num_readings < gHubMeterMaxReadings); j++) {
+      HubMeterReading& reading = readings[num_readings++];
+      reading.SessionID = session->ID;
+      reading.Channel = j;
+      reading.Peak = session->Levels[j].Peak;
+      reading.Rms = std::sqrt(session->Levels[j].SumSquares * inv_frames);
+    }
+  }
+  mNumMeterReadings = num_readings;
+  mMeterSequence.fetchAndAddOrdered(1);
+
+  // New interval
+  std::memset(mBusLevels.data(), 0, sizeof(HubLevel) * mBusLevels.size());
+  for (int i = 0; i < mSessions.size(); i++) {
+    std::memset(mSessions[i]->Levels.data(), 0, sizeof(HubLevel) * mSessions[i]->Levels.size());
+  }
+  mMeterFrames = 0;
+}
+
+
+//*******************************************************************************
+bool HubEngine::getLevels(QVector<HubMeterReading>& readings) const
+{
+  for (int attempt = 0; attempt < gHubMeterReadAttempts; attempt++) {
+    int sequence = mMeterSequence.fetchAndAddAcquire(0);
+    if ( (sequence & 1) != 0 ) {
+      yieldCurrentThread();
+      continue;
+    }
+    int num_readings = mNumMeterReadings;
+    readings.resize(num_readings);
+    std::memcpy(readings.data(), mMeterReadings.constData(),
+                sizeof(HubMeterReading) * num_readings);
+    if ( mMeterSequence.fetchAndAddOrdered(0) == sequence ) { return true; }
+  }
+  readings.clear();
+  return false;
+}
+
+
+//*******************************************************************************
+void HubEngine::queueEvent(int type, int session_id, int value0, int value1, int value2)
+{
+  HubEngineEvent event;
+  std::memset(&event, 0, sizeof(event));
+  event.Type = type;
+  event.SessionID = session_id;
+  event.Values[0] = value0;
+  event.Values[1] = value1;
+  event.Values[2] = value2;
+  // Never wait for the listener thread, the queue counts what it drops
+  mEvents.push(reinterpret_cast<const int8_t*>(&event), sizeof(event), 0, 0, 0);
+}
+
+
+//*******************************************************************************
+void HubEngine::queueSessionEvents(HubSession* session)
+{
+  const int id = session->IsAudience ? -1 : session->ID;
+  for (int type = 0; type < NUM_ENGINE_EVENTS; type++) {
+    if ( (session->PendingEvents & (1 << type)) == 0 ) { continue; }
+    HubEngineEvent event;
+    std::memset(&event, 0, sizeof(event));
+    event.Type = type;
+    event.SessionID = id;
+    if ( type == SESSION_CONNECTED ) {
+      event.Values[0] = session->NumChans;
+      event.Values[1] = static_cast<int>(session->PeerSampleRate);
+      event.Values[2] = session->PeerBufferSize;
+      event.Values[3] = session->BitResolution * 8;
+      event.Values[4] = session->Redundancy;
+    }
+    else if ( type == SESSION_REMOVED ) {
+      event.Values[0] = static_cast<int>(session->Underruns);
+      event.Values[1] = static_cast<int>(session->Overflows);
+      event.Values[2] = static_cast<int>(session->LostPackets);
+      event.Values[3] = static_cast<int>(session->LatePackets);
+      event.Values[4] = static_cast<int>(session->IngressDrops);
+      event.Values[5] = static_cast<int>(session->CpuLoad * 100.0);
+    }
+    mEvents.push(reinterpret_cast<const int8_t*>(&event), sizeof(event), 0, 0, 0);
+  }
+  session->PendingEvents = 0;
+}
+
+
+//*******************************************************************************
+void HubEngine::printEvents()
+{
+  const char* level_names[] = { "full quality", "no custom mixes",
+                                "low resolution sample rate conversion", "long period" };
+  HubEngineEvent event;
+  uint32_t address;
+  uint16_t port;
+  uint64_t arrival_time;
+  while ( mEvents.pop(reinterpret_cast<int8_t*>(&event), sizeof(event),
+                      address, port, arrival_time) > 0 ) {
+    const int* values = event.Values;
+    switch ( event.Type ) {
+    case SESSION_WAITING:
+      cout << "JackTrip HUB SERVER: Client ID = " << event.SessionID
+           << " waiting for audio" << endl;
+      break;
+    case SESSION_CONNECTED:
+      if ( event.SessionID < 0 ) { cout << "JackTrip HUB SERVER: Audience format: "; }
+      else { cout << "JackTrip HUB SERVER: Client ID = " << event.SessionID << " connected: "; }
+      cout << values[0] << " channels, " << values[1] << " Hz, " << values[2] << " samples, "
+           << values[3] << " bits, redundancy " << values[4] << endl;
+      break;
+    case SESSION_UNSUPPORTED:
+      std::cerr << "JackTrip HUB SERVER: Client ID = " << event.SessionID
+                << " has unsupported audio settings" << endl;
+      break;
+    case SESSION_OFFENDER:
+      cout << "JackTrip HUB SERVER: Client ID = " << event.SessionID
+           << " sends more than its settings need, excess datagrams are dropped" << endl;
+      break;
+    case SESSION_TIMEOUT:
+      cout << "JackTrip HUB SERVER: Client ID = " << event.SessionID
+           << " is not sending packets (timeout)" << endl;
+      break;
+    case SESSION_REMOVED:
+      cout << "JackTrip HUB SERVER: Client ID = " << event.SessionID << " removed ("
+           << values[0] << " underruns, " << values[1] << " overflows, " << values[2]
+           << " lost and " << values[3] << " late packets, " << values[4]
+           << " datagrams over budget, " << values[5] << "% CPU)" << endl;
+      break;
+    case AUDIENCE_FULL:
+      std::cerr << "JackTrip HUB SERVER: Too many audience formats, listener rejected" << endl;
+      break;
+    case OVERLOAD_LEVEL:
+      cout << "JackTrip HUB SERVER: Engine " << ((values[0] > values[1]) ? "overloaded" : "recovered")
+           << " (load " << values[2] << "%), now running with " << level_names[values[0]] << endl;
+      break;
+    case SLACK:
+      cout << "JackTrip HUB SERVER: Slack " << values[0] << " usec (min "
+           << values[1] << " usec), " << values[2] << " missed deadlines" << endl;
+      break;
+    case CPU_PINNED:
+      if ( values[1] != 0 ) {
+        cout << "JackTrip HUB SERVER: Engine pinned to CPU " << values[0] << endl; }
+      else {
+        std::cerr << "JackTrip HUB SERVER: Could not pin the engine to CPU " << values[0] << endl; }
+      break;
+    default:
+      break;
+    }
+  }
+  uint32_t dropped = mEvents.getDropped();
+  if ( dropped != mDroppedEvents ) {
+    cout << "JackTrip HUB SERVER: " << (dropped - mDroppedEvents)
+         << " engine events not printed (queue full)" << endl;
+    mDroppedEvents = dropped;
+  }
+}
+
+
+//*******************************************************************************
+void HubEngine::applyListenerGains(HubSession* session, const HubGainMessageEntry* gains,
+                                   int num_gains)
+{
+  QVector<HubGainState>& states = session->Gains;
+
+  // Sources that are not in the new gains go back to their default gain
+  // (unity, or silence for the listener itself)
+  for (int i = 0; i < states.size(); i++) {
+    states[i].Target = (states[i].SourceID == session->ID) ? 0.0 : 1.0;
+  }
+  for (int i = 0; i < num_gains; i++) {
+    int source_id = gains[i].SourceID;
+    // Ignore unknown IDs and gains that are not finite (or way too loud)
+    if ( (source_id >= mSessionsByID.size()) || !(std::fabs(gains[i].Gain) <= 16.0f) ) {
+      continue; }
+    int j = 0;
+    while ( (j < states.size()) && (states[j].SourceID != source_id) ) { j++; }
+    if ( j == states.size() ) {
+      HubGainState state;
+      state.SourceID = source_id;
+      state.Current = (source_id == session->ID) ? 0.0 : 1.0;
+      states.append(state);
+    }
+    states[j].Target = gains[i].Gain;
+  }
+  for (int i = 0; i < states.size(); i++) {
+    states[i].Step = (states[i].Target - states[i].Current) / mGainRampPeriods;
+  }
+}
+
+
+//*******************************************************************************
+void HubEngine::computeCustomMixes()
+{
+  // Overloaded engine: everyone gets the plain mix-minus, the gains are
+  // kept for when it recovers. Trunks keep their mix, or the peer hubs would
+  // get their own stems back.
+  const bool drop_custom_mixes = (mOverloadLevel >= NO_CUSTOM_MIXES);
+
+  // Listeners with the same gains (and not ramping) share the same custom mix.
+  // The gains are compared with the ones of the listeners already mixed,
+  // there are only a few distinct mixes in a room.
+  QVarLengthArray<bool, 64> shareable_mix(mSessions.size());
+  for (int i = 0; i < mSessions.size(); i++) {
+    HubSession* session = mSessions[i];
+    session->CustomMix = -1;
+    shareable_mix[i] = false;
+    if ( !session->Connected || session->Gains.isEmpty() ) { continue; }
+    if ( drop_custom_mixes && !session->IsTrunk ) {
+      session->HearsOwnInput = false;
+      continue;
+    }
+
+    const QVector<HubGainState>& gains = session->Gains;
+    bool ramping = false;
+    for (int k = 0; k < gains.size(); k++) {
+      if ( gains[k].Current != gains[k].Target ) { ramping = true; break; }
+    }
+    session->HearsOwnInput = false;
+    for (int k = 0; k < gains.size(); k++) {
+      if ( gains[k].SourceID == session->ID ) { session->HearsOwnInput = true; }
+    }
+
+    if ( !ramping ) {
+      for (int j = 0; j < i; j++) {
+        const HubSession* other = mSessions[j];
+        if ( shareable_mix[j] && (other->Gains.size() == gains.size()) ) {
+          bool same_gains = true;
+          for (int k = 0; (k < gains.size()) && same_gains; k++) {
+            same_gains = (other->Gains[k].SourceID == gains[k].SourceID) &&
+                (other->Gains[k].Current == gains[k].Current);
+          }
+          if ( same_gains ) { session->CustomMix = other->CustomMix; break; }
+        }
+      }
+    }
+    if ( session->CustomMix < 0 ) {
+      session->CustomMix = computeCustomMix(session);
+      shareable_mix[i] = !ramping;
+    }
+  }
+}
+
+
+//*******************************************************************************
+int HubEngine::computeCustomMix(HubSession* session)
+{
+  QVector<HubGainState>& gains = session->Gains;
+  const int max_sources = gains.size();
+  QVarLengthArray<const sample_t*, 32> inputs(max_sources);
+  QVarLengthArray<int, 32> num_chans(max_sources);
+  QVarLengthArray<sample_t, 32> gains_start(max_sources);
+  QVarLengthArray<sample_t, 32> gains_end(max_sources);
+
+  // The bus already has every source at unity gain, so the custom mix
+  // only holds (gain-1)*input
+  int num_sources = 0;
+  for (int k = 0; k < gains.size(); k++) {
+    HubGainState& state = gains[k];
+    sample_t start = state.Current;
+    sample_t end = state.Current + state.Step;
+    if ( ((state.Step > 0.0) && (end > state.Target)) ||
+         ((state.Step < 0.0) && (end < state.Target)) || (state.Step == 0.0) ) {
+      end = state.Target;
+    }
+    state.Current = end;
+
+    int id = state.SourceID;
+    if ( (id < 0) || (id >= mSessionsByID.size()) ) { continue; }
+    const HubSession* source = mSessionsByID[id];
+    if ( (source == NULL) || !source->Connected ) { continue; }
+    if ( (start == 1.0) && (end == 1.0) ) { continue; }
+    inputs[num_sources] = source->InBuffer;
+    num_chans[num_sources] = source->NumChans;
+    gains_start[num_sources] = start - 1.0;
+    gains_end[num_sources] = end - 1.0;
+    num_sources++;
+  }
+
+  // Drop the sources that are back to their default gain
+  for (int k = gains.size()-1; k >= 0; k--) {
+    sample_t default_gain = (gains[k].SourceID == session->ID) ? 0.0 : 1.0;
+    if ( (gains[k].Current == default_gain) && (gains[k].Target == default_gain) ) {
+      gains.remove(k); }
+  }
+
+  int custom_mix = mMixer.createCustomMix();
+  mMixer.addToCustomMix(custom_mix, inputs.constData(), num_chans.constData(),
+                        gains_start.constData(), gains_end.constData(), num_sources);
+  return custom_mix;
+}
+
+
+//*******************************************************************************
+void HubEngine::sendSession(HubSession* session)
+{
+  const int num_chans = session->NumChans;
+  const int bytes_per_sample = session->BitResolution;
+
+  const int period_frames = mPeriodFrames;
+  int num_frames = period_frames;
+  if ( session->OutConverter == NULL ) {
+    // Mix-minus encoded straight into the client bit resolution
+    // OutBuffer is not used without conversion, it's the scratch channel
+    mMixer.computeMixMinusPacket(session->InBuffer, num_chans, session->OutAudio,
+                                 session->BitResolution, session->OutBuffer,
+                                 session->CustomMix, session->HearsOwnInput);
+  }
+  else {
+    // Mix-minus, converted to the client sample rate and then encoded
+    mMixer.computeMixMinus(session->InBuffer, num_chans, session->OutBuffer,
+                           session->CustomMix, session->HearsOwnInput);
+    QVarLengthArray<const sample_t*, 16> in_channels(num_chans);
+    QVarLengthArray<sample_t*, 16> out_channels(num_chans);
+    for (int i = 0; i < num_chans; i++) {
+      in_channels[i] = session->OutBuffer + (i*period_frames);
+      out_channels[i] = session->ConvertBuffer + (i*session->ConvertFrames);
+    }
+    num_frames = session->OutConverter->process(in_channels.data(), period_frames,
+                                                out_channels.data());
+    HubMixer::encodeAudioPacket(session->ConvertBuffer, session->ConvertFrames,
+                                num_frames, num_chans, session->OutAudio,
+                                session->BitResolution);
+  }
+
+  // Re-block to the client buffer size and send, with the client redundancy
+  // (see the redundancy algorithm in UdpDataProtocol)
+  session->OutReblocker->insertPeerPacket(session->OutAudio, num_frames);
+  const int packet_size = session->PeerPacketSize;
+  while ( session->OutReblocker->getStagedFrames() >= session->PeerBufferSize ) {
+    std::memmove(session->OutDatagram + packet_size, session->OutDatagram,
+                 packet_size * (session->Redundancy-1));
+
+    DefaultHeaderStruct header;
+    header.TimeStamp = PacketHeader::usecTime();
+    header.SeqNumber = session->SendSeqNum++;
+    header.BufferSize = session->PeerBufferSize;
+    header.SamplingRate = AudioInterface::getSampleRateTypeFromRate(session->PeerSampleRate);
+    header.BitResolution = bytes_per_sample * 8;
+    header.NumChannels = num_chans;
+    header.ConnectionMode = static_cast<int>(JackTrip::NORMAL);
+    std::memcpy(session->OutDatagram, &header, sizeof(DefaultHeaderStruct));
+    session->OutReblocker->readLocalSlot(session->OutDatagram + sizeof(DefaultHeaderStruct));
+
+    if ( session->IsAudience ) {
+      sendToAudience(session, session->OutDatagram, packet_size * session->Redundancy); }
+    else {
+      mHubSocket->sendDatagram(session->OutDatagram, packet_size * session->Redundancy,
+                               session->PeerAddress, session->PeerPort);
+    }
+  }
+}
+
+
+//*******************************************************************************
+void HubEngine::sendToAudience(const HubSession* format, const int8_t* datagram, int size)
+{
+  // The same datagram for every listener, one iovec each
+  HubSendEntry entries[gHubSendBatchSize];
+  int num_entries = 0;
+  for (int i = 0; i < format->Audience.size(); i++) {
+    HubSendEntry& entry = entries[num_entries++];
+    entry.Header = NULL;
+    entry.HeaderSize = 0;
+    entry.Payload = datagram;
+    entry.PayloadSize = size;
+    entry.Address = format->Audience[i].Address;
+    entry.Port = format->Audience[i].Port;
+    if ( num_entries == gHubSendBatchSize ) {
+      mHubSocket->sendDatagrams(entries, num_entries);
+      num_entries = 0;
+    }
+  }
+  if ( num_entries > 0 ) { mHubSocket->sendDatagrams(entries, num_entries); }
+}
+
+
+//*******************************************************************************
+void HubEngine::sendStems(HubSession* trunk, int8_t* datagram)
+{
+  // Subscription of the stems this hub wants, when it changed, and
+  // refreshed in case the peer hub restarted
+  if ( (trunk->StemRequestTime == 0) ||
+       ( !trunk->Stems.isEmpty() &&
+         ((mPeriodTime - trunk->StemRequestTime) >
+          (static_cast<uint64_t>(gHubStemRefreshTime) * 1000)) ) ) {
+    HubStemMessageHeader* message = reinterpret_cast<HubStemMessageHeader*>(datagram);
+    message->Magic = gHubStemMessageMagic;
+    message->TrunkID = trunk->ID;
+    message->NumStems = trunk->Stems.size();
+    uint16_t* ids = reinterpret_cast<uint16_t*>(datagram + sizeof(HubStemMessageHeader));
+    for (int i = 0; i < trunk->Stems.size(); i++) { ids[i] = trunk->Stems[i]->StemSourceID; }
+    mHubSocket->sendDatagram(datagram, sizeof(HubStemMessageHeader) +
+                             (trunk->Stems.size() * sizeof(uint16_t)),
+                             trunk->PeerAddress, trunk->PeerPort);
+    trunk->StemRequestTime = mPeriodTime;
+  }
+  if ( trunk->StemSources.isEmpty() ) { return; }
+
+  // Stems in the format of the sub-mix, one hub period per packet. Source
+  // channel c % NumChans goes to stem channel c, as in the mix bus.
+  const int num_chans = trunk->NumChans;
+  const int bytes_per_sample = trunk->BitResolution;
+  const int period_frames = mPeriodFrames;
+  HubStemHeader stem_header;
+  stem_header.Magic = gHubStemMagic;
+  stem_header.Reserved = 0;
+  DefaultHeaderStruct header;
+  header.TimeStamp = PacketHeader::usecTime();
+  header.SeqNumber = static_cast<uint16_t>(mPeriodCount);
+  header.BufferSize = period_frames;
+  header.SamplingRate = AudioInterface::getSampleRateTypeFromRate(mSampleRate);
+  header.BitResolution = bytes_per_sample * 8;
+  header.NumChannels = num_chans;
+  header.ConnectionMode = static_cast<int>(JackTrip::NORMAL);
+  std::memcpy(datagram + sizeof(HubStemHeader), &header, sizeof(DefaultHeaderStruct));
+  int8_t* audio = datagram + sizeof(HubStemHeader) + sizeof(DefaultHeaderStruct);
+  const int size = sizeof(HubStemHeader) + sizeof(DefaultHeaderStruct) +
+      (num_chans * period_frames * bytes_per_sample);
+
+  for (int i = 0; i < trunk->StemSources.size(); i++) {
+    int id = trunk->StemSources[i];
+    if ( id >= mSessionsByID.size() ) { continue; }
+    // Only the clients of this hub, not the sub-mixes or stems of other hubs
+    const HubSession* source = mSessionsByID[id];
+    if ( (source == NULL) || !source->Connected || source->IsTrunk ||
+         (source->StemTrunk != NULL) ) { continue; }
+    stem_header.SourceID = id;
+    std::memcpy(datagram, &stem_header, sizeof(HubStemHeader));
+    for (int c = 0; c < num_chans; c++) {
+      HubMixer::encodeAudioPacket(source->InBuffer + ((c % source->NumChans) * period_frames),
+                                  period_frames, period_frames, 1,
+                                  audio + (c * period_frames * bytes_per_sample),
+                                  trunk->BitResolution);
+    }
+    mHubSocket->sendDatagram(datagram, size, trunk->PeerAddress, trunk->PeerPort);
+  }
+}
+
+
+//*******************************************************************************
+void HubEngine::storeForwardPacket(HubSession* session, const int8_t* datagram, int size)
+{
+  // More datagrams than a period should have
+  if ( session->NumForwardPackets >= session->ForwardPackets.size() ) {
+    session->Overflows++;
+    return;
+  }
+  HubPacket* packet = session->ForwardPackets[session->NumForwardPackets];
+  // The send tasks release the packets before the next period, a packet still
+  // referenced is never reused
+  if ( packet->Refs != 0 ) {
+    session->Overflows++;
+    return;
+  }
+  // The datagram is held in the client input queue until the next period
+  packet->Data = datagram;
+  packet->Size = size;
+  session->NumForwardPackets++;
+}
+
+
+//*******************************************************************************
+void HubEngine::referenceForwardPackets()
+{
+  // Every connected client but the source itself releases the packets once
+  int num_receivers = 0;
+  for (int i = 0; i < mSessions.size(); i++) {
+    if ( mSessions[i]->Connected ) { num_receivers++; }
+  }
+  for (int i = 0; i < mSessions.size(); i++) {
+    HubSession* session = mSessions[i];
+    if ( !session->Connected ) { continue; }
+    for (int k = 0; k < session->NumForwardPackets; k++) {
+      session->ForwardPackets[k]->Refs.fetchAndStoreRelease(num_receivers - 1); }
+  }
+}
+
+
+//*******************************************************************************
+void HubEngine::forwardSession(HubSession* session)
+{
+  // The packets of the other clients, with the header of their source, in
+  // batches of gHubSendBatchSize datagrams. The packet data is not copied.
+  HubSendEntry entries[gHubSendBatchSize];
+  int num_entries = 0;
+  for (int i = 0; i < mSessions.size(); i++) {
+    const HubSession* source = mSessions[i];
+    if ( (source == session) || !source->Connected || (source->NumForwardPackets == 0) ) {
+      continue; }
+    // A gain of 0 unsubscribes from the source, other gains are for the client mix
+    bool subscribed = true;
+    for (int k = 0; k < session->Gains.size(); k++) {
+      if ( session->Gains[k].SourceID == source->ID ) {
+        subscribed = (session->Gains[k].Target != 0.0); }
+    }
+    if ( !subscribed ) { continue; }
+
+    for (int k = 0; k < source->NumForwardPackets; k++) {
+      HubSendEntry& entry = entries[num_entries++];
+      entry.Header = reinterpret_cast<const int8_t*>(&source->ForwardHeader);
+      entry.HeaderSize = sizeof(HubForwardHeader);
+      entry.Payload = source->ForwardPackets[k]->Data;
+      entry.PayloadSize = source->ForwardPackets[k]->Size;
+      entry.Address = session->PeerAddress;
+      entry.Port = session->PeerPort;
+      if ( num_entries == gHubSendBatchSize ) {
+        mHubSocket->sendDatagrams(entries, num_entries);
+        num_entries = 0;
+      }
+    }
+  }
+  if ( num_entries > 0 ) { mHubSocket->sendDatagrams(entries, num_entries); }
+
+  // Sent (or not wanted), the sources can reuse their packets
+  for (int i = 0; i < mSessions.size(); i++) {
+    const HubSession* source = mSessions[i];
+    if ( (source == session) || !source->Connected ) { continue; }
+    for (int k = 0; k < source->NumForwardPackets; k++) {
+      source->ForwardPackets[k]->Refs.deref(); }
+  }
+}
+
+
+//*******************************************************************************
+void HubEngine::waitForNextPeriod()
+{
+  // Absolute period times, computed from the frame count so they don't drift
+  mPeriodCount++;
+  uint64_t samples = mClockFrames + mPeriodFrames;
+  mClockFrames = samples;
+  uint64_t next_nsec = mClockStartNsec + ( (samples / mSampleRate) * 1000000000ULL ) +
+      ( ((samples % mSampleRate) * 1000000000ULL) / mSampleRate );
+
+  // Processing time of this period, smoothed over about 64 periods
+  uint64_t period_nsec = (static_cast<uint64_t>(mPeriodFrames) * 1000000000ULL) / mSampleRate;
+  uint64_t period_start_nsec = next_nsec - period_nsec;
+  uint64_t done_nsec = monotonicNsec();
+  uint64_t busy_nsec = (done_nsec > period_start_nsec) ? (done_nsec - period_start_nsec) : 0;
+  mLoadAverage += ( (static_cast<double>(busy_nsec) / period_nsec) - mLoadAverage ) / 64.0;
+  mLoad = static_cast<int>(mLoadAverage * 1000.0);
+
+  // Slack against the period deadline, reported every second in verbose mode
+  int slack_usec = static_cast<int>( (static_cast<int64_t>(period_nsec) -
+                                      static_cast<int64_t>(busy_nsec)) / 1000 );
+  mSlackUsec = slack_usec;
+  if ( slack_usec < 0 ) { mMissedDeadlines++; }
+  if ( slack_usec < mMinSlackUsec ) { mMinSlackUsec = slack_usec; }
+  if ( gVerboseFlag && ((samples % mSampleRate) < static_cast<uint64_t>(mPeriodFrames)) ) {
+    queueEvent(SLACK, -1, slack_usec, mMinSlackUsec, static_cast<int>(mMissedDeadlines));
+    mMinSlackUsec = static_cast<int>(period_nsec / 1000);
+  }
+
+#if defined ( __LINUX__ )
+  struct timespec next;
+  next.tv_sec = next_nsec / 1000000000ULL;
+  next.tv_nsec = next_nsec % 1000000000ULL;
+  while ( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR ) {}
+#else
+  if ( next_nsec > done_nsec ) { QThread::usleep((next_nsec - done_nsec) / 1000); }
+#endif
+
+  // If we're more than one period late, restart the clock instead of
+  // processing a burst of periods
+  uint64_t now_nsec = monotonicNsec();
+  if ( now_nsec > (next_nsec + period_nsec) ) {
+    mLatePeriods++;
+    mClockStartNsec = now_nsec;
+    mPeriodCount = 0;
+    mClockFrames = 0;
+  }
+}
+
+
+//*******************************************************************************
+void HubEngine::applyCpuAffinity()
+{
+  int cpu = mCpu;
+  if ( cpu == mAppliedCpu ) { return; }
+  mAppliedCpu = cpu;
+#if defined ( __LINUX__ )
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if ( cpu >= 0 ) { CPU_SET(cpu, &cpu_set); }
+  else {
+    for (int i = 0; i < CPU_SETSIZE; i++) { CPU_SET(i, &cpu_set); }
+  }
+  if ( pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set) != 0 ) {
+    queueEvent(CPU_PINNED, -1, cpu, 0);
+    return;
+  }
+  if ( cpu >= 0 ) { queueEvent(CPU_PINNED, -1, cpu, 1); }
+#endif
+}
@@ -0,0 +1,481 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file HubEngine.h
+ * \date October 2026
+ */
+
+#ifndef __HUBENGINE_H__
+#define __HUBENGINE_H__
+
+#include <QThread>
+#include <QMutex>
+#include <QVector>
+#include <QAtomicInt>
+#include <QHash>
+
+#include "HubSession.h"
+#include "HubDatagramQueue.h"
+#include "HubMixer.h"
+#include "HubScheduler.h"
+#include "AudioInterface.h"
+#include "jacktrip_types.h"
+#include "jacktrip_globals.h"
+class UdpMasterListener; // forward declaration
+class HubSocket; // forward declaration
+
+
+/// \brief Published level of one channel of a hub room (see HubEngine::getLevels)
+struct HubMeterReading
+{
+  int SessionID; ///< Session ID of the client, -1 for the room mix
+  int Channel; ///< Channel of the client or of the mix
+  float Peak; ///< Largest absolute sample in the metering interval
+  float Rms; ///< RMS level in the metering interval
+};
+
+
+/// \brief Event of a hub engine, printed by the listener thread (see HubEngine::printEvents)
+struct HubEngineEvent
+{
+  int Type; ///< Event type (HubEngine::engineEventT)
+  int SessionID; ///< Session ID of the client, -1 for the engine and the audience formats
+  int Values[6]; ///< Values of the event, see HubEngine::engineEventT
+};
+
+
+/** \brief Hub server engine, handles all the client streams in a single
+ * clocked processing loop
+ *
+ * The legacy server creates a full JackTrip (a JACK client, two
+ * UdpDataProtocol threads and two RingBuffers) for each client. The HubEngine
+ * instead runs one thread with its own clock, at the hub sample rate and
+ * buffer size. On each period it reads the packets of all the clients,
+ * decodes them into their HubSession, mixes them (see HubMixer) and sends one
+ * period back to each client, in the client own format (sample rate and
+ * buffer size are converted when they differ). Each client gets the mix of
+ * all the other clients (mix-minus), or a custom mix with its own gains for
+ * some of the clients (see setListenerGains).
+ *
+ * Each client stream is placed on its own timeline by the sequence numbers
+ * of its packets (sample timestamps, one client buffer apart): lost packets
+ * are played as silence instead of shifting the stream, and late ones are
+ * dropped. The input queue of each client is then kept at the client playout
+ * delay, from the jitter of its packets (slower links get more buffering)
+ * and bounded by the room playout delay (the queue length), by dropping or
+ * repeating one frame per period. So the alignment between the members of a
+ * room stays the same, and doesn't drift with the client clocks.
+ *
+ * Sessions are added and removed by the UdpMasterListener; the requests are
+ * queued and applied by the engine thread at the start of a period. The
+ * sessions come from a pool, allocated (and pre-faulted) with the engine for
+ * the common client settings, and go back to it when the clients leave, so
+ * clients join and leave without allocating memory in the engine thread.
+ *
+ * The per-client work (receive and decode, mix-minus and encode) runs as
+ * tasks of a HubScheduler, on the engine thread and NumWorkers extra
+ * threads. The slack (time left before the period deadline once all the
+ * work is done) is measured every period, see getSlackUsec().
+ *
+ * The CPU time of the tasks of each session is measured with the thread CPU
+ * clock, so the HubRoomManager can refuse clients that would not fit in the
+ * period (see getSessionLoad()). If the engine is overloaded anyway, it
+ * degrades one step at a time (see overloadLevelT), and goes back up when
+ * the load is low again.
+ *
+ * Other hubs join as trunk sessions (see HubRoomManager::addTrunk), so
+ * one ensemble can span several hub processes or machines. A trunk is a
+ * client in the sub-mix format (gHubTrunkNumChannels channels, 32 bits,
+ * same sample rate and buffer size on both hubs): each hub does its own
+ * mix-minus, and the trunk gets the mix of all the other local clients
+ * (which includes the sub-mixes of its other trunks), so only aggregated
+ * streams go between hubs. The hubs have to be connected as a tree, a
+ * loop would feed the sub-mixes back. Clients can also hear some clients of
+ * the peer hub on their own: the hub subscribes to their stems through the
+ * trunk (see HubStemMessageHeader), the peer hub sends them next to the
+ * sub-mix (and leaves them out of it), and they're played by stem sessions
+ * that only receive.
+ *
+ * A forwarding engine (see the Forwarding constructor argument) doesn't
+ * mix: the clients mix locally. Each datagram a client sends is kept as it
+ * arrived in a reference counted HubPacket, and relayed in the same period
+ * to every other client with a HubForwardHeader in front (so the receiver
+ * knows the source), without decoding the audio. The sends to each client are
+ * batched (see HubSocket::sendDatagrams), and a client stops getting a source
+ * by setting its gain to 0 (see setListenerGains); other gains are applied
+ * by the client mix. Trunks are not supported in this mode.
+ *
+ * Rooms also have a listen-only audience (see addListener). Listeners are
+ * not sessions: the room mix is encoded once for each distinct listener
+ * format, by an audience format session that only sends, and the same
+ * datagram goes to all the listeners of the format in batched sends.
+ *
+ * The levels of the room mix and of each client channel are measured by the
+ * mixer while it adds them (see HubMixer::addToBus), and published every
+ * gHubMeterInterval without locks (see getLevels). A forwarding engine
+ * doesn't mix, so it has no levels.
+ */
+class HubEngine : public QThread
+{
+  Q_OBJECT;
+
+public:
+
+  /// \brief Degradation steps of an overloaded engine, each one includes the previous ones
+  enum overloadLevelT {
+    FULL_QUALITY, ///< No degradation
+    NO_CUSTOM_MIXES, ///< Every client gets the plain mix-minus (custom gains are kept)
+    LOW_RESOLUTION_SRC, ///< Sample rate converters with gHubLowSrcTapsPerPhase taps
+    LONG_PERIOD ///< Hub period of gHubLongPeriodFactor times the buffer size
+  };
+
+  /// \brief Events the engine reports (see printEvents), and the values they carry
+  enum engineEventT {
+    SESSION_WAITING, ///< Client added, waiting for its audio
+    SESSION_CONNECTED, ///< Client or audience format set up (channels, rate, buffer size, bits, redundancy)
+    SESSION_UNSUPPORTED, ///< Client with unsupported audio settings
+    SESSION_OFFENDER, ///< Client over its receive budget, the excess is dropped
+    SESSION_TIMEOUT, ///< Client stopped sending packets
+    SESSION_REMOVED, ///< Client removed (underruns, overflows, lost, late, over budget, CPU %)
+    AUDIENCE_FULL, ///< Listener rejected, too many audience formats
+    OVERLOAD_LEVEL, ///< Degradation step changed (new step, old step, load in %)
+    SLACK, ///< Slack in verbose mode (slack, min slack, missed deadlines)
+    CPU_PINNED, ///< Engine pinned to a CPU (CPU, 0 if it failed)
+    NUM_ENGINE_EVENTS ///< Number of event types
+  };
+
+  /** \brief The class constructor
+   * \param SampleRate Hub sample rate, in Hz
+   * \param BufferSize Hub period, in samples
+   * \param QueueLength Client input queue length, in hub periods
+   * \param NumWorkers Worker threads that help the engine thread, 0 for none
+   * \param PoolSize Sessions allocated in advance (see mSessionPool)
+   * \param Forwarding True to relay the client packets instead of mixing them
+   */
+  HubEngine(uint32_t SampleRate = gDefaultSampleRate,
+            uint32_t BufferSize = gDefaultBufferSizeInSamples,
+            int QueueLength = gDefaultQueueLength,
+            int NumWorkers = 0,
+            int PoolSize = gHubDefaultSessionPool,
+            bool Forwarding = false);
+  virtual ~HubEngine();
+
+  /// \brief Implements the Thread Loop. To start the thread, call start()
+  /// ( DO NOT CALL run() )
+  virtual void run();
+
+  /// \brief Stops the execution of the Thread
+  void stop() { mStopped = true; }
+
+  /// \brief Sets the listener to release the session IDs when clients go away
+  void setUdpMasterListener(UdpMasterListener* udpmasterlistener)
+  { mUdpMasterListener = udpmasterlistener; }
+  /// \brief Sets the hub socket, the sessions receive from their channels
+  /// and send through it
+  void setHubSocket(HubSocket* hub_socket) { mHubSocket = hub_socket; }
+
+  /** \brief Adds a client session (thread safe)
+   * \param id Session ID
+   * \param channel Channel of the client in the HubSocket; the engine
+   * removes it from the socket when the session is released
+   * \param settings Client audio settings, NULL if they come with the first
+   * packet. With the settings, the session is set up when it's added and the
+   * hub sends audio to the client from the next period.
+   * \param trunk True if the client is another hub (see HubRoomManager::addTrunk)
+   */
+  void addSession(int id, HubChannel* channel, const HubClientSettings* settings = NULL,
+                  bool trunk = false);
+  /// \brief Removes a client session (thread safe)
+  void removeSession(int id);
+
+  /** \brief Sets the custom mix of a client (thread safe)
+   *
+   * Clients can also set it themselves sending a HubGainMessageHeader
+   * datagram to the hub port. The gains ramp to the new values in
+   * about gHubGainRampTime seconds.
+   * \param listener_id Session ID of the client that hears the mix
+   * \param gains Gains of the sources; the sources not in the vector are
+   * heard at unity gain, as in the mix-minus (and the client itself is not heard)
+   */
+  void setListenerGains(int listener_id, const QVector<HubGainMessageEntry>& gains);
+
+  /** \brief Adds a listen-only member to the audience of the room, or keeps
+   * it if it's there already (thread safe)
+   *
+   * The listener gets the full room mix in its own format, and has no
+   * audio-processing state of its own: only a HubAudienceListener in the
+   * audience format session of its settings (created for the first listener
+   * of the format). Listeners that don't join again within
+   * gTimeOutMultiThreadedServer are removed. The new listeners are logged
+   * here, the engine thread doesn't print anything for them.
+   * \param address Listener IPv4 address
+   * \param port Listener port
+   * \param settings Listener audio settings
+   */
+  void addListener(uint32_t address, uint16_t port, const HubClientSettings& settings);
+  /// \brief Listeners in the audience of the room
+  int getNumListeners() const { return mNumListeners; }
+
+  /// \brief Checks if the hub supports the audio settings of a client
+  static bool checkClientSettings(const HubClientSettings& settings);
+
+  uint32_t getSampleRate() const { return mSampleRate; }
+  uint32_t getBufferSizeInSamples() const { return mBufferSize; }
+  bool isForwarding() const { return mForwarding; }
+
+  /** \brief Pins the engine thread to a CPU (Linux only). It's applied at
+   * the start of the next period, so the engine can be moved while running.
+   * \param cpu CPU number, -1 to let the scheduler decide
+   */
+  void setCpu(int cpu) { mCpu = cpu; }
+  int getCpu() const { return mCpu; }
+  /// \brief Average fraction of the period spent processing, in 1/1000
+  int getLoad() const { return mLoad; }
+  /// \brief Slack of the last period (time left before the deadline), in usec
+  int getSlackUsec() const { return mSlackUsec; }
+  /// \brief Periods that finished after their deadline
+  uint32_t getMissedDeadlines() const { return mMissedDeadlines; }
+  /// \brief Average CPU time of one session, in 1/1000 of the period (0 without sessions)
+  int getSessionLoad() const { return mSessionLoad; }
+  /// \brief Current degradation step (overloadLevelT)
+  int getOverloadLevel() const { return mOverloadLevel; }
+
+  /** \brief Copies the levels of the last metering interval (thread safe, lock-free)
+   *
+   * The room mix channels come first, then the channels of each client.
+   * The engine never waits for the readers: if it publishes new levels
+   * during the copy, the copy is tried again.
+   * \param readings Levels, empty before the first interval ends
+   * \return false if no consistent copy was made in gHubMeterReadAttempts tries
+   */
+  bool getLevels(QVector<HubMeterReading>& readings) const;
+
+  /** \brief Prints the events the engine queued since the last call.
+   *
+   * The engine and worker threads never write to the console, the events
+   * (clients connected, removed or over budget, overload steps...) go
+   * through a lock-free queue. Call it from one thread only, the listener
+   * thread (see HubRoomManager::printEngineEvents); the destructor prints the
+   * last ones.
+   */
+  void printEvents();
+
+
+private:
+
+  /// \brief Applies the pending add and remove requests
+  void processPendingRequests();
+  /// \brief Adds a listener to the audience format of its settings, or refreshes it
+  void addPendingListener(const HubAudienceListener& listener,
+                          const HubClientSettings& settings);
+  /// \brief Removes the listeners that stopped joining, and the formats without listeners
+  void releaseIdleListeners(uint64_t now);
+  /// \brief Applies the stem subscriptions of the clients and replies to them
+  void processStemRequests();
+  /** \brief Sets the stems a trunk receives, adding and releasing stem sessions
+   * \param source_ids Session IDs of the sources in the peer hub
+   * \param stem_ids Returns the local session IDs of the stems, 0xffff if a stem can't be added
+   */
+  void setTrunkStems(HubSession* trunk, const uint16_t* source_ids, int num_stems,
+                     uint16_t* stem_ids);
+  /// \brief Mutes the stems of a trunk, and the sources its peer hub gets as stems, in its sub-mix
+  void updateTrunkGains(HubSession* trunk);
+  /// \brief Takes a session from the pool (or allocates one if it's empty),
+  /// id -1 for an audience format
+  HubSession* createSession(int id, HubChannel* channel);
+  /// \brief Returns a session to the pool (or frees it if the pool is full)
+  void deleteSession(HubSession* session);
+  /// \brief Allocates a session without buffers
+  static HubSession* allocateSession();
+  /// \brief Frees a session and its buffers
+  static void freeSession(HubSession* session);
+  /// \brief Makes the session buffers large enough for the given settings
+  void reserveSessionBuffers(HubSession* session, int num_chans, int peer_frames,
+                             int bytes_per_sample, int redundancy,
+                             int max_in_frames, int max_out_frames);
+  /// \brief Allocates the gHubForwardPackets forward packets of the session
+  static void reserveForwardPackets(HubSession* session);
+
+  /// \brief Scheduler task: receives and pulls the input of one session
+  static void receiveTask(void* context, int task, int worker);
+  /// \brief Scheduler task: computes and sends the feed of one session
+  static void sendTask(void* context, int task, int worker);
+  /// \brief Scheduler task: encodes the room mix in one audience format and sends it
+  static void audienceTask(void* context, int task, int worker);
+  /// \brief Estimates the cost of the tasks of each session for the scheduler
+  void computeTaskCosts();
+  /// \brief Smooths the CPU time of each session over the last periods
+  void accountSessionLoads();
+  /// \brief Moves one degradation step down or up, depending on the load
+  void updateOverloadLevel();
+  /// \brief Queues an engine event for printEvents (engine thread only), dropped if the queue is full
+  void queueEvent(int type, int session_id, int value0 = 0, int value1 = 0, int value2 = 0);
+  /** \brief Queues the events recorded in a session (see HubSession::PendingEvents)
+   * and clears them (engine thread only, outside of the tasks)
+   */
+  void queueSessionEvents(HubSession* session);
+  /// \brief Creates the session converters again with mSrcTapsPerPhase taps
+  void createSessionConverters(HubSession* session);
+  /// \brief Changes the hub period, keeping the clients input queues at their target
+  void setPeriodFrames(int period_frames);
+  /// \brief Room playout delay, the longest session playout delay (before the pull), in frames
+  int getQueueTarget() const
+  { return ((mQueueLength/2) * static_cast<int>(mBufferSize)) + (mPeriodFrames - static_cast<int>(mBufferSize)); }
+  /// \brief Hub period (not the long one), in usec
+  uint32_t getPeriodUsec() const
+  { return static_cast<uint32_t>( (static_cast<uint64_t>(mBufferSize) * 1000000) / mSampleRate ); }
+  /// \brief Capacity of a session input queue, for any period
+  int getInFifoCapacity(int max_in_frames) const
+  { return (mQueueLength * static_cast<int>(mBufferSize)) +
+        (mMaxPeriodFrames - static_cast<int>(mBufferSize)) + max_in_frames; }
+
+  /// \brief Reads all the pending datagrams of a session from its channel
+  /// \param datagram Receive buffer of the calling thread
+  void receiveSession(HubSession* session, uint64_t now, int8_t* datagram);
+  /** \brief Checks the header of a packet against the session settings, and
+   * sets the session up again if they changed
+   * \return false if the session can't take the packet
+   */
+  bool updateSessionSettings(HubSession* session, const int8_t* datagram, int size);
+  /// \brief Decodes a stem datagram received through a trunk into its stem session
+  void receiveStem(HubSession* trunk, const int8_t* datagram, int size, uint64_t now);
+  /// \brief Sets up the session buffers from the client first packet
+  /// \return false if the client settings are not supported
+  bool setupSession(HubSession* session, const HubClientSettings& settings);
+  /// \brief Keeps a client datagram to relay it to the other clients (forwarding engine)
+  void storeForwardPacket(HubSession* session, const int8_t* datagram, int size);
+  /// \brief Sets the references of the packets to relay in this period (forwarding engine)
+  void referenceForwardPackets();
+  /// \brief Relays the packets of the other clients to a session (forwarding engine)
+  void forwardSession(HubSession* session);
+  /// \brief Plays lost packets as silence, so the stream keeps its timing
+  void concealPackets(HubSession* session, int num_packets);
+  /// \brief Sets the session playout delay from its jitter and the room playout delay
+  void updateQueueTarget(HubSession* session);
+  /// \brief Decodes one client packet into the session input queue
+  void decodePacket(HubSession* session, const int8_t* full_packet);
+  /// \brief Pulls one hub period from the session input queue into InBuffer,
+  /// keeping the queue at the session playout delay
+  void pullSessionInput(HubSession* session);
+  /// \brief Mixes the input of all the sessions in the mix bus
+  void processSessions();
+  /// \brief Publishes the levels of the metering interval and starts a new one
+  void publishLevels();
+  /// \brief Sets new custom gains for a session, ramping from the current ones
+  void applyListenerGains(HubSession* session, const HubGainMessageEntry* gains,
+                          int num_gains);
+  /// \brief Computes the custom mixes, one for each distinct set of gains
+  void computeCustomMixes();
+  /// \brief Adds the custom gains of a session to a new custom mix and advances its ramps
+  int computeCustomMix(HubSession* session);
+  /// \brief Computes the session mix-minus, encodes it in the client format and sends it
+  void sendSession(HubSession* session);
+  /** \brief Sends the stems the peer hub of a trunk wants, and the stem
+   * subscription of the trunk when it changed (or to refresh it)
+   * \param datagram Send buffer of the calling thread
+   */
+  void sendStems(HubSession* trunk, int8_t* datagram);
+  /// \brief Sends the datagram of an audience format to all its listeners
+  void sendToAudience(const HubSession* format, const int8_t* datagram, int size);
+  /// \brief Deletes a session and releases its ID in the UdpMasterListener
+  void releaseSession(int index);
+
+  /// \brief Measures the period slack and sleeps until the next period
+  /// starts (absolute time, no drift)
+  void waitForNextPeriod();
+  /// \brief Pins the thread to mCpu if it changed
+  void applyCpuAffinity();
+
+  const uint32_t mSampleRate; ///< Hub sample rate, in Hz
+  const uint32_t mBufferSize; ///< Hub period, in samples
+  const int mQueueLength; ///< Client input queue length, in hub periods
+  const bool mForwarding; ///< Relay the client packets instead of mixing them
+  const int mMaxPeriodFrames; ///< Longest period (LONG_PERIOD), the buffers are sized for it
+  int mPeriodFrames; ///< Current period, mBufferSize or mMaxPeriodFrames
+  uint64_t mClockStartNsec; ///< Start time of the period clock, in nanoseconds
+  uint64_t mPeriodCount; ///< Periods since mClockStartNsec
+  uint64_t mClockFrames; ///< Frames since mClockStartNsec
+  uint64_t mLatePeriods; ///< Times the clock was more than one period late
+  int mGainRampPeriods; ///< Periods to ramp to new custom gains
+  volatile int mCpu; ///< CPU the engine thread is pinned to, -1 for none
+  int mAppliedCpu; ///< CPU the thread is actually pinned to
+  double mLoadAverage; ///< Smoothed processing time, as a fraction of the period
+  volatile int mLoad; ///< mLoadAverage in 1/1000, readable from other threads
+  volatile int mSlackUsec; ///< Slack of the last period, in usec
+  int mMinSlackUsec; ///< Smallest slack since the last report, in usec
+  uint32_t mMissedDeadlines; ///< Periods with negative slack
+  uint64_t mPeriodTime; ///< Start time of the current period, in usec
+  volatile int mSessionLoad; ///< Average session CPU time, in 1/1000 of the period
+  volatile int mOverloadLevel; ///< Current degradation step (overloadLevelT)
+  uint64_t mOverloadLevelTime; ///< Time of the last degradation step change, in usec
+  uint64_t mLowLoadTime; ///< Time the load went below gHubRecoverLoad, 0 if it's not, in usec
+  int mSrcTapsPerPhase; ///< Taps per phase of the session sample rate converters
+
+  QVector<HubSession*> mSessions; ///< Active sessions (engine thread only)
+  QVector<HubSession*> mSessionsByID; ///< Sessions indexed by ID, NULL if not active
+  const int mPoolSize; ///< Maximum number of sessions kept in the pool
+  QVector<HubSession*> mSessionPool; ///< Free sessions, with their buffers (engine thread only)
+  HubMixer mMixer; ///< Mix-minus mixer
+  HubScheduler mScheduler; ///< Runs the per-session tasks of each period
+  QVector<int> mTaskCosts; ///< Estimated cost of each session tasks
+  QVector<int8_t*> mDatagrams; ///< Receive buffers for client datagrams, one per thread
+  QVector<HubSession*> mAudienceFormats; ///< Audience format sessions (engine thread only)
+  QVector<int> mAudienceCosts; ///< Estimated cost of each audience format task
+  volatile int mNumListeners; ///< Listeners in all the audience formats
+  QVector<HubLevel> mBusLevels; ///< Level of each bus channel in the current metering interval
+  int mMeterFrames; ///< Frames in the current metering interval
+  uint64_t mNextMeterTime; ///< End of the current metering interval, in usec
+  QVector<HubMeterReading> mMeterReadings; ///< Published levels (allocated once, engine thread writes)
+  volatile int mNumMeterReadings; ///< Levels in mMeterReadings
+  mutable QAtomicInt mMeterSequence; ///< Seqlock of the published levels, odd while they're written
+  HubDatagramQueue mEvents; ///< Events for printEvents (engine thread writes, listener thread reads)
+  uint32_t mDroppedEvents; ///< Dropped events already reported by printEvents
+
+  UdpMasterListener* mUdpMasterListener; ///< Listener to release session IDs
+  HubSocket* mHubSocket; ///< Socket shared by all the sessions
+
+  QMutex mPendingMutex; ///< Protects the pending requests
+  QVector<int> mPendingAddIDs; ///< Sessions to add (IDs)
+  QVector<HubChannel*> mPendingAddChannels; ///< Sessions to add (channels)
+  QVector<HubClientSettings> mPendingAddSettings; ///< Sessions to add (settings, BufferSize 0 if unknown)
+  QVector<bool> mPendingAddTrunks; ///< Sessions to add (true for the trunks)
+  QVector<int> mPendingRemoveIDs; ///< Sessions to remove
+  QVector<int> mPendingGainIDs; ///< Custom mixes to set (listener IDs)
+  QVector< QVector<HubGainMessageEntry> > mPendingGains; ///< Custom mixes to set (gains)
+  QVector<HubAudienceListener> mPendingListeners; ///< Listeners to add or keep
+  QVector<HubClientSettings> mPendingListenerSettings; ///< Listeners to add or keep (settings)
+  QHash<quint64, uint64_t> mListenerJoinTimes; ///< Last join of each listener, to log the new ones (addListener only)
+
+  volatile bool mStopped; ///< Boolean stop the execution of the thread
+};
+
+#endif //__HUBENGINE_H__
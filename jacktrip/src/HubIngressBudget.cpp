@@ -0,0 +1,106 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file HubIngressBudget.cpp
+ * \date October 2026
+ */
+
+#include "HubIngressBudget.h"
+
+#include <stdexcept>
+
+
+//*******************************************************************************
+HubIngressBudget::HubIngressBudget(int BurstPeriods) :
+  mBurstPeriods(BurstPeriods),
+  mPackets(0),
+  mBytes(0),
+  mPeriodUsec(1),
+  mPacketTokens(0),
+  mByteTokens(0),
+  mLastRefillTime(0),
+  mDroppedPackets(0),
+  mDroppedBytes(0)
+{
+  if ( mBurstPeriods < 1 ) {
+    throw std::invalid_argument("HubIngressBudget: invalid burst");
+  }
+}
+
+
+//*******************************************************************************
+void HubIngressBudget::setBudget(int packets, int bytes, uint32_t period_usec)
+{
+  // The socket thread may see a mix of the old and new values for one
+  // datagram, that's harmless
+  mPeriodUsec = (period_usec > 0) ? period_usec : 1;
+  mPackets = packets;
+  mBytes = bytes;
+}
+
+
+//*******************************************************************************
+bool HubIngressBudget::consume(int size, uint64_t now)
+{
+  const int64_t packets = mPackets;
+  const int64_t bytes = mBytes;
+  const int64_t period_usec = mPeriodUsec;
+  if ( (packets <= 0) || (bytes <= 0) ) { return true; } // no budget yet
+
+  // Refill, the buckets start full
+  const int64_t max_packet_tokens = packets * period_usec * mBurstPeriods;
+  const int64_t max_byte_tokens = bytes * period_usec * mBurstPeriods;
+  if ( mLastRefillTime == 0 ) {
+    mPacketTokens = max_packet_tokens;
+    mByteTokens = max_byte_tokens;
+  }
+  else if ( now > mLastRefillTime ) {
+    int64_t elapsed = now - mLastRefillTime;
+    if ( elapsed > (period_usec * mBurstPeriods) ) { elapsed = period_usec * mBurstPeriods; }
+    mPacketTokens += elapsed * packets;
+    mByteTokens += elapsed * bytes;
+    if ( mPacketTokens > max_packet_tokens ) { mPacketTokens = max_packet_tokens; }
+    if ( mByteTokens > max_byte_tokens ) { mByteTokens = max_byte_tokens; }
+  }
+  mLastRefillTime = now;
+
+  const int64_t packet_cost = period_usec;
+  const int64_t byte_cost = static_cast<int64_t>(size) * period_usec;
+  if ( (mPacketTokens < packet_cost) || (mByteTokens < byte_cost) ) {
+    mDroppedPackets++;
+    mDroppedBytes += size;
+    return false;
+  }
+  mPacketTokens -= packet_cost;
+  mByteTokens -= byte_cost;
+  return true;
+}
@@ -0,0 +1,100 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file HubIngressBudget.h
+ * \date October 2026
+ */
+
+#ifndef __HUBINGRESSBUDGET_H__
+#define __HUBINGRESSBUDGET_H__
+
+#include <stdint.h>
+
+#include "jacktrip_types.h"
+
+
+/** \brief Receive budget of one hub client, a token bucket in datagrams and bytes
+ *
+ * The HubSocket thread checks every datagram of a client against its budget
+ * before queuing it, so a client that sends too much (wrong rate, floods of
+ * stale redundant datagrams) can't fill the receive path and the engine
+ * time of the other clients. Both buckets are refilled at the budget rate
+ * (given per hub period) and hold up to \b BurstPeriods periods of budget,
+ * for the network jitter. Datagrams over the budget are dropped and counted.
+ *
+ * The budget is set by the HubEngine thread when it knows the client
+ * settings, and used by the socket thread.
+ */
+class HubIngressBudget
+{
+public:
+  /** \brief The class constructor
+   * \param BurstPeriods Budget the buckets hold, in periods
+   */
+  HubIngressBudget(int BurstPeriods);
+  virtual ~HubIngressBudget() {}
+
+  /** \brief Sets the budget (engine thread)
+   * \param packets Datagrams per period
+   * \param bytes Bytes per period
+   * \param period_usec Period, in usec
+   */
+  void setBudget(int packets, int bytes, uint32_t period_usec);
+
+  /** \brief Takes one datagram from the budget (socket thread)
+   * \param size Datagram size, in bytes
+   * \param now Current time, in usec
+   * \return false if the datagram is over the budget and must be dropped
+   */
+  bool consume(int size, uint64_t now);
+
+  /// \brief Datagrams dropped for being over the budget
+  uint32_t getDroppedPackets() const { return mDroppedPackets; }
+  /// \brief Bytes dropped for being over the budget
+  uint64_t getDroppedBytes() const { return mDroppedBytes; }
+
+
+private:
+
+  const int mBurstPeriods; ///< Budget the buckets hold, in periods
+  volatile int mPackets; ///< Datagrams per period
+  volatile int mBytes; ///< Bytes per period
+  volatile uint32_t mPeriodUsec; ///< Period, in usec
+  // Tokens are counted in 1/mPeriodUsec units, so the refill is exact in integers
+  int64_t mPacketTokens; ///< Datagrams in the bucket, times the period
+  int64_t mByteTokens; ///< Bytes in the bucket, times the period
+  uint64_t mLastRefillTime; ///< Time of the last refill, in usec, 0 before the first datagram
+  volatile uint32_t mDroppedPackets; ///< Datagrams dropped
+  volatile uint64_t mDroppedBytes; ///< Bytes dropped
+};
+
+#endif //__HUBINGRESSBUDGET_H__
@@ -0,0 +1,331 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+
+/**
+ * \file HubJackBridge.cpp
+ * \date October 2026
+ */
+
+#include "HubJackBridge.h"
+#include "jacktrip_globals.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <QMutexLocker>
+#include <QWaitCondition>
+
+using std::cout; using std::endl;
+
+
+// Static members definition
+HubJackBridge* HubJackBridge::sInstance = NULL;
+QMutex HubJackBridge::sInstanceMutex;
+
+
+//*******************************************************************************
+HubJackBridge* HubJackBridge::getInstance()
+{
+  QMutexLocker locker(&sInstanceMutex);
+  if ( sInstance == NULL ) {
+    sInstance = new HubJackBridge();
+  }
+  return sInstance;
+}
+
+
+//*******************************************************************************
+HubJackBridge::HubJackBridge() :
+  mClient(NULL),
+  mGroups(NULL),
+  mNumSlots(0),
+  mCycles(0)
+{
+  jack_status_t status;
+  mClient = jack_client_open(gHubJackBridgeName, JackNoStartServer, &status, NULL);
+  if (mClient == NULL) {
+    if (status & JackServerFailed) {
+      fprintf (stderr, "Unable to connect to JACK server\n");
+    }
+    throw std::runtime_error("Maybe the JACK server is not running?");
+  }
+  if (status & JackNameNotUnique) {
+    fprintf (stderr, "unique name `%s' assigned\n", jack_get_client_name(mClient));
+  }
+
+  mGroups = new QAtomicPointer<HubJackPortGroup>[gMaxThreads];
+  jack_on_shutdown (mClient, HubJackBridge::jackShutdown, 0);
+  if ( jack_set_process_callback(mClient, HubJackBridge::wrapperProcessCallback, this) ) {
+    jack_client_close(mClient);
+    throw std::runtime_error("Could not set the Jack process callback");
+  }
+  if ( jack_activate(mClient) ) {
+    jack_client_close(mClient);
+    throw std::runtime_error("Cannot activate the Jack client");
+  }
+  cout << "JackTrip HUB SERVER: JACK bridge client " << jack_get_client_name(mClient)
+       << " is running" << endl;
+  cout << gPrintSeparator << endl;
+}
+
+
+//*******************************************************************************
+HubJackBridge::~HubJackBridge()
+{
+  jack_client_close(mClient);
+  delete[] mGroups;
+}
+
+
+//*******************************************************************************
+jack_port_t* HubJackBridge::registerPort(const char* PortName, unsigned long Flags)
+{
+  QMutexLocker locker(&mMutex);
+  return jack_port_register(mClient, PortName, JACK_DEFAULT_AUDIO_TYPE, Flags, 0);
+}
+
+
+//*******************************************************************************
+void HubJackBridge::unregisterPort(jack_port_t* port)
+{
+  if ( port == NULL ) { return; }
+  QMutexLocker locker(&mMutex);
+  jack_port_unregister(mClient, port);
+}
+
+
+//*******************************************************************************
+int HubJackBridge::addGroup(HubJackPortGroup* group)
+{
+  QMutexLocker locker(&mMutex);
+  for (int i = 0; i < gMaxThreads; i++) {
+    if ( mGroups[i] == NULL ) {
+      mGroups[i].fetchAndStoreOrdered(group);
+      if ( i >= mNumSlots ) { mNumSlots.fetchAndStoreOrdered(i+1); }
+      return i;
+    }
+  }
+  std::cerr << "JackTrip HUB SERVER: no free slots in the JACK bridge" << endl;
+  return -1;
+}
+
+
+//*******************************************************************************
+void HubJackBridge::removeGroup(int slot)
+{
+  if ( (slot < 0) || (slot >= gMaxThreads) ) { return; }
+  int cycle;
+  {
+    QMutexLocker locker(&mMutex);
+    mGroups[slot].fetchAndStoreOrdered(NULL);
+    int num_slots = mNumSlots;
+    while ( (num_slots > 0) && (mGroups[num_slots-1] == NULL) ) { num_slots--; }
+    mNumSlots.fetchAndStoreOrdered(num_slots);
+    cycle = mCycles;
+  }
+
+  // A cycle that started before the slot was cleared may still be using the
+  // group: wait for it to end. New cycles won't see it. The caller frees the
+  // group when this returns, so there's no timeout, only a warning.
+  if ( (cycle & 1) == 0 ) { return; }
+  QWaitCondition sleep;
+  QMutex mutex;
+  int sleepTime = 1; // ms
+  int elapsedTime = 0;
+  QMutexLocker lock(&mutex);
+  while ( mCycles == cycle ) {
+    sleep.wait(&mutex, sleepTime);
+    elapsedTime += sleepTime;
+    if ( elapsedTime == gHubJackBridgeRemoveTime ) {
+      std::cerr << "JackTrip HUB SERVER: the JACK bridge process callback is stuck" << endl;
+    }
+  }
+}
+
+
+//*******************************************************************************
+void HubJackBridge::connectPhysicalPorts(const QVarLengthArray<jack_port_t*>& InPorts,
+                                         const QVarLengthArray<jack_port_t*>& OutPorts)
+{
+  const char** ports;
+
+  // Get physical output (capture) ports
+  if ( (ports =
+        jack_get_ports (mClient, NULL, NULL,
+                        JackPortIsPhysical | JackPortIsOutput)) == NULL)
+  {
+    cout << "WARING: Cannot find any physical capture ports" << endl;
+  }
+  else
+  {
+    // Connect capure ports to jacktrip send
+    for (int i = 0; (i < InPorts.size()) && (ports[i] != NULL); i++) {
+      jack_connect(mClient, ports[i], jack_port_name(InPorts[i]));
+    }
+    std::free(ports);
+  }
+
+  // Get physical input (playback) ports
+  if ( (ports =
+        jack_get_ports (mClient, NULL, NULL,
+                        JackPortIsPhysical | JackPortIsInput)) == NULL)
+  {
+    cout << "WARING: Cannot find any physical playback ports" << endl;
+  }
+  else
+  {
+    // Connect playback ports to jacktrip receive
+    for (int i = 0; (i < OutPorts.size()) && (ports[i] != NULL); i++) {
+      jack_connect(mClient, jack_port_name(OutPorts[i]), ports[i]);
+    }
+    std::free(ports);
+  }
+}
+
+
+//*******************************************************************************
+int HubJackBridge::processCallback(jack_nframes_t nframes)
+{
+  mCycles.fetchAndAddOrdered(1);
+  int num_slots = mNumSlots;
+  for (int i = 0; i < num_slots; i++) {
+    HubJackPortGroup* group = mGroups[i];
+    if ( group != NULL ) { group->process(nframes); }
+  }
+  mCycles.fetchAndAddOrdered(1);
+  return 0;
+}
+
+
+//*******************************************************************************
+int HubJackBridge::wrapperProcessCallback(jack_nframes_t nframes, void *arg)
+{
+  return static_cast<HubJackBridge*>(arg)->processCallback(nframes);
+}
+
+
+//*******************************************************************************
+void HubJackBridge::jackShutdown(void*)
+{
+  throw std::runtime_error("The Jack Server was shut down!");
+}
+
+
+
+//*******************************************************************************
+HubJackPortGroup::HubJackPortGroup(JackTrip* jacktrip,
+                                   int NumInChans, int NumOutChans,
+                                   AudioInterface::audioBitResolutionT AudioBitResolution) :
+  AudioInterface(jacktrip, NumInChans, NumOutChans, AudioBitResolution),
+  mBridge(HubJackBridge::getInstance()),
+  mGroupName("JackTrip"),
+  mSlot(-1)
+{}
+
+
+//*******************************************************************************
+HubJackPortGroup::~HubJackPortGroup()
+{
+  stopProcess();
+  for (int i = 0; i < mInPorts.size(); i++) { mBridge->unregisterPort(mInPorts[i]); }
+  for (int i = 0; i < mOutPorts.size(); i++) { mBridge->unregisterPort(mOutPorts[i]); }
+}
+
+
+//*******************************************************************************
+void HubJackPortGroup::setup()
+{
+  // Create input and output ports, named after the group
+  mInPorts.resize(getNumInputChannels());
+  for (int i = 0; i < getNumInputChannels(); i++) {
+    QByteArray inName = mGroupName + "_send_" + QByteArray::number(i+1);
+    mInPorts[i] = mBridge->registerPort(inName.constData(), JackPortIsInput);
+  }
+  mOutPorts.resize(getNumOutputChannels());
+  for (int i = 0; i < getNumOutputChannels(); i++) {
+    QByteArray outName = mGroupName + "_receive_" + QByteArray::number(i+1);
+    mOutPorts[i] = mBridge->registerPort(outName.constData(), JackPortIsOutput);
+  }
+  for (int i = 0; i < mInPorts.size(); i++) {
+    if ( mInPorts[i] == NULL ) { throw std::runtime_error("Could not register the Jack bridge ports"); }
+  }
+  for (int i = 0; i < mOutPorts.size(); i++) {
+    if ( mOutPorts[i] == NULL ) { throw std::runtime_error("Could not register the Jack bridge ports"); }
+  }
+
+  // Initialize Buffer array to read and write audio
+  mInBuffer.resize(getNumInputChannels());
+  mOutBuffer.resize(getNumOutputChannels());
+  AudioInterface::setup();
+}
+
+
+//*******************************************************************************
+int HubJackPortGroup::startProcess() const
+{
+  if ( mSlot != -1 ) { return 0; }
+  mSlot = mBridge->addGroup(const_cast<HubJackPortGroup*>(this));
+  return (mSlot == -1) ? -1 : 0;
+}
+
+
+//*******************************************************************************
+int HubJackPortGroup::stopProcess() const
+{
+  if ( mSlot == -1 ) { return 0; }
+  mBridge->removeGroup(mSlot);
+  mSlot = -1;
+  return 0;
+}
+
+
+//*******************************************************************************
+void HubJackPortGroup::connectDefaultPorts()
+{
+  mBridge->connectPhysicalPorts(mInPorts, mOutPorts);
+}
+
+
+//*******************************************************************************
+void HubJackPortGroup::process(jack_nframes_t nframes)
+{
+  for (int i = 0; i < mInPorts.size(); i++) {
+    // Input Ports are READ ONLY
+    mInBuffer[i] = (sample_t*) jack_port_get_buffer(mInPorts[i], nframes);
+  }
+  for (int i = 0; i < mOutPorts.size(); i++) {
+    // Output Ports are WRITABLE
+    mOutBuffer[i] = (sample_t*) jack_port_get_buffer(mOutPorts[i], nframes);
+  }
+  AudioInterface::callback(mInBuffer, mOutBuffer, nframes);
+}
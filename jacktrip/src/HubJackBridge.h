@@ -0,0 +1,201 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+
+/**
+ * \file HubJackBridge.h
+ * \date October 2026
+ */
+
+#ifndef __HUBJACKBRIDGE_H__
+#define __HUBJACKBRIDGE_H__
+
+#include <iostream>
+#include <jack/jack.h>
+
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QByteArray>
+#include <QMutex>
+#include <QVarLengthArray>
+
+#include "jacktrip_types.h"
+#include "AudioInterface.h"
+
+class HubJackPortGroup; // forward declaration
+
+
+/** \brief One JACK client shared by all the clients of a --jackbridge server
+ *
+ * Instead of one JACK client (graph node, thread and context switches on
+ * every cycle) per connection, the server opens a single JACK client and
+ * each connection registers a group of ports in it (HubJackPortGroup). The
+ * process callback serves all the active groups, one after the other.
+ *
+ * Groups are added to and removed from a fixed array of slots, so the
+ * process callback never takes a lock. To remove a group, its slot is cleared
+ * and the caller waits for the cycle that may still be using it to finish
+ * (the callback counts its cycles: the counter is odd inside a cycle).
+ *
+ * The client is created on first use and lives until the process exits.
+ */
+class HubJackBridge
+{
+public:
+
+  /** \brief Get the bridge, opening the JACK client the first time
+   * \exception std::runtime_error Can't connect to JACK
+   */
+  static HubJackBridge* getInstance();
+
+  /** \brief Registers a port in the shared client
+   * \param PortName Short name of the port
+   * \param Flags JackPortIsInput or JackPortIsOutput
+   * \return The port, NULL on error
+   */
+  jack_port_t* registerPort(const char* PortName, unsigned long Flags);
+  /// \brief Unregisters a port of the shared client
+  void unregisterPort(jack_port_t* port);
+  /** \brief Adds a group to the process callback
+   * \return The slot of the group, -1 if there are no free slots
+   */
+  int addGroup(HubJackPortGroup* group);
+  /** \brief Removes a group from the process callback. When it returns the
+   * callback doesn't use the group anymore: it waits for the current cycle
+   * to end, however long it takes.
+   */
+  void removeGroup(int slot);
+  /// \brief Connects capture ports to the send ports and receive ports to playback
+  void connectPhysicalPorts(const QVarLengthArray<jack_port_t*>& InPorts,
+                            const QVarLengthArray<jack_port_t*>& OutPorts);
+
+  /// \brief Get the Jack Server Sampling Rate, in samples/second
+  uint32_t getSampleRate() const
+  { return jack_get_sample_rate(mClient); }
+  /// \brief Get the Jack Server Buffer Size, in samples
+  uint32_t getBufferSizeInSamples() const
+  { return jack_get_buffer_size(mClient); }
+
+private:
+
+  /** \brief The class constructor
+   * \exception std::runtime_error Can't connect to JACK
+   */
+  HubJackBridge();
+  virtual ~HubJackBridge();
+
+  /// \brief JACK process callback, processes every active group
+  int processCallback(jack_nframes_t nframes);
+  /// \brief Wrapper to use processCallback with <tt>jack_set_process_callback</tt>
+  static int wrapperProcessCallback(jack_nframes_t nframes, void *arg);
+  /// \brief JACK calls this if the server shuts down or disconnects the client
+  static void jackShutdown(void*);
+
+  jack_client_t* mClient; ///< Jack Client shared by all the groups
+  QAtomicPointer<HubJackPortGroup>* mGroups; ///< Slots of the active groups, NULL when free
+  QAtomicInt mNumSlots; ///< Slots the process callback has to check (highest used slot + 1)
+  QAtomicInt mCycles; ///< Process callback counter, incremented at the start and end of a cycle
+  QMutex mMutex; ///< Protects the slots allocation and the port registration
+  static HubJackBridge* sInstance; ///< The process bridge
+  static QMutex sInstanceMutex; ///< Protects the bridge creation
+};
+
+
+/** \brief The ports of one --jackbridge client in the shared HubJackBridge
+ *
+ * This is the AudioInterface of a JackTrip in JackTrip::JACK_BRIDGE mode. It
+ * behaves like a JackAudioInterface, but instead of opening a JACK client it
+ * registers its send and receive ports, prefixed by its name, in the bridge,
+ * and runs inside the bridge process callback while it is active.
+ */
+class HubJackPortGroup : public AudioInterface
+{
+public:
+
+  /** \brief The class constructor
+   * \param jacktrip Pointer to the JackTrip class that connects all classes (mediator)
+   * \param NumInChans Number of Input Channels
+   * \param NumOutChans Number of Output Channels
+   * \param AudioBitResolution Audio Sample Resolutions in bits
+   * \exception std::runtime_error Can't connect to JACK
+   */
+  HubJackPortGroup(JackTrip* jacktrip,
+                   int NumInChans, int NumOutChans,
+                   AudioInterface::audioBitResolutionT AudioBitResolution = AudioInterface::BIT16);
+  /// \brief The class destructor, removes the group and its ports from the bridge
+  virtual ~HubJackPortGroup();
+
+  /// \brief Registers the ports in the bridge
+  virtual void setup();
+  /// \brief Adds the group to the bridge process callback
+  virtual int startProcess() const;
+  /// \brief Removes the group from the bridge process callback
+  virtual int stopProcess() const;
+  /// \brief Connect the default ports, capture to sends, and receives to playback
+  virtual void connectDefaultPorts();
+  /// \brief Processes one cycle, called from the bridge process callback
+  void process(jack_nframes_t nframes);
+
+  //--------------SETTERS---------------------------------------------
+  /// \brief Set the prefix of the port names
+  virtual void setClientName(const char* ClientName)
+  { mGroupName = ClientName; }
+  virtual void setSampleRate(uint32_t /*sample_rate*/)
+  { std::cout << "WARING: Setting the Sample Rate in Jack mode has no effect." << std::endl; }
+  virtual void setBufferSizeInSamples(uint32_t /*buf_size*/)
+  { std::cout << "WARING: Setting the Sample Rate in Jack mode has no effect." << std::endl; }
+  //------------------------------------------------------------------
+
+  //--------------GETTERS---------------------------------------------
+  /// \brief Get the Jack Server Sampling Rate, in samples/second
+  virtual uint32_t getSampleRate() const
+  { return mBridge->getSampleRate(); }
+  /// \brief Get the Jack Server Buffer Size, in samples
+  virtual uint32_t getBufferSizeInSamples() const
+  { return mBridge->getBufferSizeInSamples(); }
+  /// \brief Get size of each audio per channel, in bytes
+  virtual size_t getSizeInBytesPerChannel() const
+  { return (getBufferSizeInSamples() * getAudioBitResolution()/8); }
+  //------------------------------------------------------------------
+
+private:
+
+  HubJackBridge* mBridge; ///< The shared JACK client
+  QByteArray mGroupName; ///< Prefix of the port names
+  mutable int mSlot; ///< Slot in the bridge, -1 when not processing
+  QVarLengthArray<jack_port_t*> mInPorts; ///< Vector of Input Ports (Channels)
+  QVarLengthArray<jack_port_t*> mOutPorts; ///< Vector of Output Ports (Channels)
+  QVarLengthArray<sample_t*> mInBuffer; ///< Vector of Input buffers/channel read from JACK
+  QVarLengthArray<sample_t*> mOutBuffer; ///< Vector of Output buffer/channel to write to JACK
+};
+
+
+#endif
@@ -0,0 +1,372 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file HubMixer.cpp
+ * \date October 2026
+ */
+
+#include "HubMixer.h"
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined (__SSE2__)
+#include <emmintrin.h>
+#elif defined (__SSE__)
+#include <xmmintrin.h>
+#endif
+
+
+//*******************************************************************************
+HubMixer::HubMixer(int BufferSize, int MaxBufferSize) :
+  mBufferSize(BufferSize),
+  mMaxBufferSize( (MaxBufferSize > BufferSize) ? MaxBufferSize : BufferSize ),
+  mNumBusChans(0),
+  mBusCapacityChans(0),
+  mBus(NULL),
+  mBusMemory(NULL),
+  mCapacityChansCustomMixes(0),
+  mNumCustomMixes(0)
+{
+  if ( mBufferSize <= 0 ) {
+    throw std::invalid_argument("HubMixer: invalid buffer size");
+  }
+  clearBus(2);
+}
+
+
+//*******************************************************************************
+HubMixer::~HubMixer()
+{
+  delete[] mBusMemory;
+  for (int i = 0; i < mCustomMixes.size(); i++) { delete[] mCustomMixes[i]; }
+}
+
+
+//*******************************************************************************
+void HubMixer::clearBus(int NumBusChans)
+{
+  // The bus only grows, when a client with more channels connects
+  if ( NumBusChans > mBusCapacityChans ) {
+    delete[] mBusMemory;
+    mBusMemory = new sample_t[(NumBusChans * mMaxBufferSize) + 4];
+    size_t misalignment = reinterpret_cast<size_t>(mBusMemory) % 16;
+    mBus = mBusMemory + ( (misalignment == 0) ? 0 : (16 - misalignment) / sizeof(sample_t) );
+    mBusCapacityChans = NumBusChans;
+  }
+  mNumBusChans = NumBusChans;
+  std::memset(mBus, 0, sizeof(sample_t) * mNumBusChans * mBufferSize);
+  mNumCustomMixes = 0;
+}
+
+
+//*******************************************************************************
+void HubMixer::setBufferSize(int BufferSize) throw(std::invalid_argument)
+{
+  if ( (BufferSize <= 0) || (BufferSize > mMaxBufferSize) ) {
+    throw std::invalid_argument("HubMixer: invalid buffer size");
+  }
+  mBufferSize = BufferSize;
+}
+
+
+//*******************************************************************************
+void HubMixer::addToBus(const sample_t* input, int NumChans,
+                        HubLevel* input_levels, HubLevel* bus_levels)
+{
+  for (int i = 0; i < mNumBusChans; i++) {
+    // An input channel added to several bus channels is measured once
+    HubLevel* input_level = ( (input_levels != NULL) && (i < NumChans) ) ?
+          (input_levels + i) : NULL;
+    HubLevel* bus_level = (bus_levels != NULL) ? (bus_levels + i) : NULL;
+    if ( (input_level == NULL) && (bus_level == NULL) ) {
+      addBuffers(mBus + (i*mBufferSize), input + ((i % NumChans) * mBufferSize), mBufferSize);
+    }
+    else {
+      addBuffersMetered(mBus + (i*mBufferSize), input + ((i % NumChans) * mBufferSize),
+                        mBufferSize, input_level, bus_level);
+    }
+  }
+}
+
+
+//*******************************************************************************
+void HubMixer::computeMixMinus(const sample_t* own_input, int NumChans,
+                               sample_t* output, int custom_mix,
+                               bool hear_own_input) const
+{
+  for (int i = 0; i < NumChans; i++) {
+    computeFeedChannel(output + (i*mBufferSize), own_input, i,
+                       custom_mix, hear_own_input);
+  }
+}
+
+
+//*******************************************************************************
+void HubMixer::computeMixMinusPacket(const sample_t* own_input, int NumChans,
+                                     int8_t* audio_packet,
+                                     AudioInterface::audioBitResolutionT BitResolution,
+                                     sample_t* scratch,
+                                     int custom_mix, bool hear_own_input) const
+{
+  // One channel at a time, so the mix-minus stays in cache for the encoding
+  const int channel_bytes = mBufferSize * static_cast<int>(BitResolution);
+  for (int i = 0; i < NumChans; i++) {
+    computeFeedChannel(scratch, own_input, i, custom_mix, hear_own_input);
+    encodeAudioPacket(scratch, mBufferSize, mBufferSize, 1,
+                      audio_packet + (i*channel_bytes), BitResolution);
+  }
+}
+
+
+//*******************************************************************************
+void HubMixer::computeFeedChannel(sample_t* output, const sample_t* own_input,
+                                  int channel, int custom_mix,
+                                  bool hear_own_input) const
+{
+  // Client channel i went into bus channel i (and others if it has fewer channels)
+  if ( channel >= mNumBusChans ) {
+    std::memset(output, 0, sizeof(sample_t) * mBufferSize);
+    return;
+  }
+  const int offset = channel * mBufferSize;
+  if ( custom_mix < 0 ) {
+    subtractBuffers(output, mBus + offset, own_input + offset, mBufferSize);
+    return;
+  }
+  // The custom mix holds (gain-1)*input of the sources with a custom gain
+  std::memcpy(output, mBus + offset, sizeof(sample_t) * mBufferSize);
+  addBuffers(output, mCustomMixes[custom_mix] + offset, mBufferSize);
+  if ( !hear_own_input ) {
+    subtractBuffers(output, output, own_input + offset, mBufferSize);
+  }
+}
+
+
+//*******************************************************************************
+int HubMixer::createCustomMix()
+{
+  // The buffers only grow, with the bus or the number of distinct mixes
+  if ( mNumBusChans > mCapacityChansCustomMixes ) {
+    for (int i = 0; i < mCustomMixes.size(); i++) {
+      delete[] mCustomMixes[i];
+      mCustomMixes[i] = new sample_t[mNumBusChans * mMaxBufferSize];
+    }
+    mCapacityChansCustomMixes = mNumBusChans;
+  }
+  if ( mNumCustomMixes == mCustomMixes.size() ) {
+    mCustomMixes.append(new sample_t[mCapacityChansCustomMixes * mMaxBufferSize]);
+  }
+  std::memset(mCustomMixes[mNumCustomMixes], 0,
+              sizeof(sample_t) * mNumBusChans * mBufferSize);
+  return mNumCustomMixes++;
+}
+
+
+//*******************************************************************************
+void HubMixer::addToCustomMix(int custom_mix, const sample_t* const* inputs,
+                              const int* NumChans, const sample_t* gains_start,
+                              const sample_t* gains_end, int NumSources)
+{
+  // Frames per block: 64 floats of output stay in L1 while all the sources
+  // are accumulated
+  const int block_frames = 64;
+  const sample_t inv_buffer_size = 1.0 / mBufferSize;
+  sample_t* mix = mCustomMixes[custom_mix];
+
+  for (int i = 0; i < mNumBusChans; i++) {
+    sample_t* mix_channel = mix + (i*mBufferSize);
+    for (int start = 0; start < mBufferSize; start += block_frames) {
+      int n = mBufferSize - start;
+      if ( n > block_frames ) { n = block_frames; }
+      for (int k = 0; k < NumSources; k++) {
+        const sample_t gain_step = (gains_end[k] - gains_start[k]) * inv_buffer_size;
+        const sample_t* source = inputs[k] + ((i % NumChans[k]) * mBufferSize);
+        multiplyAccumulate(mix_channel + start, source + start, n,
+                           gains_start[k] + (start * gain_step), gain_step);
+      }
+    }
+  }
+}
+
+
+//*******************************************************************************
+void HubMixer::encodeAudioPacket(const sample_t* input, int input_stride,
+                                 int NumFrames, int NumChans, int8_t* audio_packet,
+                                 AudioInterface::audioBitResolutionT BitResolution)
+{
+  const int bytes_per_sample = static_cast<int>(BitResolution);
+  // Largest sample below 1.0 for the integer formats
+  const sample_t max_sample = 32767.0 / 32768.0;
+
+  for (int i = 0; i < NumChans; i++) {
+    const sample_t* channel = input + (i*input_stride);
+    int8_t* output = audio_packet + (i*NumFrames*bytes_per_sample);
+
+    if ( BitResolution == AudioInterface::BIT32 ) {
+      std::memcpy(output, channel, sizeof(sample_t) * NumFrames);
+      continue;
+    }
+
+    int j = 0;
+#if defined (__SSE2__)
+    if ( BitResolution == AudioInterface::BIT16 ) {
+      // Same as AudioInterface::fromSampleToBitConversion: floor(sample*32768),
+      // 8 samples at a time, with saturation
+      const __m128 scale = _mm_set1_ps(32768.0f);
+      int16_t* output16 = reinterpret_cast<int16_t*>(output);
+      for ( ; j+8 <= NumFrames; j += 8) {
+        __m128 low = _mm_mul_ps(_mm_loadu_ps(channel+j), scale);
+        __m128 high = _mm_mul_ps(_mm_loadu_ps(channel+j+4), scale);
+        __m128i low_int = _mm_cvttps_epi32(low);
+        __m128i high_int = _mm_cvttps_epi32(high);
+        // Truncation rounds negative numbers up, subtract 1 to get the floor
+        low_int = _mm_add_epi32(low_int, _mm_castps_si128(
+            _mm_cmplt_ps(low, _mm_cvtepi32_ps(low_int))));
+        high_int = _mm_add_epi32(high_int, _mm_castps_si128(
+            _mm_cmplt_ps(high, _mm_cvtepi32_ps(high_int))));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output16+j),
+                         _mm_packs_epi32(low_int, high_int));
+      }
+    }
+#endif
+    for ( ; j < NumFrames; j++) {
+      sample_t sample = channel[j];
+      if ( sample > max_sample ) { sample = max_sample; }
+      else if ( sample < -1.0 ) { sample = -1.0; }
+      AudioInterface::fromSampleToBitConversion(&sample, output + (j*bytes_per_sample),
+                                                BitResolution);
+    }
+  }
+}
+
+
+//*******************************************************************************
+void HubMixer::addBuffers(sample_t* dst, const sample_t* src, int n)
+{
+  int i = 0;
+#if defined (__SSE__)
+  for ( ; i+4 <= n; i += 4) {
+    _mm_storeu_ps(dst+i, _mm_add_ps(_mm_loadu_ps(dst+i), _mm_loadu_ps(src+i)));
+  }
+#endif
+  for ( ; i < n; i++) { dst[i] += src[i]; }
+}
+
+
+//*******************************************************************************
+void HubMixer::addBuffersMetered(sample_t* dst, const sample_t* src, int n,
+                                 HubLevel* src_level, HubLevel* dst_level)
+{
+  sample_t src_peak = 0.0;
+  sample_t src_sum = 0.0;
+  sample_t dst_peak = 0.0;
+  sample_t dst_sum = 0.0;
+  int i = 0;
+#if defined (__SSE__)
+  // Absolute value: clear the sign bit
+  const __m128 sign_mask = _mm_set1_ps(-0.0f);
+  __m128 src_peak4 = _mm_setzero_ps();
+  __m128 src_sum4 = _mm_setzero_ps();
+  __m128 dst_peak4 = _mm_setzero_ps();
+  __m128 dst_sum4 = _mm_setzero_ps();
+  for ( ; i+4 <= n; i += 4) {
+    __m128 src4 = _mm_loadu_ps(src+i);
+    __m128 dst4 = _mm_add_ps(_mm_loadu_ps(dst+i), src4);
+    _mm_storeu_ps(dst+i, dst4);
+    src_peak4 = _mm_max_ps(src_peak4, _mm_andnot_ps(sign_mask, src4));
+    src_sum4 = _mm_add_ps(src_sum4, _mm_mul_ps(src4, src4));
+    dst_peak4 = _mm_max_ps(dst_peak4, _mm_andnot_ps(sign_mask, dst4));
+    dst_sum4 = _mm_add_ps(dst_sum4, _mm_mul_ps(dst4, dst4));
+  }
+  float lanes[4][4];
+  _mm_storeu_ps(lanes[0], src_peak4);
+  _mm_storeu_ps(lanes[1], src_sum4);
+  _mm_storeu_ps(lanes[2], dst_peak4);
+  _mm_storeu_ps(lanes[3], dst_sum4);
+  for (int j = 0; j < 4; j++) {
+    if ( lanes[0][j] > src_peak ) { src_peak = lanes[0][j]; }
+    src_sum += lanes[1][j];
+    if ( lanes[2][j] > dst_peak ) { dst_peak = lanes[2][j]; }
+    dst_sum += lanes[3][j];
+  }
+#endif
+  for ( ; i < n; i++) {
+    dst[i] += src[i];
+    if ( std::fabs(src[i]) > src_peak ) { src_peak = std::fabs(src[i]); }
+    src_sum += src[i] * src[i];
+    if ( std::fabs(dst[i]) > dst_peak ) { dst_peak = std::fabs(dst[i]); }
+    dst_sum += dst[i] * dst[i];
+  }
+
+  if ( src_level != NULL ) {
+    if ( src_peak > src_level->Peak ) { src_level->Peak = src_peak; }
+    src_level->SumSquares += src_sum;
+  }
+  if ( dst_level != NULL ) {
+    if ( dst_peak > dst_level->Peak ) { dst_level->Peak = dst_peak; }
+    dst_level->SumSquares += dst_sum;
+  }
+}
+
+
+//*******************************************************************************
+void HubMixer::subtractBuffers(sample_t* dst, const sample_t* a, const sample_t* b, int n)
+{
+  int i = 0;
+#if defined (__SSE__)
+  for ( ; i+4 <= n; i += 4) {
+    _mm_storeu_ps(dst+i, _mm_sub_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+  }
+#endif
+  for ( ; i < n; i++) { dst[i] = a[i] - b[i]; }
+}
+
+
+//*******************************************************************************
+void HubMixer::multiplyAccumulate(sample_t* dst, const sample_t* src, int n,
+                                  sample_t gain_start, sample_t gain_step)
+{
+  int i = 0;
+#if defined (__SSE__)
+  __m128 gain = _mm_set_ps(gain_start + 3*gain_step, gain_start + 2*gain_step,
+                           gain_start + gain_step, gain_start);
+  const __m128 step = _mm_set1_ps(4*gain_step);
+  for ( ; i+4 <= n; i += 4) {
+    _mm_storeu_ps(dst+i, _mm_add_ps(_mm_loadu_ps(dst+i),
+                                    _mm_mul_ps(gain, _mm_loadu_ps(src+i))));
+    gain = _mm_add_ps(gain, step);
+  }
+#endif
+  for ( ; i < n; i++) { dst[i] += (gain_start + (i*gain_step)) * src[i]; }
+}
@@ -0,0 +1,236 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file HubMixer.h
+ * \date October 2026
+ */
+
+#ifndef __HUBMIXER_H__
+#define __HUBMIXER_H__
+
+#include <stdexcept>
+
+#include <QVector>
+
+#include "AudioInterface.h"
+#include "jacktrip_types.h"
+
+
+/// \brief Gain of one source in the custom mix of a listener
+struct HubGainState
+{
+  int SourceID; ///< Session ID of the source
+  sample_t Current; ///< Gain used in the current period
+  sample_t Target; ///< Gain requested by the listener
+  sample_t Step; ///< Gain change per period, while ramping to Target
+};
+
+/// \brief Level of one channel, accumulated over the periods of a metering interval
+struct HubLevel
+{
+  sample_t Peak; ///< Largest absolute sample
+  sample_t SumSquares; ///< Sum of the squared samples (RMS = sqrt(SumSquares/frames))
+};
+
+/** \brief Header of the datagram a client sends to the hub to set its custom mix
+ *
+ * It's followed by NumGains HubGainMessageEntry. Sources not in the message
+ * are heard at unity gain (and the listener itself is not heard), as in the
+ * mix-minus.
+ */
+struct HubGainMessageHeader
+{
+  uint32_t Magic; ///< gHubGainMessageMagic
+  uint16_t NumGains; ///< Number of entries that follow
+  uint16_t Reserved; ///< Set to 0
+};
+
+/// \brief Entry of the custom mix datagram
+struct HubGainMessageEntry
+{
+  uint16_t SourceID; ///< Session ID of the source
+  uint16_t Reserved; ///< Set to 0
+  float Gain; ///< Linear gain
+};
+
+const uint32_t gHubGainMessageMagic = 0x4D47544A; ///< "JTGM"
+
+
+/** \brief Mix-minus mixer for the HubEngine
+ *
+ * A naive mix for each listener adds all the other clients, which is O(N^2)
+ * for N clients. The HubMixer adds every client once into a mix bus, and the
+ * feed for each client is then the bus minus its own contribution, so the
+ * whole mix is O(N).
+ *
+ * Buffers are structure-of-arrays (one contiguous array per channel, channel
+ * after channel), so additions and subtractions are vectorized with SSE.
+ * The mix-minus can be encoded straight into the client wire format,
+ * without an intermediate buffer.
+ *
+ * Bus channel \b b gets client channel <tt>b % NumChans</tt>, so mono clients
+ * are heard on all the bus channels.
+ *
+ * Custom mixes (per listener gains) are built on top of the mix-minus: a
+ * custom mix only holds the sum of <tt>(gain-1)*input</tt> over the few
+ * sources with a custom gain, so it costs close to the mix-minus baseline.
+ * Listeners with the same gains share the same custom mix.
+ *
+ * The levels of the client channels and of the bus (peak and sum of squares,
+ * see HubLevel) are measured in the same loop that adds them, so metering
+ * doesn't read the audio again.
+ */
+class HubMixer
+{
+public:
+
+  /** \brief The class constructor
+   * \param BufferSize Frames per channel in the bus (hub period)
+   * \param MaxBufferSize Largest BufferSize setBufferSize can set, 0 for BufferSize
+   */
+  HubMixer(int BufferSize, int MaxBufferSize = 0);
+  /// \brief The class destructor
+  virtual ~HubMixer();
+
+  /** \brief Clears the bus, to start a new period
+   * \param NumBusChans Number of bus channels (largest number of client channels)
+   */
+  void clearBus(int NumBusChans);
+
+  /** \brief Adds a client input to the bus
+   * \param input Client input, NumChans channels of BufferSize frames
+   * \param NumChans Number of client channels
+   * \param input_levels If not NULL, the levels of the NumChans input
+   * channels are accumulated in it
+   * \param bus_levels If not NULL, the levels of the bus channels after the
+   * addition are accumulated in it (pass it with the last input of the period)
+   */
+  void addToBus(const sample_t* input, int NumChans,
+                HubLevel* input_levels = NULL, HubLevel* bus_levels = NULL);
+
+  /** \brief Computes the feed of a client: the bus minus the client input
+   * \param own_input Client input, as given to addToBus
+   * \param NumChans Number of client channels
+   * \param output Client feed, NumChans channels of BufferSize frames
+   * \param custom_mix Custom mix added to the feed (see createCustomMix),
+   * -1 for none
+   * \param hear_own_input If true, the client input is not subtracted (the
+   * custom mix sets the gain of the client itself)
+   */
+  void computeMixMinus(const sample_t* own_input, int NumChans, sample_t* output,
+                       int custom_mix = -1, bool hear_own_input = false) const;
+
+  /** \brief Same as computeMixMinus, but encodes the feed straight into
+   * wire format (see encodeAudioPacket)
+   *
+   * The feed is computed one channel at a time in \b scratch (BufferSize
+   * frames), so several threads can compute feeds at the same time.
+   */
+  void computeMixMinusPacket(const sample_t* own_input, int NumChans,
+                             int8_t* audio_packet,
+                             AudioInterface::audioBitResolutionT BitResolution,
+                             sample_t* scratch,
+                             int custom_mix = -1, bool hear_own_input = false) const;
+
+  /** \brief Creates an empty custom mix for this period (they're cleared by clearBus)
+   * \return Index of the custom mix
+   */
+  int createCustomMix();
+
+  /** \brief Adds sources to a custom mix, with gains that ramp linearly over the period
+   *
+   * The sources are processed in blocks of frames, so each block of the
+   * custom mix stays in cache while all the sources are added.
+   * \param custom_mix Index of the custom mix
+   * \param inputs Inputs of the sources, as given to addToBus
+   * \param NumChans Number of channels of each source
+   * \param gains_start Gain of each source at the start of the period
+   * \param gains_end Gain of each source at the end of the period
+   * \param NumSources Number of sources
+   */
+  void addToCustomMix(int custom_mix, const sample_t* const* inputs, const int* NumChans,
+                      const sample_t* gains_start, const sample_t* gains_end,
+                      int NumSources);
+
+  /** \brief Encodes audio in wire format (channel after channel), clipping
+   * the samples to the [-1.0, 1.0) range of the integer formats
+   * \param input Audio, channel after channel, input_stride frames apart
+   * \param input_stride Distance between channels in input, in frames
+   * \param NumFrames Frames to encode per channel
+   * \param NumChans Number of channels
+   * \param audio_packet Output, NumChans channels of NumFrames samples
+   * \param BitResolution Bit resolution of the output
+   */
+  static void encodeAudioPacket(const sample_t* input, int input_stride,
+                                int NumFrames, int NumChans, int8_t* audio_packet,
+                                AudioInterface::audioBitResolutionT BitResolution);
+
+  int getNumBusChannels() const { return mNumBusChans; }
+
+  /** \brief Changes the frames per channel (e.g., when the hub period is
+   * raised). Inputs and outputs use the new size from the next clearBus.
+   * \param BufferSize Frames per channel, at most MaxBufferSize
+   */
+  void setBufferSize(int BufferSize) throw(std::invalid_argument);
+  int getBufferSize() const { return mBufferSize; }
+
+
+private:
+
+  /// \brief dst = dst + src
+  static void addBuffers(sample_t* dst, const sample_t* src, int n);
+  /// \brief Same as addBuffers, and accumulates the levels of src and of
+  /// the result (either can be NULL)
+  static void addBuffersMetered(sample_t* dst, const sample_t* src, int n,
+                                HubLevel* src_level, HubLevel* dst_level);
+  /// \brief dst = a - b
+  static void subtractBuffers(sample_t* dst, const sample_t* a, const sample_t* b, int n);
+  /// \brief dst = dst + (gain ramp)*src, the gain goes from gain_start
+  /// (included) to gain_start + n*gain_step (excluded)
+  static void multiplyAccumulate(sample_t* dst, const sample_t* src, int n,
+                                 sample_t gain_start, sample_t gain_step);
+  /// \brief Computes one channel of a client feed
+  void computeFeedChannel(sample_t* output, const sample_t* own_input, int channel,
+                          int custom_mix, bool hear_own_input) const;
+
+  int mBufferSize; ///< Frames per channel
+  const int mMaxBufferSize; ///< Frames per channel allocated in the buffers
+  int mNumBusChans; ///< Bus channels in use
+  int mBusCapacityChans; ///< Channels allocated in the bus
+  sample_t* mBus; ///< Mix bus, 16 byte aligned
+  sample_t* mBusMemory; ///< Allocated memory (mBus points inside it)
+  QVector<sample_t*> mCustomMixes; ///< Custom mixes buffers (grow only)
+  int mCapacityChansCustomMixes; ///< Channels allocated in the custom mixes
+  int mNumCustomMixes; ///< Custom mixes in use this period
+};
+
+#endif //__HUBMIXER_H__
@@ -0,0 +1,695 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file HubRoomManager.cpp
+ * \date October 2026
+ */
+
+#include "HubRoomManager.h"
+#include "HubEngine.h"
+#include "HubSocket.h"
+#include "UdpMasterListener.h"
+#include "AudioInterface.h"
+
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cmath>
+
+#include <QMutexLocker>
+#include <QThread>
+#include <QHostAddress>
+
+using std::cout; using std::endl;
+
+/// Minimum load improvement to move a room to another CPU, in 1/1000 of a period
+const int gHubRebalanceHysteresis = 50;
+/// Peak level reported as clipping (full scale of the 16 bit clients)
+const float gHubClipLevel = 32767.0 / 32768.0;
+/// RMS level reported as silence (-60 dBFS)
+const float gHubSilenceLevel = 0.001;
+
+
+//*******************************************************************************
+HubRoomManager::HubRoomManager(uint32_t SampleRate, uint32_t BufferSize,
+                               int QueueLength, int NumWorkers, int PoolSize,
+                               int UdpPort, bool Forwarding) :
+  mSampleRate(SampleRate),
+  mBufferSize(BufferSize),
+  mQueueLength(QueueLength),
+  mNumWorkers(NumWorkers),
+  mPoolSize(PoolSize),
+  mForwarding(Forwarding),
+  mFirstCpu(0),
+  mNumCpus(1),
+  mMeterReportInterval(0),
+  mNextMeterReport(0),
+  mUdpMasterListener(NULL),
+  mHubSocket(NULL),
+  mRoomsBySession(NULL)
+{
+  mRoomsBySession = new QAtomicPointer<HubRoom>[gMaxThreads];
+  for (int i = 0; i < gMaxThreads; i++) { mRoomsBySession[i] = NULL; }
+  mHubSocket = new HubSocket(UdpPort);
+  mHubSocket->setHubRoomManager(this);
+  mHubSocket->start();
+  int num_cpus = QThread::idealThreadCount();
+  if ( num_cpus > 1 ) {
+    mFirstCpu = 1;
+    mNumCpus = num_cpus - 1;
+  }
+}
+
+
+//*******************************************************************************
+HubRoomManager::~HubRoomManager()
+{
+  // The engines release their sessions when they stop, so they're deleted
+  // without holding the lock
+  QVector<HubRoom*> rooms;
+  {
+    QMutexLocker locker(&mMutex);
+    rooms = mRooms;
+    mRooms.clear();
+    for (int i = 0; i < gMaxThreads; i++) { mRoomsBySession[i].fetchAndStoreOrdered(NULL); }
+  }
+  for (int i = 0; i < rooms.size(); i++) {
+    delete rooms[i]->Engine;
+    delete rooms[i];
+  }
+  // The engines removed their channels, the socket can go
+  delete mHubSocket;
+  delete[] mRoomsBySession;
+}
+
+
+//*******************************************************************************
+int HubRoomManager::getHubPort() const
+{
+  return mHubSocket->getPort();
+}
+
+
+//*******************************************************************************
+uint64_t HubRoomManager::getSessionCookie(int id, uint32_t address) const
+{
+  return mHubSocket->getSessionCookie(id, address);
+}
+
+
+//*******************************************************************************
+HubRoomManager::HubRoom* HubRoomManager::findRoom(const QString& room) const
+{
+  for (int i = 0; i < mRooms.size(); i++) {
+    if ( mRooms[i]->Name == room ) { return mRooms[i]; }
+  }
+  return NULL;
+}
+
+
+//*******************************************************************************
+HubRoomManager::HubRoom* HubRoomManager::createRoom(const QString& room)
+{
+  {
+    QMutexLocker locker(&mMutex);
+    HubRoom* hub_room = findRoom(room);
+    if ( (hub_room != NULL) || (mRooms.size() >= gHubMaxRooms) ) { return hub_room; }
+  }
+
+  HubEngine* engine = new HubEngine(mSampleRate, mBufferSize, mQueueLength, mNumWorkers,
+                                    mPoolSize, mForwarding);
+  engine->setUdpMasterListener(mUdpMasterListener);
+  engine->setHubSocket(mHubSocket);
+  int cpu;
+  {
+    QMutexLocker locker(&mMutex);
+    cpu = getLeastLoadedCpu();
+  }
+  engine->setCpu(cpu);
+  engine->start();
+
+  mMutex.lock();
+  // Rooms are only created by the listener thread, but the TCP handshakes
+  // and the UDP joins can ask for the same one
+  HubRoom* hub_room = findRoom(room);
+  if ( (hub_room != NULL) || (mRooms.size() >= gHubMaxRooms) ) {
+    mMutex.unlock();
+    delete engine;
+    return hub_room;
+  }
+  hub_room = new HubRoom;
+  hub_room->Name = room;
+  hub_room->Engine = engine;
+  hub_room->NumSessions = 0;
+  hub_room->New = true;
+  mRooms.append(hub_room);
+  mMutex.unlock();
+  cout << "JackTrip HUB SERVER: Room \"" << room.toStdString()
+       << "\" created on CPU " << cpu << endl;
+  return hub_room;
+}
+
+
+//*******************************************************************************
+void HubRoomManager::createRequestedRooms()
+{
+  QVector<QString> rooms;
+  {
+    QMutexLocker locker(&mMutex);
+    if ( mRequestedRooms.isEmpty() ) { return; }
+    rooms = mRequestedRooms;
+    mRequestedRooms.clear();
+  }
+  for (int i = 0; i < rooms.size(); i++) {
+    if ( createRoom(rooms[i]) == NULL ) {
+      std::cerr << "JackTrip HUB SERVER: Room \"" << rooms[i].toStdString()
+                << "\" not created, the hub has " << gHubMaxRooms << " rooms" << endl;
+    }
+  }
+}
+
+
+//*******************************************************************************
+bool HubRoomManager::addSession(const QString& room, int id, uint32_t address,
+                                uint16_t client_port, const HubClientSettings* settings,
+                                bool trunk, bool create)
+{
+  // The engines call sessionReleased while holding their own locks, so they're
+  // called without holding mMutex. Rooms are only deleted by rebalance(), and
+  // only when they have no sessions, so the room can't go away once it
+  // counts this one. rebalance() runs in the thread that creates the rooms,
+  // so a room created here is still there when it's locked again.
+  mMutex.lock();
+  HubRoom* hub_room = findRoom(room);
+  if ( (hub_room == NULL) && create ) {
+    mMutex.unlock();
+    createRoom(room);
+    mMutex.lock();
+    hub_room = findRoom(room);
+  }
+  if ( hub_room == NULL ) {
+    mMutex.unlock();
+    return false;
+  }
+
+  hub_room->NumSessions.ref();
+  mRoomsBySession[id].fetchAndStoreOrdered(hub_room);
+  mMutex.unlock();
+
+  hub_room->Engine->addSession(id, mHubSocket->addChannel(id, address, client_port),
+                               settings, trunk);
+  cout << "JackTrip HUB SERVER: " << (trunk ? "Trunk" : "Client") << " ID = " << id
+       << " joins room \"" << room.toStdString() << "\"" << endl;
+  return true;
+}
+
+
+//*******************************************************************************
+int HubRoomManager::joinSession(const HubJoinRequest& request, uint32_t address,
+                                uint16_t port)
+{
+  if ( mUdpMasterListener == NULL ) { return -1; } // the listener isn't running yet
+
+  // The reply was lost and the client asks again
+  int id = mUdpMasterListener->getPoolID(address, port);
+  if ( id >= 0 ) { return id; }
+
+  HubClientSettings settings;
+  settings.BufferSize = request.BufferSize;
+  settings.SamplingRate = request.SamplingRate;
+  settings.BitResolution = request.BitResolution;
+  settings.NumChannels = request.NumChannels;
+  settings.Redundancy = request.Redundancy;
+  if ( !HubEngine::checkClientSettings(settings) ) {
+    std::cerr << "JackTrip HUB SERVER: Join request with unsupported audio settings" << endl;
+    return -1;
+  }
+  // The sub-mixes go between the hubs as they are, without conversion, and
+  // a forwarding hub has no sub-mix to send
+  bool trunk = ( (request.Flags & gHubJoinTrunkFlag) != 0 );
+  if ( trunk && mForwarding ) {
+    std::cerr << "JackTrip HUB SERVER: Trunk request to a forwarding hub rejected" << endl;
+    return -1;
+  }
+  if ( trunk && ( (settings.BufferSize != static_cast<int>(mBufferSize)) ||
+                  (static_cast<uint32_t>( AudioInterface::getSampleRateFromType
+                    ( static_cast<AudioInterface::samplingRateT>(settings.SamplingRate) ) ) !=
+                   mSampleRate) ) ) {
+    std::cerr << "JackTrip HUB SERVER: Trunk request from a hub with another sample rate "
+              << "or buffer size" << endl;
+    return -1;
+  }
+  // The clients of a forwarding hub get the packets of the other clients,
+  // with a HubForwardHeader in front, and have to mix them
+  if ( mForwarding && !trunk && ((request.Flags & gHubJoinAudienceFlag) == 0) &&
+       ((request.Flags & gHubJoinForwardFlag) == 0) ) {
+    std::cerr << "JackTrip HUB SERVER: Client that can't mix locally rejected by a forwarding hub"
+              << endl;
+    return -1;
+  }
+  int room_length = (request.RoomLength < gHubMaxRoomNameLength) ?
+        request.RoomLength : gHubMaxRoomNameLength;
+  QString room = QString::fromUtf8(request.Room, room_length);
+  if ( (request.Flags & gHubJoinAudienceFlag) != 0 ) {
+    return joinAudience(room, address, port, settings) ? gHubAudienceSessionID : -1; }
+  if ( !canAdmitSession(room) ) {
+    std::cerr << "JackTrip HUB SERVER: Hub is overloaded (or has too many rooms), join request rejected" << endl;
+    return -1;
+  }
+  {
+    // The listener thread creates the room, the client asks again meanwhile
+    QMutexLocker locker(&mMutex);
+    if ( findRoom(room) == NULL ) {
+      if ( !mRequestedRooms.contains(room) ) { mRequestedRooms.append(room); }
+      return gHubJoinPendingID;
+    }
+  }
+
+  id = mUdpMasterListener->isNewAddress(address, port);
+  if ( id < 0 ) { return -1; } // pool is full
+  if ( !addSession(room, id, address, port, &settings, trunk, false) ) {
+    // The room was closed meanwhile
+    mUdpMasterListener->releaseThread(id);
+    return -1;
+  }
+  return id;
+}
+
+
+//*******************************************************************************
+bool HubRoomManager::joinAudience(const QString& room, uint32_t address, uint16_t port,
+                                  const HubClientSettings& settings)
+{
+  // A forwarding hub has no room mix to send
+  if ( mForwarding ) {
+    std::cerr << "JackTrip HUB SERVER: A forwarding hub has no audience" << endl;
+    return false;
+  }
+  // The room is counted as used while the listener is added (rebalance() only
+  // deletes rooms without sessions), the engine is called without mMutex
+  mMutex.lock();
+  HubRoom* hub_room = findRoom(room);
+  if ( (hub_room == NULL) ||
+       (hub_room->Engine->getNumListeners() >= gHubAudienceMaxListeners) ) {
+    mMutex.unlock();
+    std::cerr << "JackTrip HUB SERVER: Audience join request to a room that doesn't exist "
+              << "or is full" << endl;
+    return false;
+  }
+  hub_room->NumSessions.ref();
+  mMutex.unlock();
+
+  hub_room->Engine->addListener(address, port, settings);
+
+  hub_room->NumSessions.deref();
+  return true;
+}
+
+
+//*******************************************************************************
+int HubRoomManager::resumeSession(int id, uint64_t cookie, uint32_t address, uint16_t port)
+{
+  if ( mUdpMasterListener == NULL ) { return -1; }
+  uint32_t old_address;
+  if ( !mHubSocket->resumeChannel(id, cookie, address, port, old_address) ) { return -1; }
+  // A new handshake from the new address and port resumes the session too
+  mUdpMasterListener->moveAddress(id, old_address, address, port);
+  return id;
+}
+
+
+//*******************************************************************************
+bool HubRoomManager::isSessionInRoom(int id, const QString& room)
+{
+  QMutexLocker locker(&mMutex);
+  if ( (id < 0) || (id >= gMaxThreads) ) { return false; }
+  HubRoom* hub_room = mRoomsBySession[id].fetchAndAddAcquire(0);
+  return ( (hub_room != NULL) && (hub_room->Name == room) );
+}
+
+
+//*******************************************************************************
+bool HubRoomManager::canAdmitSession(const QString& room)
+{
+  QMutexLocker locker(&mMutex);
+  HubRoom* hub_room = findRoom(room);
+  HubEngine* engine = (hub_room != NULL) ? hub_room->Engine : NULL;
+
+  QVector<int> cpu_loads;
+  computeCpuLoads(cpu_loads);
+  int cpu_load = 0;
+  int session_load = gHubDefaultSessionLoad;
+  if ( engine != NULL ) {
+    if ( engine->getOverloadLevel() != HubEngine::FULL_QUALITY ) { return false; }
+    int cpu = engine->getCpu() - mFirstCpu;
+    if ( (cpu >= 0) && (cpu < mNumCpus) ) { cpu_load = cpu_loads[cpu]; }
+    if ( engine->getSessionLoad() > 0 ) { session_load = engine->getSessionLoad(); }
+  }
+  else {
+    if ( ((mRooms.size() + mRequestedRooms.size()) >= gHubMaxRooms) &&
+         !mRequestedRooms.contains(room) ) { return false; }
+    cpu_load = cpu_loads[getLeastLoadedCpu() - mFirstCpu];
+  }
+  return ( (cpu_load + session_load) <= gHubAdmissionLoad );
+}
+
+
+//*******************************************************************************
+void HubRoomManager::removeSession(int id)
+{
+  HubEngine* engine = NULL;
+  {
+    QMutexLocker locker(&mMutex);
+    HubRoom* hub_room = mRoomsBySession[id].fetchAndAddAcquire(0);
+    if ( hub_room != NULL ) { engine = hub_room->Engine; }
+  }
+  if ( engine != NULL ) { engine->removeSession(id); }
+}
+
+
+//*******************************************************************************
+void HubRoomManager::sessionReleased(int id)
+{
+  // Lock-free, the engines call it from their audio thread. The count only
+  // drops once the room isn't reachable from the session, and rebalance()
+  // (with mMutex) only deletes rooms whose count is 0.
+  HubRoom* hub_room = mRoomsBySession[id].fetchAndStoreOrdered(NULL);
+  if ( hub_room != NULL ) { hub_room->NumSessions.deref(); }
+}
+
+
+//*******************************************************************************
+void HubRoomManager::addTrunk(const QString& room, uint32_t address, uint16_t port)
+{
+  if ( mForwarding ) {
+    std::cerr << "JackTrip HUB SERVER: A forwarding hub can't have trunks" << endl;
+    return;
+  }
+  HubTrunk trunk;
+  trunk.Room = room;
+  trunk.Address = address;
+  trunk.Port = port;
+  trunk.Attempts = 0;
+  trunk.Cookie = 0;
+  QMutexLocker locker(&mMutex);
+  mTrunks.append(trunk);
+}
+
+
+//*******************************************************************************
+void HubRoomManager::getTrunkRequest(const HubTrunk& trunk, HubJoinRequest& request) const
+{
+  HubClientSettings settings;
+  getTrunkSettings(settings);
+  std::memset(&request, 0, sizeof(request));
+  request.Magic = gHubJoinMagic;
+  request.BufferSize = settings.BufferSize;
+  request.SamplingRate = settings.SamplingRate;
+  request.BitResolution = settings.BitResolution;
+  request.NumChannels = settings.NumChannels;
+  request.Redundancy = settings.Redundancy;
+  request.Flags = gHubJoinTrunkFlag;
+  request.Cookie = trunk.Cookie;
+  QByteArray room = trunk.Room.toUtf8();
+  request.RoomLength = (room.size() < gHubMaxRoomNameLength) ?
+        room.size() : gHubMaxRoomNameLength;
+  std::memcpy(request.Room, room.constData(), request.RoomLength);
+}
+
+
+//*******************************************************************************
+void HubRoomManager::connectTrunks()
+{
+  if ( mUdpMasterListener == NULL ) { return; }
+  HubJoinRequest request;
+  QMutexLocker locker(&mMutex);
+  for (int i = 0; i < mTrunks.size(); i++) {
+    HubTrunk& trunk = mTrunks[i];
+    // The trunk is up while the peer hub has a session here
+    if ( mUdpMasterListener->getPoolID(trunk.Address, trunk.Port) >= 0 ) {
+      trunk.Attempts = 0;
+      continue;
+    }
+    if ( trunk.Attempts == 0 ) {
+      cout << "JackTrip HUB SERVER: Joining hub "
+           << QHostAddress(trunk.Address).toString().toStdString() << ":" << trunk.Port
+           << " (room \"" << trunk.Room.toStdString() << "\")" << endl;
+    }
+    trunk.Attempts++;
+    getTrunkRequest(trunk, request);
+    mHubSocket->sendDatagram(reinterpret_cast<const int8_t*>(&request), sizeof(request),
+                             trunk.Address, trunk.Port);
+  }
+}
+
+
+//*******************************************************************************
+void HubRoomManager::trunkJoined(const HubJoinReply& reply, uint32_t address, uint16_t port)
+{
+  if ( mUdpMasterListener == NULL ) { return; }
+  QString room;
+  int attempts = 0;
+  {
+    QMutexLocker locker(&mMutex);
+    for (int i = 0; i < mTrunks.size(); i++) {
+      if ( (mTrunks[i].Address == address) && (mTrunks[i].Port == port) ) {
+        room = mTrunks[i].Room;
+        attempts = mTrunks[i].Attempts;
+        // The peer hub wants its join cookie back before it adds the trunk
+        if ( (attempts > 0) && (reply.SessionID == gHubJoinChallengeID) ) {
+          mTrunks[i].Cookie = reply.Cookie;
+          HubJoinRequest request;
+          getTrunkRequest(mTrunks[i], request);
+          mHubSocket->sendDatagram(reinterpret_cast<const int8_t*>(&request),
+                                   sizeof(request), address, port);
+          return;
+        }
+        break;
+      }
+    }
+  }
+  // Only the hubs this hub asked to join
+  if ( attempts == 0 ) { return; }
+  if ( reply.SessionID < 0 ) {
+    if ( attempts == 1 ) {
+      std::cerr << "JackTrip HUB SERVER: Hub " << QHostAddress(address).toString().toStdString()
+                << ":" << port << " refused the trunk (the hubs need the same sample rate "
+                << "and buffer size), trying again" << endl;
+    }
+    return;
+  }
+  // The reply is repeated if a join request was sent again meanwhile
+  if ( mUdpMasterListener->getPoolID(address, port) >= 0 ) { return; }
+
+  int id = mUdpMasterListener->isNewAddress(address, port);
+  if ( id < 0 ) { return; } // pool is full, tried again later
+  HubClientSettings settings;
+  getTrunkSettings(settings);
+  // The room of a trunk is created by the listener thread, the trunk is
+  // joined again later
+  if ( !addSession(room, id, address, port, &settings, true, false) ) {
+    mUdpMasterListener->releaseThread(id);
+    QMutexLocker locker(&mMutex);
+    if ( !mRequestedRooms.contains(room) ) { mRequestedRooms.append(room); }
+    return;
+  }
+  cout << "JackTrip HUB SERVER: Trunk to hub " << QHostAddress(address).toString().toStdString()
+       << ":" << port << " is up (session ID " << reply.SessionID << " there)" << endl;
+}
+
+
+//*******************************************************************************
+void HubRoomManager::getTrunkSettings(HubClientSettings& settings) const
+{
+  // 32 bits are floats on the wire, sub-mixes louder than one client don't clip
+  settings.BufferSize = mBufferSize;
+  settings.SamplingRate = AudioInterface::getSampleRateTypeFromRate(mSampleRate);
+  settings.BitResolution = 32;
+  settings.NumChannels = gHubTrunkNumChannels;
+  settings.Redundancy = gHubTrunkRedundancy;
+}
+
+
+//*******************************************************************************
+void HubRoomManager::rebalance()
+{
+  QVector<HubRoom*> empty_rooms;
+  {
+    QMutexLocker locker(&mMutex);
+
+    // Rooms without clients are closed (a new room waits one rebalance for
+    // its first client)
+    for (int i = mRooms.size()-1; i >= 0; i--) {
+      if ( mRooms[i]->New ) {
+        mRooms[i]->New = false;
+        continue;
+      }
+      if ( mRooms[i]->NumSessions == 0 ) {
+        empty_rooms.append(mRooms[i]);
+        mRooms.remove(i);
+      }
+    }
+
+    // Move the room that best evens the busiest and the least loaded CPUs
+    QVector<int> cpu_loads;
+    computeCpuLoads(cpu_loads);
+    int busiest = 0;
+    int idlest = 0;
+    for (int i = 1; i < mNumCpus; i++) {
+      if ( cpu_loads[i] > cpu_loads[busiest] ) { busiest = i; }
+      if ( cpu_loads[i] < cpu_loads[idlest] ) { idlest = i; }
+    }
+    HubRoom* best_room = NULL;
+    int best_max_load = cpu_loads[busiest] - gHubRebalanceHysteresis;
+    for (int i = 0; i < mRooms.size(); i++) {
+      if ( mRooms[i]->Engine->getCpu() != (mFirstCpu + busiest) ) { continue; }
+      int load = mRooms[i]->Engine->getLoad();
+      int busiest_load = cpu_loads[busiest] - load;
+      int idlest_load = cpu_loads[idlest] + load;
+      int max_load = (busiest_load > idlest_load) ? busiest_load : idlest_load;
+      if ( max_load < best_max_load ) {
+        best_room = mRooms[i];
+        best_max_load = max_load;
+      }
+    }
+    if ( best_room != NULL ) {
+      best_room->Engine->setCpu(mFirstCpu + idlest);
+      cout << "JackTrip HUB SERVER: Room \"" << best_room->Name.toStdString()
+           << "\" moved to CPU " << (mFirstCpu + idlest) << endl;
+    }
+  }
+
+  // Stop the engines of the empty rooms (no new sessions can get there)
+  for (int i = 0; i < empty_rooms.size(); i++) {
+    cout << "JackTrip HUB SERVER: Room \"" << empty_rooms[i]->Name.toStdString()
+         << "\" closed" << endl;
+    delete empty_rooms[i]->Engine;
+    delete empty_rooms[i];
+  }
+}
+
+
+//*******************************************************************************
+void HubRoomManager::reportLevels(uint64_t now)
+{
+  if ( (mMeterReportInterval <= 0) || (now < mNextMeterReport) ) { return; }
+  mNextMeterReport = now + (mMeterReportInterval * 1000000ULL);
+
+  // Rooms are only deleted by rebalance(), in this same thread, so their
+  // engines are read without holding the lock
+  QVector<HubRoom*> rooms;
+  {
+    QMutexLocker locker(&mMutex);
+    rooms = mRooms;
+  }
+  QVector<HubMeterReading> readings;
+  for (int i = 0; i < rooms.size(); i++) {
+    if ( !rooms[i]->Engine->getLevels(readings) || readings.isEmpty() ) { continue; }
+    cout << "JackTrip HUB SERVER: Room \"" << rooms[i]->Name.toStdString()
+         << "\" levels (peak/RMS dBFS of each channel):" << endl;
+    // One line for the mix and one for each client
+    for (int j = 0; j < readings.size(); ) {
+      const int session_id = readings[j].SessionID;
+      bool clipping = false;
+      bool silent = true;
+      if ( session_id < 0 ) { cout << "  Mix:"; }
+      else { cout << "  Client ID = " << session_id << ":"; }
+      for ( ; (j < readings.size()) && (readings[j].SessionID == session_id); j++) {
+        cout << " ";
+        printDecibels(readings[j].Peak);
+        cout << "/";
+        printDecibels(readings[j].Rms);
+        if ( readings[j].Peak >= gHubClipLevel ) { clipping = true; }
+        if ( readings[j].Rms >= gHubSilenceLevel ) { silent = false; }
+      }
+      if ( clipping ) { cout << " (clipping)"; }
+      else if ( silent ) { cout << " (silent)"; }
+      cout << endl;
+    }
+  }
+}
+
+
+//*******************************************************************************
+void HubRoomManager::printEngineEvents()
+{
+  // As in reportLevels, the engines are read without holding the lock
+  QVector<HubRoom*> rooms;
+  {
+    QMutexLocker locker(&mMutex);
+    rooms = mRooms;
+  }
+  for (int i = 0; i < rooms.size(); i++) { rooms[i]->Engine->printEvents(); }
+}
+
+
+//*******************************************************************************
+void HubRoomManager::printDecibels(float level)
+{
+  if ( level <= 0.0 ) {
+    cout << "-inf";
+    return;
+  }
+  std::ios_base::fmtflags flags = cout.flags();
+  std::streamsize precision = cout.precision();
+  cout << std::fixed << std::setprecision(1) << (20.0 * std::log10(level));
+  cout.flags(flags);
+  cout.precision(precision);
+}
+
+
+//*******************************************************************************
+int HubRoomManager::getLeastLoadedCpu() const
+{
+  QVector<int> cpu_loads;
+  computeCpuLoads(cpu_loads);
+  int idlest = 0;
+  for (int i = 1; i < mNumCpus; i++) {
+    if ( cpu_loads[i] < cpu_loads[idlest] ) { idlest = i; }
+  }
+  return mFirstCpu + idlest;
+}
+
+
+//*******************************************************************************
+void HubRoomManager::computeCpuLoads(QVector<int>& cpu_loads) const
+{
+  cpu_loads.resize(mNumCpus);
+  cpu_loads.fill(0);
+  for (int i = 0; i < mRooms.size(); i++) {
+    int cpu = mRooms[i]->Engine->getCpu() - mFirstCpu;
+    // A new room has no load yet, count it as a small load so the next new
+    // room goes to another CPU
+    int load = mRooms[i]->Engine->getLoad();
+    if ( (cpu >= 0) && (cpu < mNumCpus) ) { cpu_loads[cpu] += (load > 0) ? load : 1; }
+  }
+}
@@ -0,0 +1,308 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file HubRoomManager.h
+ * \date October 2026
+ */
+
+#ifndef __HUBROOMMANAGER_H__
+#define __HUBROOMMANAGER_H__
+
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#include "jacktrip_types.h"
+#include "jacktrip_globals.h"
+class HubEngine; // forward declaration
+class HubSocket; // forward declaration
+struct HubClientSettings; // forward declaration
+struct HubJoinRequest; // forward declaration
+struct HubJoinReply; // forward declaration
+class UdpMasterListener; // forward declaration
+
+
+/** \brief Named rooms of the hub server, each one with its own HubEngine
+ *
+ * Clients only hear the clients in the same room. Every room has its own
+ * engine thread (with its own mixer and buffers), pinned to one CPU,
+ * so rooms don't compete for the same cache and the scheduler doesn't move
+ * the realtime threads around. New rooms go to the least loaded CPU, and
+ * rebalance() moves rooms when a CPU gets busier than the others.
+ *
+ * All the rooms share one HubSocket, so all the clients send their audio to
+ * the same UDP port.
+ *
+ * The CPU 0 is left for the UdpMasterListener, the HubSocket and the system,
+ * unless it's the only one.
+ *
+ * A hub has at most gHubMaxRooms rooms. The rooms of the UDP joins are
+ * created by the listener thread (see createRequestedRooms), building and
+ * starting an engine would stall the reception of all the clients.
+ *
+ * Rooms can be trunked to the same room of other hubs (see addTrunk), so
+ * an ensemble too large for one machine is split among several hubs. The
+ * hub that has the trunk configured joins the other one, and joins it again
+ * if the trunk times out.
+ *
+ * A forwarding hub relays the client packets instead of mixing them, the
+ * clients mix locally (see HubEngine). It can't have trunks, and it only
+ * takes the clients that join by UDP with gHubJoinForwardFlag (the others
+ * can't read the relayed packets).
+ *
+ * Rooms have a listen-only audience too (see joinAudience), for concerts:
+ * the listeners get the room mix without being sessions, so they don't
+ * count against the session pool nor the room admission control.
+ *
+ * With a meter report interval (see setMeterReportInterval), the levels of
+ * every room mix and client channel are printed, so operators see who is
+ * clipping or silent.
+ */
+class HubRoomManager
+{
+public:
+  /** \brief The class constructor
+   * \param SampleRate Sample rate of the room engines, in Hz
+   * \param BufferSize Period of the room engines, in samples
+   * \param QueueLength Client input queue length, in periods
+   * \param NumWorkers Scheduler worker threads of each room engine
+   * \param PoolSize Sessions allocated in advance by each room engine
+   * \param UdpPort UDP port of the hub, where all the clients send their audio
+   * \param Forwarding True if the room engines relay the client packets instead of mixing them
+   */
+  HubRoomManager(uint32_t SampleRate = gDefaultSampleRate,
+                 uint32_t BufferSize = gDefaultBufferSizeInSamples,
+                 int QueueLength = gDefaultQueueLength,
+                 int NumWorkers = 0,
+                 int PoolSize = gHubDefaultSessionPool,
+                 int UdpPort = gServerUdpPort,
+                 bool Forwarding = false);
+  /// \brief The class destructor, stops all the room engines
+  virtual ~HubRoomManager();
+
+  /// \brief Sets the listener the engines release the session IDs to
+  void setUdpMasterListener(UdpMasterListener* udpmasterlistener)
+  { mUdpMasterListener = udpmasterlistener; }
+
+  /// \brief UDP port of the hub, to send to the clients
+  int getHubPort() const;
+  /// \brief True if the room engines relay the client packets instead of mixing them
+  bool isForwarding() const { return mForwarding; }
+
+  /** \brief Adds a client to a room
+   * \param room Room name (empty for the default room)
+   * \param id Session ID
+   * \param address Client IPv4 address
+   * \param client_port UDP port the client announced in the TCP handshake
+   * \param settings Client audio settings, NULL if they come with the first packet
+   * \param trunk True if the client is another hub
+   * \param create True to create the room if it doesn't exist
+   * \return false if the room doesn't exist and isn't created (the hub has
+   * gHubMaxRooms rooms, or \b create is false)
+   */
+  bool addSession(const QString& room, int id, uint32_t address, uint16_t client_port,
+                  const HubClientSettings* settings = NULL, bool trunk = false,
+                  bool create = true);
+  /** \brief Adds the client of a HubJoinRequest with a valid join cookie
+   * (thread safe, called by the HubSocket thread). A repeated request (the
+   * reply was lost) gets the same session. If the room doesn't exist, it's
+   * requested to the listener thread (see createRequestedRooms) and the
+   * client gets its session when it asks again. Another hub joins as a trunk (gHubJoinTrunkFlag) only if it
+   * runs at the same sample rate and buffer size. A listener of the audience
+   * (gHubJoinAudienceFlag) gets no session, see joinAudience.
+   * \param request Join request
+   * \param address Client IPv4 address (source of the request)
+   * \param port Client UDP port (source of the request)
+   * \return The session ID, gHubAudienceSessionID for a listener,
+   * gHubJoinPendingID if the room is being created, -1 if the client can't join
+   */
+  int joinSession(const HubJoinRequest& request, uint32_t address, uint16_t port);
+  /** \brief Moves a session to the new address and port of its client (thread
+   * safe, called by the HubSocket thread). The session keeps its state.
+   * \param id Session ID
+   * \param cookie Session cookie the client has
+   * \param address New client IPv4 address
+   * \param port New client UDP port
+   * \return The session ID, -1 if there's no such session or the cookie is wrong
+   */
+  int resumeSession(int id, uint64_t cookie, uint32_t address, uint16_t port);
+  /** \brief Tells whether a session is in a room (thread safe), so a client
+   * that does the handshake again can keep it
+   * \param id Session ID
+   * \param room Room the client asks for
+   */
+  bool isSessionInRoom(int id, const QString& room);
+  /** \brief Admission control (thread safe): tells whether one more client
+   * fits in a room without overloading its CPU
+   *
+   * The client is refused if the room engine is already degraded (see
+   * HubEngine::overloadLevelT), or if the load of the room CPU (the least
+   * loaded one for a new room) plus the average CPU time of one session
+   * would go over gHubAdmissionLoad. A new room is refused if the hub has
+   * gHubMaxRooms rooms.
+   * \param room Room the client asks for
+   */
+  bool canAdmitSession(const QString& room);
+  /** \brief Creates the rooms the UDP joins asked for (see joinSession)
+   *
+   * Call it from the listener thread, every time it wakes up.
+   */
+  void createRequestedRooms();
+  /// \brief Cookie of a session, for the TCP handshake (see HubSocket::getSessionCookie)
+  uint64_t getSessionCookie(int id, uint32_t address) const;
+  /// \brief Removes a client from its room
+  void removeSession(int id);
+  /// \brief Tells the manager that an engine released a session (lock-free, thread safe)
+  void sessionReleased(int id);
+
+  /** \brief Trunks a room to the same room of another hub (thread safe)
+   *
+   * This hub joins the other one with a HubJoinRequest from the hub port,
+   * in the sub-mix format (see HubEngine), and both hubs add the other one
+   * as a trunk session. The hubs have to be connected as a tree.
+   * \param room Room name (empty for the default room)
+   * \param address IPv4 address of the other hub
+   * \param port UDP port of the other hub
+   */
+  void addTrunk(const QString& room, uint32_t address, uint16_t port);
+  /** \brief Joins the hubs of the trunks that are not up (thread safe)
+   *
+   * Call it periodically (every gHubRebalanceInterval) from the listener thread.
+   */
+  void connectTrunks();
+  /** \brief Adds the trunk a peer hub accepted (thread safe, called by the
+   * HubSocket thread). Replies that don't come from a trunk peer are ignored.
+   * A challenge (gHubJoinChallengeID) is answered right away, with the join
+   * cookie of the peer hub.
+   * \param reply Join reply of the peer hub
+   * \param address IPv4 address of the peer hub (source of the reply)
+   * \param port UDP port of the peer hub (source of the reply)
+   */
+  void trunkJoined(const HubJoinReply& reply, uint32_t address, uint16_t port);
+
+  /** \brief Deletes the empty rooms and moves one room from the busiest CPU to
+   * the least loaded one, if that lowers the load of the busiest CPU.
+   *
+   * Call it periodically (every gHubRebalanceInterval) from the listener thread.
+   */
+  void rebalance();
+
+  /// \brief Prints the room levels every \b seconds (see reportLevels), 0 for never
+  void setMeterReportInterval(int seconds) { mMeterReportInterval = seconds; }
+  /** \brief Prints the peak and RMS levels of the last metering interval of
+   * every room (see HubEngine::getLevels), if the report interval elapsed.
+   *
+   * Call it periodically from the listener thread (with rebalance).
+   * \param now Current time, in usec
+   */
+  void reportLevels(uint64_t now);
+  /** \brief Prints the events the engines of the rooms queued (see HubEngine::printEvents).
+   *
+   * Call it from the listener thread, every time it wakes up.
+   */
+  void printEngineEvents();
+
+
+private:
+
+  /// \brief A room and its engine
+  struct HubRoom
+  {
+    QString Name; ///< Room name
+    HubEngine* Engine; ///< Engine of the room
+    QAtomicInt NumSessions; ///< Sessions added and not released yet (released without mMutex)
+    bool New; ///< Not rebalanced yet, kept without sessions (the client of the UDP join is on its way)
+  };
+
+  /// \brief A trunk this hub joins
+  struct HubTrunk
+  {
+    QString Room; ///< Room name, the same in both hubs
+    uint32_t Address; ///< IPv4 address of the peer hub
+    uint16_t Port; ///< UDP port of the peer hub
+    int Attempts; ///< Join requests sent since the trunk was last up
+    uint64_t Cookie; ///< Join cookie of the last challenge of the peer hub
+  };
+
+  /// \brief Audio settings of the trunks, the sub-mix format
+  void getTrunkSettings(HubClientSettings& settings) const;
+  /** \brief Join request of a trunk (called with mMutex locked)
+   * \param trunk Trunk to join
+   * \param request Returns the request, with the last join cookie of the peer hub
+   */
+  void getTrunkRequest(const HubTrunk& trunk, HubJoinRequest& request) const;
+  /// \brief Returns the room with that name, NULL if none (called with mMutex locked)
+  HubRoom* findRoom(const QString& room) const;
+  /** \brief Builds and starts the engine of a new room, and adds the room
+   * (called without mMutex, the engine takes time to start)
+   * \return The room (an existing one if it was added meanwhile), NULL if
+   * the hub has gHubMaxRooms rooms
+   */
+  HubRoom* createRoom(const QString& room);
+  /** \brief Adds a listener to the audience of a room that exists (see
+   * HubEngine::addListener). The listener joins again to stay.
+   * \return false if the room doesn't exist or its audience is full
+   */
+  bool joinAudience(const QString& room, uint32_t address, uint16_t port,
+                    const HubClientSettings& settings);
+  /// \brief Returns the CPU with the lowest load
+  int getLeastLoadedCpu() const;
+  /// \brief Adds up the load of the rooms on each CPU
+  void computeCpuLoads(QVector<int>& cpu_loads) const;
+  /// \brief Prints a linear level in dBFS
+  static void printDecibels(float level);
+
+  const uint32_t mSampleRate; ///< Sample rate of the room engines
+  const uint32_t mBufferSize; ///< Period of the room engines
+  const int mQueueLength; ///< Client input queue length
+  const int mNumWorkers; ///< Scheduler worker threads of each room engine
+  const int mPoolSize; ///< Sessions allocated in advance by each room engine
+  const bool mForwarding; ///< The room engines relay the client packets instead of mixing them
+  int mFirstCpu; ///< First CPU for the room engines
+  int mNumCpus; ///< Number of CPUs for the room engines
+  int mMeterReportInterval; ///< Time between two level reports, in seconds (0 for none)
+  uint64_t mNextMeterReport; ///< Time of the next level report, in usec (listener thread)
+  UdpMasterListener* mUdpMasterListener; ///< Listener to release session IDs
+  HubSocket* mHubSocket; ///< Socket shared by all the rooms
+
+  QVector<HubRoom*> mRooms; ///< Active rooms
+  /// Room of each session ID (gMaxThreads), NULL if none. Set with mMutex
+  /// locked, cleared without it by sessionReleased
+  QAtomicPointer<HubRoom>* mRoomsBySession;
+  QVector<HubTrunk> mTrunks; ///< Trunks this hub joins
+  QVector<QString> mRequestedRooms; ///< Rooms the UDP joins asked for, not created yet
+  QMutex mMutex; ///< Protects the rooms (and the session count increments), the requested rooms, and the trunks
+};
+
+#endif //__HUBROOMMANAGER_H__
@@ -0,0 +1,207 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file HubScheduler.cpp
+ * \date October 2026
+ */
+
+#include "HubScheduler.h"
+#include "jacktrip_globals.h"
+
+#include <stdexcept>
+
+#include <QMutexLocker>
+
+
+//*******************************************************************************
+HubScheduler::HubScheduler(int NumWorkers) :
+  mNumThreads(NumWorkers + 1),
+  mRanges(NULL),
+  mPendingTasks(0),
+  mActiveWorkers(0),
+  mFunction(NULL),
+  mContext(NULL),
+  mStolenTasks(0),
+  mRunStolenTasks(0),
+  mGeneration(0),
+  mStopped(false)
+{
+  if ( NumWorkers < 0 ) {
+    throw std::invalid_argument("HubScheduler: invalid number of workers");
+  }
+  mRanges = new QAtomicInt[mNumThreads];
+  for (int i = 0; i < mNumThreads; i++) { mRanges[i] = 0; }
+  for (int i = 1; i < mNumThreads; i++) {
+    mWorkers.append(new Worker(this, i));
+    mWorkers.last()->start(QThread::TimeCriticalPriority);
+  }
+}
+
+
+//*******************************************************************************
+HubScheduler::~HubScheduler()
+{
+  {
+    QMutexLocker locker(&mMutex);
+    mStopped = true;
+    mStartCondition.wakeAll();
+  }
+  for (int i = 0; i < mWorkers.size(); i++) {
+    mWorkers[i]->wait();
+    delete mWorkers[i];
+  }
+  delete[] mRanges;
+}
+
+
+//*******************************************************************************
+void HubScheduler::run(TaskFunction function, void* context, const int* costs, int NumTasks)
+{
+  if ( NumTasks <= 0 ) { return; }
+  if ( (mNumThreads == 1) || (NumTasks == 1) ) {
+    for (int i = 0; i < NumTasks; i++) { function(context, i, 0); }
+    return;
+  }
+
+  // Contiguous ranges of about the same total cost
+  int total_cost = 0;
+  for (int i = 0; i < NumTasks; i++) { total_cost += (costs[i] > 0) ? costs[i] : 1; }
+  int begin = 0;
+  int accumulated_cost = 0;
+  for (int i = 0; i < mNumThreads; i++) {
+    int end = begin;
+    // Range i ends where the accumulated cost reaches (i+1)/mNumThreads of the total
+    const int target_cost = static_cast<int>
+        ( (static_cast<int64_t>(total_cost) * (i+1)) / mNumThreads );
+    while ( (end < NumTasks) &&
+            ((i == mNumThreads-1) || (accumulated_cost < target_cost)) ) {
+      accumulated_cost += (costs[end] > 0) ? costs[end] : 1;
+      end++;
+    }
+    mRanges[i] = packRange(begin, end);
+    begin = end;
+  }
+
+  mFunction = function;
+  mContext = context;
+  mRunStolenTasks = 0;
+  mPendingTasks = NumTasks;
+  mActiveWorkers = mWorkers.size();
+  {
+    QMutexLocker locker(&mMutex);
+    mGeneration++;
+    mStartCondition.wakeAll();
+  }
+
+  // The calling thread works too, then waits (spinning, the wait is short)
+  // until the workers are done and out of the ranges
+  executeTasks(0);
+  while ( (static_cast<int>(mPendingTasks) != 0) || (static_cast<int>(mActiveWorkers) != 0) ) {
+    QThread::yieldCurrentThread();
+  }
+  mStolenTasks += static_cast<int>(mRunStolenTasks);
+}
+
+
+//*******************************************************************************
+void HubScheduler::workerLoop(int worker)
+{
+  set_crossplatform_realtime_priority();
+  int generation = 0;
+  while ( true ) {
+    {
+      QMutexLocker locker(&mMutex);
+      while ( (generation == mGeneration) && !mStopped ) {
+        mStartCondition.wait(&mMutex);
+      }
+      if ( mStopped ) { return; }
+      generation = mGeneration;
+    }
+    executeTasks(worker);
+    mActiveWorkers.deref();
+  }
+}
+
+
+//*******************************************************************************
+void HubScheduler::executeTasks(int worker)
+{
+  int task;
+  while ( true ) {
+    if ( popTask(worker, task) ) {
+      mFunction(mContext, task, worker);
+      mPendingTasks.deref();
+      continue;
+    }
+    // Own range empty, steal from the others, starting with the next thread
+    bool stolen = false;
+    for (int i = 1; (i < mNumThreads) && !stolen; i++) {
+      stolen = stealTask((worker + i) % mNumThreads, task);
+    }
+    if ( !stolen ) { return; } // all the ranges are empty
+    mRunStolenTasks.ref();
+    mFunction(mContext, task, worker);
+    mPendingTasks.deref();
+  }
+}
+
+
+//*******************************************************************************
+bool HubScheduler::popTask(int range, int& task)
+{
+  while ( true ) {
+    int value = mRanges[range];
+    int begin = rangeBegin(value);
+    int end = rangeEnd(value);
+    if ( begin >= end ) { return false; }
+    if ( mRanges[range].testAndSetOrdered(value, packRange(begin+1, end)) ) {
+      task = begin;
+      return true;
+    }
+  }
+}
+
+
+//*******************************************************************************
+bool HubScheduler::stealTask(int range, int& task)
+{
+  while ( true ) {
+    int value = mRanges[range];
+    int begin = rangeBegin(value);
+    int end = rangeEnd(value);
+    if ( begin >= end ) { return false; }
+    if ( mRanges[range].testAndSetOrdered(value, packRange(begin, end-1)) ) {
+      task = end-1;
+      return true;
+    }
+  }
+}
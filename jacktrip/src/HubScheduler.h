@@ -0,0 +1,142 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file HubScheduler.h
+ * \date October 2026
+ */
+
+#ifndef __HUBSCHEDULER_H__
+#define __HUBSCHEDULER_H__
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QVector>
+#include <stdint.h>
+
+#include "jacktrip_types.h"
+
+
+/** \brief Work-stealing scheduler for the tasks of one hub period
+ *
+ * The HubEngine splits each period in one task per client (receive and decode,
+ * or mix and encode) and runs them with run(). The tasks are spread over a
+ * fixed pool of realtime worker threads, plus the calling thread, in
+ * contiguous ranges of about the same cost. Each thread takes the tasks of
+ * its own range from the front, and when it's done it steals from the back of
+ * the other ranges, so a few expensive clients (more channels, sample rate
+ * conversion, 24 bits) don't delay the whole period.
+ *
+ * With no worker threads, run() just executes the tasks in the calling thread.
+ */
+class HubScheduler
+{
+public:
+  /** \brief Function that executes one task
+   * \param context Pointer given to run()
+   * \param task Task index, from 0 to NumTasks-1
+   * \param worker Index of the thread that runs it, from 0 (the caller)
+   * to getNumThreads()-1, to use per thread scratch buffers
+   */
+  typedef void (*TaskFunction)(void* context, int task, int worker);
+
+  /** \brief The class constructor
+   * \param NumWorkers Number of worker threads (without the calling thread)
+   */
+  HubScheduler(int NumWorkers);
+  /// \brief The class destructor, stops the worker threads
+  virtual ~HubScheduler();
+
+  /** \brief Runs NumTasks tasks and returns when all are done
+   * \param function Function that executes one task
+   * \param context Pointer passed to function
+   * \param costs Estimated cost of each task (any unit), to split the tasks
+   * \param NumTasks Number of tasks (less than 65536)
+   */
+  void run(TaskFunction function, void* context, const int* costs, int NumTasks);
+
+  /// \brief Number of threads that run tasks, including the calling thread
+  int getNumThreads() const { return mNumThreads; }
+  /// \brief Tasks stolen from other threads ranges since the start
+  uint64_t getStolenTasks() const { return mStolenTasks; }
+
+
+private:
+
+  /// \brief Worker thread, runs the tasks of each run() call
+  class Worker : public QThread
+  {
+  public:
+    Worker(HubScheduler* scheduler, int index) :
+      mScheduler(scheduler), mIndex(index) {}
+    virtual void run() { mScheduler->workerLoop(mIndex); }
+  private:
+    HubScheduler* mScheduler;
+    int mIndex;
+  };
+
+  /// \brief Loop of the worker threads
+  void workerLoop(int worker);
+  /// \brief Executes tasks until there's nothing left to take
+  void executeTasks(int worker);
+  /// \brief Takes a task from the front of a range (the owner side)
+  bool popTask(int range, int& task);
+  /// \brief Takes a task from the back of a range (the thief side)
+  bool stealTask(int range, int& task);
+  /// \brief Packs a task range in the value of a QAtomicInt (shifted as unsigned,
+  /// begin can take the sign bit)
+  static int packRange(int begin, int end)
+  { return static_cast<int>( (static_cast<uint32_t>(begin) << 16) | static_cast<uint32_t>(end) ); }
+  /// \brief First task of a packed range
+  static int rangeBegin(int value) { return static_cast<int>(static_cast<uint32_t>(value) >> 16); }
+  /// \brief Task after the last one of a packed range
+  static int rangeEnd(int value) { return static_cast<int>(static_cast<uint32_t>(value) & 0xFFFF); }
+
+  const int mNumThreads; ///< Worker threads + the calling thread
+  QVector<Worker*> mWorkers; ///< Worker threads
+  /// Task range of each thread, see packRange
+  QAtomicInt* mRanges;
+  QAtomicInt mPendingTasks; ///< Tasks not finished yet
+  QAtomicInt mActiveWorkers; ///< Workers still looking for tasks
+  TaskFunction mFunction; ///< Function of the current run
+  void* mContext; ///< Context of the current run
+  uint64_t mStolenTasks; ///< Tasks stolen (statistics)
+  QAtomicInt mRunStolenTasks; ///< Tasks stolen in the current run
+
+  QMutex mMutex; ///< Protects mGeneration
+  QWaitCondition mStartCondition; ///< Wakes the workers for a new run
+  int mGeneration; ///< Incremented on each run
+  volatile bool mStopped; ///< Stops the worker threads
+};
+
+#endif //__HUBSCHEDULER_H__
@@ -0,0 +1,240 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file HubSession.h
+ * \date October 2026
+ */
+
+#ifndef __HUBSESSION_H__
+#define __HUBSESSION_H__
+
+#include <QVector>
+#include <QAtomicInt>
+
+#include "AudioInterface.h"
+#include "HubMixer.h"
+#include "PacketReblocker.h"
+#include "SampleRateConverter.h"
+#include "jacktrip_types.h"
+struct HubChannel; // forward declaration
+
+
+/** \brief Audio settings of a client, from its HubJoinRequest or its first
+ * packet header
+ */
+struct HubClientSettings
+{
+  int BufferSize; ///< Client buffer size, in samples
+  uint8_t SamplingRate; ///< Client sampling rate (AudioInterface::samplingRateT)
+  int BitResolution; ///< Audio bit resolution
+  int NumChannels; ///< Number of channels
+  int Redundancy; ///< Packets per datagram
+};
+
+
+/// \brief Magic number of a HubStemMessageHeader, stem subscription ("JTSM")
+const uint32_t gHubStemMessageMagic = 0x4D53544A;
+/// \brief Magic number of a HubStemMessageHeader, reply to a client ("JTSR")
+const uint32_t gHubStemReplyMagic = 0x5253544A;
+/// \brief Magic number of a HubStemHeader ("JTST")
+const uint32_t gHubStemMagic = 0x5453544A;
+
+/** \brief Header of a stem subscription, followed by NumStems session IDs (uint16_t)
+ *
+ * A client sends it to its hub to hear some clients of a peer hub on their
+ * own (e.g., to set their gains): TrunkID is the session ID of the trunk to
+ * that hub, and the IDs are the session IDs of the clients in the peer
+ * hub. The hub subscribes to them through the trunk, and replies with
+ * gHubStemReplyMagic and the local session IDs of the stems, in the same
+ * order (0xffff if a stem can't be added). The stems replace the previous
+ * ones of the trunk. Between hubs the message goes through the trunk, and
+ * the IDs are the sources the peer hub wants as stems.
+ */
+struct HubStemMessageHeader
+{
+  uint32_t Magic; ///< gHubStemMessageMagic or gHubStemReplyMagic
+  uint16_t TrunkID; ///< Session ID of the trunk (ignored between hubs)
+  uint16_t NumStems; ///< Number of session IDs that follow
+};
+
+/** \brief Header of a stem datagram between hubs, followed by one packet
+ * (DefaultHeaderStruct and audio, in the format of the trunk sub-mix)
+ */
+struct HubStemHeader
+{
+  uint32_t Magic; ///< gHubStemMagic
+  uint16_t SourceID; ///< Session ID of the source, in the hub that sends the stem
+  uint16_t Reserved; ///< Set to 0
+};
+
+
+/// \brief Magic number of a HubForwardHeader ("JTFW")
+const uint32_t gHubForwardMagic = 0x5746544A;
+
+/** \brief Header a forwarding hub puts in front of the datagrams it relays,
+ * followed by the datagram of the source client as it was received
+ * (DefaultHeaderStruct and audio, with the client redundancy)
+ */
+struct HubForwardHeader
+{
+  uint32_t Magic; ///< gHubForwardMagic
+  uint16_t SourceID; ///< Session ID of the client that sent the datagram
+  uint16_t Reserved; ///< Set to 0
+};
+
+/** \brief Datagram of a client in a forwarding hub, shared by all the
+ * sends that relay it (they refer to Data, they don't copy it)
+ *
+ * The datagram isn't copied out of the input queue of the client either:
+ * the engine holds it in the queue (see HubDatagramQueue::hold) and
+ * releases it when it receives the next period. The engine sets Refs to the
+ * number of listeners before the sends, each listener releases it once its
+ * send is done (or if it doesn't want the source), and the packet is only
+ * reused when Refs is back to 0.
+ */
+struct HubPacket
+{
+  QAtomicInt Refs; ///< Listeners that still refer to the packet
+  int Size; ///< Datagram size, in bytes
+  const int8_t* Data; ///< The datagram, as the client sent it (in the client input queue)
+};
+
+
+/** \brief A listen-only member of the audience of a room. Listeners have no
+ * session, only this entry in the audience format session they get the
+ * room mix from (see HubEngine::addListener).
+ */
+struct HubAudienceListener
+{
+  uint32_t Address; ///< Listener IPv4 address
+  uint16_t Port; ///< Listener port
+  uint64_t LastJoinTime; ///< Time of the last join request (keepalive), in usec
+};
+
+
+/** \brief State of one client connected to the HubEngine
+ *
+ * All the per-client state lives here, in plain buffers sized when the
+ * client settings are known (join request or first packet). Sessions are
+ * only touched by the HubEngine thread, so there are no locks. The engine
+ * keeps a pool of sessions with their buffers, and reuses them. Audio buffers are
+ * channel after channel (one contiguous array per buffer).
+ */
+struct HubSession
+{
+  // Identification
+  int ID; ///< Session ID (same as the UdpMasterListener pool ID)
+  HubChannel* Channel; ///< Datagrams of the client, from the HubSocket
+  uint32_t PeerAddress; ///< Client IPv4 address, replies go to the packets source
+  uint16_t PeerPort; ///< Client port
+  bool Connected; ///< True once the first audio packet has been received
+  uint64_t LastPacketTime; ///< Arrival time of the last packet, in usec
+
+  // Client audio settings, from the join request or the first packet header
+  int NumChans; ///< Number of channels
+  int PeerBufferSize; ///< Client buffer size, in samples
+  uint32_t PeerSampleRate; ///< Client sample rate, in Hz
+  AudioInterface::audioBitResolutionT BitResolution; ///< Bytes per sample on the wire
+  int PeerPacketSize; ///< Size of one client packet (header+audio), in bytes
+  int Redundancy; ///< Packets per datagram the client sends (and gets back)
+
+  // Receiving side
+  uint16_t LastSeqNum; ///< Last sequence number received
+  bool TimelineStarted; ///< LastSeqNum is the last packet placed in the input queue
+  uint64_t LastArrivalTime; ///< Arrival time of the last packet, in usec
+  double Jitter; ///< Interarrival jitter of the client packets (RFC 3550), in usec
+  int QueueTarget; ///< Playout delay of the client: input queue depth before each pull, in frames
+  double QueueDepth; ///< Smoothed input queue depth before each pull, in frames
+  sample_t* DecodeBuffer; ///< One client packet, decoded to samples
+  SampleRateConverter* InConverter; ///< Client to hub rate, NULL if the rates match
+  sample_t* ConvertBuffer; ///< Output of the sample rate converters
+  int ConvertFrames; ///< Capacity of ConvertBuffer, in frames per channel
+  sample_t* InFifo; ///< Input queue, InFifoCapacity frames per channel
+  int InFifoCapacity; ///< Capacity of InFifo, in frames
+  int InFifoFrames; ///< Frames in InFifo
+  sample_t* InBuffer; ///< One hub period of client input
+
+  // Sending side
+  sample_t* OutBuffer; ///< One hub period of mix-minus, when the sample rate is converted
+  SampleRateConverter* OutConverter; ///< Hub to client rate, NULL if the rates match
+  int8_t* OutAudio; ///< Converted output, in wire format
+  PacketReblocker* OutReblocker; ///< Re-blocks the output to the client buffer size
+  int8_t* OutDatagram; ///< Redundant datagram, Redundancy packets
+  uint16_t SendSeqNum; ///< Sequence number of the next packet to the client
+
+  // Allocated sizes of the buffers. Buffers are only reallocated when they're
+  // too small, so pooled sessions keep them from one client to the next
+  int DecodeBufferSize; ///< Allocated samples in DecodeBuffer
+  int ConvertBufferSize; ///< Allocated samples in ConvertBuffer
+  int InFifoSize; ///< Allocated samples in InFifo
+  int InBufferSize; ///< Allocated samples in InBuffer
+  int OutBufferSize; ///< Allocated samples in OutBuffer
+  int OutAudioSize; ///< Allocated bytes in OutAudio
+  int OutDatagramSize; ///< Allocated bytes in OutDatagram
+
+  // Custom mix
+  QVector<HubGainState> Gains; ///< Custom gains of the sources, empty for the plain mix-minus
+  int CustomMix; ///< HubMixer custom mix of this period, -1 for the plain mix-minus
+  bool HearsOwnInput; ///< True if the client has a custom gain for itself
+
+  // Trunks to other hubs (see HubEngine)
+  bool IsTrunk; ///< The client is another hub, it gets a sub-mix of this one
+  HubSession* StemTrunk; ///< Trunk the stem comes through, NULL if the session is not a stem
+  int StemSourceID; ///< Session ID of the stem source in the peer hub
+  QVector<HubSession*> Stems; ///< Stems received through the trunk
+  QVector<int> StemSources; ///< Sessions the peer hub of the trunk gets as stems
+  uint64_t StemRequestTime; ///< Last stem subscription sent through the trunk (0 to send now), in usec
+  QVector<uint16_t> StemRequest; ///< Stem subscription of the client, trunk ID first (empty if none)
+
+  // Forwarding hub (see HubEngine), the packets are relayed without decoding
+  HubForwardHeader ForwardHeader; ///< Put in front of the packets relayed from the client
+  QVector<HubPacket*> ForwardPackets; ///< gHubForwardPackets packets, reused when their Refs is 0
+  int NumForwardPackets; ///< Packets received from the client in this period
+
+  // Audience (see HubEngine::addListener)
+  bool IsAudience; ///< The session is an audience format, it sends the room mix to its listeners
+  QVector<HubAudienceListener> Audience; ///< Listeners of the audience format
+
+  // Statistics
+  uint32_t Underruns; ///< Hub periods without enough client input
+  uint32_t Overflows; ///< Times the input queue was full
+  uint32_t LostPackets; ///< Packets that never arrived, played as silence to keep the timing
+  uint32_t LatePackets; ///< Packets that arrived after a newer one, dropped
+  uint32_t IngressDrops; ///< Datagrams dropped for being over the client receive budget
+  bool IngressOffender; ///< The client went over its receive budget
+  int PendingEvents; ///< Events recorded by the session tasks, bits of HubEngine::engineEventT
+  uint64_t CpuNsec; ///< CPU time of the session tasks in this period, in nanoseconds
+  double CpuLoad; ///< Smoothed CPU time of the session tasks, as a fraction of the period
+  QVector<HubLevel> Levels; ///< Level of each input channel in the current metering interval
+};
+
+#endif //__HUBSESSION_H__
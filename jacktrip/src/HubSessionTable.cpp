@@ -0,0 +1,331 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file HubSessionTable.cpp
+ * \date October 2026
+ */
+
+#include "HubSessionTable.h"
+
+#include <stdexcept>
+
+#include <QMutexLocker>
+
+
+//*******************************************************************************
+HubSessionTable::HubSessionTable(int MaxSessions, int MaxReaders) :
+  mMaxSessions(MaxSessions),
+  mMaxReaders(MaxReaders),
+  mCapacityBits(2),
+  mCapacity(4),
+  mSlots(NULL),
+  mEntries(NULL),
+  mMaxProbe(0),
+  mEpoch(1),
+  mReaderEpochs(NULL),
+  mRetired(NULL)
+{
+  if ( (mMaxSessions < 1) || (mMaxReaders < 1) ) {
+    throw std::invalid_argument("HubSessionTable: invalid size");
+  }
+  // At most a quarter of the slots are live, so the probes stay short
+  while ( mCapacity < (4 * mMaxSessions) ) {
+    mCapacityBits++;
+    mCapacity *= 2;
+  }
+  mSlots = new QAtomicInt[mCapacity];
+  mEntries = new QAtomicPointer<Entry>[mMaxSessions];
+  mReaderEpochs = new QAtomicInt[mMaxReaders];
+}
+
+
+//*******************************************************************************
+HubSessionTable::~HubSessionTable()
+{
+  for (int i = 0; i < mMaxSessions; i++) { delete static_cast<Entry*>(mEntries[i]); }
+  Retired* retired = mRetired;
+  while ( retired != NULL ) {
+    Retired* next = retired->Next;
+    retired->Deleter(retired->Object);
+    delete retired;
+    retired = next;
+  }
+  delete[] mSlots;
+  delete[] mEntries;
+  delete[] mReaderEpochs;
+}
+
+
+//*******************************************************************************
+int HubSessionTable::beginRead()
+{
+  // The epoch is never 0, a reader slot at 0 is free. There are more slots
+  // than concurrent readers, so this doesn't spin.
+  while ( true ) {
+    for (int i = 0; i < mMaxReaders; i++) {
+      if ( (mReaderEpochs[i] == 0) && mReaderEpochs[i].testAndSetOrdered(0, mEpoch) ) {
+        return i; }
+    }
+  }
+}
+
+
+//*******************************************************************************
+void HubSessionTable::endRead(int reader)
+{
+  mReaderEpochs[reader].fetchAndStoreOrdered(0);
+}
+
+
+//*******************************************************************************
+HubSessionTable::Entry* HubSessionTable::findEntry(uint64_t key) const
+{
+  // Live entries are at most mMaxProbe slots away from their home slot, and
+  // before any slot that was never used
+  const int max_probe = mMaxProbe;
+  int slot = homeSlot(key);
+  for (int i = 0; i <= max_probe; i++) {
+    int value = mSlots[slot];
+    if ( value == 0 ) { return NULL; }
+    Entry* entry = loadEntry(value - 1);
+    if ( (entry != NULL) && (entry->Key == key) && (entry->Slot >= 0) ) { return entry; }
+    slot = (slot + 1) & (mCapacity - 1);
+  }
+  return NULL;
+}
+
+
+//*******************************************************************************
+int HubSessionTable::find(uint32_t address, uint16_t port, void** value) const
+{
+  Entry* entry = findEntry(sourceKey(address, port));
+  if ( entry == NULL ) { return -1; }
+  if ( value != NULL ) { *value = entry->Value; }
+  return entry->ID;
+}
+
+
+//*******************************************************************************
+void* HubSessionTable::getValue(int id) const
+{
+  if ( (id < 0) || (id >= mMaxSessions) ) { return NULL; }
+  Entry* entry = loadEntry(id);
+  return (entry == NULL) ? NULL : entry->Value;
+}
+
+
+//*******************************************************************************
+bool HubSessionTable::getSource(int id, uint32_t& address, uint16_t& port) const
+{
+  if ( (id < 0) || (id >= mMaxSessions) ) { return false; }
+  Entry* entry = loadEntry(id);
+  if ( entry == NULL ) { return false; }
+  address = static_cast<uint32_t>(entry->Key >> 16);
+  port = static_cast<uint16_t>(entry->Key & 0xffff);
+  return true;
+}
+
+
+//*******************************************************************************
+int HubSessionTable::findFreeSlot(uint64_t key, int& probe) const
+{
+  // A slot is live if the current entry of its session points back to it,
+  // the others are free. Only writers (one at a time) reclaim, so the
+  // entries can be read here without a read section.
+  int slot = homeSlot(key);
+  int free_slot = -1;
+  for (int i = 0; i < mCapacity; i++) {
+    int value = mSlots[slot];
+    Entry* entry = (value == 0) ? NULL : loadEntry(value - 1);
+    bool live = (entry != NULL) && (entry->Slot == slot);
+    if ( live && (entry->Key == key) ) { return -1; }
+    if ( !live && (free_slot < 0) ) {
+      free_slot = slot;
+      probe = i;
+    }
+    if ( value == 0 ) { break; }
+    slot = (slot + 1) & (mCapacity - 1);
+  }
+  return free_slot;
+}
+
+
+//*******************************************************************************
+bool HubSessionTable::publishEntry(int id, uint64_t key, bool with_source, void* value,
+                                   Entry* old_entry)
+{
+  int slot = -1;
+  int probe = 0;
+  if ( with_source ) {
+    slot = findFreeSlot(key, probe);
+    if ( slot < 0 ) { return false; }
+  }
+  Entry* entry = new Entry;
+  entry->Key = key;
+  entry->ID = id;
+  entry->Slot = slot;
+  entry->Value = value;
+  // Fails if the session was removed meanwhile (or, for a new one, the ID is used)
+  if ( !mEntries[id].testAndSetOrdered(old_entry, entry) ) {
+    delete entry;
+    return false;
+  }
+  if ( slot >= 0 ) {
+    if ( probe > mMaxProbe ) { mMaxProbe.fetchAndStoreOrdered(probe); }
+    mSlots[slot].fetchAndStoreOrdered(id + 1);
+  }
+  if ( old_entry != NULL ) { retire(old_entry, deleteEntry); }
+  return true;
+}
+
+
+//*******************************************************************************
+bool HubSessionTable::insert(int id, uint32_t address, uint16_t port, void* value)
+{
+  if ( (id < 0) || (id >= mMaxSessions) ) { return false; }
+  QMutexLocker locker(&mWriterMutex);
+  bool inserted = publishEntry(id, sourceKey(address, port), (port != 0), value, NULL);
+  reclaimRetired();
+  return inserted;
+}
+
+
+//*******************************************************************************
+int HubSessionTable::insertNew(uint32_t address, uint16_t port, void* value)
+{
+  const uint64_t key = sourceKey(address, port);
+  QMutexLocker locker(&mWriterMutex);
+  if ( (port != 0) && (findEntry(key) != NULL) ) { return -1; }
+  int id = 0;
+  while ( (id < mMaxSessions) && (loadEntry(id) != NULL) ) { id++; }
+  if ( (id == mMaxSessions) || !publishEntry(id, key, (port != 0), value, NULL) ) { return -2; }
+  reclaimRetired();
+  return id;
+}
+
+
+//*******************************************************************************
+bool HubSessionTable::move(int id, uint32_t old_address, uint32_t address, uint16_t port)
+{
+  if ( (id < 0) || (id >= mMaxSessions) ) { return false; }
+  const uint64_t key = sourceKey(address, port);
+  QMutexLocker locker(&mWriterMutex);
+  Entry* entry = loadEntry(id);
+  if ( (entry == NULL) || (static_cast<uint32_t>(entry->Key >> 16) != old_address) ) {
+    return false; }
+  if ( (entry->Key == key) && (entry->Slot >= 0) ) { return true; }
+  if ( findEntry(key) != NULL ) { return false; }
+  // The old slot is stale as soon as the new entry is published
+  bool moved = publishEntry(id, key, true, entry->Value, entry);
+  reclaimRetired();
+  return moved;
+}
+
+
+//*******************************************************************************
+void* HubSessionTable::remove(int id, const void* value)
+{
+  if ( (id < 0) || (id >= mMaxSessions) ) { return NULL; }
+  // The entry could be moved and reclaimed under us otherwise
+  int reader = beginRead();
+  void* removed = NULL;
+  while ( true ) {
+    Entry* entry = loadEntry(id);
+    if ( (entry == NULL) || ((value != NULL) && (entry->Value != value)) ) { break; }
+    if ( mEntries[id].testAndSetOrdered(entry, NULL) ) {
+      removed = entry->Value;
+      retire(entry, deleteEntry);
+      break;
+    }
+  }
+  endRead(reader);
+  return removed;
+}
+
+
+//*******************************************************************************
+void HubSessionTable::retire(void* object, deleterT deleter)
+{
+  Retired* retired = new Retired;
+  retired->Object = object;
+  retired->Deleter = deleter;
+  // Readers that start after this can't see the object
+  retired->Epoch = mEpoch.fetchAndAddOrdered(1);
+  pushRetired(retired);
+}
+
+
+//*******************************************************************************
+void HubSessionTable::pushRetired(Retired* retired)
+{
+  Retired* head;
+  do {
+    head = mRetired;
+    retired->Next = head;
+  } while ( !mRetired.testAndSetOrdered(head, retired) );
+}
+
+
+//*******************************************************************************
+void HubSessionTable::reclaim()
+{
+  if ( static_cast<Retired*>(mRetired) == NULL ) { return; }
+  if ( !mWriterMutex.tryLock() ) { return; }
+  reclaimRetired();
+  mWriterMutex.unlock();
+}
+
+
+//*******************************************************************************
+void HubSessionTable::reclaimRetired()
+{
+  if ( static_cast<Retired*>(mRetired) == NULL ) { return; }
+  Retired* retired = mRetired.fetchAndStoreOrdered(NULL);
+
+  // Objects retired before the oldest epoch of the readers can go
+  int oldest = mEpoch.fetchAndAddOrdered(0);
+  for (int i = 0; i < mMaxReaders; i++) {
+    int epoch = mReaderEpochs[i].fetchAndAddOrdered(0);
+    if ( (epoch != 0) && (epoch < oldest) ) { oldest = epoch; }
+  }
+  while ( retired != NULL ) {
+    Retired* next = retired->Next;
+    if ( retired->Epoch < oldest ) {
+      retired->Deleter(retired->Object);
+      delete retired;
+    }
+    else {
+      pushRetired(retired);
+    }
+    retired = next;
+  }
+}
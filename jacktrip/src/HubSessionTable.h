@@ -0,0 +1,188 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file HubSessionTable.h
+ * \date October 2026
+ */
+
+#ifndef __HUBSESSIONTABLE_H__
+#define __HUBSESSIONTABLE_H__
+
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QMutex>
+#include <stdint.h>
+
+#include "jacktrip_types.h"
+
+
+/** \brief Lock-free table of the hub sessions, by source address and port
+ * and by session ID
+ *
+ * The threads on the audio path (the HubSocket thread, the engines) use the
+ * table without locks. Each session is an immutable entry, published with
+ * an atomic pointer per session ID. The hash by source (open addressing)
+ * only holds session IDs: a slot whose session has gone or moved is stale,
+ * lookups skip it and inserts reuse it, so slots are never cleared under
+ * the readers. Sessions are removed with one compare-and-swap, so an engine
+ * that releases a session never waits. Inserts and moves are serialized by
+ * a mutex, that readers never take.
+ *
+ * A removed entry (and the objects passed to retire()) can still be in use
+ * by a reader that found it before the removal. It's only deleted once
+ * every reader that could have seen it is done (epoch based reclamation):
+ * readers announce the epoch they read in between beginRead() and
+ * endRead(), and reclaim() deletes what was retired before the oldest
+ * announced epoch.
+ */
+class HubSessionTable
+{
+public:
+
+  /// \brief Deletes a retired object
+  typedef void (*deleterT)(void* object);
+
+  /** \brief The class constructor
+   * \param MaxSessions Number of session IDs (0 to MaxSessions-1)
+   * \param MaxReaders Largest number of concurrent read sections
+   */
+  HubSessionTable(int MaxSessions, int MaxReaders);
+  /// \brief The class destructor, deletes the retired objects (not the session values)
+  virtual ~HubSessionTable();
+
+  /** \brief Starts a read section (lock-free). The entries found in the
+   * section, and the retired objects, stay valid until endRead().
+   * \return Reader slot, to give to endRead()
+   */
+  int beginRead();
+  /// \brief Ends a read section
+  void endRead(int reader);
+
+  /** \brief Finds the session of a source (in a read section)
+   * \param value Returns the value of the session, if not NULL
+   * \return Session ID, -1 if no session has that source
+   */
+  int find(uint32_t address, uint16_t port, void** value = NULL) const;
+  /// \brief Value of a session (in a read section), NULL if there's no session
+  void* getValue(int id) const;
+  /// \brief Source of a session (in a read section), false if there's no session
+  bool getSource(int id, uint32_t& address, uint16_t& port) const;
+
+  /** \brief Adds a session
+   * \param id Session ID
+   * \param address Source IPv4 address
+   * \param port Source port, 0 if unknown (the session is only found by ID
+   * until it's moved to its source)
+   * \param value Value of the session (not owned by the table)
+   * \return false if the ID or the source is already used
+   */
+  bool insert(int id, uint32_t address, uint16_t port, void* value);
+  /** \brief Adds a session with the first free ID
+   *
+   * With port 0 the session has no source (it's only found by ID), so any
+   * number of them can share an address.
+   * \return The session ID, -1 if the source is already used, -2 if there's no free ID
+   */
+  int insertNew(uint32_t address, uint16_t port, void* value);
+  /** \brief Moves a session to another source, if it's still at old_address
+   * \return false if there's no such session or the new source is used
+   */
+  bool move(int id, uint32_t old_address, uint32_t address, uint16_t port);
+  /** \brief Removes a session (lock-free, from any thread)
+   * \param id Session ID
+   * \param value Only remove the session if it has this value, NULL for any
+   * \return The value of the session, NULL if it wasn't there
+   */
+  void* remove(int id, const void* value = NULL);
+
+  /// \brief Deletes an object with deleter once no reader can use it (lock-free)
+  void retire(void* object, deleterT deleter);
+  /// \brief Deletes the retired objects no reader can see anymore (skipped if a writer is busy)
+  void reclaim();
+
+
+private:
+
+  /// \brief A session, never modified once published
+  struct Entry
+  {
+    uint64_t Key; ///< Source address and port
+    int ID; ///< Session ID
+    int Slot; ///< Hash slot of the session, -1 if it has no source yet
+    void* Value; ///< Session value
+  };
+
+  /// \brief An object waiting to be deleted
+  struct Retired
+  {
+    void* Object; ///< Object
+    deleterT Deleter; ///< Deletes the object
+    int Epoch; ///< Epoch of the retirement
+    Retired* Next; ///< Next in the retired list
+  };
+
+  static uint64_t sourceKey(uint32_t address, uint16_t port)
+  { return (static_cast<uint64_t>(address) << 16) | port; }
+  /// \brief First hash slot of a key
+  int homeSlot(uint64_t key) const
+  { return static_cast<int>( (key * 0x9E3779B97F4A7C15ULL) >> (64 - mCapacityBits) ); }
+  /// \brief Loads the entry of a session ID (acquire)
+  Entry* loadEntry(int id) const
+  { return mEntries[id].fetchAndAddAcquire(0); }
+  /// \brief Finds the live entry of a key
+  Entry* findEntry(uint64_t key) const;
+  /** \brief Finds the slot for a new key (mWriterMutex locked)
+   * \return The slot, -1 if the key is already there or the table is full
+   */
+  int findFreeSlot(uint64_t key, int& probe) const;
+  /// \brief Publishes a new entry for a session (mWriterMutex locked)
+  bool publishEntry(int id, uint64_t key, bool with_source, void* value, Entry* old_entry);
+  /// \brief Pushes a retired object (lock-free)
+  void pushRetired(Retired* retired);
+  /// \brief Deletes the retired objects no reader can see (mWriterMutex locked)
+  void reclaimRetired();
+  static void deleteEntry(void* entry) { delete static_cast<Entry*>(entry); }
+
+  const int mMaxSessions; ///< Number of session IDs
+  const int mMaxReaders; ///< Number of reader slots
+  int mCapacityBits; ///< log2 of the number of hash slots
+  int mCapacity; ///< Number of hash slots
+  QAtomicInt* mSlots; ///< Hash by source: session ID + 1, 0 for a slot never used
+  QAtomicPointer<Entry>* mEntries; ///< Entries by session ID, NULL if none
+  QAtomicInt mMaxProbe; ///< Longest probe of a live entry, lookups stop there
+  QAtomicInt mEpoch; ///< Current epoch, incremented on each retirement
+  QAtomicInt* mReaderEpochs; ///< Epoch of each reader slot, 0 if not in a read section
+  QAtomicPointer<Retired> mRetired; ///< Objects waiting to be deleted
+  QMutex mWriterMutex; ///< Serializes the inserts, moves and reclaims
+};
+
+#endif //__HUBSESSIONTABLE_H__
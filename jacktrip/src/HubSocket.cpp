@@ -0,0 +1,545 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file HubSocket.cpp
+ * \date October 2026
+ */
+
+#include "HubSocket.h"
+#include "HubRoomManager.h"
+#include "PacketHeader.h"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+
+#include <QMutexLocker>
+#include <QHostAddress>
+#include <QVarLengthArray>
+
+#if defined (__LINUX__) || (__MAC_OSX__)
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#endif
+#ifdef __WIN_32__
+#include <winsock.h>
+#endif
+
+using std::cout; using std::endl;
+
+/// Datagrams read with one system call
+const int gHubSocketBatchSize = 16;
+/// Size of the receive buffers (largest UDP datagram)
+const int gHubSocketDatagramSize = 65536;
+/// Size of the datagram queue of each client, in bytes
+const int gHubChannelQueueSize = 128 * 1024;
+/// Receive timeout, to check if the thread was stopped, in milliseconds
+const int gHubSocketTimeout = 100;
+
+
+//*******************************************************************************
+// SipHash-2-4 (Aumasson and Bernstein) of a short message, used for the
+// session cookies
+#define SIPHASH_ROTL(x, b) ( ((x) << (b)) | ((x) >> (64 - (b))) )
+#define SIPHASH_ROUND(v0, v1, v2, v3) \
+  v0 += v1; v1 = SIPHASH_ROTL(v1, 13); v1 ^= v0; v0 = SIPHASH_ROTL(v0, 32); \
+  v2 += v3; v3 = SIPHASH_ROTL(v3, 16); v3 ^= v2; \
+  v0 += v3; v3 = SIPHASH_ROTL(v3, 21); v3 ^= v0; \
+  v2 += v1; v1 = SIPHASH_ROTL(v1, 17); v1 ^= v2; v2 = SIPHASH_ROTL(v2, 32);
+
+static uint64_t sipHash24(const uint64_t key[2], const uint8_t* data, int size)
+{
+  uint64_t v0 = key[0] ^ 0x736f6d6570736575ULL;
+  uint64_t v1 = key[1] ^ 0x646f72616e646f6dULL;
+  uint64_t v2 = key[0] ^ 0x6c7967656e657261ULL;
+  uint64_t v3 = key[1] ^ 0x7465646279746573ULL;
+
+  int i = 0;
+  for ( ; i + 8 <= size; i += 8) {
+    uint64_t m = 0;
+    for (int j = 7; j >= 0; j--) { m = (m << 8) | data[i+j]; }
+    v3 ^= m;
+    SIPHASH_ROUND(v0, v1, v2, v3);
+    SIPHASH_ROUND(v0, v1, v2, v3);
+    v0 ^= m;
+  }
+  // Last block: remaining bytes and the message size in the top byte
+  uint64_t m = static_cast<uint64_t>(size & 0xff) << 56;
+  for (int j = size - i - 1; j >= 0; j--) { m |= static_cast<uint64_t>(data[i+j]) << (8*j); }
+  v3 ^= m;
+  SIPHASH_ROUND(v0, v1, v2, v3);
+  SIPHASH_ROUND(v0, v1, v2, v3);
+  v0 ^= m;
+
+  v2 ^= 0xff;
+  for (int r = 0; r < 4; r++) { SIPHASH_ROUND(v0, v1, v2, v3); }
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+
+//*******************************************************************************
+HubSocket::HubSocket(int port) throw(std::runtime_error) :
+  mPort(port),
+  mSocket(-1),
+  mChannels(gMaxThreads, gHubSessionTableReaders),
+  mHubRoomManager(NULL),
+  mUnknownDatagrams(0),
+  mReceiveTime(0),
+  mStopped(false)
+{
+  mSocket = ::socket(AF_INET, SOCK_DGRAM, 0);
+  if ( mSocket < 0 ) { throw std::runtime_error("HubSocket: Could not create UDP socket"); }
+
+  struct sockaddr_in local_addr;
+  std::memset(&local_addr, 0, sizeof(local_addr));
+  local_addr.sin_family = AF_INET;
+  local_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  local_addr.sin_port = htons(mPort);
+  if ( ::bind(mSocket, (struct sockaddr *) &local_addr, sizeof(local_addr)) < 0 ) {
+#if defined (__WIN_32__)
+    closesocket(mSocket);
+#else
+    ::close(mSocket);
+#endif
+    throw std::runtime_error("HubSocket: Could not bind UDP socket. It may be already binded.");
+  }
+
+  // The receive calls time out, so the thread can be stopped
+#if defined (__WIN_32__)
+  DWORD timeout = gHubSocketTimeout;
+  ::setsockopt(mSocket, SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout, sizeof(timeout));
+#else
+  struct timeval timeout;
+  timeout.tv_sec = 0;
+  timeout.tv_usec = gHubSocketTimeout * 1000;
+  ::setsockopt(mSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+#endif
+  // Room for the bursts of all the clients while the thread is descheduled
+  int buffer_size = 4 * 1024 * 1024;
+  ::setsockopt(mSocket, SOL_SOCKET, SO_RCVBUF, (char*)&buffer_size, sizeof(buffer_size));
+
+  // Key of the session cookies, new every time the hub starts
+  mCookieKey[0] = 0;
+  mCookieKey[1] = 0;
+  std::FILE* random_device = std::fopen("/dev/urandom", "rb");
+  if ( random_device != NULL ) {
+    if ( std::fread(mCookieKey, sizeof(mCookieKey), 1, random_device) != 1 ) {
+      mCookieKey[0] = 0; }
+    std::fclose(random_device);
+  }
+  if ( mCookieKey[0] == 0 ) { // no random device (Windows)
+    uint64_t seed[2] = { PacketHeader::usecTime(), reinterpret_cast<size_t>(this) };
+    mCookieKey[0] = sipHash24(seed, reinterpret_cast<const uint8_t*>(seed), sizeof(seed));
+    mCookieKey[1] = sipHash24(seed, reinterpret_cast<const uint8_t*>(mCookieKey),
+                              sizeof(mCookieKey[0]));
+  }
+
+  cout << "JackTrip HUB SERVER: UDP Socket Receiving in Port: " << mPort << endl;
+}
+
+
+//*******************************************************************************
+HubSocket::~HubSocket()
+{
+  stop();
+  wait();
+#if defined (__WIN_32__)
+  closesocket(mSocket);
+#else
+  ::close(mSocket);
+#endif
+  for (int i = 0; i < gMaxThreads; i++) { delete static_cast<HubChannel*>(mChannels.remove(i)); }
+}
+
+
+//*******************************************************************************
+HubChannel* HubSocket::addChannel(int id, uint32_t address, uint16_t port)
+{
+  if ( (id < 0) || (id >= gMaxThreads) ) { return NULL; }
+  HubChannel* channel = new HubChannel(id, address, gHubChannelQueueSize);
+
+  QMutexLocker locker(&mMutex);
+  // A stale channel with the same ID (should have been removed)
+  void* stale_channel = mChannels.remove(id);
+  if ( stale_channel != NULL ) { mChannels.retire(stale_channel, deleteChannel); }
+  // Clients without a NAT send from the port they announced. If another
+  // session has that source, the client has to register its own.
+  if ( (port != 0) && mChannels.insert(id, address, port, channel) ) {
+    channel->Port = port;
+    return channel;
+  }
+  if ( !mChannels.insert(id, address, 0, channel) ) {
+    delete channel;
+    return NULL;
+  }
+  return channel;
+}
+
+
+//*******************************************************************************
+void HubSocket::removeChannel(HubChannel* channel)
+{
+  if ( channel == NULL ) { return; }
+  // The socket thread may still be pushing to the channel, it's deleted
+  // when it's done with the datagrams it received before the removal
+  if ( mChannels.remove(channel->ID, channel) != NULL ) {
+    mChannels.retire(channel, deleteChannel); }
+}
+
+
+//*******************************************************************************
+uint64_t HubSocket::getSessionCookie(int id, uint32_t address) const
+{
+  uint8_t message[8];
+  for (int i = 0; i < 4; i++) {
+    message[i] = static_cast<uint8_t>(static_cast<uint32_t>(id) >> (8*i));
+    message[4+i] = static_cast<uint8_t>(address >> (8*i));
+  }
+  return sipHash24(mCookieKey, message, sizeof(message));
+}
+
+
+//*******************************************************************************
+uint64_t HubSocket::getJoinCookie(uint32_t address, uint16_t port, uint64_t epoch) const
+{
+  // Longer than the session cookie message, so a join cookie is never a
+  // session cookie
+  uint8_t message[10];
+  for (int i = 0; i < 4; i++) {
+    message[i] = static_cast<uint8_t>(address >> (8*i));
+    message[6+i] = static_cast<uint8_t>(epoch >> (8*i));
+  }
+  message[4] = static_cast<uint8_t>(port);
+  message[5] = static_cast<uint8_t>(port >> 8);
+  return sipHash24(mCookieKey, message, sizeof(message));
+}
+
+
+//*******************************************************************************
+void HubSocket::sendDatagram(const int8_t* datagram, int size, uint32_t address,
+                             uint16_t port)
+{
+  struct sockaddr_in peer_addr;
+  std::memset(&peer_addr, 0, sizeof(peer_addr));
+  peer_addr.sin_family = AF_INET;
+  peer_addr.sin_addr.s_addr = htonl(address);
+  peer_addr.sin_port = htons(port);
+  ::sendto(mSocket, reinterpret_cast<const char*>(datagram), size, 0,
+           (struct sockaddr *) &peer_addr, sizeof(peer_addr));
+}
+
+
+//*******************************************************************************
+void HubSocket::sendDatagrams(const HubSendEntry* entries, int num_entries)
+{
+#if defined (__LINUX__)
+  // Header and payload go as two iovecs, neither is copied
+  struct sockaddr_in peer_addrs[gHubSendBatchSize];
+  struct iovec iovecs[2*gHubSendBatchSize];
+  struct mmsghdr messages[gHubSendBatchSize];
+  int sent = 0;
+  while ( sent < num_entries ) {
+    int batch = num_entries - sent;
+    if ( batch > gHubSendBatchSize ) { batch = gHubSendBatchSize; }
+    for (int i = 0; i < batch; i++) {
+      const HubSendEntry& entry = entries[sent+i];
+      std::memset(&peer_addrs[i], 0, sizeof(peer_addrs[i]));
+      peer_addrs[i].sin_family = AF_INET;
+      peer_addrs[i].sin_addr.s_addr = htonl(entry.Address);
+      peer_addrs[i].sin_port = htons(entry.Port);
+      iovecs[2*i].iov_base = const_cast<int8_t*>(entry.Header);
+      iovecs[2*i].iov_len = entry.HeaderSize;
+      iovecs[(2*i)+1].iov_base = const_cast<int8_t*>(entry.Payload);
+      iovecs[(2*i)+1].iov_len = entry.PayloadSize;
+      std::memset(&messages[i], 0, sizeof(messages[i]));
+      messages[i].msg_hdr.msg_name = &peer_addrs[i];
+      messages[i].msg_hdr.msg_namelen = sizeof(peer_addrs[i]);
+      messages[i].msg_hdr.msg_iov = (entry.HeaderSize > 0) ? &iovecs[2*i] : &iovecs[(2*i)+1];
+      messages[i].msg_hdr.msg_iovlen = (entry.HeaderSize > 0) ? 2 : 1;
+    }
+    // sendmmsg stops at the first datagram that fails, that one is skipped
+    int num_sent = ::sendmmsg(mSocket, messages, batch, 0);
+    sent += (num_sent > 0) ? num_sent : 1;
+  }
+#else
+  QVarLengthArray<int8_t, 2048> datagram;
+  for (int i = 0; i < num_entries; i++) {
+    const HubSendEntry& entry = entries[i];
+    datagram.resize(entry.HeaderSize + entry.PayloadSize);
+    if ( entry.HeaderSize > 0 ) {
+      std::memcpy(datagram.data(), entry.Header, entry.HeaderSize); }
+    std::memcpy(datagram.data() + entry.HeaderSize, entry.Payload, entry.PayloadSize);
+    sendDatagram(datagram.constData(), datagram.size(), entry.Address, entry.Port);
+  }
+#endif
+}
+
+
+//*******************************************************************************
+void HubSocket::run()
+{
+  mStopped = false;
+  // Set realtime priority (function in jacktrip_globals.h)
+  set_crossplatform_realtime_priority();
+
+  int8_t* buffers = new int8_t[gHubSocketBatchSize * gHubSocketDatagramSize];
+  struct sockaddr_in sources[gHubSocketBatchSize];
+#if defined (__LINUX__)
+  // One system call reads all the datagrams that are waiting
+  struct mmsghdr messages[gHubSocketBatchSize];
+  struct iovec iovecs[gHubSocketBatchSize];
+  for (int i = 0; i < gHubSocketBatchSize; i++) {
+    iovecs[i].iov_base = buffers + (i*gHubSocketDatagramSize);
+    iovecs[i].iov_len = gHubSocketDatagramSize;
+  }
+#endif
+
+  while ( !mStopped )
+  {
+    // Deletes the channels the engines removed
+    mChannels.reclaim();
+#if defined (__LINUX__)
+    for (int i = 0; i < gHubSocketBatchSize; i++) {
+      std::memset(&messages[i], 0, sizeof(messages[i]));
+      messages[i].msg_hdr.msg_name = &sources[i];
+      messages[i].msg_hdr.msg_namelen = sizeof(sources[i]);
+      messages[i].msg_hdr.msg_iov = &iovecs[i];
+      messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    // Blocks until the first datagram (or the timeout), then takes the rest
+    int num_datagrams = ::recvmmsg(mSocket, messages, gHubSocketBatchSize,
+                                   MSG_WAITFORONE, NULL);
+    if ( num_datagrams <= 0 ) { continue; }
+    mReceiveTime = PacketHeader::usecTime();
+    int reader = mChannels.beginRead();
+    for (int i = 0; i < num_datagrams; i++) {
+      dispatchDatagram(buffers + (i*gHubSocketDatagramSize), messages[i].msg_len,
+                       ntohl(sources[i].sin_addr.s_addr), ntohs(sources[i].sin_port));
+    }
+    mChannels.endRead(reader);
+#else
+#if defined (__WIN_32__)
+    int source_size = sizeof(sources[0]);
+#else
+    socklen_t source_size = sizeof(sources[0]);
+#endif
+    int size = ::recvfrom(mSocket, reinterpret_cast<char*>(buffers), gHubSocketDatagramSize,
+                          0, (struct sockaddr *) &sources[0], &source_size);
+    if ( size <= 0 ) { continue; }
+    mReceiveTime = PacketHeader::usecTime();
+    int reader = mChannels.beginRead();
+    dispatchDatagram(buffers, size, ntohl(sources[0].sin_addr.s_addr),
+                     ntohs(sources[0].sin_port));
+    mChannels.endRead(reader);
+#endif
+    // Adding a client takes the locks of the rooms (and this one)
+    if ( !mJoinRequests.isEmpty() || !mResumeRequests.isEmpty() || !mTrunkReplies.isEmpty() ) {
+      processJoinRequests(); }
+  }
+
+  delete[] buffers;
+  if ( mUnknownDatagrams > 0 ) {
+    cout << "JackTrip HUB SERVER: " << mUnknownDatagrams
+         << " datagrams from unknown sources" << endl;
+  }
+}
+
+
+//*******************************************************************************
+void HubSocket::dispatchDatagram(const int8_t* datagram, int size, uint32_t address,
+                                 uint16_t port)
+{
+  if ( size == static_cast<int>(sizeof(HubRegisterMessage)) ) {
+    const HubRegisterMessage* message = reinterpret_cast<const HubRegisterMessage*>(datagram);
+    if ( message->Magic == gHubRegisterMagic ) {
+      registerSource(message, address, port);
+      return;
+    }
+    if ( message->Magic == gHubResumeMagic ) {
+      mResumeRequests.append(*message);
+      mResumeSources.append(sourceKey(address, port));
+      return;
+    }
+  }
+  if ( size == static_cast<int>(sizeof(HubJoinReply)) ) {
+    const HubJoinReply* reply = reinterpret_cast<const HubJoinReply*>(datagram);
+    if ( reply->Magic == gHubJoinReplyMagic ) {
+      mTrunkReplies.append(*reply);
+      mTrunkSources.append(sourceKey(address, port));
+      return;
+    }
+  }
+  if ( size == static_cast<int>(sizeof(HubJoinRequest)) ) {
+    const HubJoinRequest* request = reinterpret_cast<const HubJoinRequest*>(datagram);
+    if ( request->Magic == gHubJoinMagic ) {
+      mJoinRequests.append(*request);
+      mJoinSources.append(sourceKey(address, port));
+      return;
+    }
+  }
+
+  void* value = NULL;
+  if ( mChannels.find(address, port, &value) < 0 ) {
+    mUnknownDatagrams++;
+    return;
+  }
+  HubChannel* channel = static_cast<HubChannel*>(value);
+  // Datagrams over the client budget are dropped before they cost anything
+  // else (counted by the budget). If the engine doesn't keep up the datagram
+  // is dropped too (counted by the queue).
+  if ( !channel->Budget.consume(size, mReceiveTime) ) { return; }
+  channel->Queue.push(datagram, size, address, port, mReceiveTime);
+}
+
+
+//*******************************************************************************
+void HubSocket::registerSource(const HubRegisterMessage* message, uint32_t address,
+                               uint16_t port)
+{
+  int id = message->SessionID;
+  if ( (id < 0) || (id >= gMaxThreads) ) { return; }
+  // Clients repeat the message, the source is usually registered already
+  if ( mChannels.find(address, port) == id ) { return; }
+
+  QMutexLocker locker(&mMutex);
+  HubChannel* channel = static_cast<HubChannel*>(mChannels.getValue(id));
+  if ( channel == NULL ) { return; }
+  // Only the client that did the handshake can use its session
+  if ( channel->Address != address ) { return; }
+  if ( message->Cookie != getSessionCookie(id, address) ) { return; }
+  // Another session of the same client can't be taken over
+  if ( !moveChannel(channel, address, port) ) { return; }
+  cout << "JackTrip HUB SERVER: Client ID = " << id << " sends from UDP port "
+       << port << endl;
+}
+
+
+//*******************************************************************************
+bool HubSocket::moveChannel(HubChannel* channel, uint32_t address, uint16_t port)
+{
+  if ( !mChannels.move(channel->ID, channel->Address, address, port) ) { return false; }
+  channel->Address = address;
+  channel->Port = port;
+  return true;
+}
+
+
+//*******************************************************************************
+bool HubSocket::resumeChannel(int id, uint64_t cookie, uint32_t address, uint16_t port,
+                              uint32_t& old_address)
+{
+  if ( (id < 0) || (id >= gMaxThreads) ) { return false; }
+  QMutexLocker locker(&mMutex);
+  // The engine can remove the channel meanwhile, it isn't deleted until endRead()
+  int reader = mChannels.beginRead();
+  HubChannel* channel = static_cast<HubChannel*>(mChannels.getValue(id));
+  bool resumed = (channel != NULL) && (cookie == getSessionCookie(id, channel->Address));
+  if ( resumed ) {
+    old_address = channel->Address;
+    // A repeated request (the reply was lost) is already there. Another
+    // session can't be taken over.
+    if ( (channel->Address != address) || (channel->Port != port) ) {
+      resumed = moveChannel(channel, address, port);
+      if ( resumed ) {
+        cout << "JackTrip HUB SERVER: Client ID = " << id << " resumed from "
+             << QHostAddress(address).toString().toStdString() << ":" << port << endl;
+      }
+    }
+  }
+  mChannels.endRead(reader);
+  return resumed;
+}
+
+
+//*******************************************************************************
+void HubSocket::processJoinRequests()
+{
+  // The cookie of the last lifetime is still good, so a client that got it
+  // just before the change isn't challenged again
+  const uint64_t epoch = mReceiveTime / (gHubJoinCookieTime * 1000ULL);
+  for (int i = 0; i < mJoinRequests.size(); i++) {
+    uint32_t address = static_cast<uint32_t>(mJoinSources[i] >> 16);
+    uint16_t port = static_cast<uint16_t>(mJoinSources[i] & 0xffff);
+    HubJoinReply reply;
+    reply.Magic = gHubJoinReplyMagic;
+    reply.SessionID = -1;
+    reply.Cookie = 0;
+    const uint64_t cookie = mJoinRequests[i].Cookie;
+    if ( (cookie != getJoinCookie(address, port, epoch)) &&
+         (cookie != getJoinCookie(address, port, epoch-1)) ) {
+      // Nothing is allocated until the source proves it gets the replies
+      reply.SessionID = gHubJoinChallengeID;
+      reply.Cookie = getJoinCookie(address, port, epoch);
+    }
+    else if ( mHubRoomManager != NULL ) {
+      reply.SessionID = mHubRoomManager->joinSession(mJoinRequests[i], address, port);
+    }
+    // The room is being created, the client asks again
+    if ( reply.SessionID == gHubJoinPendingID ) { continue; }
+    if ( reply.SessionID >= 0 ) { reply.Cookie = getSessionCookie(reply.SessionID, address); }
+    sendDatagram(reinterpret_cast<const int8_t*>(&reply), sizeof(reply), address, port);
+  }
+  mJoinRequests.clear();
+  mJoinSources.clear();
+
+  for (int i = 0; i < mResumeRequests.size(); i++) {
+    uint32_t address = static_cast<uint32_t>(mResumeSources[i] >> 16);
+    uint16_t port = static_cast<uint16_t>(mResumeSources[i] & 0xffff);
+    HubJoinReply reply;
+    reply.Magic = gHubJoinReplyMagic;
+    reply.SessionID = -1;
+    reply.Cookie = 0;
+    if ( mHubRoomManager != NULL ) {
+      reply.SessionID = mHubRoomManager->resumeSession(mResumeRequests[i].SessionID,
+                                                       mResumeRequests[i].Cookie,
+                                                       address, port);
+    }
+    // The cookie is bound to the new address
+    if ( reply.SessionID >= 0 ) { reply.Cookie = getSessionCookie(reply.SessionID, address); }
+    sendDatagram(reinterpret_cast<const int8_t*>(&reply), sizeof(reply), address, port);
+  }
+  mResumeRequests.clear();
+  mResumeSources.clear();
+
+  for (int i = 0; i < mTrunkReplies.size(); i++) {
+    uint32_t address = static_cast<uint32_t>(mTrunkSources[i] >> 16);
+    uint16_t port = static_cast<uint16_t>(mTrunkSources[i] & 0xffff);
+    if ( mHubRoomManager != NULL ) {
+      mHubRoomManager->trunkJoined(mTrunkReplies[i], address, port); }
+  }
+  mTrunkReplies.clear();
+  mTrunkSources.clear();
+}
@@ -0,0 +1,322 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file HubSocket.h
+ * \date October 2026
+ */
+
+#ifndef __HUBSOCKET_H__
+#define __HUBSOCKET_H__
+
+#include <stdexcept>
+
+#include <QThread>
+#include <QMutex>
+#include <QVector>
+
+#include "HubDatagramQueue.h"
+#include "HubIngressBudget.h"
+#include "HubSessionTable.h"
+#include "jacktrip_types.h"
+#include "jacktrip_globals.h"
+class HubRoomManager; // forward declaration
+
+
+/// \brief Magic number of a HubRegisterMessage ("JTHS")
+const uint32_t gHubRegisterMagic = 0x5348544A;
+/// \brief Magic number of a HubJoinRequest ("JTJR")
+const uint32_t gHubJoinMagic = 0x524A544A;
+/// \brief Magic number of a HubJoinReply ("JTJA")
+const uint32_t gHubJoinReplyMagic = 0x414A544A;
+/// \brief Magic number of a resume request, a HubRegisterMessage ("JTRR")
+const uint32_t gHubResumeMagic = 0x5252544A;
+/// \brief HubJoinRequest flag of another hub that joins as a trunk
+const uint8_t gHubJoinTrunkFlag = 0x01;
+/// \brief HubJoinRequest flag of a listen-only member of the audience
+const uint8_t gHubJoinAudienceFlag = 0x02;
+/// \brief HubJoinRequest flag of a client that mixes locally the datagrams a
+/// forwarding hub relays (HubForwardHeader), required by forwarding hubs
+const uint8_t gHubJoinForwardFlag = 0x04;
+/// \brief Session ID of the HubJoinReply to an audience listener (listeners have no session)
+const int32_t gHubAudienceSessionID = -2;
+/// \brief Session ID of the HubJoinReply that challenges a request without a valid join cookie
+const int32_t gHubJoinChallengeID = -3;
+/// \brief HubRoomManager::joinSession result when the room is being created (no reply, the client asks again)
+const int32_t gHubJoinPendingID = -4;
+
+/** \brief Datagram a client sends to the hub port to tell the hub which
+ * session its source address and port belong to (e.g., when a NAT changes
+ * the source port). The session ID and cookie are the ones the server sends
+ * in the handshake (TCP or HubJoinReply).
+ *
+ * With gHubResumeMagic, the session is also moved to a new source address
+ * (e.g., the client changed networks), and the hub answers with a
+ * HubJoinReply with the cookie for the new address. The session keeps its
+ * state (input queue, mix, statistics), so the audio resumes with the next
+ * period.
+ */
+struct HubRegisterMessage
+{
+  uint32_t Magic; ///< gHubRegisterMagic or gHubResumeMagic
+  int32_t SessionID; ///< Session ID
+  uint64_t Cookie; ///< Session cookie
+};
+
+/** \brief Datagram a client sends to the hub port to join, instead of the
+ * TCP handshake. It's sent from the client audio port, so the hub knows
+ * where the audio comes from, and carries the client audio settings, so the
+ * session is set up before the first audio packet arrives.
+ *
+ * The request always has the full size: the reply is smaller, so the hub
+ * can't be used to amplify spoofed requests.
+ *
+ * The source address of a request can be spoofed, so the hub allocates
+ * nothing for a request without a valid join cookie: it answers with a
+ * HubJoinReply with gHubJoinChallengeID and a cookie for the source address
+ * and port (a keyed hash with the time, the hub keeps no state), and the
+ * client sends the request again with that cookie. Only a source that
+ * receives the replies gets a session (or a place in the audience).
+ *
+ * Hubs join other hubs the same way, with gHubJoinTrunkFlag (see
+ * HubRoomManager::addTrunk). Listen-only members of the audience of a room
+ * join with gHubJoinAudienceFlag, and send the request again (with the
+ * cookie) at least every gTimeOutMultiThreadedServer milliseconds to stay
+ * (see HubEngine::addListener).
+ */
+struct HubJoinRequest
+{
+  uint32_t Magic; ///< gHubJoinMagic
+  uint16_t BufferSize; ///< Client buffer size, in samples
+  uint8_t SamplingRate; ///< Client sampling rate (AudioInterface::samplingRateT)
+  uint8_t BitResolution; ///< Audio bit resolution
+  uint8_t NumChannels; ///< Number of channels
+  uint8_t Redundancy; ///< Packets per datagram
+  uint8_t RoomLength; ///< Length of the room name, 0 for the default room
+  uint8_t Flags; ///< gHubJoinTrunkFlag for a hub, gHubJoinAudienceFlag for a listener, 0 for a client (gHubJoinForwardFlag if it mixes locally)
+  uint32_t Reserved; ///< 0 (aligns the cookie the same way on every platform)
+  uint64_t Cookie; ///< Join cookie of the last challenge of the hub, 0 in the first request
+  char Room[gHubMaxRoomNameLength+1]; ///< Room name (not null terminated)
+};
+
+/** \brief Reply of the hub to a HubJoinRequest. The hub keeps no state for the
+ * cookie: it's a keyed hash (SipHash-2-4) of the session ID and client
+ * address, checked again when the client uses it (HubRegisterMessage).
+ * With gHubJoinChallengeID, it's the join cookie the client has to send
+ * back in the HubJoinRequest instead.
+ */
+struct HubJoinReply
+{
+  uint32_t Magic; ///< gHubJoinReplyMagic
+  int32_t SessionID; ///< Session ID, -1 if the hub couldn't take the client (gHubAudienceSessionID for a listener, gHubJoinChallengeID for a challenge)
+  uint64_t Cookie; ///< Session cookie (join cookie of a challenge)
+};
+
+
+/** \brief One datagram of a batch sent with HubSocket::sendDatagrams, a
+ * header and a payload sent together without copying them
+ */
+struct HubSendEntry
+{
+  const int8_t* Header; ///< Header data
+  int HeaderSize; ///< Header size, in bytes (0 for none)
+  const int8_t* Payload; ///< Payload data
+  int PayloadSize; ///< Payload size, in bytes
+  uint32_t Address; ///< Destination IPv4 address
+  uint16_t Port; ///< Destination port
+};
+
+
+/** \brief Datagrams of one client, as demultiplexed by the HubSocket
+ *
+ * The socket thread pushes the datagrams to Queue, if they're within the
+ * client Budget, and the HubEngine of the client room pops them. A removed
+ * channel is deleted once the socket thread can't be pushing to it anymore.
+ */
+struct HubChannel
+{
+  /** \brief The class constructor
+   * \param id Session ID
+   * \param address Client IPv4 address (from the TCP handshake)
+   * \param queue_capacity Size of the datagram queue, in bytes
+   */
+  HubChannel(int id, uint32_t address, int queue_capacity) :
+    ID(id), Address(address), Port(0), Queue(queue_capacity),
+    Budget(gHubIngressBurstPeriods) {}
+
+  const int ID; ///< Session ID
+  /// Client IPv4 address, only datagrams from there are accepted (protected
+  /// by the HubSocket mutex, it only changes when the session is resumed)
+  uint32_t Address;
+  uint16_t Port; ///< Client source port, 0 until known (protected by the HubSocket mutex)
+  HubDatagramQueue Queue; ///< Datagrams received from the client
+  HubIngressBudget Budget; ///< Receive budget, set by the engine from the client settings
+};
+
+
+/** \brief The single UDP socket of the hub, shared by all the clients and rooms
+ *
+ * All the clients send their audio to the same well-known port. The socket
+ * thread receives the datagrams in batches (recvmmsg on Linux) and
+ * demultiplexes them by their source address and port, with one lock-free
+ * lookup (see HubSessionTable), into the HubChannel of the client. The
+ * engines remove their channels without waiting for the socket thread. A client is first known by the address
+ * of its TCP handshake and the UDP port it announced there; a
+ * HubRegisterMessage with its session ID maps another source port to it
+ * (NAT). Clients can also join without TCP, with a HubJoinRequest: the
+ * socket thread challenges the source with a join cookie, then adds the
+ * client that sends it back to its room (see HubRoomManager::joinSession)
+ * and replies right away. A client that reappears at another address
+ * resumes its session with its cookie (see gHubResumeMagic). The engines
+ * send from the same socket, so the replies come from the port the clients
+ * send to. Trunks to other hubs are joined from this socket too, and the
+ * HubJoinReply of the peer hub goes to HubRoomManager::trunkJoined.
+ */
+class HubSocket : public QThread
+{
+  Q_OBJECT;
+
+public:
+  /** \brief The class constructor, binds the socket
+   * \param port UDP port of the hub
+   */
+  HubSocket(int port = gServerUdpPort) throw(std::runtime_error);
+  /// \brief The class destructor, stops the thread and closes the socket
+  virtual ~HubSocket();
+
+  /// \brief Implements the Thread Loop. To start the thread, call start()
+  /// ( DO NOT CALL run() )
+  virtual void run();
+
+  /// \brief Stops the execution of the Thread
+  void stop() { mStopped = true; }
+
+  /// \brief UDP port of the hub
+  int getPort() const { return mPort; }
+
+  /// \brief Sets the manager that adds the clients of HubJoinRequest s
+  void setHubRoomManager(HubRoomManager* hub_room_manager)
+  { mHubRoomManager = hub_room_manager; }
+
+  /** \brief Cookie of a session, sent to the client in the handshake (thread safe)
+   * \param id Session ID
+   * \param address Client IPv4 address
+   */
+  uint64_t getSessionCookie(int id, uint32_t address) const;
+  /** \brief Join cookie of a source address and port (thread safe)
+   * \param address Client IPv4 address
+   * \param port Client source port
+   * \param epoch Cookie lifetime the cookie is for (time / gHubJoinCookieTime)
+   */
+  uint64_t getJoinCookie(uint32_t address, uint16_t port, uint64_t epoch) const;
+
+  /** \brief Creates the channel of a client (thread safe)
+   * \param id Session ID
+   * \param address Client IPv4 address
+   * \param port UDP port the client announced, 0 if unknown
+   * \return The new channel, owned by the socket until removeChannel()
+   */
+  HubChannel* addChannel(int id, uint32_t address, uint16_t port);
+  /// \brief Stops demultiplexing to a channel and deletes it (thread safe, lock-free)
+  void removeChannel(HubChannel* channel);
+  /** \brief Moves a channel to a new source address and port, if the cookie
+   * is the one of its current address (thread safe)
+   * \param id Session ID
+   * \param cookie Session cookie the client has
+   * \param address New client IPv4 address
+   * \param port New client source port
+   * \param old_address Returns the previous client address
+   * \return true if the channel was moved (or was already there)
+   */
+  bool resumeChannel(int id, uint64_t cookie, uint32_t address, uint16_t port,
+                     uint32_t& old_address);
+
+  /** \brief Sends a datagram to a client (thread safe, from any thread)
+   * \param datagram Datagram data
+   * \param size Datagram size, in bytes
+   * \param address Destination IPv4 address
+   * \param port Destination port
+   */
+  void sendDatagram(const int8_t* datagram, int size, uint32_t address, uint16_t port);
+  /** \brief Sends a batch of datagrams (thread safe, from any thread), with
+   * gHubSendBatchSize datagrams per system call (sendmmsg on Linux). The
+   * datagrams without header take one iovec.
+   * \param entries Datagrams to send
+   * \param num_entries Number of datagrams
+   */
+  void sendDatagrams(const HubSendEntry* entries, int num_entries);
+
+
+private:
+
+  /// \brief Hash key of a source address and port
+  static quint64 sourceKey(uint32_t address, uint16_t port)
+  { return (static_cast<quint64>(address) << 16) | port; }
+
+  /// \brief Deletes a retired channel
+  static void deleteChannel(void* channel) { delete static_cast<HubChannel*>(channel); }
+
+  /// \brief Demultiplexes one received datagram (called in a read section of mChannels)
+  void dispatchDatagram(const int8_t* datagram, int size, uint32_t address, uint16_t port);
+  /// \brief Maps a source port to the channel of a HubRegisterMessage (called in a read section)
+  void registerSource(const HubRegisterMessage* message, uint32_t address, uint16_t port);
+  /** \brief Demultiplexes the datagrams of a channel from a new source
+   * (called with mMutex locked, in a read section)
+   * \return false if the source is used or the channel was removed
+   */
+  bool moveChannel(HubChannel* channel, uint32_t address, uint16_t port);
+  /// \brief Adds the clients of the HubJoinRequest s received (challenges the
+  /// ones without a valid join cookie), resumes the sessions of the resume
+  /// requests, and replies (called without mMutex). Also adds the trunks the
+  /// peer hubs accepted.
+  void processJoinRequests();
+
+  const int mPort; ///< UDP port of the hub
+  int mSocket; ///< Socket descriptor
+
+  QMutex mMutex; ///< Serializes the changes of the channel sources (lookups don't take it)
+  HubSessionTable mChannels; ///< Channels by source address and port, and by session ID
+
+  HubRoomManager* mHubRoomManager; ///< Adds the clients that join by UDP, NULL to ignore them
+  uint64_t mCookieKey[2]; ///< Random SipHash key of the session and join cookies
+  QVector<HubJoinRequest> mJoinRequests; ///< Join requests received (socket thread only)
+  QVector<quint64> mJoinSources; ///< Source address and port of each join request
+  QVector<HubRegisterMessage> mResumeRequests; ///< Resume requests received (socket thread only)
+  QVector<quint64> mResumeSources; ///< Source address and port of each resume request
+  QVector<HubJoinReply> mTrunkReplies; ///< Join replies of peer hubs received (socket thread only)
+  QVector<quint64> mTrunkSources; ///< Source address and port of each join reply
+
+  uint32_t mUnknownDatagrams; ///< Datagrams from unknown sources
+  uint64_t mReceiveTime; ///< Time of the last receive batch, in usec (socket thread only)
+  volatile bool mStopped; ///< Boolean stop the execution of the thread
+};
+
+#endif //__HUBSOCKET_H__
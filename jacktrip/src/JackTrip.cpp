@@ -37,12 +37,19 @@
 
 #include "JackTrip.h"
 #include "UdpDataProtocol.h"
+#include "HubSocket.h"
 #include "RingBufferWavetable.h"
+#include "PacketReblocker.h"
 #include "jacktrip_globals.h"
 #include "JackAudioInterface.h"
+#ifndef __NO_JACK__
+#include "HubJackBridge.h"
+#endif
 #ifdef __RT_AUDIO__
 #include "RtAudioInterface.h"
 #endif
+#include "PacketClockAudioInterface.h"
+#include "NullAudioInterface.h"
 
 #include <iostream>
 //#include <unistd.h> // for usleep, sleep
@@ -50,6 +57,7 @@
 #include <stdexcept>
 
 #include <QHostAddress>
+#include <QHostInfo>
 #include <QThread>
 #include <QTcpSocket>
 
@@ -83,10 +91,13 @@ JackTrip::JackTrip(jacktripModeT JacktripMode,
   mBufferQueueLength(BufferQueueLength),
   mSampleRate(gDefaultSampleRate),
   mAudioBufferSize(gDefaultBufferSizeInSamples),
+  mSendSampleRate(0),
+  mSendBufferSize(0),
   mAudioBitResolution(AudioBitResolution),
   mDataProtocolSender(NULL),
   mDataProtocolReceiver(NULL),
   mAudioInterface(NULL),
+  mPacketClock(NULL),
   mPacketHeader(NULL),
   mUnderRunMode(UnderRunMode),
   mSendRingBuffer(NULL),
@@ -96,8 +107,15 @@ JackTrip::JackTrip(jacktripModeT JacktripMode,
   mSenderBindPort(sender_bind_port),
   mReceiverPeerPort(receiver_peer_port),
   mTcpServerPort(4464),
+  mHubSessionID(-1),
+  mHubCookie(0),
+  mHubUdpJoin(false),
+  mDuplex(false),
   mRedundancy(redundancy),
   mJackClientName("JackTrip"),
+  mNullAudioInput("silence"),
+  mNullAudioOutput(NULL),
+  mNullAudioSpeed(1.0),
   mConnectionMode(JackTrip::NORMAL),
   mReceivedConnection(false),
   mTcpConnectionError(false),
@@ -111,7 +129,7 @@ JackTrip::JackTrip(jacktripModeT JacktripMode,
 JackTrip::~JackTrip()
 {
   wait();
-  delete mDataProtocolSender;
+  if ( mDataProtocolSender != mDataProtocolReceiver ) { delete mDataProtocolSender; }
   delete mDataProtocolReceiver;
   delete mAudioInterface;
   delete mPacketHeader;
@@ -150,6 +168,33 @@ void JackTrip::setupAudio()
 #endif
 #endif
   }
+  else if ( mAudiointerfaceMode == JackTrip::JACK_BRIDGE ) {
+#ifndef __NO_JACK__
+    mAudioInterface = new HubJackPortGroup(this, mNumChans, mNumChans, mAudioBitResolution);
+    mAudioInterface->setClientName(mJackClientName);
+    mAudioInterface->setup();
+    mSampleRate = mAudioInterface->getSampleRate();
+    mAudioBufferSize = mAudioInterface->getBufferSizeInSamples();
+#endif //__NON_JACK__
+  }
+  else if ( mAudiointerfaceMode == JackTrip::PACKETCLOCK ) {
+    mPacketClock = new PacketClockAudioInterface(this, mNumChans, mNumChans, mAudioBitResolution);
+    mAudioInterface = mPacketClock;
+    mAudioInterface->setSampleRate(mSampleRate);
+    mAudioInterface->setBufferSizeInSamples(mAudioBufferSize);
+    mAudioInterface->setup();
+  }
+  else if ( mAudiointerfaceMode == JackTrip::NULLAUDIO ) {
+    NullAudioInterface* null_audio =
+        new NullAudioInterface(this, mNumChans, mNumChans, mAudioBitResolution);
+    mAudioInterface = null_audio;
+    null_audio->setInput(mNullAudioInput);
+    null_audio->setOutput( (mNullAudioOutput != NULL) ? mNullAudioOutput : "" );
+    null_audio->setSpeed(mNullAudioSpeed);
+    mAudioInterface->setSampleRate(mSampleRate);
+    mAudioInterface->setBufferSizeInSamples(mAudioBufferSize);
+    mAudioInterface->setup();
+  }
   else if ( mAudiointerfaceMode == JackTrip::RTAUDIO ) {
 #ifdef __RT_AUDIO__
     mAudioInterface = new RtAudioInterface(this, mNumChans, mNumChans, mAudioBitResolution);
@@ -180,6 +225,7 @@ void JackTrip::closeAudio()
     mAudioInterface->stopProcess();
     delete mAudioInterface;
     mAudioInterface = NULL;
+    mPacketClock = NULL;
   }
 }
 
@@ -193,6 +239,14 @@ void JackTrip::setupDataProtocol()
     std::cout << "Using UDP Protocol" << std::endl;
     std::cout << gPrintSeparator << std::endl;
     QThread::usleep(100);
+    if ( mDuplex ) {
+      // One socket and thread for both directions
+      mDataProtocolReceiver = new UdpDataProtocol(this, DataProtocol::DUPLEX,
+                                                  mReceiverBindPort, mReceiverPeerPort,
+                                                  mRedundancy);
+      mDataProtocolSender = mDataProtocolReceiver;
+      break;
+    }
     mDataProtocolSender = new UdpDataProtocol(this, DataProtocol::SENDER,
                                               //mSenderPeerPort, mSenderBindPort,
                                               mSenderBindPort, mSenderPeerPort,
@@ -323,7 +377,8 @@ void JackTrip::startProcess() throw(std::invalid_argument)
     serverStart();
     break;
   case CLIENTTOPINGSERVER :
-    if ( clientPingToServerStart() == -1 ) { // if error on server start (-1) we return inmediatly
+    if ( (mHubUdpJoin ? clientHubJoinStart() : clientPingToServerStart()) == -1 ) {
+      // if error on server start (-1) we return inmediatly
       mTcpConnectionError = true;
       slotStopProcesses();
       return;
@@ -348,8 +403,10 @@ void JackTrip::startProcess() throw(std::invalid_argument)
   }
   mAudioInterface->connectDefaultPorts();
   mDataProtocolReceiver->start();
-  QThread::msleep(1);
-  mDataProtocolSender->start();
+  if ( mDataProtocolSender != mDataProtocolReceiver ) {
+    QThread::msleep(1);
+    mDataProtocolSender->start();
+  }
 }
 
 
@@ -506,9 +563,20 @@ int JackTrip::clientPingToServerStart() throw(std::invalid_argument)
   // Send Client Port Number to Server
   // ---------------------------------
   char port_buf[sizeof(mReceiverBindPort)];
-  std::memcpy(port_buf, &mReceiverBindPort, sizeof(mReceiverBindPort));
-
-  tcpClient.write(port_buf, sizeof(mReceiverBindPort));
+  int client_port = mReceiverBindPort;
+  // Hub servers send the session ID after the port if we ask for it
+  client_port |= gHubSessionFlag;
+  if ( !mHubRoom.isEmpty() ) { client_port |= gHubRoomFlag; }
+  std::memcpy(port_buf, &client_port, sizeof(client_port));
+
+  tcpClient.write(port_buf, sizeof(client_port));
+  // The room name follows the port (length byte + name)
+  if ( !mHubRoom.isEmpty() ) {
+    QByteArray room = mHubRoom.toUtf8().left(gHubMaxRoomNameLength);
+    char room_length = static_cast<char>(room.size());
+    tcpClient.write(&room_length, 1);
+    tcpClient.write(room.constData(), room.size());
+  }
   while ( tcpClient.bytesToWrite() > 0 ) {
     tcpClient.waitForBytesWritten(-1);
   }
@@ -535,6 +603,24 @@ int JackTrip::clientPingToServerStart() throw(std::invalid_argument)
   std::memcpy(&udp_port, port_buf, size);
   //cout << "Received UDP Port Number: " << udp_port << endl;
 
+  // Hub servers send our session ID and cookie, to register the source of
+  // our packets in the hub port (see UdpDataProtocol)
+  mHubSessionID = -1;
+  if ( udp_port & gHubSessionFlag ) {
+    udp_port &= ~gHubSessionFlag;
+    int32_t session_id;
+    while ( tcpClient.bytesAvailable() < (int)(sizeof(session_id) + sizeof(mHubCookie)) ) {
+      if (!tcpClient.waitForReadyRead()) {
+        std::cerr << "TCP Socket ERROR: " << tcpClient.errorString().toStdString() <<  endl;
+        return -1;
+      }
+    }
+    tcpClient.read(reinterpret_cast<char*>(&session_id), sizeof(session_id));
+    tcpClient.read(reinterpret_cast<char*>(&mHubCookie), sizeof(mHubCookie));
+    mHubSessionID = session_id;
+    cout << "Hub Session ID: " << mHubSessionID << endl;
+  }
+
   // Close the TCP Socket
   // --------------------
   tcpClient.close(); // Close the socket
@@ -605,6 +691,111 @@ int JackTrip::clientPingToServerStart() throw(std::invalid_argument)
 }
 
 
+//*******************************************************************************
+int JackTrip::clientHubJoinStart() throw(std::invalid_argument)
+{
+  // Set Peer (server in this case) address
+  // --------------------------------------
+  if ( mPeerAddress.isEmpty() ) {
+    throw std::invalid_argument("Peer Address has to be set if you run in CLIENTTOPINGSERVER mode");
+    return -1;
+  }
+  // The peer can be a host name (setAddress only parses numeric addresses),
+  // the hub takes IPv4 joins
+  QHostInfo info = QHostInfo::fromName(mPeerAddress);
+  QHostAddress serverHostAddress;
+  for (int i = 0; i < info.addresses().size(); i++) {
+    if ( info.addresses()[i].protocol() == QAbstractSocket::IPv4Protocol ) {
+      serverHostAddress = info.addresses()[i];
+      break;
+    }
+  }
+  if ( serverHostAddress.isNull() ) {
+    std::cerr << "Hub Server address '" << mPeerAddress.toStdString()
+              << "' is not a valid IPv4 address or Host Name" << endl;
+    return -1;
+  }
+  // The hub receives the clients in its well known port
+  uint16_t hub_port = mTcpServerPort;
+
+  // Request with our audio settings, so the hub sets up our session before
+  // our first packet arrives
+  // ----------------------------------------------------------------------
+  HubJoinRequest request;
+  std::memset(&request, 0, sizeof(request));
+  request.Magic = gHubJoinMagic;
+  request.BufferSize = getSendBufferSizeInSamples();
+  request.SamplingRate = getSendSampleRateType();
+  request.BitResolution = getAudioBitResolution();
+  request.NumChannels = mNumChans;
+  request.Redundancy = mRedundancy;
+  QByteArray room = mHubRoom.toUtf8().left(gHubMaxRoomNameLength);
+  request.RoomLength = room.size();
+  std::memcpy(request.Room, room.constData(), room.size());
+
+  // Send it from the receiver port, where the hub sends the audio to us.
+  // It's sent again if the reply doesn't arrive (UDP can lose it).
+  // -------------------------------------------------------------------
+  QUdpSocket UdpSockTemp;
+  if ( !UdpSockTemp.bind(QHostAddress::Any, mReceiverBindPort,
+                         QUdpSocket::DefaultForPlatform) ) {
+    std::cerr << "in JackTrip: Could not bind UDP socket. It may be already binded." << endl;
+    return -1;
+  }
+  cout << "Joining the Hub Server..." << endl;
+  HubJoinReply reply;
+  bool joined = false;
+  int elapsedTime = 0;
+  while ( !joined && (elapsedTime < gTimeOutMultiThreadedServer) ) {
+    if (mStopped == true) { UdpSockTemp.close(); return -1; }
+    UdpSockTemp.writeDatagram(reinterpret_cast<char*>(&request), sizeof(request),
+                              serverHostAddress, hub_port);
+    // A challenge wakes us up before the retry time, the answer goes right away
+    UdpSockTemp.waitForReadyRead(gHubJoinRetryTime);
+    elapsedTime += gHubJoinRetryTime;
+    while ( !joined && UdpSockTemp.hasPendingDatagrams() ) {
+      QHostAddress sender_address;
+      uint16_t sender_port;
+      int size = UdpSockTemp.readDatagram(reinterpret_cast<char*>(&reply), sizeof(reply),
+                                          &sender_address, &sender_port);
+      if ( (size != static_cast<int>(sizeof(reply))) ||
+           (reply.Magic != gHubJoinReplyMagic) || (sender_port != hub_port) ) { continue; }
+      // The hub first checks that we get its replies, the request is sent
+      // again with its cookie
+      if ( reply.SessionID == gHubJoinChallengeID ) {
+        request.Cookie = reply.Cookie;
+        continue;
+      }
+      joined = true;
+    }
+  }
+  UdpSockTemp.close();
+  if ( !joined ) {
+    std::cerr << "Hub Server is not answering (timeout)" << endl;
+    return -1;
+  }
+  if ( reply.SessionID < 0 ) {
+    std::cerr << "Hub Server could not take the client (full, or unsupported audio settings)" << endl;
+    return -1;
+  }
+  mHubSessionID = reply.SessionID;
+  mHubCookie = reply.Cookie;
+  cout << "Hub Session ID: " << mHubSessionID << endl;
+  cout << "Connection Succesfull!" << endl;
+
+  // Send to the hub port
+  // --------------------
+  setPeerPorts(hub_port);
+  mDataProtocolReceiver->setPeerAddress( mPeerAddress.toLatin1().data() );
+  mDataProtocolSender->setPeerAddress( mPeerAddress.toLatin1().data() );
+  mDataProtocolSender->setPeerPort(hub_port);
+  mDataProtocolReceiver->setPeerPort(hub_port);
+  cout << "Server Address set to: " << mPeerAddress.toStdString() << " Port: " << hub_port << std::endl;
+  cout << gPrintSeparator << endl;
+  return 0;
+}
+
+
 //*******************************************************************************
 /*
 void JackTrip::bindReceiveSocket(QUdpSocket& UdpSocket, int bind_port,
@@ -693,7 +884,7 @@ void JackTrip::putHeaderInPacket(int8_t* full_packet, int8_t* audio_packet)
   audio_part = full_packet + mPacketHeader->getHeaderSizeInBytes();
   //std::memcpy(audio_part, audio_packet, mAudioInterface->getBufferSizeInBytes());
   //std::memcpy(audio_part, audio_packet, mAudioInterface->getSizeInBytesPerChannel() * mNumChans);
-  std::memcpy(audio_part, audio_packet, getTotalAudioPacketSizeInBytes());
+  std::memcpy(audio_part, audio_packet, getSendAudioPacketSizeInBytes());
 }
 
 
@@ -719,6 +910,15 @@ void JackTrip::parseAudioPacket(int8_t* full_packet, int8_t* audio_packet)
 }
 
 
+//*******************************************************************************
+void JackTrip::writeAudioBuffer(const int8_t* ptrToSlot)
+{
+  mReceiveRingBuffer->insertSlotNonBlocking(ptrToSlot);
+  // The packet clock follows the slot arrivals
+  if ( mPacketClock != NULL ) { mPacketClock->slotArrived(); }
+}
+
+
 //*******************************************************************************
 void JackTrip::checkPeerSettings(int8_t* full_packet)
 {
@@ -726,6 +926,25 @@ void JackTrip::checkPeerSettings(int8_t* full_packet)
 }
 
 
+//*******************************************************************************
+void JackTrip::adaptReceiveQueueToPeer(int peer_buffer_size)
+{
+  int max_slots =
+      PacketReblocker::getMaxSlotsPerPacket(getBufferSizeInSamples(), peer_buffer_size);
+  if ( max_slots <= 1 ) { return; } // peer packets are not larger than local ones
+
+  // A peer packet can produce max_slots local slots at once. Until the next
+  // peer packet arrives, max_slots-1 extra slots have to be already queued,
+  // and the queue needs room for a full burst. The RingBuffer starts half
+  // full, so this adds exactly (max_slots-1) slots of latency.
+  int num_slots = mBufferQueueLength + 2*(max_slots-1);
+  cout << "Receive queue set to " << num_slots << " slots to re-block peer packets of "
+       << peer_buffer_size << " samples" << endl;
+  cout << gPrintSeparator << endl;
+  mReceiveRingBuffer->setNumSlots(num_slots);
+}
+
+
 //*******************************************************************************
 void JackTrip::checkIfPortIsBinded(int port)
 {
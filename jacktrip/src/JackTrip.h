@@ -56,6 +56,9 @@
 #include "RingBuffer.h"
 
 #include <signal.h>
+
+class PacketClockAudioInterface; // forward declaration
+
 /** \brief Main class to creates a SERVER (to listen) or a CLIENT (to connect
  * to a listening server) to send audio streams in the network.
  *
@@ -95,7 +98,10 @@ public:
   /// \brief Enum for Audio Interface Mode
   enum audiointerfaceModeT {
     JACK, ///< Jack Mode
-    RTAUDIO  ///< RtAudio Mode
+    RTAUDIO, ///< RtAudio Mode
+    JACK_BRIDGE, ///< Ports in the JACK client shared by the server (HubJackBridge)
+    PACKETCLOCK, ///< No sound card, clocked by the peer packets (PacketClockAudioInterface)
+    NULLAUDIO ///< No sound card, clocked by a timer, audio from and to files (NullAudioInterface)
   };
 
   /// \brief Enum for Connection Mode (useful for connections to MultiClient Server)
@@ -210,9 +216,41 @@ public:
   /// \brief Set Client Name to something different that the default (JackTrip)
   virtual void setClientName(const char* ClientName)
   { mJackClientName = ClientName; }
+  /** \brief Set the input, output file and speed of the NULLAUDIO mode
+   * (see NullAudioInterface)
+   * \param input Input source: silence, sine[:frequency], noise or a WAV file
+   * \param output Output WAV file, NULL to discard the output
+   * \param speed Speed in times real time, 0 for as fast as possible
+   */
+  virtual void setNullAudio(const char* input, const char* output, double speed)
+  {
+    mNullAudioInput = input;
+    mNullAudioOutput = output;
+    mNullAudioSpeed = speed;
+  }
   /// \brief Set the number of audio channels
   virtual void setNumChannels(int num_chans)
   { mNumChans = num_chans; }
+  /// \brief Set the hub server room to join (CLIENTTOPINGSERVER mode)
+  virtual void setHubRoom(const QString& room)
+  { mHubRoom = room; }
+  /// \brief Send and receive with one DataProtocol (one socket and thread)
+  /// instead of a sender and a receiver. Set it before startProcess().
+  virtual void setDuplex(bool duplex)
+  { mDuplex = duplex; }
+  /// \brief Join the hub server with one UDP request (HubJoinRequest) instead
+  /// of the TCP handshake (CLIENTTOPINGSERVER mode)
+  virtual void setHubUdpJoin(bool udp_join)
+  { mHubUdpJoin = udp_join; }
+  /// \brief Session ID the hub server assigned to us, -1 if the server is not a hub
+  virtual int getHubSessionID() const
+  { return mHubSessionID; }
+  /// \brief Cookie of our hub session, to register our source port
+  virtual uint64_t getHubCookie() const
+  { return mHubCookie; }
+  /// \brief Set the cookie of our hub session, when it's resumed from another address
+  virtual void setHubCookie(uint64_t cookie)
+  { mHubCookie = cookie; }
 
   virtual int getReceiverBindPort() const
   { return mReceiverBindPort; }
@@ -257,6 +295,15 @@ public:
   { mSampleRate = sample_rate; }
   void setAudioBufferSizeInSamples(uint32_t buf_size)
   { mAudioBufferSize = buf_size; }
+  /** \brief Send the audio to the peer with its own sample rate and buffer size
+   *
+   * The outgoing audio is converted (see SampleRateConverter and PacketReblocker),
+   * so the peer doesn't need to do it. This is used in the hub server.
+   * \param sample_rate Peer sample rate in Hz, 0 to use the local one
+   * \param buf_size Peer buffer size in samples, 0 to use the local one
+   */
+  void setSendAudioSettings(uint32_t sample_rate, uint32_t buf_size)
+  { mSendSampleRate = sample_rate; mSendBufferSize = buf_size; }
 
   JackTrip::connectionModeT getConnectionMode() const
   { return mConnectionMode; }
@@ -287,13 +334,18 @@ public:
   virtual int getPacketSizeInBytes();
   void parseAudioPacket(int8_t* full_packet, int8_t* audio_packet);
   virtual void sendNetworkPacket(const int8_t* ptrToSlot)
-  { mSendRingBuffer->insertSlotNonBlocking(ptrToSlot); }
+  {
+    mSendRingBuffer->insertSlotNonBlocking(ptrToSlot);
+    mDataProtocolSender->wakeUp();
+  }
   virtual void receiveNetworkPacket(int8_t* ptrToReadSlot)
   { mReceiveRingBuffer->readSlotNonBlocking(ptrToReadSlot); }
   virtual void readAudioBuffer(int8_t* ptrToReadSlot)
   { mSendRingBuffer->readSlotBlocking(ptrToReadSlot); }
-  virtual void writeAudioBuffer(const int8_t* ptrToSlot)
-  { mReceiveRingBuffer->insertSlotNonBlocking(ptrToSlot); }
+  /// \brief Non-blocking readAudioBuffer, returns false if there's no buffer to send
+  virtual bool readAudioBufferIfAvailable(int8_t* ptrToReadSlot)
+  { return mSendRingBuffer->readSlotIfAvailable(ptrToReadSlot); }
+  virtual void writeAudioBuffer(const int8_t* ptrToSlot);
   uint32_t getBufferSizeInSamples() const
   { return mAudioBufferSize; /*return mAudioInterface->getBufferSizeInSamples();*/ }
 
@@ -301,6 +353,14 @@ public:
   { return mAudioInterface->getSampleRateType(); }
   int getSampleRate() const
   { return mSampleRate; /*return mAudioInterface->getSampleRate();*/ }
+  /// \brief Buffer size of the packets sent to the peer, in samples
+  uint32_t getSendBufferSizeInSamples() const
+  { return (mSendBufferSize == 0) ? getBufferSizeInSamples() : mSendBufferSize; }
+  /// \brief Sample rate of the packets sent to the peer, in Hz
+  uint32_t getSendSampleRate() const
+  { return (mSendSampleRate == 0) ? getSampleRate() : mSendSampleRate; }
+  AudioInterface::samplingRateT getSendSampleRateType() const
+  { return AudioInterface::getSampleRateTypeFromRate( getSendSampleRate() ); }
 
   uint8_t getAudioBitResolution() const
   { return mAudioBitResolution*8; /*return mAudioInterface->getAudioBitResolution();*/ }
@@ -315,6 +375,12 @@ public:
     else { return 0; }
   }
   virtual void checkPeerSettings(int8_t* full_packet);
+  /** \brief Resize the receive RingBuffer for a peer that uses a different
+   * buffer size, so it can absorb the bursts of re-blocked slots
+   * (see PacketReblocker)
+   * \param peer_buffer_size Peer buffer size, in samples
+   */
+  virtual void adaptReceiveQueueToPeer(int peer_buffer_size);
   void increaseSequenceNumber()
   { mPacketHeader->increaseSequenceNumber(); }
   int getSequenceNumber() const
@@ -347,6 +413,9 @@ public:
   { return mPacketHeader->getHeaderSizeInBytes(); }
   virtual int getTotalAudioPacketSizeInBytes() const
   { return mAudioInterface->getSizeInBytesPerChannel() * mNumChans; }
+  /// \brief Size of the audio part of the packets sent to the peer
+  int getSendAudioPacketSizeInBytes() const
+  { return getSendBufferSizeInSamples() * mAudioBitResolution * mNumChans; }
   //@}
   //------------------------------------------------------------------------------------
 
@@ -412,6 +481,12 @@ public:
   /// \brief Stats for the Client to Ping Server
   /// \return -1 on error, 0 on success
   virtual int clientPingToServerStart() throw(std::invalid_argument);
+  /** \brief Starts for the Client to Ping Server, joining the hub with one UDP
+   * request from the receiver port. The request carries our audio settings,
+   * the reply our session ID.
+   * \return -1 on error, 0 on success
+   */
+  virtual int clientHubJoinStart() throw(std::invalid_argument);
 
 private:
   //void bindReceiveSocket(QUdpSocket& UdpSocket, int bind_port,
@@ -428,6 +503,8 @@ private:
   int mBufferQueueLength; ///< Audio Buffer from network queue length
   uint32_t mSampleRate; ///< Sample Rate
   uint32_t mAudioBufferSize; ///< Audio buffer size to process on each callback
+  uint32_t mSendSampleRate; ///< Sample rate sent to the peer, 0 for mSampleRate
+  uint32_t mSendBufferSize; ///< Buffer size sent to the peer, 0 for mAudioBufferSize
   AudioInterface::audioBitResolutionT mAudioBitResolution; ///< Audio Bit Resolutions
   QString mPeerAddress; ///< Peer Address to use in jacktripModeT::CLIENT Mode
 
@@ -436,6 +513,7 @@ private:
   /// Pointer to Abstract Type DataProtocol that receives packets
   DataProtocol* mDataProtocolReceiver;
   AudioInterface* mAudioInterface; ///< Interface to Jack Client
+  PacketClockAudioInterface* mPacketClock; ///< mAudioInterface in PACKETCLOCK mode, NULL otherwise
   PacketHeader* mPacketHeader; ///< Pointer to Packet Header
   underrunModeT mUnderRunMode; ///< underrunModeT Mode
 
@@ -449,9 +527,17 @@ private:
   int mSenderBindPort; ///< Outgoing (sending) port for local machine
   int mReceiverPeerPort; ///< Outgoing (sending) port for peer machine
   int mTcpServerPort;
+  QString mHubRoom; ///< Hub server room, empty for the default room
+  int mHubSessionID; ///< Session ID in the hub server, -1 if none
+  uint64_t mHubCookie; ///< Cookie of the hub session
+  bool mHubUdpJoin; ///< Join the hub with a UDP request instead of TCP
+  bool mDuplex; ///< One DataProtocol for sending and receiving (the sender is the receiver)
 
   unsigned int mRedundancy; ///< Redundancy factor in network data
   const char* mJackClientName; ///< JackAudio Client Name
+  const char* mNullAudioInput; ///< Input source in NULLAUDIO mode
+  const char* mNullAudioOutput; ///< Output WAV file in NULLAUDIO mode, NULL to discard it
+  double mNullAudioSpeed; ///< Speed in NULLAUDIO mode, in times real time (0 as fast as possible)
 
   JackTrip::connectionModeT mConnectionMode; ///< Connection Mode
 
@@ -0,0 +1,374 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+
+
+/**
+ * \file JackTripSimulator.cpp
+ * \date October 2026
+ */
+
+#include "JackTripSimulator.h"
+#include "PacketHeader.h"
+#include "RingBuffer.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <stdexcept>
+
+using std::cout; using std::endl;
+
+/// Value of the frame after the period number, it marks the audio of a period
+const sample_t gSimulationMark = 0.5;
+/// Frames of the first channel with the period number (4 bits each) and the mark
+const unsigned int gSimulationMarkFrames = 5;
+/// Start of the receiver callbacks after the sender ones, in periods
+const double gSimulationReceiverPhase = 0.5;
+
+
+//*******************************************************************************
+SimulatedAudioInterface::SimulatedAudioInterface(JackTrip* jacktrip,
+                                                 int NumInChans, int NumOutChans,
+                                                 audioBitResolutionT AudioBitResolution) :
+  AudioInterface(jacktrip,
+                 NumInChans, NumOutChans,
+                 AudioBitResolution)
+{}
+
+
+//*******************************************************************************
+SimulatedAudioInterface::~SimulatedAudioInterface()
+{
+  for (int i = 0; i < mInBuffer.size(); i++) { delete[] mInBuffer[i]; }
+  for (int i = 0; i < mOutBuffer.size(); i++) { delete[] mOutBuffer[i]; }
+}
+
+
+//*******************************************************************************
+void SimulatedAudioInterface::setup()
+{
+  AudioInterface::setup();
+
+  int nframes = getBufferSizeInSamples();
+  if ( (nframes < static_cast<int>(gSimulationMarkFrames)) ||
+       (getNumInputChannels() < 1) || (getNumOutputChannels() < 1) ) {
+    throw std::invalid_argument("The simulation needs at least one channel and 5 samples per buffer");
+  }
+  mInBuffer.resize(getNumInputChannels());
+  for (int i = 0; i < getNumInputChannels(); i++) {
+    mInBuffer[i] = new sample_t[nframes];
+    std::memset(mInBuffer[i], 0, sizeof(sample_t) * nframes);
+  }
+  mOutBuffer.resize(getNumOutputChannels());
+  for (int i = 0; i < getNumOutputChannels(); i++) {
+    mOutBuffer[i] = new sample_t[nframes];
+    std::memset(mOutBuffer[i], 0, sizeof(sample_t) * nframes);
+  }
+}
+
+
+//*******************************************************************************
+int SimulatedAudioInterface::processPeriod(uint16_t period)
+{
+  // The period number in 4 bit steps of 1/16 is exact at every bit resolution
+  sample_t* input = mInBuffer[0];
+  for (unsigned int i = 0; i < (gSimulationMarkFrames - 1); i++) {
+    input[i] = static_cast<sample_t>( static_cast<int>((period >> (4*i)) & 0xF) - 8 ) / 16.0;
+  }
+  input[gSimulationMarkFrames - 1] = gSimulationMark;
+
+  AudioInterface::callback(mInBuffer, mOutBuffer, getBufferSizeInSamples());
+
+  const sample_t* output = mOutBuffer[0];
+  if ( output[gSimulationMarkFrames - 1] != gSimulationMark ) { return -1; }
+  int mark = 0;
+  for (unsigned int i = 0; i < (gSimulationMarkFrames - 1); i++) {
+    mark |= ( static_cast<int>(std::floor((output[i] * 16.0) + 0.5)) + 8 ) << (4*i);
+  }
+  return mark;
+}
+
+
+
+
+//*******************************************************************************
+JackTripSimulator::JackTripSimulator(int NumChans, int BufferQueueLength,
+                                     unsigned int Redundancy,
+                                     AudioInterface::audioBitResolutionT AudioBitResolution,
+                                     JackTrip::underrunModeT UnderRunMode,
+                                     uint32_t SampleRate, uint32_t BufferSize) :
+  mNumChans(NumChans),
+  mBufferQueueLength(BufferQueueLength),
+  mRedundancy(Redundancy),
+  mAudioBitResolution(AudioBitResolution),
+  mUnderRunMode(UnderRunMode),
+  mSampleRate(SampleRate),
+  mBufferSize(BufferSize)
+{}
+
+
+//*******************************************************************************
+void JackTripSimulator::runTraceFile(const char* path)
+{
+  QVector<Scenario> scenarios = readTraceFile(path);
+
+  cout << "Simulation of " << path << ": " << mSampleRate << " Hz, "
+       << mBufferSize << " samples per period, " << mNumChans << " channels, "
+       << (mAudioBitResolution * 8) << " bits, queue " << mBufferQueueLength
+       << ", redundancy " << mRedundancy << ", "
+       << ((mUnderRunMode == JackTrip::ZEROS) ? "zeros" : "wavetable") << " under-runs" << endl;
+  cout << gPrintSeparator << endl;
+  for (int i = 0; i < scenarios.size(); i++) {
+    runScenario(scenarios[i]);
+  }
+}
+
+
+//*******************************************************************************
+QVector<JackTripSimulator::Scenario> JackTripSimulator::readTraceFile(const char* path)
+{
+  std::ifstream file(path);
+  if ( !file ) {
+    throw std::runtime_error(std::string("Can't read the trace file ") + path);
+  }
+
+  QVector<Scenario> scenarios;
+  std::string line;
+  int line_number = 0;
+  while ( std::getline(file, line) ) {
+    line_number++;
+    std::string::size_type comment = line.find('#');
+    if ( comment != std::string::npos ) { line.erase(comment); }
+    std::istringstream words(line);
+    std::string keyword;
+    if ( !(words >> keyword) ) { continue; }
+
+    std::ostringstream error;
+    error << path << ":" << line_number << ": ";
+    if ( keyword == "scenario" ) {
+      Scenario scenario;
+      std::string name;
+      if ( !(words >> name) ) { name = "unnamed"; }
+      scenario.Name = name.c_str();
+      scenario.Seed = 1;
+      scenario.Drift = 0.0;
+      scenarios.append(scenario);
+      continue;
+    }
+    if ( scenarios.isEmpty() ) {
+      error << "'" << keyword << "' before the first scenario";
+      throw std::invalid_argument(error.str());
+    }
+
+    Scenario& scenario = scenarios.last();
+    if ( keyword == "seed" ) {
+      if ( !(words >> scenario.Seed) ) {
+        error << "seed needs a number";
+        throw std::invalid_argument(error.str());
+      }
+    }
+    else if ( keyword == "drift" ) {
+      if ( !(words >> scenario.Drift) ) {
+        error << "drift needs a number of ppm";
+        throw std::invalid_argument(error.str());
+      }
+    }
+    else if ( keyword == "segment" ) {
+      SimulatedLinkSegment segment = { 0.0, 0.0, 0.0, 0.0, 1.0, 0.0 };
+      if ( !(words >> segment.Duration) || (segment.Duration <= 0.0) ) {
+        error << "segment needs a duration in seconds";
+        throw std::invalid_argument(error.str());
+      }
+      std::string name;
+      double value;
+      while ( words >> name ) {
+        if ( !(words >> value) || (value < 0.0) ) {
+          error << "segment " << name << " needs a positive number";
+          throw std::invalid_argument(error.str());
+        }
+        if ( name == "delay" ) { segment.Delay = value / 1000.0; }
+        else if ( name == "jitter" ) { segment.Jitter = value / 1000.0; }
+        else if ( name == "loss" ) { segment.Loss = value / 100.0; }
+        else if ( name == "burst" ) { segment.BurstLength = value; }
+        else if ( name == "reorder" ) { segment.Reorder = value / 100.0; }
+        else {
+          error << "unknown segment value " << name;
+          throw std::invalid_argument(error.str());
+        }
+      }
+      scenario.Segments.append(segment);
+    }
+    else {
+      error << "unknown keyword " << keyword;
+      throw std::invalid_argument(error.str());
+    }
+  }
+
+  if ( scenarios.isEmpty() ) {
+    throw std::invalid_argument(std::string("No scenario in the trace file ") + path);
+  }
+  for (int i = 0; i < scenarios.size(); i++) {
+    if ( scenarios[i].Segments.isEmpty() ) {
+      throw std::invalid_argument(std::string("No segment in the scenario ")
+                                  + scenarios[i].Name.constData());
+    }
+  }
+  return scenarios;
+}
+
+
+//*******************************************************************************
+void JackTripSimulator::setupPeer(JackTrip& jacktrip, SimulatedAudioInterface*& audio,
+                                  SimulatedDataProtocol*& protocol,
+                                  SimulatedLink* send_link, SimulatedLink* receive_link)
+{
+  // Same steps as JackTrip::startProcess, with the simulated classes
+  jacktrip.setSampleRate(mSampleRate);
+  jacktrip.setAudioBufferSizeInSamples(mBufferSize);
+  audio = new SimulatedAudioInterface(&jacktrip, mNumChans, mNumChans, mAudioBitResolution);
+  audio->setSampleRate(mSampleRate);
+  audio->setBufferSizeInSamples(mBufferSize);
+  audio->setup();
+  jacktrip.setAudioInterface(audio);
+  protocol = new SimulatedDataProtocol(&jacktrip, send_link, receive_link, mRedundancy);
+  protocol->setAudioPacketSize(jacktrip.getTotalAudioPacketSizeInBytes());
+  jacktrip.setDataProtocolSender(protocol);
+  jacktrip.setDataProtocolReceiver(protocol);
+  jacktrip.setupRingBuffers();
+  protocol->setup();
+}
+
+
+//*******************************************************************************
+void JackTripSimulator::runScenario(const Scenario& scenario)
+{
+  double period = static_cast<double>(mBufferSize) / mSampleRate;
+  double receive_period = period / (1.0 + (scenario.Drift * 1.0e-6));
+  double duration = 0.0;
+  for (int i = 0; i < scenario.Segments.size(); i++) {
+    duration += scenario.Segments[i].Duration;
+  }
+
+  // The link is deleted after the peers, their protocols use it
+  SimulatedLink link(scenario.Segments, scenario.Seed, period);
+  JackTrip sender(JackTrip::CLIENT, JackTrip::UDP, mNumChans, mBufferQueueLength,
+                  mRedundancy, mAudioBitResolution, DataProtocol::DEFAULT, mUnderRunMode);
+  JackTrip receiver(JackTrip::CLIENT, JackTrip::UDP, mNumChans, mBufferQueueLength,
+                    mRedundancy, mAudioBitResolution, DataProtocol::DEFAULT, mUnderRunMode);
+  SimulatedAudioInterface* sender_audio;
+  SimulatedDataProtocol* sender_protocol;
+  SimulatedAudioInterface* receiver_audio;
+  SimulatedDataProtocol* receiver_protocol;
+  setupPeer(sender, sender_audio, sender_protocol, &link, NULL);
+  setupPeer(receiver, receiver_audio, receiver_protocol, NULL, &link);
+
+  uint64_t start_usec = PacketHeader::usecTime();
+  uint64_t sent = 0; // Sender periods
+  uint64_t received = 0; // Receiver periods
+  double send_time = 0.0;
+  double receive_time = gSimulationReceiverPhase * period;
+  bool playing = false; // The receiver has played the first period of the sender
+  int64_t last_played = 0; // Last sender period played
+  uint64_t played = 0; // Receiver periods since the first one played
+  uint64_t concealed = 0; // Receiver periods without a new sender period
+  uint64_t never_played = 0; // Sender periods skipped by the receiver
+  double latency_sum = 0.0;
+  double latency_min = 0.0;
+  double latency_max = 0.0;
+
+  // Run the events in time order: the datagram arrivals, then the callbacks
+  while ( receive_time < duration ) {
+    if ( link.hasDatagram() && (link.nextArrival() <= send_time) &&
+         (link.nextArrival() <= receive_time) ) {
+      receiver_protocol->receiveAudio(link.nextArrival());
+    }
+    else if ( send_time <= receive_time ) {
+      link.setTime(send_time);
+      sender_audio->processPeriod(static_cast<uint16_t>(sent));
+      sender_protocol->sendAudio();
+      sent++;
+      send_time = sent * period;
+    }
+    else {
+      int mark = receiver_audio->processPeriod(0);
+      // The receiver packets have nowhere to go, this only empties its send RingBuffer
+      receiver_protocol->sendAudio();
+      // The period number has 16 bits, it's the closest to the last one sent
+      int64_t number = -1;
+      if ( mark >= 0 ) {
+        uint16_t distance = static_cast<uint16_t>(mark) - static_cast<uint16_t>(sent);
+        number = static_cast<int64_t>(sent) + static_cast<int16_t>(distance);
+      }
+      if ( playing ) { played++; }
+      if ( (number < 0) || (playing && (number <= last_played)) ) {
+        if ( playing ) { concealed++; }
+      }
+      else {
+        double latency = receive_time - (number * period);
+        if ( !playing || (latency < latency_min) ) { latency_min = latency; }
+        if ( !playing || (latency > latency_max) ) { latency_max = latency; }
+        latency_sum += latency;
+        if ( playing ) { never_played += number - last_played - 1; }
+        else { played++; }
+        playing = true;
+        last_played = number;
+      }
+      received++;
+      receive_time = (gSimulationReceiverPhase * period) + (received * receive_period);
+    }
+  }
+
+  double elapsed = (PacketHeader::usecTime() - start_usec) / 1.0e6;
+  uint64_t new_periods = played - concealed;
+  RingBuffer* receive_queue = receiver.getReceiveRingBuffer();
+  cout << "Scenario " << scenario.Name.constData() << ": " << duration
+       << " s simulated in " << elapsed << " s" << endl;
+  cout << "  Network:  " << link.getSent() << " datagrams, " << link.getLost() << " lost ("
+       << ((link.getSent() > 0) ? (100.0 * link.getLost()) / link.getSent() : 0.0)
+       << "%), " << link.getReordered() << " reordered" << endl;
+  cout << "  Receiver: " << played << " periods, " << concealed << " concealed ("
+       << ((played > 0) ? (100.0 * concealed) / played : 0.0) << "%), "
+       << receive_queue->getUnderruns() << " under-runs, "
+       << receive_queue->getOverflows() << " over-flows, "
+       << never_played << " periods never played" << endl;
+  cout << "  Latency:  ";
+  if ( new_periods > 0 ) {
+    cout << (1000.0 * latency_sum) / new_periods << " ms mean, "
+         << 1000.0 * latency_min << " ms min, " << 1000.0 * latency_max << " ms max" << endl;
+  }
+  else {
+    cout << "nothing played" << endl;
+  }
+  cout << gPrintSeparator << endl;
+}
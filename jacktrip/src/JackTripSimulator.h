@@ -0,0 +1,186 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+
+
+/**
+ * \file JackTripSimulator.h
+ * \date October 2026
+ */
+
+#ifndef __JACKTRIPSIMULATOR_H__
+#define __JACKTRIPSIMULATOR_H__
+
+#include <stdint.h>
+
+#include <QVector>
+#include <QByteArray>
+#include <QVarLengthArray>
+
+#include "AudioInterface.h"
+#include "JackTrip.h"
+#include "SimulatedLink.h"
+
+
+/** \brief Audio interface of the simulated peers, the callback runs when
+ * JackTripSimulator asks for it
+ *
+ * The input carries the number of each period (in the first frames of the
+ * first channel, exact at every bit resolution), so the simulator can tell
+ * which period the receiver plays: a new one, an old one again (wavetable
+ * concealment) or none (silence).
+ */
+class SimulatedAudioInterface : public AudioInterface
+{
+public:
+
+  /** \brief The class constructor
+   * \param jacktrip Pointer to the JackTrip class that connects all classes (mediator)
+   * \param NumInChans Number of Input Channels
+   * \param NumOutChans Number of Output Channels
+   * \param AudioBitResolution Audio Sample Resolutions in bits
+   */
+  SimulatedAudioInterface(JackTrip* jacktrip,
+                          int NumInChans = gDefaultNumInChannels,
+                          int NumOutChans = gDefaultNumOutChannels,
+                          audioBitResolutionT AudioBitResolution = BIT16);
+  /// \brief The class destructor
+  virtual ~SimulatedAudioInterface();
+
+  /** \brief Allocates the buffers
+   * \exception std::invalid_argument The buffers are too small for the
+   * period number
+   */
+  virtual void setup();
+  /// \brief This has no effect, the simulator runs the callback
+  virtual int startProcess() const { return 0; }
+  /// \brief This has no effect, the simulator runs the callback
+  virtual int stopProcess() const { return 0; }
+  /// \brief This has no effect without a sound card
+  virtual void connectDefaultPorts() {}
+  /// \brief This has no effect without a sound card
+  virtual void setClientName(const char* /*ClientName*/) {}
+
+  /** \brief Runs the process callback for one period
+   * \param period Period number to put in the input
+   * \return Period number found in the output, -1 if there's none
+   */
+  int processPeriod(uint16_t period);
+
+private:
+  QVarLengthArray<sample_t*> mInBuffer; ///< Vector of Input buffers/channel
+  QVarLengthArray<sample_t*> mOutBuffer; ///< Vector of Output buffer/channel
+};
+
+
+/** \brief Runs a sender and a receiver JackTrip in one process, in virtual
+ * time, over scripted network conditions
+ *
+ * Both peers are JackTrip objects with their header, RingBuffers and redundancy
+ * algorithm, but with a SimulatedAudioInterface instead of a sound card and a
+ * SimulatedDataProtocol instead of the UDP sockets. The simulator runs the
+ * sender and receiver callbacks at their period times and delivers the
+ * datagrams of the SimulatedLink at their arrival times, in time order and as
+ * fast as the CPU allows: an hour of audio takes seconds, and the same trace
+ * always gives the same results.
+ *
+ * The network conditions are read from a trace file, with one or more
+ * scenarios:
+ * \code
+ * # Comments start with #
+ * scenario wifi
+ * seed 7          # random seed (defaults 1)
+ * drift 20        # receiver clock, in ppm faster than the sender (defaults 0)
+ * segment 600 delay 10 jitter 2 loss 0.5 burst 3 reorder 0.1
+ * segment 60 delay 10 jitter 15 loss 5 burst 10
+ * \endcode
+ * Each segment lasts the given seconds, with the fixed delay and mean
+ * queueing jitter in milliseconds, the loss and reorder rates in percent, and
+ * the mean number of datagrams lost in a row (see SimulatedLink). Missing
+ * values are 0 (and 1 for burst, independent losses).
+ *
+ * The report of each scenario counts the datagrams lost and reordered by the
+ * network, the periods the receiver concealed (silence or repeated audio), the
+ * under-runs and over-flows of its receive RingBuffer, the periods never
+ * played, and the latency from the sender callback to the receiver callback.
+ */
+class JackTripSimulator
+{
+public:
+
+  /** \brief The class constructor
+   * \param NumChans Number of Audio Channels
+   * \param BufferQueueLength Receive queue length, in packets
+   * \param Redundancy Number of redundant packets in each datagram
+   * \param AudioBitResolution Audio Sample Resolutions in bits
+   * \param UnderRunMode Receiver concealment of lost or late packets
+   * \param SampleRate Sampling rate, in Hz
+   * \param BufferSize Buffer size, in samples
+   */
+  JackTripSimulator(int NumChans, int BufferQueueLength, unsigned int Redundancy,
+                    AudioInterface::audioBitResolutionT AudioBitResolution,
+                    JackTrip::underrunModeT UnderRunMode,
+                    uint32_t SampleRate, uint32_t BufferSize);
+
+  /** \brief Runs all the scenarios of a trace file
+   * \exception std::runtime_error The file can't be read
+   * \exception std::invalid_argument The file has a syntax error
+   */
+  void runTraceFile(const char* path);
+
+private:
+  /// \brief Scenario of a trace file
+  struct Scenario {
+    QByteArray Name; ///< Name of the scenario
+    uint32_t Seed; ///< Random seed of the link
+    double Drift; ///< Receiver clock, in ppm faster than the sender
+    QVector<SimulatedLinkSegment> Segments; ///< Network conditions
+  };
+
+  /// \brief Reads the scenarios of a trace file
+  QVector<Scenario> readTraceFile(const char* path);
+  /// \brief Runs one scenario and prints its report
+  void runScenario(const Scenario& scenario);
+  /// \brief Sets up one peer with a SimulatedAudioInterface and a SimulatedDataProtocol
+  void setupPeer(JackTrip& jacktrip, SimulatedAudioInterface*& audio,
+                 SimulatedDataProtocol*& protocol,
+                 SimulatedLink* send_link, SimulatedLink* receive_link);
+
+  int mNumChans; ///< Number of Audio Channels
+  int mBufferQueueLength; ///< Receive queue length, in packets
+  unsigned int mRedundancy; ///< Number of redundant packets in each datagram
+  AudioInterface::audioBitResolutionT mAudioBitResolution; ///< Audio Sample Resolutions in bits
+  JackTrip::underrunModeT mUnderRunMode; ///< Receiver concealment mode
+  uint32_t mSampleRate; ///< Sampling rate, in Hz
+  uint32_t mBufferSize; ///< Buffer size, in samples
+};
+
+#endif // __JACKTRIPSIMULATOR_H__
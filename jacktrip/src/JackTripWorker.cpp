@@ -121,6 +121,8 @@ void JackTripWorker::run()
     // Create and setup JackTrip Object
     //JackTrip jacktrip(JackTrip::SERVER, JackTrip::UDP, mNumChans, 2);
     cout << "---> JackTripWorker: Creating jacktip objects..." << endl;
+    // Ports of this client in the JACK client shared by the server
+    QByteArray PortGroupName = "client_" + QByteArray::number(mID);
 #ifndef __JAMTEST__
     JackTrip jacktrip(JackTrip::SERVERPINGSERVER, JackTrip::UDP, mNumChans, 2);
 #endif
@@ -149,6 +151,10 @@ void JackTripWorker::run()
     jacktrip.setPeerAddress(ClientAddress.toString().toLatin1().constData());
     jacktrip.setBindPorts(mServerPort);
     //jacktrip.setPeerPorts(mClientPort);
+#ifndef __NO_JACK__
+    jacktrip.setAudiointerfaceMode(JackTrip::JACK_BRIDGE);
+    jacktrip.setClientName(PortGroupName.constData());
+#endif
 
     cout << "---> JackTripWorker: setJackTripFromClientHeader..." << endl;
     int PeerConnectionMode = setJackTripFromClientHeader(jacktrip);
@@ -256,6 +262,12 @@ int JackTripWorker::setJackTripFromClientHeader(JackTrip& jacktrip)
   cout << "--->JackTripWorker: getPeerConnectionMode = " << PeerConnectionMode << endl;
 
   jacktrip.setNumChannels(PeerNumChannels);
+  // Send the audio with the client settings, so the client doesn't have to
+  // convert it (the server converts what it receives from the client)
+  jacktrip.setSendAudioSettings(
+      AudioInterface::getSampleRateFromType
+      ( static_cast<AudioInterface::samplingRateT>(PeerSamplingRate) ),
+      PeerBufferSize);
   return PeerConnectionMode;
 }
 
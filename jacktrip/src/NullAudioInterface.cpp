@@ -0,0 +1,443 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+
+/**
+ * \file NullAudioInterface.cpp
+ * \date October 2026
+ */
+
+#include "NullAudioInterface.h"
+#include "PacketHeader.h"
+
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <stdexcept>
+
+#if defined ( __LINUX__ )
+#include <time.h>
+#endif
+
+using std::cout; using std::endl;
+
+/// Level of the input generators (-12 dBFS)
+const double gNullAudioGeneratorLevel = 0.25;
+/// Default frequency of the sine generator, in Hz
+const double gNullAudioSineFrequency = 440.0;
+
+
+//*******************************************************************************
+// Monotonic time in nanoseconds
+static double monotonicNsec()
+{
+#if defined ( __LINUX__ )
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ( static_cast<double>(now.tv_sec) * 1.0e9 ) + now.tv_nsec;
+#else
+  return static_cast<double>(PacketHeader::usecTime()) * 1.0e3;
+#endif
+}
+
+
+//*******************************************************************************
+// Little endian integers of the WAV files
+static uint32_t readLE(const uint8_t* bytes, int size)
+{
+  uint32_t value = 0;
+  for (int i = size-1; i >= 0; i--) { value = (value << 8) | bytes[i]; }
+  return value;
+}
+
+static void writeLE(uint8_t* bytes, uint32_t value, int size)
+{
+  for (int i = 0; i < size; i++) { bytes[i] = static_cast<uint8_t>(value >> (8*i)); }
+}
+
+
+//*******************************************************************************
+NullAudioInterface::NullAudioInterface(JackTrip* jacktrip,
+                                       int NumInChans, int NumOutChans,
+                                       audioBitResolutionT AudioBitResolution) :
+  AudioInterface(jacktrip,
+                 NumInChans, NumOutChans,
+                 AudioBitResolution),
+  mInputSpec("silence"),
+  mSpeed(1.0),
+  mStopped(true),
+  mInputMode(SILENCE),
+  mSineFrequency(gNullAudioSineFrequency),
+  mSinePhase(0.0),
+  mNoiseState(1),
+  mInputFile(NULL),
+  mInputChannels(0),
+  mInputBytesPerSample(0),
+  mInputFloat(false),
+  mInputDataStart(0),
+  mInputDataSize(0),
+  mInputDataLeft(0),
+  mOutputFile(NULL),
+  mOutputDataSize(0)
+{}
+
+
+//*******************************************************************************
+NullAudioInterface::~NullAudioInterface()
+{
+  stopProcess();
+  if ( mInputFile != NULL ) { std::fclose(mInputFile); }
+  closeOutputFile();
+  for (int i = 0; i < mInBuffer.size(); i++) { delete[] mInBuffer[i]; }
+  for (int i = 0; i < mOutBuffer.size(); i++) { delete[] mOutBuffer[i]; }
+}
+
+
+//*******************************************************************************
+void NullAudioInterface::setup()
+{
+  AudioInterface::setup();
+
+  int nframes = getBufferSizeInSamples();
+  mInBuffer.resize(getNumInputChannels());
+  for (int i = 0; i < getNumInputChannels(); i++) {
+    mInBuffer[i] = new sample_t[nframes];
+    std::memset(mInBuffer[i], 0, sizeof(sample_t) * nframes);
+  }
+  mOutBuffer.resize(getNumOutputChannels());
+  for (int i = 0; i < getNumOutputChannels(); i++) {
+    mOutBuffer[i] = new sample_t[nframes];
+    std::memset(mOutBuffer[i], 0, sizeof(sample_t) * nframes);
+  }
+
+  // Input source
+  const char* input = mInputSpec.constData();
+  if ( (input[0] == '\0') || (std::strcmp(input, "silence") == 0) ) {
+    mInputMode = SILENCE;
+  }
+  else if ( std::strncmp(input, "sine", 4) == 0 ) {
+    mInputMode = SINE;
+    if ( input[4] == ':' ) { mSineFrequency = std::atof(input + 5); }
+    else if ( input[4] != '\0' ) { throw std::runtime_error("Invalid sine generator frequency"); }
+  }
+  else if ( std::strcmp(input, "noise") == 0 ) {
+    mInputMode = NOISE;
+  }
+  else {
+    mInputMode = WAVFILE;
+    openInputFile();
+  }
+  if ( mOutputPath.size() > 0 ) { openOutputFile(); }
+  // Room for one period of the input or output file
+  int input_bytes = nframes * mInputChannels * mInputBytesPerSample;
+  int output_bytes = nframes * getNumOutputChannels() * 4;
+  mFileBuffer.resize( (input_bytes > output_bytes) ? input_bytes : output_bytes );
+
+  cout << "Null audio: " << getSampleRate() << " Hz, " << nframes << " samples per period, ";
+  if ( mSpeed > 0.0 ) { cout << mSpeed << " times real time" << endl; }
+  else { cout << "as fast as possible" << endl; }
+  cout << "Input: " << input << ", output: "
+       << ((mOutputPath.size() > 0) ? mOutputPath.constData() : "discarded") << endl;
+  cout << gPrintSeparator << endl;
+}
+
+
+//*******************************************************************************
+void NullAudioInterface::openInputFile()
+{
+  mInputFile = std::fopen(mInputSpec.constData(), "rb");
+  if ( mInputFile == NULL ) {
+    throw std::runtime_error("Could not open the audio input file");
+  }
+
+  uint8_t header[12];
+  if ( (std::fread(header, 1, 12, mInputFile) != 12) ||
+       (std::memcmp(header, "RIFF", 4) != 0) || (std::memcmp(header + 8, "WAVE", 4) != 0) ) {
+    throw std::runtime_error("The audio input file is not a WAV file");
+  }
+
+  // Walk the chunks until the samples, after the format
+  int format = 0;
+  uint32_t sample_rate = 0;
+  uint8_t chunk[8];
+  while ( std::fread(chunk, 1, 8, mInputFile) == 8 ) {
+    uint32_t chunk_size = readLE(chunk + 4, 4);
+    if ( std::memcmp(chunk, "fmt ", 4) == 0 ) {
+      uint8_t fmt[40];
+      std::memset(fmt, 0, sizeof(fmt));
+      uint32_t fmt_size = (chunk_size < sizeof(fmt)) ? chunk_size : sizeof(fmt);
+      if ( std::fread(fmt, 1, fmt_size, mInputFile) != fmt_size ) { break; }
+      format = readLE(fmt, 2);
+      // WAVE_FORMAT_EXTENSIBLE, the format is in the sub-format GUID
+      if ( (format == 0xFFFE) && (fmt_size >= 26) ) { format = readLE(fmt + 24, 2); }
+      mInputChannels = readLE(fmt + 2, 2);
+      sample_rate = readLE(fmt + 4, 4);
+      mInputBytesPerSample = readLE(fmt + 14, 2) / 8;
+      std::fseek(mInputFile, (chunk_size - fmt_size) + (chunk_size & 1), SEEK_CUR);
+    }
+    else if ( std::memcmp(chunk, "data", 4) == 0 ) {
+      mInputDataStart = std::ftell(mInputFile);
+      mInputDataSize = chunk_size;
+      break;
+    }
+    else {
+      std::fseek(mInputFile, chunk_size + (chunk_size & 1), SEEK_CUR);
+    }
+  }
+
+  mInputFloat = (format == 3);
+  if ( (mInputDataStart == 0) || (mInputChannels <= 0) ||
+       !( ((format == 1) && (mInputBytesPerSample >= 1) && (mInputBytesPerSample <= 4)) ||
+          (mInputFloat && (mInputBytesPerSample == 4)) ) ) {
+    throw std::runtime_error("The audio input file is not a PCM or 32 bit float WAV file");
+  }
+  // Whole frames only
+  mInputDataSize -= mInputDataSize % (mInputChannels * mInputBytesPerSample);
+  if ( mInputDataSize == 0 ) {
+    throw std::runtime_error("The audio input file is empty");
+  }
+  mInputDataLeft = mInputDataSize;
+  if ( sample_rate != getSampleRate() ) {
+    cout << "WARNING: The audio input file sample rate (" << sample_rate
+         << " Hz) is not converted" << endl;
+  }
+}
+
+
+//*******************************************************************************
+void NullAudioInterface::openOutputFile()
+{
+  mOutputFile = std::fopen(mOutputPath.constData(), "wb");
+  if ( mOutputFile == NULL ) {
+    throw std::runtime_error("Could not create the audio output file");
+  }
+
+  // 32 bit float WAV header, the sizes are updated after each period
+  uint32_t channels = getNumOutputChannels();
+  uint8_t header[44];
+  std::memcpy(header, "RIFF", 4);
+  writeLE(header + 4, 36, 4);
+  std::memcpy(header + 8, "WAVEfmt ", 8);
+  writeLE(header + 16, 16, 4);
+  writeLE(header + 20, 3, 2); // WAVE_FORMAT_IEEE_FLOAT
+  writeLE(header + 22, channels, 2);
+  writeLE(header + 24, getSampleRate(), 4);
+  writeLE(header + 28, getSampleRate() * channels * 4, 4);
+  writeLE(header + 32, channels * 4, 2);
+  writeLE(header + 34, 32, 2);
+  std::memcpy(header + 36, "data", 4);
+  writeLE(header + 40, 0, 4);
+  std::fwrite(header, 1, sizeof(header), mOutputFile);
+  mOutputDataSize = 0;
+}
+
+
+//*******************************************************************************
+void NullAudioInterface::writeOutputSizes()
+{
+  uint8_t size[4];
+  writeLE(size, 36 + mOutputDataSize, 4);
+  std::fseek(mOutputFile, 4, SEEK_SET);
+  std::fwrite(size, 1, 4, mOutputFile);
+  writeLE(size, mOutputDataSize, 4);
+  std::fseek(mOutputFile, 40, SEEK_SET);
+  std::fwrite(size, 1, 4, mOutputFile);
+  std::fseek(mOutputFile, 0, SEEK_END);
+  std::fflush(mOutputFile);
+}
+
+
+//*******************************************************************************
+void NullAudioInterface::closeOutputFile()
+{
+  if ( mOutputFile == NULL ) { return; }
+  writeOutputSizes();
+  std::fclose(mOutputFile);
+  mOutputFile = NULL;
+}
+
+
+//*******************************************************************************
+int NullAudioInterface::startProcess() const
+{
+  NullAudioInterface* self = const_cast<NullAudioInterface*>(this);
+  self->mStopped = false;
+  self->start();
+  return 0;
+}
+
+
+//*******************************************************************************
+int NullAudioInterface::stopProcess() const
+{
+  NullAudioInterface* self = const_cast<NullAudioInterface*>(this);
+  self->mStopped = true;
+  self->wait();
+  return 0;
+}
+
+
+//*******************************************************************************
+void NullAudioInterface::run()
+{
+  unsigned int n_frames = getBufferSizeInSamples();
+  double period = 0.0;
+  if ( mSpeed > 0.0 ) {
+    // Set realtime priority (function in jacktrip_globals.h)
+    set_crossplatform_realtime_priority();
+    period = (static_cast<double>(n_frames) * 1.0e9) / (getSampleRate() * mSpeed);
+  }
+
+  double next_time = monotonicNsec();
+  while ( !mStopped ) {
+    readInput(n_frames);
+    AudioInterface::callback(mInBuffer, mOutBuffer, n_frames);
+    writeOutput(n_frames);
+
+    if ( mSpeed <= 0.0 ) {
+      // Let the network threads run
+      QThread::yieldCurrentThread();
+      continue;
+    }
+
+    // Absolute period times, so they don't drift
+    next_time += period;
+#if defined ( __LINUX__ )
+    struct timespec next;
+    next.tv_sec = static_cast<time_t>(next_time / 1.0e9);
+    next.tv_nsec = static_cast<long>(next_time - (next.tv_sec * 1.0e9));
+    while ( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR ) {}
+#else
+    double wait_nsec = next_time - monotonicNsec();
+    if ( wait_nsec > 0.0 ) { QThread::usleep(static_cast<unsigned long>(wait_nsec / 1.0e3)); }
+#endif
+
+    // If we're more than one period late, restart the clock instead of
+    // processing a burst of periods
+    double now = monotonicNsec();
+    if ( now > (next_time + period) ) { next_time = now; }
+  }
+}
+
+
+//*******************************************************************************
+void NullAudioInterface::readInput(unsigned int n_frames)
+{
+  int num_chans = getNumInputChannels();
+  switch ( mInputMode )
+  {
+  case SILENCE :
+    break;
+
+  case SINE : {
+      double step = (2.0 * M_PI * mSineFrequency) / getSampleRate();
+      for (unsigned int j = 0; j < n_frames; j++) {
+        sample_t value = static_cast<sample_t>(gNullAudioGeneratorLevel * std::sin(mSinePhase));
+        for (int i = 0; i < num_chans; i++) { mInBuffer[i][j] = value; }
+        mSinePhase += step;
+        if ( mSinePhase >= (2.0 * M_PI) ) { mSinePhase -= 2.0 * M_PI; }
+      }
+      break; }
+
+  case NOISE :
+    for (unsigned int j = 0; j < n_frames; j++) {
+      // Linear congruential generator, the same sequence on every run
+      mNoiseState = (mNoiseState * 1664525u) + 1013904223u;
+      sample_t value = static_cast<sample_t>( gNullAudioGeneratorLevel *
+          (static_cast<int32_t>(mNoiseState) / 2147483648.0) );
+      for (int i = 0; i < num_chans; i++) { mInBuffer[i][j] = value; }
+    }
+    break;
+
+  case WAVFILE : {
+      int frame_bytes = mInputChannels * mInputBytesPerSample;
+      unsigned int frames_read = 0;
+      while ( frames_read < n_frames ) {
+        // Loop at the end of the file
+        if ( mInputDataLeft == 0 ) {
+          std::fseek(mInputFile, mInputDataStart, SEEK_SET);
+          mInputDataLeft = mInputDataSize;
+        }
+        uint32_t bytes = (n_frames - frames_read) * frame_bytes;
+        if ( bytes > mInputDataLeft ) { bytes = mInputDataLeft; }
+        size_t got = std::fread(mFileBuffer.data() + (frames_read * frame_bytes), 1, bytes, mInputFile);
+        got -= got % frame_bytes;
+        if ( got == 0 ) { mInputDataLeft = 0; break; } // truncated file
+        mInputDataLeft -= got;
+        frames_read += got / frame_bytes;
+      }
+
+      // Deinterleave, the channels missing in the file are silent
+      for (int i = 0; i < num_chans; i++) {
+        for (unsigned int j = 0; j < n_frames; j++) {
+          sample_t value = 0.0;
+          if ( (i < mInputChannels) && (j < frames_read) ) {
+            const uint8_t* sample = mFileBuffer.data() + (j * frame_bytes) + (i * mInputBytesPerSample);
+            uint32_t bits = readLE(sample, mInputBytesPerSample);
+            if ( mInputFloat ) {
+              std::memcpy(&value, &bits, sizeof(value));
+            }
+            else if ( mInputBytesPerSample == 1 ) {
+              value = (static_cast<int>(bits) - 128) / 128.0f; // 8 bit WAV is unsigned
+            }
+            else {
+              // Sign extend to 32 bits
+              int32_t integer = static_cast<int32_t>(bits << (32 - (8 * mInputBytesPerSample)));
+              value = static_cast<sample_t>(integer / 2147483648.0);
+            }
+          }
+          mInBuffer[i][j] = value;
+        }
+      }
+      break; }
+  }
+}
+
+
+//*******************************************************************************
+void NullAudioInterface::writeOutput(unsigned int n_frames)
+{
+  if ( mOutputFile == NULL ) { return; }
+  int num_chans = getNumOutputChannels();
+  uint8_t* frame = mFileBuffer.data();
+  for (unsigned int j = 0; j < n_frames; j++) {
+    for (int i = 0; i < num_chans; i++) {
+      uint32_t bits;
+      std::memcpy(&bits, &mOutBuffer[i][j], sizeof(bits));
+      writeLE(frame, bits, 4);
+      frame += 4;
+    }
+  }
+  mOutputDataSize += std::fwrite(mFileBuffer.data(), 1, n_frames * num_chans * 4, mOutputFile);
+  // The file stays valid if the process is killed (Ctrl-C doesn't run the destructor)
+  writeOutputSizes();
+}
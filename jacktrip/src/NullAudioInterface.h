@@ -0,0 +1,162 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+
+/**
+ * \file NullAudioInterface.h
+ * \date October 2026
+ */
+
+#ifndef __NULLAUDIOINTERFACE_H__
+#define __NULLAUDIOINTERFACE_H__
+
+#include <cstdio>
+#include <stdint.h>
+
+#include <QThread>
+#include <QByteArray>
+#include <QVector>
+#include <QVarLengthArray>
+
+#include "AudioInterface.h"
+#include "jacktrip_globals.h"
+class JackTrip; // Forward declaration
+
+
+/** \brief Audio interface without a sound card, driven by a timer
+ *
+ * The process callback runs in its own thread, at the period of the sample
+ * rate and buffer size, scaled by a speed factor (0 runs as fast as
+ * possible). The inputs are read from a WAV file (looped, channel by
+ * channel) or a generator, and the outputs are written to a 32 bit float WAV
+ * file or discarded. This allows headless clients, load bots and reproducible
+ * performance runs without a JACK server or an audio device.
+ *
+ * The input is one of:\n
+ *  - <tt>silence</tt> (default)
+ *  - <tt>sine</tt> or <tt>sine:<frequency></tt>, at -12 dBFS
+ *  - <tt>noise</tt>, white noise at -12 dBFS (the same on every run)
+ *  - the path of a WAV file (8 to 32 bit PCM or 32 bit float)
+ */
+class NullAudioInterface : public QThread, public AudioInterface
+{
+public:
+
+  /** \brief The class constructor
+   * \param jacktrip Pointer to the JackTrip class that connects all classes (mediator)
+   * \param NumInChans Number of Input Channels
+   * \param NumOutChans Number of Output Channels
+   * \param AudioBitResolution Audio Sample Resolutions in bits
+   */
+  NullAudioInterface(JackTrip* jacktrip,
+                     int NumInChans = gDefaultNumInChannels,
+                     int NumOutChans = gDefaultNumOutChannels,
+                     audioBitResolutionT AudioBitResolution = BIT16);
+  /// \brief The class destructor, completes the output file
+  virtual ~NullAudioInterface();
+
+  /** \brief Opens the input and output files
+   * \exception std::runtime_error The files can't be opened or the input
+   * isn't a supported WAV file
+   */
+  virtual void setup();
+  /// \brief Starts the process thread
+  virtual int startProcess() const;
+  /// \brief Stops the process thread
+  virtual int stopProcess() const;
+  /// \brief This has no effect without a sound card
+  virtual void connectDefaultPorts() {}
+
+  //--------------SETTERS---------------------------------------------
+  /// \brief This has no effect without a sound card
+  virtual void setClientName(const char* /*ClientName*/) {}
+  /// \brief Set the input: silence, sine[:frequency], noise or a WAV file
+  void setInput(const char* input)
+  { mInputSpec = input; }
+  /// \brief Set the output WAV file, empty to discard the output
+  void setOutput(const char* output)
+  { mOutputPath = output; }
+  /// \brief Set the speed, in times real time (0 runs as fast as possible)
+  void setSpeed(double speed)
+  { mSpeed = speed; }
+  //------------------------------------------------------------------
+
+protected:
+  /// \brief Process thread, runs the callback once per period
+  virtual void run();
+
+private:
+  /// \brief Input sources
+  enum inputModeT {
+    SILENCE, ///< Silent inputs
+    SINE, ///< Sine generator
+    NOISE, ///< White noise generator
+    WAVFILE ///< WAV file
+  };
+
+  /// \brief Opens and checks the input WAV file
+  void openInputFile();
+  /// \brief Creates the output WAV file, with an empty data chunk
+  void openOutputFile();
+  /// \brief Writes the sizes of the output WAV file in its header, and flushes it
+  void writeOutputSizes();
+  /// \brief Writes the sizes of the output WAV file and closes it
+  void closeOutputFile();
+  /// \brief Fills the input buffers for one period
+  void readInput(unsigned int n_frames);
+  /// \brief Appends the output buffers of one period to the output file
+  void writeOutput(unsigned int n_frames);
+
+  QByteArray mInputSpec; ///< Input source (see setInput())
+  QByteArray mOutputPath; ///< Output WAV file, empty to discard the output
+  double mSpeed; ///< Speed in times real time, 0 for as fast as possible
+  volatile bool mStopped; ///< Stops the process thread
+
+  inputModeT mInputMode; ///< Input source
+  double mSineFrequency; ///< Sine generator frequency, in Hz
+  double mSinePhase; ///< Sine generator phase, in radians
+  uint32_t mNoiseState; ///< Noise generator state
+  FILE* mInputFile; ///< Input WAV file
+  int mInputChannels; ///< Channels of the input file
+  int mInputBytesPerSample; ///< Bytes per sample of the input file
+  bool mInputFloat; ///< The input file has float samples
+  long mInputDataStart; ///< Offset of the input samples in the file
+  uint32_t mInputDataSize; ///< Size of the input samples, in bytes
+  uint32_t mInputDataLeft; ///< Input bytes left before looping
+  FILE* mOutputFile; ///< Output WAV file
+  uint32_t mOutputDataSize; ///< Size of the output samples, in bytes
+
+  QVarLengthArray<sample_t*> mInBuffer; ///< Vector of Input buffers/channel
+  QVarLengthArray<sample_t*> mOutBuffer; ///< Vector of Output buffer/channel
+  QVector<uint8_t> mFileBuffer; ///< Interleaved samples read from or written to a file
+};
+
+#endif // __NULLAUDIOINTERFACE_H__
@@ -0,0 +1,225 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+
+/**
+ * \file PacketClockAudioInterface.cpp
+ * \date October 2026
+ */
+
+#include "PacketClockAudioInterface.h"
+#include "PacketHeader.h"
+
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+
+#include <QMutexLocker>
+
+#if defined ( __LINUX__ )
+#include <time.h>
+#endif
+
+using std::cout; using std::endl;
+
+
+//*******************************************************************************
+// Monotonic time in nanoseconds
+static double monotonicNsec()
+{
+#if defined ( __LINUX__ )
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ( static_cast<double>(now.tv_sec) * 1.0e9 ) + now.tv_nsec;
+#else
+  return static_cast<double>(PacketHeader::usecTime()) * 1.0e3;
+#endif
+}
+
+
+//*******************************************************************************
+PacketClockAudioInterface::PacketClockAudioInterface(JackTrip* jacktrip,
+                                                     int NumInChans, int NumOutChans,
+                                                     audioBitResolutionT AudioBitResolution) :
+  AudioInterface(jacktrip,
+                 NumInChans, NumOutChans,
+                 AudioBitResolution),
+  mStopped(true),
+  mLocked(false),
+  mNominalPeriod(0.0),
+  mPeriodEstimate(0.0),
+  mExpectedArrival(0.0),
+  mDllB(0.0),
+  mDllC(0.0),
+  mNextPeriodTime(0.0)
+{}
+
+
+//*******************************************************************************
+PacketClockAudioInterface::~PacketClockAudioInterface()
+{
+  stopProcess();
+  for (int i = 0; i < mInBuffer.size(); i++) { delete[] mInBuffer[i]; }
+  for (int i = 0; i < mOutBuffer.size(); i++) { delete[] mOutBuffer[i]; }
+}
+
+
+//*******************************************************************************
+void PacketClockAudioInterface::setup()
+{
+  AudioInterface::setup();
+
+  // Silent inputs and discarded outputs
+  int nframes = getBufferSizeInSamples();
+  mInBuffer.resize(getNumInputChannels());
+  for (int i = 0; i < getNumInputChannels(); i++) {
+    mInBuffer[i] = new sample_t[nframes];
+    std::memset(mInBuffer[i], 0, sizeof(sample_t) * nframes);
+  }
+  mOutBuffer.resize(getNumOutputChannels());
+  for (int i = 0; i < getNumOutputChannels(); i++) {
+    mOutBuffer[i] = new sample_t[nframes];
+    std::memset(mOutBuffer[i], 0, sizeof(sample_t) * nframes);
+  }
+
+  // Second order DLL coefficients, from its bandwidth and the nominal period
+  mNominalPeriod = (static_cast<double>(nframes) * 1.0e9) / getSampleRate();
+  double omega = 2.0 * M_PI * gPacketClockBandwidth * (mNominalPeriod / 1.0e9);
+  mDllB = std::sqrt(2.0) * omega;
+  mDllC = omega * omega;
+  mPeriodEstimate = mNominalPeriod;
+  mLocked = false;
+
+  cout << "Packet clock: " << getSampleRate() << " Hz, " << nframes
+       << " samples per period, following the peer packets" << endl;
+  cout << gPrintSeparator << endl;
+}
+
+
+//*******************************************************************************
+int PacketClockAudioInterface::startProcess() const
+{
+  PacketClockAudioInterface* self = const_cast<PacketClockAudioInterface*>(this);
+  self->mStopped = false;
+  self->start();
+  return 0;
+}
+
+
+//*******************************************************************************
+int PacketClockAudioInterface::stopProcess() const
+{
+  PacketClockAudioInterface* self = const_cast<PacketClockAudioInterface*>(this);
+  self->mStopped = true;
+  self->wait();
+  return 0;
+}
+
+
+//*******************************************************************************
+void PacketClockAudioInterface::slotArrived()
+{
+  double now = monotonicNsec();
+  QMutexLocker locker(&mClockMutex);
+
+  // (Re)start the loop on the first packet, after a long gap, or if the
+  // estimate ran away
+  double error = now - mExpectedArrival;
+  bool runaway = (mPeriodEstimate < (0.5 * mNominalPeriod)) ||
+      (mPeriodEstimate > (2.0 * mNominalPeriod));
+  if ( !mLocked || runaway || (std::fabs(error) > (gPacketClockMaxGap * mPeriodEstimate)) ) {
+    if ( !mLocked || runaway ) { mPeriodEstimate = mNominalPeriod; }
+    mExpectedArrival = now + mPeriodEstimate;
+    mLocked = true;
+    return;
+  }
+
+  // Late, lost and bursts of slots only move the loop by half a period
+  double max_error = 0.5 * mPeriodEstimate;
+  if ( error > max_error ) { error = max_error; }
+  else if ( error < -max_error ) { error = -max_error; }
+  mExpectedArrival += (mDllB * error) + mPeriodEstimate;
+  mPeriodEstimate += mDllC * error;
+}
+
+
+//*******************************************************************************
+void PacketClockAudioInterface::run()
+{
+  // Set realtime priority (function in jacktrip_globals.h)
+  set_crossplatform_realtime_priority();
+
+  mNextPeriodTime = monotonicNsec() + mNominalPeriod;
+  while ( !mStopped ) {
+    waitForNextPeriod();
+    AudioInterface::callback(mInBuffer, mOutBuffer, getBufferSizeInSamples());
+  }
+}
+
+
+//*******************************************************************************
+void PacketClockAudioInterface::waitForNextPeriod()
+{
+#if defined ( __LINUX__ )
+  struct timespec next;
+  next.tv_sec = static_cast<time_t>(mNextPeriodTime / 1.0e9);
+  next.tv_nsec = static_cast<long>(mNextPeriodTime - (next.tv_sec * 1.0e9));
+  while ( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR ) {}
+#else
+  double wait_nsec = mNextPeriodTime - monotonicNsec();
+  if ( wait_nsec > 0.0 ) { QThread::usleep(static_cast<unsigned long>(wait_nsec / 1.0e3)); }
+#endif
+
+  // Next period, at the DLL rate and slewed towards the DLL phase
+  bool locked;
+  double period = mNominalPeriod;
+  double arrival = 0.0;
+  {
+    QMutexLocker locker(&mClockMutex);
+    locked = mLocked;
+    if ( locked ) {
+      period = mPeriodEstimate;
+      arrival = mExpectedArrival;
+    }
+  }
+  double next_time = mNextPeriodTime + period;
+  if ( locked ) {
+    double phase = next_time - (arrival + (gPacketClockOffset * period));
+    phase -= period * std::floor((phase / period) + 0.5);
+    next_time -= phase / gPacketClockPhaseSlew;
+  }
+
+  // If we're more than one period late, restart the clock instead of
+  // processing a burst of periods
+  double now = monotonicNsec();
+  if ( now > (next_time + period) ) { next_time = now + period; }
+  mNextPeriodTime = next_time;
+}
@@ -0,0 +1,122 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+
+/**
+ * \file PacketClockAudioInterface.h
+ * \date October 2026
+ */
+
+#ifndef __PACKETCLOCKAUDIOINTERFACE_H__
+#define __PACKETCLOCKAUDIOINTERFACE_H__
+
+#include <stdint.h>
+
+#include <QThread>
+#include <QMutex>
+#include <QVarLengthArray>
+
+#include "AudioInterface.h"
+#include "jacktrip_globals.h"
+class JackTrip; // Forward declaration
+
+
+/** \brief Audio interface without a sound card, clocked by the peer packets
+ *
+ * Headless nodes (hubs, recorders) don't have an audio clock of their own.
+ * This interface runs the process callback in its own thread, at the times of
+ * the peer packets: JackTrip reports every slot it writes in the receive
+ * RingBuffer (slotArrived()), and a delay-locked loop (DLL) filters their
+ * arrival times into a smooth period and phase. The callback runs a fraction of
+ * a period (gPacketClockOffset) after each expected arrival, so the node runs
+ * in lockstep with its source and the receive queue neither fills nor drains.
+ *
+ * Before the first packet, or when the peer stops sending, the callback runs
+ * at the last period (the nominal one at first). The inputs are silent and the
+ * outputs are discarded, the audio is for the process plugins and the network.
+ */
+class PacketClockAudioInterface : public QThread, public AudioInterface
+{
+public:
+
+  /** \brief The class constructor
+   * \param jacktrip Pointer to the JackTrip class that connects all classes (mediator)
+   * \param NumInChans Number of Input Channels
+   * \param NumOutChans Number of Output Channels
+   * \param AudioBitResolution Audio Sample Resolutions in bits
+   */
+  PacketClockAudioInterface(JackTrip* jacktrip,
+                            int NumInChans = gDefaultNumInChannels,
+                            int NumOutChans = gDefaultNumOutChannels,
+                            audioBitResolutionT AudioBitResolution = BIT16);
+  /// \brief The class destructor
+  virtual ~PacketClockAudioInterface();
+
+  virtual void setup();
+  /// \brief Starts the process thread
+  virtual int startProcess() const;
+  /// \brief Stops the process thread
+  virtual int stopProcess() const;
+  /// \brief This has no effect without a sound card
+  virtual void connectDefaultPorts() {}
+  /** \brief Reports a slot written in the receive RingBuffer. Called by
+   * JackTrip from the network receive thread.
+   */
+  void slotArrived();
+
+  //--------------SETTERS---------------------------------------------
+  /// \brief This has no effect without a sound card
+  virtual void setClientName(const char* /*ClientName*/) {}
+  //------------------------------------------------------------------
+
+protected:
+  /// \brief Process thread, runs the callback once per period
+  virtual void run();
+
+private:
+  /// \brief Waits for the start of the next period, following the DLL
+  void waitForNextPeriod();
+
+  QVarLengthArray<sample_t*> mInBuffer; ///< Vector of Input buffers/channel (silence)
+  QVarLengthArray<sample_t*> mOutBuffer; ///< Vector of Output buffer/channel (discarded)
+  volatile bool mStopped; ///< Stops the process thread
+
+  QMutex mClockMutex; ///< Protects the DLL state, shared with the network thread
+  bool mLocked; ///< The DLL has seen the peer packets
+  double mNominalPeriod; ///< Period from the local settings, in nsec
+  double mPeriodEstimate; ///< DLL period (second order state), in nsec
+  double mExpectedArrival; ///< DLL time of the next slot arrival, in nsec
+  double mDllB; ///< DLL first order coefficient
+  double mDllC; ///< DLL second order coefficient
+  double mNextPeriodTime; ///< Start time of the next period, in nsec
+};
+
+#endif // __PACKETCLOCKAUDIOINTERFACE_H__
@@ -113,8 +113,8 @@ DefaultHeader::DefaultHeader(JackTrip* jacktrip) :
 void DefaultHeader::fillHeaderCommonFromAudio()
 {
   mHeader.TimeStamp = PacketHeader::usecTime();
-  mHeader.BufferSize = mJackTrip->getBufferSizeInSamples();
-  mHeader.SamplingRate = mJackTrip->getSampleRateType ();
+  mHeader.BufferSize = mJackTrip->getSendBufferSizeInSamples();
+  mHeader.SamplingRate = mJackTrip->getSendSampleRateType();
   mHeader.BitResolution = mJackTrip->getAudioBitResolution();
   mHeader.NumChannels = mJackTrip->getNumChannels();
   mHeader.ConnectionMode = static_cast<int>(mJackTrip->getConnectionMode());
@@ -131,28 +131,40 @@ void DefaultHeader::checkPeerSettings(int8_t* full_packet)
   peer_header =  reinterpret_cast<DefaultHeaderStruct*>(full_packet);
 
   // Check Buffer Size
-  if ( peer_header->BufferSize != mHeader.BufferSize ) 
+  // Different buffer sizes are fine, the receiving end re-blocks the peer
+  // packets to its own buffer size (see PacketReblocker)
+  if ( peer_header->BufferSize == 0 )
     {
-      std::cerr << "ERROR: Peer Buffer Size is  : " << peer_header->BufferSize << endl;
-      std::cerr << "       Local Buffer Size is : " << mHeader.BufferSize << endl;
-      std::cerr << "Make sure both machines use same buffer size" << endl;
+      std::cerr << "ERROR: Peer Buffer Size is 0" << endl;
       std::cerr << gPrintSeparator << endl;
       error = true;
     }
+  else if ( peer_header->BufferSize != mJackTrip->getBufferSizeInSamples() )
+    {
+      cout << "Peer Buffer Size is  : " << peer_header->BufferSize << endl;
+      cout << "Local Buffer Size is : " << mJackTrip->getBufferSizeInSamples() << endl;
+      cout << "Peer packets will be re-blocked to the local buffer size" << endl;
+      cout << gPrintSeparator << endl;
+    }
 
   // Check Sampling Rate
-  if ( peer_header->SamplingRate != mHeader.SamplingRate ) 
+  // Different sampling rates are fine, the receiving end converts the peer
+  // audio to its own sampling rate (see SampleRateConverter)
+  int peer_sample_rate = AudioInterface::getSampleRateFromType
+      ( static_cast<AudioInterface::samplingRateT>(peer_header->SamplingRate) );
+  if ( peer_sample_rate == 0 )
   {
-    std::cerr << "ERROR: Peer Sampling Rate is   : " <<
-        AudioInterface::getSampleRateFromType
-        ( static_cast<AudioInterface::samplingRateT>(peer_header->SamplingRate) ) << endl;
-    std::cerr << "       Local Sampling Rate is  : " <<
-        AudioInterface::getSampleRateFromType
-        ( static_cast<AudioInterface::samplingRateT>(mHeader.SamplingRate) ) << endl;
-    std::cerr << "Make sure both machines use the same Sampling Rate" << endl;
+    std::cerr << "ERROR: Peer Sampling Rate is not supported" << endl;
     std::cerr << gPrintSeparator << endl;
     error = true;
   }
+  else if ( peer_sample_rate != mJackTrip->getSampleRate() )
+  {
+    cout << "Peer Sampling Rate is   : " << peer_sample_rate << endl;
+    cout << "Local Sampling Rate is  : " << mJackTrip->getSampleRate() << endl;
+    cout << "Peer audio will be converted to the local Sampling Rate" << endl;
+    cout << gPrintSeparator << endl;
+  }
 
   // Check Audio Bit Resolution
   if ( peer_header->BitResolution != mHeader.BitResolution ) 
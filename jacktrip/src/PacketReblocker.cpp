@@ -0,0 +1,144 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file PacketReblocker.cpp
+ * \date October 2026
+ */
+
+#include "PacketReblocker.h"
+
+#include <cstring>
+#include <stdexcept>
+
+
+//*******************************************************************************
+PacketReblocker::PacketReblocker(int NumChans, int BytesPerSample,
+                                 int LocalFrames, int MaxPeerFrames) :
+  mNumChans(NumChans),
+  mBytesPerSample(BytesPerSample),
+  mLocalFrames(LocalFrames),
+  // Worst case: one frame short of a local slot plus a full peer packet
+  mCapacityFrames(LocalFrames - 1 + MaxPeerFrames),
+  mChannelCapacityBytes(mCapacityFrames * BytesPerSample),
+  mReadFrame(0),
+  mStagedFrames(0),
+  mStagingBytes(0),
+  mStaging(NULL)
+{
+  if ( (NumChans <= 0) || (BytesPerSample <= 0) ||
+       (LocalFrames <= 0) || (MaxPeerFrames <= 0) ) {
+    throw std::invalid_argument("PacketReblocker: invalid audio settings");
+  }
+  mStagingBytes = mNumChans * mChannelCapacityBytes;
+  mStaging = new int8_t[mStagingBytes];
+  std::memset(mStaging, 0, mStagingBytes);
+}
+
+
+//*******************************************************************************
+PacketReblocker::~PacketReblocker()
+{
+  delete[] mStaging;
+}
+
+
+//*******************************************************************************
+bool PacketReblocker::reset(int NumChans, int BytesPerSample, int LocalFrames, int MaxPeerFrames)
+{
+  if ( (NumChans <= 0) || (BytesPerSample <= 0) ||
+       (LocalFrames <= 0) || (MaxPeerFrames <= 0) ) { return false; }
+  int capacity_frames = LocalFrames - 1 + MaxPeerFrames;
+  if ( (NumChans * capacity_frames * BytesPerSample) > mStagingBytes ) { return false; }
+
+  mNumChans = NumChans;
+  mBytesPerSample = BytesPerSample;
+  mLocalFrames = LocalFrames;
+  mCapacityFrames = capacity_frames;
+  mChannelCapacityBytes = capacity_frames * BytesPerSample;
+  mReadFrame = 0;
+  mStagedFrames = 0;
+  return true;
+}
+
+
+//*******************************************************************************
+void PacketReblocker::insertPeerPacket(const int8_t* ptrToAudioPart, int PeerFrames)
+{
+  // If the packet is larger than the capacity, only its newest frames are kept
+  int skip_frames = (PeerFrames > mCapacityFrames) ? (PeerFrames - mCapacityFrames) : 0;
+  int new_frames = PeerFrames - skip_frames;
+
+  // Drop the oldest staged frames if the new ones don't fit
+  int overflow = mStagedFrames + new_frames - mCapacityFrames;
+  if ( overflow > 0 ) {
+    mReadFrame += overflow;
+    mStagedFrames -= overflow;
+  }
+
+  // Move the staged frames to the beginning of the buffers if there's no
+  // space left at the end. This is at most LocalFrames-1 frames per channel.
+  if ( (mReadFrame + mStagedFrames + new_frames) > mCapacityFrames ) {
+    for (int i = 0; i < mNumChans; i++) {
+      int8_t* channel = mStaging + (i*mChannelCapacityBytes);
+      std::memmove(channel, channel + (mReadFrame*mBytesPerSample),
+                   mStagedFrames*mBytesPerSample);
+    }
+    mReadFrame = 0;
+  }
+
+  // Append the new frames, channel by channel
+  int write_offset = (mReadFrame + mStagedFrames) * mBytesPerSample;
+  for (int i = 0; i < mNumChans; i++) {
+    std::memcpy(mStaging + (i*mChannelCapacityBytes) + write_offset,
+                ptrToAudioPart + ((i*PeerFrames) + skip_frames)*mBytesPerSample,
+                new_frames*mBytesPerSample);
+  }
+  mStagedFrames += new_frames;
+}
+
+
+//*******************************************************************************
+bool PacketReblocker::readLocalSlot(int8_t* ptrToReadSlot)
+{
+  if ( mStagedFrames < mLocalFrames ) { return false; }
+
+  int slot_channel_bytes = mLocalFrames * mBytesPerSample;
+  for (int i = 0; i < mNumChans; i++) {
+    std::memcpy(ptrToReadSlot + (i*slot_channel_bytes),
+                mStaging + (i*mChannelCapacityBytes) + (mReadFrame*mBytesPerSample),
+                slot_channel_bytes);
+  }
+  mReadFrame += mLocalFrames;
+  mStagedFrames -= mLocalFrames;
+  if ( mStagedFrames == 0 ) { mReadFrame = 0; }
+  return true;
+}
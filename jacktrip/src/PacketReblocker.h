@@ -0,0 +1,120 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file PacketReblocker.h
+ * \date October 2026
+ */
+
+#ifndef __PACKETREBLOCKER_H__
+#define __PACKETREBLOCKER_H__
+
+#include "jacktrip_types.h"
+
+
+/** \brief Re-blocks the audio part of peer packets into slots of the
+ * local buffer size.
+ *
+ * The audio part of a packet has all the samples of channel 0 first,
+ * then all the samples of channel 1, etc. (see AudioInterface). When the
+ * peer runs with a different period size than the local audio interface,
+ * the receiving end inserts each peer audio part with insertPeerPacket() and
+ * reads local sized slots with readLocalSlot() until it returns false.
+ *
+ * Samples are kept in network (wire) format, so no bit resolution
+ * conversion happens here. A slot is available as soon as enough frames
+ * have arrived, so the only added latency is the one that is mathematically
+ * needed to fill a local buffer (at most <tt>LocalFrames-1</tt> frames
+ * are kept between calls).
+ */
+class PacketReblocker
+{
+public:
+
+  /** \brief The class constructor
+   * \param NumChans Number of audio channels in each packet
+   * \param BytesPerSample Size of one sample in the network, in bytes
+   * \param LocalFrames Local buffer size, in samples
+   * \param MaxPeerFrames Maximum size of a peer packet, in samples
+   */
+  PacketReblocker(int NumChans, int BytesPerSample,
+                  int LocalFrames, int MaxPeerFrames);
+  /// \brief The class destructor
+  virtual ~PacketReblocker();
+
+  /** \brief Insert the audio part of a peer packet
+   *
+   * If inserting the packet would exceed the capacity (which only happens when
+   * the caller doesn't read the available slots), the oldest frames are dropped.
+   * \param ptrToAudioPart Pointer to the audio part of the peer packet
+   * \param PeerFrames Number of frames (samples per channel) in the packet
+   */
+  void insertPeerPacket(const int8_t* ptrToAudioPart, int PeerFrames);
+
+  /** \brief Read a local sized slot, if enough frames are available
+   * \param ptrToReadSlot Pointer to the slot to write. The caller is responsible
+   * to make sure its size is <tt>NumChans*LocalFrames*BytesPerSample</tt>
+   * \return true if a slot was written, false if there are not enough frames yet
+   */
+  bool readLocalSlot(int8_t* ptrToReadSlot);
+
+  /** \brief Sets new audio settings and drops the staged frames, without
+   * allocating: it only works if the staging buffers are large enough
+   * \return false if the staging buffers are too small (nothing is changed)
+   */
+  bool reset(int NumChans, int BytesPerSample, int LocalFrames, int MaxPeerFrames);
+
+  /// \brief Number of frames waiting for the next local slot
+  int getStagedFrames() const { return mStagedFrames; }
+  /// \brief Local buffer size, in samples
+  int getLocalFrames() const { return mLocalFrames; }
+
+  /** \brief Number of local slots that a single peer packet can produce at
+   * once, i.e., the burst the receive queue has to absorb
+   */
+  static int getMaxSlotsPerPacket(int LocalFrames, int PeerFrames)
+  { return (PeerFrames + LocalFrames - 1) / LocalFrames; }
+
+
+private:
+
+  int mNumChans; ///< Number of Channels
+  int mBytesPerSample; ///< Bytes per sample in the network
+  int mLocalFrames; ///< Local buffer size, in samples
+  int mCapacityFrames; ///< Capacity of the staging buffers, in samples
+  int mChannelCapacityBytes; ///< Capacity in bytes of one channel staging buffer
+  int mReadFrame; ///< Read position (in frames) inside the staging buffers
+  int mStagedFrames; ///< Frames available starting at mReadFrame
+  int mStagingBytes; ///< Allocated size of mStaging, in bytes
+  int8_t* mStaging; ///< Staging buffers, one after the other for each channel
+};
+
+#endif // __PACKETREBLOCKER_H__
@@ -55,7 +55,9 @@ RingBuffer::RingBuffer(int SlotSize, int NumSlots) :
   mWritePosition(0),
   mFullSlots(0),
   mRingBuffer(new int8_t[mTotalSize]),
-  mLastReadSlot(new int8_t[mSlotSize])
+  mLastReadSlot(new int8_t[mSlotSize]),
+  mUnderruns(0),
+  mOverflows(0)
 {
   //QMutexLocker locker(&mMutex); // lock the mutex  
   
@@ -200,6 +202,48 @@ void RingBuffer::readSlotNonBlocking(int8_t* ptrToReadSlot)
 }
 
 
+//*******************************************************************************
+bool RingBuffer::readSlotIfAvailable(int8_t* ptrToReadSlot)
+{
+  QMutexLocker locker(&mMutex); // lock the mutex
+
+  if (mFullSlots == 0) { return false; }
+
+  // Copy mSlotSize bytes to ReadSlot
+  std::memcpy(ptrToReadSlot, mRingBuffer+mReadPosition, mSlotSize);
+  // Always save memory of the last read slot
+  std::memcpy(mLastReadSlot, mRingBuffer+mReadPosition, mSlotSize);
+  // Update write position
+  mReadPosition = (mReadPosition+mSlotSize) % mTotalSize;
+  mFullSlots--; //update full slots
+  // Wake threads waitng for bufferIsNotFull condition
+  mBufferIsNotFull.wakeAll();
+  return true;
+}
+
+
+//*******************************************************************************
+void RingBuffer::setNumSlots(int NumSlots)
+{
+  QMutexLocker locker(&mMutex); // lock the mutex
+
+  if ( NumSlots == mNumSlots ) { return; }
+  int8_t* new_ring_buffer = new int8_t[mSlotSize*NumSlots];
+  delete[] mRingBuffer;
+  mRingBuffer = new_ring_buffer;
+  mNumSlots = NumSlots;
+  mTotalSize = mSlotSize*mNumSlots;
+  std::memset(mRingBuffer, 0, mTotalSize); // set buffer to 0
+
+  // Same state as after construction: read at 0, write at half of the RingBuffer
+  mReadPosition = 0;
+  mWritePosition = ( (mNumSlots/2) * mSlotSize ) % mTotalSize;
+  mFullSlots = (mNumSlots/2);
+  mBufferIsNotFull.wakeAll();
+  mBufferIsNotEmpty.wakeAll();
+}
+
+
 //*******************************************************************************
 void RingBuffer::setUnderrunReadSlot(int8_t* ptrToReadSlot)
 {
@@ -226,6 +270,7 @@ void RingBuffer::underrunReset()
   //mFullSlots += mNumSlots/2;
   // There's nothing new to read, so we clear the whole buffer (Set the entire buffer to 0)
   std::memset(mRingBuffer, 0, mTotalSize);
+  mUnderruns++;
 }
 
 
@@ -237,6 +282,7 @@ void RingBuffer::overflowReset()
   //mReadPosition = ( mWritePosition + ( (mNumSlots/2) * mSlotSize ) ) % mTotalSize;
   mReadPosition = ( mReadPosition + ( (mNumSlots/2) * mSlotSize ) ) % mTotalSize;
   mFullSlots -= mNumSlots/2;
+  mOverflows++;
 }
 
 
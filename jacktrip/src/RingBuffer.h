@@ -100,6 +100,34 @@ public:
    */
   void readSlotNonBlocking(int8_t* ptrToReadSlot);
 
+  /** \brief Reads a slot only if there's one available. Unlike
+   * readSlotNonBlocking, an empty buffer is not an under-run: nothing is
+   * read nor reset.
+   *
+   * This is meant for a thread that polls several sources (see the
+   * UdpDataProtocol DUPLEX mode).
+   * \param ptrToReadSlot Pointer to read slot from the RingBuffer
+   * \return true if a slot was read
+   */
+  bool readSlotIfAvailable(int8_t* ptrToReadSlot);
+
+  /** \brief Change the number of slots of the RingBuffer. The buffer is
+   * cleared and set half full, as after construction.
+   *
+   * This is meant to be called once, when the peer settings are known
+   * (e.g., to absorb the bursts of a re-blocked peer), not while audio is
+   * running steadily.
+   * \param NumSlots New number of slots
+   */
+  void setNumSlots(int NumSlots);
+
+  /// \brief Get the number of slots
+  int getNumSlots() const { return mNumSlots; }
+  /// \brief Get the number of non-blocking reads that found the buffer empty
+  unsigned int getUnderruns() const { return mUnderruns; }
+  /// \brief Get the number of non-blocking writes that found the buffer full
+  unsigned int getOverflows() const { return mOverflows; }
+
 
 protected:
 
@@ -127,13 +155,15 @@ private:
   void debugDump() const;
 
   const int mSlotSize; ///< The size of one slot in byes
-  const int mNumSlots; ///< Number of Slots
-  const int mTotalSize; ///< Total size of the mRingBuffer = mSlotSize*mNumSlotss
+  int mNumSlots; ///< Number of Slots
+  int mTotalSize; ///< Total size of the mRingBuffer = mSlotSize*mNumSlotss
   int mReadPosition; ///< Read Positions in the RingBuffer (Tail)
   int mWritePosition; ///< Write Position in the RingBuffer (Head)
   int mFullSlots; ///< Number of used (full) slots, in slot-size
   int8_t* mRingBuffer; ///< 8-bit array of data (1-byte)
   int8_t* mLastReadSlot; ///< Last slot read  
+  unsigned int mUnderruns; ///< Under-runs since construction
+  unsigned int mOverflows; ///< Over-flows since construction
 
   // Thread Synchronization Private Members
   QMutex mMutex; ///< Mutex to protect read and write operations
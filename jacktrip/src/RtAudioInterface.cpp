@@ -40,6 +40,7 @@
 #include "jacktrip_globals.h"
 
 #include <cstdlib>
+#include <stdexcept>
 
 
 using std::cout; using std::endl;
@@ -77,8 +78,7 @@ void RtAudioInterface::setup()
   cout << gPrintSeparator << endl;
   mRtAudio = new RtAudio;
   if ( mRtAudio->getDeviceCount() < 1 ) {
-    cout << "No audio devices found!" << endl;
-    std::exit(0);
+    throw std::runtime_error("No audio devices found!");
   }
 
   // Get and print default devices
@@ -124,8 +124,7 @@ void RtAudioInterface::setup()
                          &RtAudioInterface::wrapperRtAudioCallback, this, &options);
   }
   catch ( RtError& e ) {
-    std::cout << '\n' << e.getMessage() << '\n' << std::endl;
-    exit( 0 );
+    throw std::runtime_error(e.getMessage());
   }
 
   // Setup parent class
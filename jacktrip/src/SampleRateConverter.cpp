@@ -0,0 +1,289 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file SampleRateConverter.cpp
+ * \date October 2026
+ */
+
+#include "SampleRateConverter.h"
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <QMutexLocker>
+
+#if defined (__SSE__)
+#include <xmmintrin.h>
+#endif
+
+QMutex SampleRateConverter::sFilterBankMutex;
+QVector<SampleRateConverter::FilterBank*> SampleRateConverter::sFilterBanks;
+
+
+//*******************************************************************************
+static int greatestCommonDivisor(int a, int b)
+{
+  while ( b != 0 ) {
+    int tmp = a % b;
+    a = b;
+    b = tmp;
+  }
+  return a;
+}
+
+
+//*******************************************************************************
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window
+static double besselI0(double x)
+{
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 50; k++) {
+    term *= (x / (2.0*k)) * (x / (2.0*k));
+    sum += term;
+    if ( term < (1e-12 * sum) ) { break; }
+  }
+  return sum;
+}
+
+
+//*******************************************************************************
+SampleRateConverter::SampleRateConverter(int NumChans, uint32_t InRate, uint32_t OutRate,
+                                         int MaxInFrames, int TapsPerPhase) :
+  mNumChans(NumChans),
+  mMaxInFrames(MaxInFrames),
+  mUpFactor(1),
+  mDownFactor(1),
+  mTapsPerPhase( ((TapsPerPhase + 3) / 4) * 4 ),
+  mFilterBank(NULL),
+  mTime(0)
+{
+  if ( (InRate == 0) || (OutRate == 0) || (NumChans <= 0) || (MaxInFrames <= 0) ) {
+    throw std::invalid_argument("SampleRateConverter: invalid settings");
+  }
+  int gcd = greatestCommonDivisor(OutRate, InRate);
+  mUpFactor = OutRate / gcd;
+  mDownFactor = InRate / gcd;
+  mFilterBank = acquireFilterBank(mUpFactor, mDownFactor, mTapsPerPhase);
+
+  int history_size = (mTapsPerPhase - 1) + mMaxInFrames;
+  int max_out_frames = getMaxOutputFrames(mMaxInFrames);
+  mHistory.resize(mNumChans);
+  mInScratch.resize(mNumChans);
+  mOutScratch.resize(mNumChans);
+  for (int i = 0; i < mNumChans; i++) {
+    mHistory[i] = new sample_t[history_size];
+    std::memset(mHistory[i], 0, sizeof(sample_t) * history_size);
+    mInScratch[i] = new sample_t[mMaxInFrames];
+    mOutScratch[i] = new sample_t[max_out_frames];
+  }
+}
+
+
+//*******************************************************************************
+SampleRateConverter::~SampleRateConverter()
+{
+  for (int i = 0; i < mNumChans; i++) {
+    delete[] mHistory[i];
+    delete[] mInScratch[i];
+    delete[] mOutScratch[i];
+  }
+  releaseFilterBank(mFilterBank);
+}
+
+
+//*******************************************************************************
+int SampleRateConverter::process(const sample_t* const* in, int in_frames, sample_t** out)
+{
+  const int history_length = mTapsPerPhase - 1;
+  const int block_end = in_frames * mUpFactor;
+  int out_frames = 0;
+
+  for (int i = 0; i < mNumChans; i++) {
+    sample_t* history = mHistory[i];
+    std::memcpy(history + history_length, in[i], sizeof(sample_t) * in_frames);
+
+    // history[index] to history[index+TapsPerPhase-1] are the input samples
+    // x[index-TapsPerPhase+1] to x[index] for the filter
+    sample_t* out_channel = out[i];
+    int n = 0;
+    for (int t = mTime; t < block_end; t += mDownFactor) {
+      int index = t / mUpFactor;
+      int phase = t - (index * mUpFactor);
+      out_channel[n++] = dotProduct(mFilterBank->Taps + (phase * mTapsPerPhase),
+                                    history + index, mTapsPerPhase);
+    }
+    out_frames = n;
+
+    // Keep the last samples for the next block
+    std::memmove(history, history + in_frames, sizeof(sample_t) * history_length);
+  }
+
+  // Advance the time to the next output, relative to the next block
+  int steps = (block_end > mTime) ? ((block_end - mTime + mDownFactor - 1) / mDownFactor) : 0;
+  mTime = mTime + (steps * mDownFactor) - block_end;
+  return out_frames;
+}
+
+
+//*******************************************************************************
+int SampleRateConverter::processPacket(const int8_t* in_packet, int in_frames,
+                                       int8_t* out_packet,
+                                       AudioInterface::audioBitResolutionT BitResolution)
+{
+  // Convert from the network bit resolution, process and convert back
+  int bytes_per_sample = static_cast<int>(BitResolution);
+  for (int i = 0; i < mNumChans; i++) {
+    const int8_t* in_channel = in_packet + (i * in_frames * bytes_per_sample);
+    for (int j = 0; j < in_frames; j++) {
+      AudioInterface::fromBitToSampleConversion(in_channel + (j*bytes_per_sample),
+                                                &mInScratch[i][j], BitResolution);
+    }
+  }
+
+  int out_frames = process(mInScratch.data(), in_frames, mOutScratch.data());
+
+  for (int i = 0; i < mNumChans; i++) {
+    int8_t* out_channel = out_packet + (i * out_frames * bytes_per_sample);
+    for (int j = 0; j < out_frames; j++) {
+      AudioInterface::fromSampleToBitConversion(&mOutScratch[i][j],
+                                                out_channel + (j*bytes_per_sample),
+                                                BitResolution);
+    }
+  }
+  return out_frames;
+}
+
+
+//*******************************************************************************
+float SampleRateConverter::dotProduct(const float* taps, const float* samples, int n)
+{
+#if defined (__SSE__)
+  // taps are 16 byte aligned and n is a multiple of 4
+  __m128 sum = _mm_setzero_ps();
+  for (int k = 0; k < n; k += 4) {
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(taps + k), _mm_loadu_ps(samples + k)));
+  }
+  float partial[4];
+  _mm_storeu_ps(partial, sum);
+  return (partial[0] + partial[1]) + (partial[2] + partial[3]);
+#else
+  float sum0 = 0.0, sum1 = 0.0, sum2 = 0.0, sum3 = 0.0;
+  for (int k = 0; k < n; k += 4) {
+    sum0 += taps[k] * samples[k];
+    sum1 += taps[k+1] * samples[k+1];
+    sum2 += taps[k+2] * samples[k+2];
+    sum3 += taps[k+3] * samples[k+3];
+  }
+  return (sum0 + sum1) + (sum2 + sum3);
+#endif
+}
+
+
+//*******************************************************************************
+SampleRateConverter::FilterBank*
+SampleRateConverter::acquireFilterBank(int UpFactor, int DownFactor, int TapsPerPhase)
+{
+  QMutexLocker locker(&sFilterBankMutex);
+  for (int i = 0; i < sFilterBanks.size(); i++) {
+    FilterBank* bank = sFilterBanks[i];
+    if ( (bank->UpFactor == UpFactor) && (bank->DownFactor == DownFactor) &&
+         (bank->TapsPerPhase == TapsPerPhase) ) {
+      bank->RefCount++;
+      return bank;
+    }
+  }
+
+  FilterBank* bank = new FilterBank;
+  bank->UpFactor = UpFactor;
+  bank->DownFactor = DownFactor;
+  bank->TapsPerPhase = TapsPerPhase;
+  bank->RefCount = 1;
+  // Over allocate to align the taps to 16 bytes for SSE loads
+  bank->Memory = new float[(UpFactor * TapsPerPhase) + 4];
+  size_t misalignment = reinterpret_cast<size_t>(bank->Memory) % 16;
+  bank->Taps = bank->Memory + ( (misalignment == 0) ? 0 : (16 - misalignment) / sizeof(float) );
+  designFilterBank(bank);
+  sFilterBanks.append(bank);
+  return bank;
+}
+
+
+//*******************************************************************************
+void SampleRateConverter::releaseFilterBank(FilterBank* bank)
+{
+  QMutexLocker locker(&sFilterBankMutex);
+  if ( --bank->RefCount > 0 ) { return; }
+  for (int i = 0; i < sFilterBanks.size(); i++) {
+    if ( sFilterBanks[i] == bank ) {
+      sFilterBanks.remove(i);
+      break;
+    }
+  }
+  delete[] bank->Memory;
+  delete bank;
+}
+
+
+//*******************************************************************************
+// Kaiser windowed sinc low-pass prototype at the interpolated rate (L*InRate),
+// with the cutoff just under the lowest of the two Nyquist frequencies.
+void SampleRateConverter::designFilterBank(FilterBank* bank)
+{
+  const int L = bank->UpFactor;
+  const int M = bank->DownFactor;
+  const int T = bank->TapsPerPhase;
+  const int length = L * T;
+  const double rolloff = 0.92;
+  const double beta = 8.0; // about 80 dB of stop-band attenuation
+  // Cutoff in cycles per sample of the interpolated rate
+  const double cutoff = 0.5 * rolloff / ( (L > M) ? L : M );
+  const double center = 0.5 * (length - 1);
+  const double i0_beta = besselI0(beta);
+
+  for (int k = 0; k < length; k++) {
+    double x = k - center;
+    double sinc = (x == 0.0) ? 2.0*cutoff
+        : std::sin(2.0*M_PI*cutoff*x) / (M_PI*x);
+    double ratio = x / center;
+    double window = besselI0( beta * std::sqrt(1.0 - (ratio*ratio)) ) / i0_beta;
+    // The gain of L compensates the zeros inserted by the interpolation
+    float tap = static_cast<float>(sinc * window * L);
+
+    // Tap k belongs to phase k%L, and multiplies the sample k/L positions in the past.
+    // Phases store the oldest sample first, to walk the history forward.
+    int phase = k % L;
+    int delay = k / L;
+    bank->Taps[(phase * T) + (T - 1 - delay)] = tap;
+  }
+}
@@ -0,0 +1,141 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+/**
+ * \file SampleRateConverter.h
+ * \date October 2026
+ */
+
+#ifndef __SAMPLERATECONVERTER_H__
+#define __SAMPLERATECONVERTER_H__
+
+#include <QVector>
+#include <QMutex>
+
+#include "AudioInterface.h"
+#include "jacktrip_types.h"
+#include "jacktrip_globals.h"
+
+
+/** \brief Fixed ratio sample rate converter, used to connect peers that run
+ * at different sampling rates.
+ *
+ * The conversion ratio <tt>OutRate/InRate</tt> is reduced to <tt>L/M</tt>, and
+ * the signal is converted with a polyphase FIR filter: a windowed-sinc prototype
+ * of <tt>L*TapsPerPhase</tt> taps split in \b L phases of \b TapsPerPhase taps.
+ * Each output sample is then a single dot product, vectorized with SSE when
+ * available.
+ *
+ * Filter banks only depend on the ratio and the number of taps, so they are
+ * computed once and shared by all the converters that use the same ratio
+ * (e.g., all the 44.1 kHz clients in a 48 kHz server).
+ */
+class SampleRateConverter
+{
+public:
+
+  /** \brief The class constructor
+   * \param NumChans Number of audio channels
+   * \param InRate Input sampling rate, in Hz
+   * \param OutRate Output sampling rate, in Hz
+   * \param MaxInFrames Maximum number of input frames in one call to process
+   * \param TapsPerPhase Number of filter taps per phase (rounded up to a multiple of 4)
+   */
+  SampleRateConverter(int NumChans, uint32_t InRate, uint32_t OutRate,
+                      int MaxInFrames, int TapsPerPhase = gDefaultSrcTapsPerPhase);
+  /// \brief The class destructor
+  virtual ~SampleRateConverter();
+
+  /** \brief Convert one block of audio
+   * \param in Array of input audio samples for each channel, each with in_frames samples
+   * \param in_frames Number of input frames, at most MaxInFrames
+   * \param out Array of output audio samples for each channel. Each channel has
+   * to have space for getMaxOutputFrames(in_frames) samples
+   * \return Number of output frames written
+   */
+  int process(const sample_t* const* in, int in_frames, sample_t** out);
+
+  /** \brief Convert the audio part of a packet, in network (wire) format
+   *
+   * Channels are one after the other, as in the packets (see AudioInterface).
+   * \param in_packet Input audio part, with in_frames samples per channel
+   * \param in_frames Number of input frames, at most MaxInFrames
+   * \param out_packet Output audio part. It has to have space for
+   * getMaxOutputFrames(in_frames) samples per channel
+   * \param BitResolution Bit resolution of the samples in the packets
+   * \return Number of output frames written (per channel)
+   */
+  int processPacket(const int8_t* in_packet, int in_frames, int8_t* out_packet,
+                    AudioInterface::audioBitResolutionT BitResolution);
+
+  /// \brief Maximum number of output frames for in_frames input frames
+  int getMaxOutputFrames(int in_frames) const
+  { return ( (in_frames * mUpFactor) / mDownFactor ) + 1; }
+  /// \brief Latency added by the filter, in input samples
+  int getLatencyInInputSamples() const { return mTapsPerPhase/2; }
+
+
+private:
+
+  /// \brief Filter bank shared by all the converters with the same ratio
+  struct FilterBank
+  {
+    int UpFactor; ///< Interpolation factor L
+    int DownFactor; ///< Decimation factor M
+    int TapsPerPhase; ///< Taps per phase
+    float* Taps; ///< Aligned taps, phase after phase, in reversed order
+    float* Memory; ///< Allocated memory (Taps points inside it)
+    int RefCount; ///< Number of converters using this bank
+  };
+
+  static FilterBank* acquireFilterBank(int UpFactor, int DownFactor, int TapsPerPhase);
+  static void releaseFilterBank(FilterBank* bank);
+  static void designFilterBank(FilterBank* bank);
+  static float dotProduct(const float* taps, const float* samples, int n);
+
+  const int mNumChans; ///< Number of Channels
+  const int mMaxInFrames; ///< Maximum number of input frames per call
+  int mUpFactor; ///< Interpolation factor L
+  int mDownFactor; ///< Decimation factor M
+  int mTapsPerPhase; ///< Taps per phase
+  FilterBank* mFilterBank; ///< Shared filter bank
+  /// Position of the next output sample, in units of 1/L input samples,
+  /// relative to the first sample of the next input block
+  int mTime;
+  QVector<sample_t*> mHistory; ///< Per channel: TapsPerPhase-1 past samples + input block
+  QVector<sample_t*> mInScratch; ///< Per channel input buffers for processPacket
+  QVector<sample_t*> mOutScratch; ///< Per channel output buffers for processPacket
+
+  static QMutex sFilterBankMutex; ///< Protects sFilterBanks
+  static QVector<FilterBank*> sFilterBanks; ///< Filter banks in use
+};
+
+#endif // __SAMPLERATECONVERTER_H__
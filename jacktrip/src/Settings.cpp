@@ -40,12 +40,16 @@
 #include "NetKS.h"
 #include "UdpMasterListener.h"
 #include "JackTripWorker.h"
+#include "HubRoomManager.h"
+#include "JackTripSimulator.h"
 #include "jacktrip_globals.h"
 
 #include <iostream>
 #include <getopt.h> // for command line parsing
 #include <cstdlib>
 
+#include <QHostInfo>
+
 #include "ThreadPoolTest.h"
 
 using std::cout; using std::endl;
@@ -64,13 +68,26 @@ Settings::Settings() :
     mBindPortNum(gDefaultPort), mPeerPortNum(gDefaultPort),
     mClientName(NULL),
     mUnderrrunZero(false),
+    mDuplex(false),
+    mHubUdpJoin(false),
     mLoopBack(false),
     mJamLink(false),
     mEmptyHeader(false),
     mJackTripServer(false),
+    mJackBridge(false),
+    mHubWorkers(0),
+    mHubPool(gHubDefaultSessionPool),
+    mHubForward(false),
+    mHubMeterInterval(0),
     mLocalAddress(gDefaultLocalAddress),
     mRedundancy(1),
     mUseJack(true),
+    mPacketClock(false),
+    mNullAudio(false),
+    mNullAudioInput("silence"),
+    mNullAudioOutput(NULL),
+    mNullAudioSpeed(1.0),
+    mSimulationTrace(NULL),
     mChanfeDefaultSR(false),
     mChanfeDefaultBS(false)
 {}
@@ -104,7 +121,15 @@ void Settings::parseInput(int argc, char** argv)
         { "client", required_argument, NULL, 'c' }, // Run in client mode, set server IP address
         { "localaddress", required_argument, NULL, 'L' }, // set local address e.g., 127.0.0.2 for second instance on same host
         { "jacktripserver", no_argument, NULL, 'S' }, // Run in JamLink mode
+        { "jackbridge", no_argument, NULL, 'k' }, // jacktripserver with JACK ports per client
         { "pingtoserver", required_argument, NULL, 'C' }, // Run in ping to server mode, set server IP address
+        { "room", required_argument, NULL, 'm' }, // Hub server room to join
+        { "udpjoin", no_argument, NULL, 'U' }, // Join the hub server with one UDP request
+        { "hubworkers", required_argument, NULL, 'W' }, // Hub scheduler worker threads
+        { "hubpool", required_argument, NULL, 'p' }, // Hub sessions allocated in advance
+        { "hubtrunk", required_argument, NULL, 't' }, // Trunk to another hub
+        { "hubforward", no_argument, NULL, 'f' }, // Hub relays the packets, clients mix locally
+        { "hubmeters", required_argument, NULL, 'M' }, // Hub level reports
         { "portoffset", required_argument, NULL, 'o' }, // Port Offset from 4464
         { "bindport", required_argument, NULL, 'B' }, // Port Offset from 4464
         { "peerport", required_argument, NULL, 'P' }, // Port Offset from 4464
@@ -112,11 +137,18 @@ void Settings::parseInput(int argc, char** argv)
         { "redundancy", required_argument, NULL, 'r' }, // Redundancy
         { "bitres", required_argument, NULL, 'b' }, // Audio Bit Resolution
         { "zerounderrun", no_argument, NULL, 'z' }, // Use Underrun to Zeros Mode
+        { "duplex", no_argument, NULL, 'd' }, // One socket and thread to send and receive
         { "loopback", no_argument, NULL, 'l' }, // Run in loopback mode
         { "jamlink", no_argument, NULL, 'j' }, // Run in JamLink mode
         { "emptyheader", no_argument, NULL, 'e' }, // Run in JamLink mode
         { "clientname", required_argument, NULL, 'J' }, // Run in JamLink mode
         { "rtaudio", no_argument, NULL, 'R' }, // Run in JamLink mode
+        { "packetclock", no_argument, NULL, 'K' }, // No sound card, clocked by the peer packets
+        { "nullaudio", no_argument, NULL, 'N' }, // No sound card, clocked by a timer
+        { "audioin", required_argument, NULL, 'I' }, // Null audio input source
+        { "audioout", required_argument, NULL, 'O' }, // Null audio output file
+        { "audiospeed", required_argument, NULL, 'X' }, // Null audio speed
+        { "simulate", required_argument, NULL, 'Y' }, // Simulation of a network trace file
         { "srate", required_argument, NULL, 'T' }, // Set Sample Rate
         { "bufsize", required_argument, NULL, 'F' }, // Set buffer Size
         { "version", no_argument, NULL, 'v' }, // Version Number
@@ -129,7 +161,7 @@ void Settings::parseInput(int argc, char** argv)
     /// \todo Specify mandatory arguments
     int ch;
     while ( (ch = getopt_long(argc, argv,
-                              "n:sc:SC:o:B:P:q:r:b:zljeJ:RT:F:vh", longopts, NULL)) != -1 )
+                              "n:sc:SkC:m:UW:p:t:fM:o:B:P:q:r:b:zdljeJ:RKNI:O:X:Y:T:F:vh", longopts, NULL)) != -1 )
         switch (ch) {
 
         case 'n': // Number of input and output channels
@@ -144,6 +176,10 @@ void Settings::parseInput(int argc, char** argv)
             //-------------------------------------------------------
             mJackTripServer = true;
             break;
+        case 'k': // jacktripserver with JACK ports per client
+            //-------------------------------------------------------
+            mJackBridge = true;
+            break;
         case 'c': // Client mode
             //-------------------------------------------------------
             mJackTripMode = JackTrip::CLIENT;
@@ -158,6 +194,46 @@ void Settings::parseInput(int argc, char** argv)
             mJackTripMode = JackTrip::CLIENTTOPINGSERVER;
             mPeerAddress = optarg;
             break;
+        case 'm': // Hub server room
+            //-------------------------------------------------------
+            mHubRoom = optarg;
+            break;
+        case 'U': // Hub join with UDP
+            //-------------------------------------------------------
+            mHubUdpJoin = true;
+            break;
+        case 'W': // Hub scheduler worker threads
+            //-------------------------------------------------------
+            if ( atoi(optarg) < 0 ) {
+                std::cerr << "--hubworkers ERROR: The number of workers can't be negative" << endl;
+                printUsage();
+                std::exit(1); }
+            mHubWorkers = atoi(optarg);
+            break;
+        case 'p': // Hub sessions allocated in advance
+            //-------------------------------------------------------
+            if ( atoi(optarg) < 0 ) {
+                std::cerr << "--hubpool ERROR: The number of sessions can't be negative" << endl;
+                printUsage();
+                std::exit(1); }
+            mHubPool = atoi(optarg);
+            break;
+        case 't': // Trunk to another hub
+            //-------------------------------------------------------
+            mHubTrunks.append(optarg);
+            break;
+        case 'f': // Hub relays the packets, clients mix locally
+            //-------------------------------------------------------
+            mHubForward = true;
+            break;
+        case 'M': // Hub level reports
+            //-------------------------------------------------------
+            if ( atoi(optarg) <= 0 ) {
+                std::cerr << "--hubmeters ERROR: The report interval has to be a positive number of seconds" << endl;
+                printUsage();
+                std::exit(1); }
+            mHubMeterInterval = atoi(optarg);
+            break;
         case 'o': // Port Offset
             //-------------------------------------------------------
             mBindPortNum += atoi(optarg);
@@ -211,6 +287,10 @@ void Settings::parseInput(int argc, char** argv)
             //-------------------------------------------------------
             mUnderrrunZero = true;
             break;
+        case 'd': // duplex
+            //-------------------------------------------------------
+            mDuplex = true;
+            break;
         case 'l': // loopback
             //-------------------------------------------------------
             mLoopBack = true;
@@ -231,6 +311,30 @@ void Settings::parseInput(int argc, char** argv)
             //-------------------------------------------------------
             mUseJack = false;
             break;
+        case 'K': // Packet clock
+            //-------------------------------------------------------
+            mPacketClock = true;
+            break;
+        case 'N': // Null audio
+            //-------------------------------------------------------
+            mNullAudio = true;
+            break;
+        case 'I': // Null audio input
+            //-------------------------------------------------------
+            mNullAudioInput = optarg;
+            break;
+        case 'O': // Null audio output
+            //-------------------------------------------------------
+            mNullAudioOutput = optarg;
+            break;
+        case 'X': // Null audio speed
+            //-------------------------------------------------------
+            mNullAudioSpeed = atof(optarg);
+            break;
+        case 'Y': // Simulation
+            //-------------------------------------------------------
+            mSimulationTrace = optarg;
+            break;
         case 'T': // Sampling Rate
             //-------------------------------------------------------
             mChanfeDefaultSR = true;
@@ -308,16 +412,37 @@ void Settings::printUsage()
     cout << " --peerport        #                      Set only the Peer port number (default to 4464)" << endl;
     cout << " -b, --bitres      # (8, 16, 24, 32)      Audio Bit Rate Resolutions (default 16)" << endl;
     cout << " -z, --zerounderrun                       Set buffer to zeros when underrun occurs (defaults to wavetable)" << endl;
+    cout << " -d, --duplex                             Send and receive with one socket and thread (instead of two)" << endl;
     cout << " -l, --loopback                           Run in Loop-Back Mode" << endl;
     cout << " -j, --jamlink                            Run in JamLink Mode (Connect to a JamLink Box)" << endl;
     cout << " --clientname                             Change default client name (default is JackTrip)" << endl;
     cout << " --localaddress                           Change default local host IP address (127.0.0.1)" << endl;
     cout << endl;
+    cout << "ARGUMENTS FOR THE MULTI-CLIENT SERVER (-S, --jacktripserver):" << endl;
+    cout << "=============================================================" << endl;
+    cout << " --jackbridge                             Create JACK ports for each client (in one shared JACK client), instead of the hub engine" << endl;
+    cout << " -m, --room        <room_name>            Hub room to join, with -C (clients only hear the clients in the same room)" << endl;
+    cout << " -U, --udpjoin                            Join the hub with one UDP request, with -C (instead of the TCP handshake)" << endl;
+    cout << "   --srate         #                      Set the hub engine sampling rate (defaults 48000)" << endl;
+    cout << "   --bufsize       #                      Set the hub engine buffer size (defaults 128)" << endl;
+    cout << "   --hubworkers    #                      Worker threads per hub room, besides the engine thread (defaults 0)" << endl;
+    cout << "   --hubpool       #                      Sessions allocated in advance per hub room (defaults " << gHubDefaultSessionPool << ")" << endl;
+    cout << " -t, --hubtrunk    <host[:port][/room]>   Trunk a room to the same room of another hub (repeat for more, hubs connected as a tree)" << endl;
+    cout << " -f, --hubforward                         Relay each client packets to the other clients, without mixing (clients mix locally)" << endl;
+    cout << " -M, --hubmeters   #                      Print the peak/RMS level of each room mix and client channel every # seconds" << endl;
+    cout << endl;
     cout << "ARGUMENTS TO USE IT WITHOUT JACK:" << endl;
     cout << "=================================" << endl;
     cout << " --rtaudio                                Use defaul sound system instead of Jack" << endl;
-    cout << "   --srate         #                      Set the sampling rate, works on --rtaudio mode only (defaults 48000)" << endl;
-    cout << "   --bufsize       #                      Set the buffer size, works on --rtaudio mode only (defaults 128)" << endl;
+    cout << " --packetclock                            No sound card, run at the rate of the peer packets (silent inputs)" << endl;
+    cout << " --nullaudio                              No sound card, run on a timer (headless clients, load tests)" << endl;
+    cout << "   --audioin       <source>               Input: silence (default), sine[:Hz], noise or a WAV file (looped)" << endl;
+    cout << "   --audioout      <file.wav>             Write the output to a 32 bit float WAV file (discarded by default)" << endl;
+    cout << "   --audiospeed    #                      Speed in times real time, 0 runs as fast as possible (defaults 1)" << endl;
+    cout << "   --srate         #                      Set the sampling rate, works on --rtaudio, --packetclock, --nullaudio and --simulate modes only (defaults 48000)" << endl;
+    cout << "   --bufsize       #                      Set the buffer size, works on --rtaudio, --packetclock, --nullaudio and --simulate modes only (defaults 128)" << endl;
+    cout << " --simulate        <trace file>           Run a sender and a receiver over the network scenarios of the file, in virtual time, and report" << endl;
+    cout << "                                          their under-runs, concealment and latency (with -n, -q, -r, -b, -z, --srate and --bufsize)" << endl;
     cout << endl;
     cout << "HELP ARGUMENTS: " << endl;
     cout << "===============" << endl;
@@ -330,10 +455,60 @@ void Settings::printUsage()
 //*******************************************************************************
 void Settings::startJackTrip()
 {
+    // Simulation in virtual time, without audio or network
+    if ( mSimulationTrace != NULL ) {
+        JackTripSimulator simulator(mNumChans, mBufferQueueLength, mRedundancy,
+                                    mAudioBitResolution,
+                                    mUnderrrunZero ? JackTrip::ZEROS : JackTrip::WAVETABLE,
+                                    mChanfeDefaultSR ? mSampleRate : gDefaultSampleRate,
+                                    mChanfeDefaultBS ? mAudioBufferSize : gDefaultBufferSizeInSamples);
+        simulator.runTraceFile(mSimulationTrace);
+        std::exit(0);
+    }
 
     /// \todo Change this, just here to test
     if ( mJackTripServer ) {
-        UdpMasterListener* udpmaster = new UdpMasterListener;
+        // Several hubs can run on one host with --bindport (or --portoffset)
+        UdpMasterListener* udpmaster = new UdpMasterListener(mBindPortNum);
+        // The clients are handled by one engine per room, unless they get JACK ports
+        if ( !mJackBridge ) {
+            HubRoomManager* hub_room_manager =
+                new HubRoomManager(mChanfeDefaultSR ? mSampleRate : gDefaultSampleRate,
+                                   mChanfeDefaultBS ? mAudioBufferSize : gDefaultBufferSizeInSamples,
+                                   mBufferQueueLength, mHubWorkers, mHubPool, mBindPortNum,
+                                   mHubForward);
+            // Trunks to other hubs, host[:port][/room]
+            for (int i = 0; i < mHubTrunks.size(); i++) {
+                QString host = mHubTrunks[i];
+                QString room;
+                int port = gDefaultPort;
+                int room_start = host.indexOf('/');
+                if ( room_start >= 0 ) {
+                    room = host.mid(room_start + 1);
+                    host.truncate(room_start);
+                }
+                int port_start = host.indexOf(':');
+                if ( port_start >= 0 ) {
+                    port = host.mid(port_start + 1).toInt();
+                    host.truncate(port_start);
+                }
+                quint32 address = 0;
+                QList<QHostAddress> addresses = QHostInfo::fromName(host).addresses();
+                for (int j = 0; j < addresses.size(); j++) {
+                    if ( addresses[j].protocol() == QAbstractSocket::IPv4Protocol ) {
+                        address = addresses[j].toIPv4Address();
+                        break;
+                    }
+                }
+                if ( (address == 0) || (port <= 0) || (port > 65535) ) {
+                    std::cerr << "--hubtrunk ERROR: Can't find the hub " << mHubTrunks[i].toStdString() << endl;
+                    continue;
+                }
+                hub_room_manager->addTrunk(room, address, port);
+            }
+            hub_room_manager->setMeterReportInterval(mHubMeterInterval);
+            udpmaster->setHubRoomManager(hub_room_manager);
+        }
         udpmaster->start();
 
         //---Thread Pool Test--------------------------------------------
@@ -378,6 +553,16 @@ void Settings::startJackTrip()
         if ( mJackTripMode == JackTrip::CLIENT || mJackTripMode == JackTrip::CLIENTTOPINGSERVER ) {
             mJackTrip->setPeerAddress(mPeerAddress.toLatin1().data()); }
 
+        // Hub room to join
+        if ( !mHubRoom.isEmpty() ) {
+            mJackTrip->setHubRoom(mHubRoom); }
+
+        // Hub join with one UDP request
+        mJackTrip->setHubUdpJoin(mHubUdpJoin);
+
+        // One thread to send and receive
+        mJackTrip->setDuplex(mDuplex);
+
 //        if(mLocalAddress!=QString()) // default
 //            mJackTrip->setLocalAddress(QHostAddress(mLocalAddress.toLatin1().data()));
 //        else
@@ -409,6 +594,17 @@ void Settings::startJackTrip()
         }
 #endif
 
+        // Set the packet clock
+        if (mPacketClock) {
+            mJackTrip->setAudiointerfaceMode(JackTrip::PACKETCLOCK);
+        }
+
+        // Set the null audio
+        if (mNullAudio) {
+            mJackTrip->setAudiointerfaceMode(JackTrip::NULLAUDIO);
+            mJackTrip->setNullAudio(mNullAudioInput, mNullAudioOutput, mNullAudioSpeed);
+        }
+
         // Chanfe default Sampling Rate
         if (mChanfeDefaultSR) {
             mJackTrip->setSampleRate(mSampleRate);
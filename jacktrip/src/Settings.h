@@ -41,6 +41,8 @@
 
 #include <cstdlib>
 
+#include <QStringList>
+
 #include "DataProtocol.h"
 
 #ifndef __NO_JACK__
@@ -90,14 +92,29 @@ private:
   int mPeerPortNum; ///< Peer Port Number
   char* mClientName; ///< JackClient Name
   bool mUnderrrunZero; ///< Use Underrun to Zero mode
+  bool mDuplex; ///< Send and receive with one DataProtocol
+  bool mHubUdpJoin; ///< Join the hub server with a UDP request instead of TCP
 
   bool mLoopBack; ///< Loop-back mode
   bool mJamLink; ///< JamLink mode
   bool mEmptyHeader; ///< EmptyHeader mode
   bool mJackTripServer; ///< JackTrip Server mode
+  bool mJackBridge; ///< JackTrip Server creates a JACK client per connection
+  QString mHubRoom; ///< Hub server room to join
+  int mHubWorkers; ///< Scheduler worker threads of each hub room
+  int mHubPool; ///< Sessions allocated in advance by each hub room
+  QStringList mHubTrunks; ///< Hubs to trunk to, host[:port][/room]
+  bool mHubForward; ///< Hub rooms relay the client packets instead of mixing them
+  int mHubMeterInterval; ///< Time between two hub level reports, in seconds (0 for none)
   QString mLocalAddress; ///< Local Address
   unsigned int mRedundancy; ///< Redundancy factor for data in the network
   bool mUseJack; ///< Use or not JackAduio
+  bool mPacketClock; ///< Run without a sound card, clocked by the peer packets
+  bool mNullAudio; ///< Run without a sound card, clocked by a timer
+  const char* mNullAudioInput; ///< Null audio input source (silence, sine[:Hz], noise or a WAV file)
+  const char* mNullAudioOutput; ///< Null audio output WAV file, NULL to discard the output
+  double mNullAudioSpeed; ///< Null audio speed, in times real time (0 as fast as possible)
+  const char* mSimulationTrace; ///< Network trace file to simulate, NULL to run normally
   bool mChanfeDefaultSR; ///< Change Default Sampling Rate
   bool mChanfeDefaultBS; ///< Change Default Buffer Size
   unsigned int mSampleRate;
@@ -0,0 +1,238 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+
+
+/**
+ * \file SimulatedLink.cpp
+ * \date October 2026
+ */
+
+#include "SimulatedLink.h"
+#include "JackTrip.h"
+
+#include <cmath>
+#include <cstring>
+
+
+//*******************************************************************************
+SimulatedLink::SimulatedLink(const QVector<SimulatedLinkSegment>& Segments,
+                             uint32_t Seed, double ReorderTime) :
+  mSegments(Segments),
+  mSegment(0),
+  mSegmentEnd(0.0),
+  mRandomState(Seed),
+  mReorderTime(ReorderTime),
+  mNow(0.0),
+  mLastArrival(0.0),
+  mLossBurst(false),
+  mSent(0),
+  mLost(0),
+  mReordered(0)
+{
+  if ( mSegments.isEmpty() ) {
+    SimulatedLinkSegment perfect = { 0.0, 0.0, 0.0, 0.0, 1.0, 0.0 };
+    mSegments.append(perfect);
+  }
+  mSegmentEnd = mSegments[0].Duration;
+}
+
+
+//*******************************************************************************
+const SimulatedLinkSegment& SimulatedLink::currentSegment()
+{
+  // The time only moves forward
+  while ( (mNow >= mSegmentEnd) && (mSegment < (mSegments.size() - 1)) ) {
+    mSegment++;
+    mSegmentEnd += mSegments[mSegment].Duration;
+  }
+  return mSegments[mSegment];
+}
+
+
+//*******************************************************************************
+double SimulatedLink::random()
+{
+  // Same linear congruential generator on every platform
+  mRandomState = (mRandomState * 1664525) + 1013904223;
+  return static_cast<double>((mRandomState >> 8) + 1) / 16777216.0;
+}
+
+
+//*******************************************************************************
+void SimulatedLink::send(const char* buf, int n)
+{
+  const SimulatedLinkSegment& segment = currentSegment();
+  mSent++;
+
+  // Gilbert model: the bursts last BurstLength datagrams on average, and
+  // start often enough to lose a fraction Loss of the datagrams. Without
+  // bursts each datagram is lost on its own (Bernoulli).
+  double burst_length = segment.BurstLength;
+  double loss_draw = random();
+  if ( burst_length <= 1.0 ) {
+    mLossBurst = ( loss_draw <= segment.Loss );
+  }
+  else if ( mLossBurst ) {
+    mLossBurst = ( loss_draw > (1.0 / burst_length) );
+  }
+  else if ( segment.Loss >= 1.0 ) {
+    mLossBurst = true;
+  }
+  else {
+    mLossBurst = ( loss_draw <= (segment.Loss / (burst_length * (1.0 - segment.Loss))) );
+  }
+  // Draw the delays of every datagram, so a loss doesn't shift the next ones
+  double queueing = -segment.Jitter * std::log(random());
+  bool reorder = ( random() <= segment.Reorder );
+  if ( mLossBurst ) {
+    mLost++;
+    return;
+  }
+
+  // Queueing keeps the order, the reordered datagrams are held back after it
+  double arrival = mNow + segment.Delay + queueing;
+  if ( arrival < mLastArrival ) { arrival = mLastArrival; }
+  if ( reorder ) {
+    arrival += mReorderTime;
+    mReordered++;
+  }
+  else {
+    mLastArrival = arrival;
+  }
+
+  // Insert by arrival time, after the datagrams of the same time
+  Datagram datagram;
+  datagram.Arrival = arrival;
+  datagram.Data = QByteArray(buf, n);
+  int i = mInFlight.size();
+  while ( (i > 0) && (mInFlight[i-1].Arrival > arrival) ) { i--; }
+  mInFlight.insert(i, datagram);
+}
+
+
+
+
+//*******************************************************************************
+SimulatedDataProtocol::SimulatedDataProtocol(JackTrip* jacktrip,
+                                             SimulatedLink* SendLink,
+                                             SimulatedLink* ReceiveLink,
+                                             unsigned int udp_redundancy_factor) :
+  UdpDataProtocol(jacktrip, DataProtocol::DUPLEX, 0, 0, udp_redundancy_factor),
+  mSendLink(SendLink),
+  mReceiveLink(ReceiveLink),
+  mRedundancy(udp_redundancy_factor),
+  mSendPacketSize(0),
+  mSendRedundantPacketSize(0),
+  mSendRedundantPacket(NULL),
+  mReceivePacketSize(0),
+  mReceiveRedundantPacketSize(0),
+  mReceiveRedundantPacket(NULL),
+  mCurrentSeqNum(0),
+  mLastSeqNum(0),
+  mNewerSeqNum(0)
+{}
+
+
+//*******************************************************************************
+SimulatedDataProtocol::~SimulatedDataProtocol()
+{
+  delete[] mSendRedundantPacket;
+  delete[] mReceiveRedundantPacket;
+}
+
+
+//*******************************************************************************
+int SimulatedDataProtocol::receivePacket(QUdpSocket& /*UdpSocket*/, char* buf, const size_t n)
+{
+  int n_bytes = ( static_cast<size_t>(mDatagram.size()) < n ) ? mDatagram.size() : n;
+  std::memcpy(buf, mDatagram.constData(), n_bytes);
+  return n_bytes;
+}
+
+
+//*******************************************************************************
+int SimulatedDataProtocol::sendPacket(QUdpSocket& /*UdpSocket*/,
+                                      const QHostAddress& /*PeerAddress*/,
+                                      const char* buf, const size_t n)
+{
+  if ( mSendLink != NULL ) { mSendLink->send(buf, n); }
+  return n;
+}
+
+
+//*******************************************************************************
+void SimulatedDataProtocol::setup()
+{
+  setupPacketBuffers();
+  mSendPacketSize = setupSendConversion();
+  mSendRedundantPacketSize = mSendPacketSize * mRedundancy;
+  delete[] mSendRedundantPacket;
+  mSendRedundantPacket = new int8_t[mSendRedundantPacketSize];
+  std::memset(mSendRedundantPacket, 0, mSendRedundantPacketSize);
+}
+
+
+//*******************************************************************************
+void SimulatedDataProtocol::sendAudio()
+{
+  sendAvailableAudio(mUnusedSocket, mUnusedAddress, mSendRedundantPacket,
+                     mSendRedundantPacketSize, mSendPacketSize);
+}
+
+
+//*******************************************************************************
+void SimulatedDataProtocol::receiveAudio(double now)
+{
+  while ( (mReceiveLink != NULL) && mReceiveLink->hasDatagram() &&
+          (mReceiveLink->nextArrival() <= now) ) {
+    mDatagram = mReceiveLink->takeDatagram();
+    if ( mReceiveRedundantPacket == NULL ) {
+      // Check that peer has the same audio settings, as the DUPLEX mode does
+      // with its first packet
+      int8_t* first_packet = reinterpret_cast<int8_t*>(mDatagram.data());
+      mJackTrip->checkPeerSettings(first_packet);
+      mReceivePacketSize = setupReceiveConversion(first_packet);
+      mReceiveRedundantPacketSize = mReceivePacketSize * mRedundancy;
+      mReceiveRedundantPacket = new int8_t[mReceiveRedundantPacketSize];
+      std::memset(mReceiveRedundantPacket, 0, mReceiveRedundantPacketSize);
+      continue;
+    }
+    if ( mDatagram.size() < mReceiveRedundantPacketSize ) { continue; }
+    receivePacketRedundancy(mUnusedSocket,
+                            mReceiveRedundantPacket,
+                            mReceiveRedundantPacketSize,
+                            mReceivePacketSize,
+                            mCurrentSeqNum,
+                            mLastSeqNum,
+                            mNewerSeqNum);
+  }
+}
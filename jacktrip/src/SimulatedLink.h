@@ -0,0 +1,201 @@
+//*****************************************************************
+/*
+  JackTrip: A System for High-Quality Audio Network Performance
+  over the Internet
+
+  Copyright (c) 2008 Juan-Pablo Caceres, Chris Chafe.
+  SoundWIRE group at CCRMA, Stanford University.
+  
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation
+  files (the "Software"), to deal in the Software without
+  restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+  OTHER DEALINGS IN THE SOFTWARE.
+*/
+//*****************************************************************
+
+
+
+/**
+ * \file SimulatedLink.h
+ * \date October 2026
+ */
+
+#ifndef __SIMULATEDLINK_H__
+#define __SIMULATEDLINK_H__
+
+#include <stdint.h>
+
+#include <QList>
+#include <QVector>
+#include <QByteArray>
+#include <QUdpSocket>
+#include <QHostAddress>
+
+#include "UdpDataProtocol.h"
+class JackTrip; // Forward declaration
+
+
+/// \brief Network conditions of one part of a simulated link
+struct SimulatedLinkSegment
+{
+  double Duration; ///< Length of the segment, in seconds
+  double Delay; ///< Fixed one-way delay, in seconds
+  double Jitter; ///< Mean of the random queueing delay added to Delay, in seconds
+  double Loss; ///< Fraction of the datagrams lost (0 to 1)
+  double BurstLength; ///< Mean number of datagrams lost in a row, 1 or less for independent (Bernoulli) losses
+  double Reorder; ///< Fraction of the datagrams held back one period (0 to 1)
+};
+
+
+/** \brief One-way network link in virtual time, for JackTripSimulator
+ *
+ * The link keeps the datagrams in flight in memory and delivers them at their
+ * arrival times. The conditions follow a trace of segments: each datagram
+ * gets the fixed delay plus an exponential queueing delay of mean Jitter.
+ * Queueing keeps the datagrams in order (one can't overtake the previous
+ * one), except for the reordered ones, which are held back one period. Losses
+ * follow a two state (Gilbert) model, with the loss rate and mean burst length
+ * of the segment.
+ *
+ * All the random numbers come from one generator seeded in the constructor, so
+ * the same trace and seed always give the same datagram times and losses.
+ */
+class SimulatedLink
+{
+public:
+
+  /** \brief The class constructor
+   * \param Segments Network conditions, one after the other (the last one
+   * holds after the end of the trace)
+   * \param Seed Seed of the random number generator
+   * \param ReorderTime Time the reordered datagrams are held back, in seconds
+   */
+  SimulatedLink(const QVector<SimulatedLinkSegment>& Segments,
+                uint32_t Seed, double ReorderTime);
+
+  /// \brief Set the virtual time of the next datagrams sent, in seconds
+  void setTime(double now)
+  { mNow = now; }
+  /// \brief Send a datagram at the current time, it's lost or put in flight
+  void send(const char* buf, int n);
+  /// \brief Check if there's a datagram in flight
+  bool hasDatagram() const
+  { return !mInFlight.isEmpty(); }
+  /// \brief Get the arrival time of the next datagram, in seconds
+  double nextArrival() const
+  { return mInFlight.at(0).Arrival; }
+  /// \brief Take the next datagram out of the link
+  QByteArray takeDatagram()
+  { return mInFlight.takeFirst().Data; }
+
+  /// \brief Get the number of datagrams sent
+  uint64_t getSent() const { return mSent; }
+  /// \brief Get the number of datagrams lost
+  uint64_t getLost() const { return mLost; }
+  /// \brief Get the number of datagrams held back
+  uint64_t getReordered() const { return mReordered; }
+
+private:
+  /// \brief Datagram in flight
+  struct Datagram {
+    double Arrival; ///< Arrival time, in seconds
+    QByteArray Data; ///< Datagram contents
+  };
+
+  /// \brief Get the segment of the current time
+  const SimulatedLinkSegment& currentSegment();
+  /// \brief Uniform random number in (0, 1]
+  double random();
+
+  QVector<SimulatedLinkSegment> mSegments; ///< Network conditions
+  int mSegment; ///< Index of the current segment
+  double mSegmentEnd; ///< End time of the current segment
+  uint32_t mRandomState; ///< Random number generator state
+  double mReorderTime; ///< Time the reordered datagrams are held back
+  double mNow; ///< Current virtual time
+  double mLastArrival; ///< Arrival time of the last datagram in order
+  bool mLossBurst; ///< The last datagram was lost
+  QList<Datagram> mInFlight; ///< Datagrams in flight, by arrival time
+  uint64_t mSent; ///< Datagrams sent
+  uint64_t mLost; ///< Datagrams lost
+  uint64_t mReordered; ///< Datagrams held back
+};
+
+
+/** \brief UdpDataProtocol that sends and receives through SimulatedLink
+ * objects instead of a socket
+ *
+ * It's a DUPLEX protocol without a thread: JackTripSimulator calls
+ * sendAudio() after each callback of the audio interface, and receiveAudio()
+ * when datagrams arrive. Both go through the same code as the socket loop
+ * (header, redundancy, sequence numbers and the receive RingBuffer), only
+ * sendPacket() and receivePacket() are replaced.
+ */
+class SimulatedDataProtocol : public UdpDataProtocol
+{
+public:
+
+  /** \brief The class constructor
+   * \param jacktrip Pointer to the JackTrip class that connects all classes (mediator)
+   * \param SendLink Link to send to, NULL to discard the packets
+   * \param ReceiveLink Link to receive from, NULL if nothing is received
+   * \param udp_redundancy_factor Number of redundant packets in each datagram
+   */
+  SimulatedDataProtocol(JackTrip* jacktrip,
+                        SimulatedLink* SendLink, SimulatedLink* ReceiveLink,
+                        unsigned int udp_redundancy_factor = 1);
+  /// \brief The class destructor
+  virtual ~SimulatedDataProtocol();
+
+  /// \brief Copies the datagram taken from the receive link
+  virtual int receivePacket(QUdpSocket& UdpSocket, char* buf, const size_t n);
+  /// \brief Does nothing, the simulation sends when it steps (see sendAudio)
+  virtual void wakeUp() {}
+  /// \brief Sends the datagram to the send link
+  virtual int sendPacket(QUdpSocket& UdpSocket, const QHostAddress& PeerAddress,
+                         const char* buf, const size_t n);
+
+  /// \brief Allocates the packets, as the thread of UdpDataProtocol does
+  /// before its loop
+  void setup();
+  /// \brief Sends one packet for each buffer written by the audio interface
+  void sendAudio();
+  /// \brief Receives the datagrams that have arrived up to now (in seconds)
+  void receiveAudio(double now);
+
+private:
+  SimulatedLink* mSendLink; ///< Link to send to, NULL to discard
+  SimulatedLink* mReceiveLink; ///< Link to receive from
+  unsigned int mRedundancy; ///< Number of redundant packets in each datagram
+  QUdpSocket mUnusedSocket; ///< Never bound, only passed along to UdpDataProtocol
+  QHostAddress mUnusedAddress; ///< Only passed along to UdpDataProtocol
+  QByteArray mDatagram; ///< Datagram taken from the receive link
+
+  int mSendPacketSize; ///< Size of the sent packets (header+audio)
+  int mSendRedundantPacketSize; ///< Size of the sent datagrams
+  int8_t* mSendRedundantPacket; ///< Sent datagram
+  int mReceivePacketSize; ///< Size of the received packets, 0 before the first one
+  int mReceiveRedundantPacketSize; ///< Size of the received datagrams
+  int8_t* mReceiveRedundantPacket; ///< Received datagram
+  uint16_t mCurrentSeqNum; ///< Sequence numbers of the redundancy algorithm
+  uint16_t mLastSeqNum; ///< (see UdpDataProtocol::receivePacketRedundancy)
+  uint16_t mNewerSeqNum;
+};
+
+#endif // __SIMULATEDLINK_H__
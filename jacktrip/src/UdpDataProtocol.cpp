@@ -38,6 +38,7 @@
 #include "UdpDataProtocol.h"
 #include "jacktrip_globals.h"
 #include "JackTrip.h"
+#include "HubSocket.h"
 
 #include <QHostInfo>
 
@@ -52,6 +53,11 @@
 #if defined (__LINUX__) || (__MAC__OSX__)
 #include <sys/socket.h> // for POSIX Sockets
 #endif
+#if !defined (__WIN_32__)
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 using std::cout; using std::endl;
 
@@ -70,10 +76,29 @@ DataProtocol(jacktrip, runmode, bind_port, peer_port),
 mBindPort(bind_port), mPeerPort(peer_port),
 mRunMode(runmode),
 mAudioPacket(NULL), mFullPacket(NULL),
-mUdpRedundancyFactor(udp_redundancy_factor)
+mUdpRedundancyFactor(udp_redundancy_factor),
+mPacketReblocker(NULL), mSampleRateConverter(NULL),
+mConvertedPacket(NULL), mSendPacketReblocker(NULL), mSendSampleRateConverter(NULL),
+mSendConvertedPacket(NULL), mReblockedPacket(NULL), mPeerBufferSize(0)
 {
   mStopped = false;
-  if (mRunMode == RECEIVER) {
+  mWakeupPipe[0] = -1;
+  mWakeupPipe[1] = -1;
+#if !defined (__WIN_32__)
+  // The DUPLEX thread sleeps until a packet arrives or the audio interface
+  // writes a buffer, neither end of the pipe blocks
+  if ( mRunMode == DUPLEX ) {
+    if ( ::pipe(mWakeupPipe) == 0 ) {
+      ::fcntl(mWakeupPipe[0], F_SETFL, O_NONBLOCK);
+      ::fcntl(mWakeupPipe[1], F_SETFL, O_NONBLOCK);
+    }
+    else {
+      mWakeupPipe[0] = -1;
+      mWakeupPipe[1] = -1;
+    }
+  }
+#endif
+  if ( (mRunMode == RECEIVER) || (mRunMode == DUPLEX) ) {
     QObject::connect(this, SIGNAL(signalWatingTooLong(int)),
                      jacktrip, SLOT(slotUdpWatingTooLong(int)), Qt::QueuedConnection);
   }
@@ -85,10 +110,63 @@ UdpDataProtocol::~UdpDataProtocol()
 {
   delete[] mAudioPacket;
   delete[] mFullPacket;
+  delete mPacketReblocker;
+  delete mSampleRateConverter;
+  delete[] mConvertedPacket;
+  delete mSendPacketReblocker;
+  delete mSendSampleRateConverter;
+  delete[] mSendConvertedPacket;
+  delete[] mReblockedPacket;
   wait();
+#if !defined (__WIN_32__)
+  if ( mWakeupPipe[0] >= 0 ) { ::close(mWakeupPipe[0]); }
+  if ( mWakeupPipe[1] >= 0 ) { ::close(mWakeupPipe[1]); }
+#endif
 } 
 
 
+//*******************************************************************************
+void UdpDataProtocol::wakeUp()
+{
+#if !defined (__WIN_32__)
+  if ( mWakeupPipe[1] < 0 ) { return; }
+  // A full pipe already has wake-ups the thread hasn't read
+  char byte = 0;
+  if ( ::write(mWakeupPipe[1], &byte, 1) < 0 ) { return; }
+#endif
+}
+
+
+//*******************************************************************************
+void UdpDataProtocol::waitForDuplexEvent(QUdpSocket& UdpSocket, int timeout_usec)
+{
+#if defined (__WIN_32__)
+  // No pipe to wait on, the audio buffers are sent at the next datagram or timeout
+  fd_set read_sockets;
+  FD_ZERO(&read_sockets);
+  FD_SET(UdpSocket.socketDescriptor(), &read_sockets);
+  struct timeval timeout;
+  timeout.tv_sec = timeout_usec / 1000000;
+  timeout.tv_usec = timeout_usec % 1000000;
+  ::select(0, &read_sockets, NULL, NULL, &timeout);
+#else
+  struct pollfd fds[2];
+  fds[0].fd = UdpSocket.socketDescriptor();
+  fds[0].events = POLLIN;
+  fds[0].revents = 0;
+  fds[1].fd = mWakeupPipe[0];
+  fds[1].events = POLLIN;
+  fds[1].revents = 0;
+  int num_fds = (mWakeupPipe[0] >= 0) ? 2 : 1;
+  ::poll(fds, num_fds, (timeout_usec + 999) / 1000);
+  if ( (num_fds == 2) && (fds[1].revents & POLLIN) ) {
+    char bytes[64];
+    while ( ::read(mWakeupPipe[0], bytes, sizeof(bytes)) > 0 ) { }
+  }
+#endif
+}
+
+
 //*******************************************************************************
 void UdpDataProtocol::setPeerAddress(const char* peerHostOrIP) throw(std::invalid_argument)
 {
@@ -201,12 +279,13 @@ void UdpDataProtocol::bindSocket(QUdpSocket& UdpSocket) throw(std::runtime_error
 
   // To be able to use the two UDP sockets bound to the same port number,
   // we connect the receiver and issue a SHUT_WR.
+  // The DUPLEX socket is connected too, but it's used to send as well.
   if (mRunMode == SENDER) {
     // We use the sender as an unconnected UDP socket
     UdpSocket.setSocketDescriptor(sock_fd, QUdpSocket::BoundState,
                                   QUdpSocket::WriteOnly);
   }
-  else if (mRunMode == RECEIVER) {
+  else if ( (mRunMode == RECEIVER) || (mRunMode == DUPLEX) ) {
 #if defined (__LINUX__) || (__MAC_OSX__)
     // Set peer IPv4 Address
     struct sockaddr_in peer_addr;
@@ -221,7 +300,7 @@ void UdpDataProtocol::bindSocket(QUdpSocket& UdpSocket) throw(std::runtime_error
     { throw std::runtime_error("ERROR: Invalid address presentation format"); }
     if ( (::connect(sock_fd, (struct sockaddr *) &peer_addr, sizeof(peer_addr))) < 0)
     { throw std::runtime_error("ERROR: Could not connect UDP socket"); }
-    if ( (::shutdown(sock_fd,SHUT_WR)) < 0)
+    if ( (mRunMode == RECEIVER) && ((::shutdown(sock_fd,SHUT_WR)) < 0) )
     { throw std::runtime_error("ERROR: Could suntdown SHUT_WR UDP socket"); }
 #endif
 #if defined __WIN_32__
@@ -241,16 +320,19 @@ void UdpDataProtocol::bindSocket(QUdpSocket& UdpSocket) throw(std::runtime_error
       throw std::runtime_error("ERROR: Could not connect UDP socket");
     }
     //cout<<"connect returned: "<<con<<endl;
-    int shut_sr = shutdown(sock_fd, SD_SEND);  //shut down sender's receive function
-    if ( shut_sr< 0)
-    {
-      fprintf(stderr, "ERROR: Could not shutdown SD_SEND UDP socket");
-      throw std::runtime_error("ERROR: Could not shutdown SD_SEND UDP socket");
+    if (mRunMode == RECEIVER) {
+      int shut_sr = shutdown(sock_fd, SD_SEND);  //shut down sender's receive function
+      if ( shut_sr< 0)
+      {
+        fprintf(stderr, "ERROR: Could not shutdown SD_SEND UDP socket");
+        throw std::runtime_error("ERROR: Could not shutdown SD_SEND UDP socket");
+      }
     }
 #endif
 
     UdpSocket.setSocketDescriptor(sock_fd, QUdpSocket::ConnectedState,
-                                  QUdpSocket::ReadOnly);
+                                  (mRunMode == DUPLEX) ? QUdpSocket::ReadWrite
+                                                       : QUdpSocket::ReadOnly);
     cout << "UDP Socket Receiving in Port: " << mBindPort << endl;
     cout << gPrintSeparator << endl;
   }
@@ -331,22 +413,10 @@ void UdpDataProtocol::run()
   QHostAddress PeerAddress;
   PeerAddress = mPeerAddress;
 
-  // Setup Audio Packet buffer 
-  size_t audio_packet_size = getAudioPacketSizeInBites();
-  //cout << "audio_packet_size: " << audio_packet_size << endl;
-  mAudioPacket = new int8_t[audio_packet_size];
-  std::memset(mAudioPacket, 0, audio_packet_size); // set buffer to 0
-  
-  // Setup Full Packet buffer
-  int full_packet_size = mJackTrip->getPacketSizeInBytes();
-  //cout << "full_packet_size: " << full_packet_size << endl;
-  mFullPacket = new int8_t[full_packet_size];
-  std::memset(mFullPacket, 0, full_packet_size); // set buffer to 0
+  // Setup Audio Packet and Full Packet buffers
+  int full_packet_size = setupPacketBuffers();
 
   bool timeout = false; // Time out flag for packets that arrive too late
-  
-  // Put header in first packet
-  mJackTrip->putHeaderInPacket(mFullPacket, mAudioPacket);
 
   // Redundancy Variables
   // (Algorithm explained at the end of this file)
@@ -370,10 +440,14 @@ void UdpDataProtocol::run()
       // Wait for the first packet to be ready and obtain address
       // from that packet
       std::cout << "Waiting for Peer..." << std::endl;
-      // This blocks waiting for the first packet
-      while ( !UdpSocket.hasPendingDatagrams() ) {
-        if (mStopped) { return; }
-        QThread::msleep(100);
+      // This blocks waiting for the first packet (a late hub reply is not one)
+      while ( true ) {
+        while ( !UdpSocket.hasPendingDatagrams() ) {
+          if (mStopped) { return; }
+          QThread::msleep(100);
+        }
+        if ( !isControlDatagram(UdpSocket) ) { break; }
+        receiveHubReply(UdpSocket);
       }
       int first_packet_size = UdpSocket.pendingDatagramSize();
       // The following line is the same as
@@ -385,6 +459,15 @@ void UdpDataProtocol::run()
       // Check that peer has the same audio settings
       mJackTrip->checkPeerSettings(first_packet);
       mJackTrip->parseAudioPacket(mFullPacket, mAudioPacket);
+      // Peer packets have a different size if the peer uses another buffer size
+      int peer_packet_size = setupReceiveConversion(first_packet);
+      if ( peer_packet_size != full_packet_size ) {
+        full_packet_size = peer_packet_size;
+        full_redundant_packet_size = full_packet_size * mUdpRedundancyFactor;
+        delete[] full_redundant_packet;
+        full_redundant_packet = new int8_t[full_redundant_packet_size];
+        std::memset(full_redundant_packet, 0, full_redundant_packet_size);
+      }
       std::cout << "Received Connection for Peer!" << std::endl;
       emit signalReceivedConnectionFromPeer();
 
@@ -429,6 +512,16 @@ void UdpDataProtocol::run()
       break; }
 
   case SENDER : {
+      // Packets have a different size if the peer asked for other audio settings
+      int send_packet_size = setupSendConversion();
+      if ( send_packet_size != full_packet_size ) {
+        full_packet_size = send_packet_size;
+        full_redundant_packet_size = full_packet_size * mUdpRedundancyFactor;
+        delete[] full_redundant_packet;
+        full_redundant_packet = new int8_t[full_redundant_packet_size];
+        std::memset(full_redundant_packet, 0, full_redundant_packet_size);
+      }
+      sendHubRegistration(UdpSocket, PeerAddress);
       //----------------------------------------------------------------------------------- 
       while ( !mStopped )
       {
@@ -449,7 +542,239 @@ void UdpDataProtocol::run()
                              full_packet_size);
       }
       break; }
+
+  case DUPLEX : {
+      runDuplex(UdpSocket, PeerAddress);
+      break; }
+  }
+}
+
+
+//*******************************************************************************
+int UdpDataProtocol::setupPacketBuffers()
+{
+  // Setup Audio Packet buffer 
+  // (large enough for the audio sent to the peer, if it uses other settings)
+  size_t audio_packet_size = getAudioPacketSizeInBites();
+  size_t send_audio_packet_size = mJackTrip->getSendAudioPacketSizeInBytes();
+  if ( send_audio_packet_size > audio_packet_size ) {
+    audio_packet_size = send_audio_packet_size; }
+  //cout << "audio_packet_size: " << audio_packet_size << endl;
+  delete[] mAudioPacket;
+  mAudioPacket = new int8_t[audio_packet_size];
+  std::memset(mAudioPacket, 0, audio_packet_size); // set buffer to 0
+  
+  // Setup Full Packet buffer
+  int full_packet_size = mJackTrip->getPacketSizeInBytes();
+  int full_packet_buffer_size = mJackTrip->getHeaderSizeInBytes() + audio_packet_size;
+  //cout << "full_packet_size: " << full_packet_size << endl;
+  delete[] mFullPacket;
+  mFullPacket = new int8_t[full_packet_buffer_size];
+  std::memset(mFullPacket, 0, full_packet_buffer_size); // set buffer to 0
+
+  // Put header in first packet
+  mJackTrip->putHeaderInPacket(mFullPacket, mAudioPacket);
+  return full_packet_size;
+}
+
+
+//*******************************************************************************
+int UdpDataProtocol::sendAvailableAudio(QUdpSocket& UdpSocket,
+                                        QHostAddress& PeerAddress,
+                                        int8_t* full_redundant_packet,
+                                        int full_redundant_packet_size,
+                                        int full_packet_size)
+{
+  int sent = 0;
+  while ( mJackTrip->readAudioBufferIfAvailable(mAudioPacket) ) {
+    sendLocalAudioRedundancy(UdpSocket, PeerAddress, full_redundant_packet,
+                             full_redundant_packet_size, full_packet_size);
+    sent++;
   }
+  return sent;
+}
+
+
+//*******************************************************************************
+void UdpDataProtocol::runDuplex(QUdpSocket& UdpSocket, QHostAddress& PeerAddress)
+{
+  QObject::connect(this, SIGNAL(signalWatingTooLong(int)),
+                   this, SLOT(printUdpWaitedTooLong(int)),
+                   Qt::QueuedConnection);
+
+  // Sending side, same as the SENDER
+  int send_packet_size = setupSendConversion();
+  int send_redundant_packet_size = send_packet_size * mUdpRedundancyFactor;
+  int8_t* send_redundant_packet = new int8_t[send_redundant_packet_size];
+  std::memset(send_redundant_packet, 0, send_redundant_packet_size);
+  sendHubRegistration(UdpSocket, PeerAddress);
+
+  // Receiving side, set up with the first packet of the peer (we don't wait
+  // for it, the peer may be waiting for our packets)
+  int receive_packet_size = 0;
+  int receive_redundant_packet_size = 0;
+  int8_t* receive_redundant_packet = NULL;
+  uint16_t current_seq_num = 0; // Store current sequence number
+  uint16_t last_seq_num = 0;    // Store last package sequence number
+  uint16_t newer_seq_num = 0;   // Store newer sequence number
+
+  // The thread wakes up at least once per period, even if the audio
+  // interface doesn't wake it
+  int period_usec = static_cast<int>( (static_cast<uint64_t>(mJackTrip->getBufferSizeInSamples())
+                                       * 1000000) / mJackTrip->getSampleRate() );
+  int emit_resolution_usec = 10000; // 10 milliseconds
+  uint64_t last_receive_time = 0; // Time of the last packet of the peer
+  int next_emit_usec = emit_resolution_usec;
+  // A hub client asks to resume its session if the audio stops (the hub may
+  // see us at another address), until the hub answers
+  int resume_usec = gHubResumeTime * 1000;
+  int resume_retry_usec = gHubJoinRetryTime * 1000;
+  int next_resume_usec = resume_usec;
+  bool resume_refused = false;
+  std::cout << "Waiting for Peer..." << std::endl;
+
+  while ( !mStopped )
+  {
+    bool idle = true;
+
+    // Send one packet for each buffer the audio interface has written, this
+    // paces the output as the blocking read of the SENDER does
+    if ( sendAvailableAudio(UdpSocket, PeerAddress, send_redundant_packet,
+                            send_redundant_packet_size, send_packet_size) > 0 ) {
+      idle = false;
+    }
+
+    // Receive all the packets that have arrived (the timers of the receiving
+    // side restart once per iteration, even if packets were also sent)
+    bool received = false;
+    while ( UdpSocket.hasPendingDatagrams() ) {
+      if ( !received ) {
+        last_receive_time = PacketHeader::usecTime();
+        next_emit_usec = emit_resolution_usec;
+        next_resume_usec = resume_usec;
+        received = true;
+      }
+      idle = false;
+      if ( receive_redundant_packet == NULL ) {
+        // A late hub reply is not the first packet of the peer
+        if ( isControlDatagram(UdpSocket) ) {
+          if ( receiveHubReply(UdpSocket) < 0 ) { resume_refused = true; }
+          continue;
+        }
+        // Check that peer has the same audio settings, as the RECEIVER
+        int first_packet_size = UdpSocket.pendingDatagramSize();
+        int8_t* first_packet = new int8_t[first_packet_size];
+        receivePacket( UdpSocket, reinterpret_cast<char*>(first_packet), first_packet_size);
+        mJackTrip->checkPeerSettings(first_packet);
+        receive_packet_size = setupReceiveConversion(first_packet);
+        delete[] first_packet;
+        receive_redundant_packet_size = receive_packet_size * mUdpRedundancyFactor;
+        receive_redundant_packet = new int8_t[receive_redundant_packet_size];
+        std::memset(receive_redundant_packet, 0, receive_redundant_packet_size);
+        std::cout << "Received Connection for Peer!" << std::endl;
+        emit signalReceivedConnectionFromPeer();
+        continue;
+      }
+      // receivePacket waits for a datagram large enough, smaller ones would
+      // block the sending side too, so they're dropped (except the hub replies)
+      if ( UdpSocket.pendingDatagramSize() < receive_redundant_packet_size ) {
+        if ( receiveHubReply(UdpSocket) < 0 ) { resume_refused = true; }
+        continue;
+      }
+      receivePacketRedundancy(UdpSocket,
+                              receive_redundant_packet,
+                              receive_redundant_packet_size,
+                              receive_packet_size,
+                              current_seq_num,
+                              last_seq_num,
+                              newer_seq_num);
+    }
+
+    if ( idle ) {
+      waitForDuplexEvent(UdpSocket, period_usec);
+      // Report packets arriving too late, as waitForReady
+      if ( receive_redundant_packet != NULL ) {
+        int waited_usec = static_cast<int>(PacketHeader::usecTime() - last_receive_time);
+        if ( waited_usec >= next_emit_usec ) {
+          emit signalWatingTooLong(waited_usec/1000);
+          next_emit_usec = ((waited_usec / emit_resolution_usec) + 1) * emit_resolution_usec;
+        }
+        if ( (mJackTrip->getHubSessionID() >= 0) && !resume_refused &&
+             (waited_usec >= next_resume_usec) ) {
+          sendHubResume(UdpSocket, PeerAddress);
+          next_resume_usec = waited_usec + resume_retry_usec;
+        }
+      }
+    }
+  }
+
+  delete[] send_redundant_packet;
+  delete[] receive_redundant_packet;
+}
+
+
+//*******************************************************************************
+void UdpDataProtocol::sendHubRegistration(QUdpSocket& UdpSocket, const QHostAddress& PeerAddress)
+{
+  // Hub servers get all the clients in one port, tell the hub which
+  // session our packets belong to (a NAT may change our source port).
+  // It's sent a few times, in case one is lost.
+  if ( mJackTrip->getHubSessionID() < 0 ) { return; }
+  HubRegisterMessage register_message;
+  register_message.Magic = gHubRegisterMagic;
+  register_message.SessionID = mJackTrip->getHubSessionID();
+  register_message.Cookie = mJackTrip->getHubCookie();
+  for (int i = 0; i < 3; i++) {
+    sendPacket( UdpSocket, PeerAddress, reinterpret_cast<char*>(&register_message),
+                sizeof(register_message) );
+  }
+}
+
+
+//*******************************************************************************
+void UdpDataProtocol::sendHubResume(QUdpSocket& UdpSocket, const QHostAddress& PeerAddress)
+{
+  HubRegisterMessage resume_message;
+  resume_message.Magic = gHubResumeMagic;
+  resume_message.SessionID = mJackTrip->getHubSessionID();
+  resume_message.Cookie = mJackTrip->getHubCookie();
+  sendPacket( UdpSocket, PeerAddress, reinterpret_cast<char*>(&resume_message),
+              sizeof(resume_message) );
+}
+
+
+//*******************************************************************************
+bool UdpDataProtocol::isControlDatagram(QUdpSocket& UdpSocket)
+{
+  int size = UdpSocket.pendingDatagramSize();
+  if ( size < mJackTrip->getHeaderSizeInBytes() ) { return true; }
+  if ( size != static_cast<int>(sizeof(HubJoinReply)) ) { return false; }
+  // Peek at the magic number, the datagram stays in the socket
+  uint32_t magic = 0;
+  if ( ::recv(UdpSocket.socketDescriptor(), reinterpret_cast<char*>(&magic),
+              sizeof(magic), MSG_PEEK) != static_cast<int>(sizeof(magic)) ) { return false; }
+  return ( magic == gHubJoinReplyMagic );
+}
+
+
+//*******************************************************************************
+int UdpDataProtocol::receiveHubReply(QUdpSocket& UdpSocket)
+{
+  HubJoinReply reply;
+  int size = UdpSocket.readDatagram(reinterpret_cast<char*>(&reply), sizeof(reply));
+  // (a join challenge arriving late is not an answer to a resume)
+  if ( (size != static_cast<int>(sizeof(reply))) || (reply.Magic != gHubJoinReplyMagic) ||
+       (mJackTrip->getHubSessionID() < 0) || (reply.SessionID == gHubJoinChallengeID) ) {
+    return 0;
+  }
+  if ( reply.SessionID != mJackTrip->getHubSessionID() ) {
+    std::cerr << "Hub Server could not resume the session (it was removed)" << endl;
+    return -1;
+  }
+  // The cookie is bound to the address the hub sees now
+  mJackTrip->setHubCookie(reply.Cookie);
+  cout << "Hub Session ID " << reply.SessionID << " resumed" << endl;
+  return 0;
 }
 
 
@@ -530,6 +855,24 @@ void UdpDataProtocol::receivePacketRedundancy(QUdpSocket& UdpSocket,
 
   // Send to audio all available audio packets, in order
   for (int i = redun_last_index; i>=0; i--) {
+    if ( mPacketReblocker != NULL ) {
+      // Peer packets have a different buffer size or sample rate,
+      // convert and re-block them to local slots
+      int8_t* audio_part = full_redundant_packet + (i*full_packet_size)
+          + mJackTrip->getHeaderSizeInBytes();
+      int num_frames = mPeerBufferSize;
+      if ( mSampleRateConverter != NULL ) {
+        num_frames = mSampleRateConverter->processPacket(
+            audio_part, mPeerBufferSize, mConvertedPacket,
+            static_cast<AudioInterface::audioBitResolutionT>(mJackTrip->getAudioBitResolution()/8));
+        audio_part = mConvertedPacket;
+      }
+      mPacketReblocker->insertPeerPacket(audio_part, num_frames);
+      while ( mPacketReblocker->readLocalSlot(mAudioPacket) ) {
+        mJackTrip->writeAudioBuffer(mAudioPacket);
+      }
+      continue;
+    }
     memcpy(mFullPacket,
            full_redundant_packet + (i*full_packet_size),
            full_packet_size);
@@ -538,6 +881,89 @@ void UdpDataProtocol::receivePacketRedundancy(QUdpSocket& UdpSocket,
   }
 }
 
+
+//*******************************************************************************
+int UdpDataProtocol::setupReceiveConversion(int8_t* first_packet)
+{
+  int local_buffer_size = mJackTrip->getBufferSizeInSamples();
+  int local_sample_rate = mJackTrip->getSampleRate();
+  int peer_buffer_size = mJackTrip->getPeerBufferSize(first_packet);
+  // Headers without buffer size and sample rate information (e.g., JamLink) return 0
+  int peer_sample_rate = AudioInterface::getSampleRateFromType
+      ( static_cast<AudioInterface::samplingRateT>(mJackTrip->getPeerSamplingRate(first_packet)) );
+  if ( peer_sample_rate == 0 ) { peer_sample_rate = local_sample_rate; }
+  if ( (peer_buffer_size == 0) ||
+       ((peer_buffer_size == local_buffer_size) && (peer_sample_rate == local_sample_rate)) ) {
+    return mJackTrip->getPacketSizeInBytes();
+  }
+
+  int bytes_per_sample = mJackTrip->getAudioBitResolution()/8;
+  int num_chans = mJackTrip->getNumChannels();
+  // Largest number of frames that go into the PacketReblocker at once
+  int max_frames = peer_buffer_size;
+  delete mSampleRateConverter;
+  mSampleRateConverter = NULL;
+  if ( peer_sample_rate != local_sample_rate ) {
+    mSampleRateConverter = new SampleRateConverter(num_chans, peer_sample_rate,
+                                                   local_sample_rate, peer_buffer_size);
+    max_frames = mSampleRateConverter->getMaxOutputFrames(peer_buffer_size);
+    delete[] mConvertedPacket;
+    mConvertedPacket = new int8_t[max_frames * bytes_per_sample * num_chans];
+    cout << "Converting peer audio from " << peer_sample_rate << " to "
+         << local_sample_rate << " Hz" << endl;
+  }
+  delete mPacketReblocker;
+  mPacketReblocker = new PacketReblocker(num_chans, bytes_per_sample,
+                                         local_buffer_size, max_frames);
+  mPeerBufferSize = peer_buffer_size;
+  mJackTrip->adaptReceiveQueueToPeer(max_frames);
+  cout << "Re-blocking peer packets from " << peer_buffer_size << " to "
+       << local_buffer_size << " samples" << endl;
+  cout << gPrintSeparator << endl;
+
+  return mJackTrip->getHeaderSizeInBytes() +
+      (peer_buffer_size * bytes_per_sample * num_chans);
+}
+
+
+//*******************************************************************************
+int UdpDataProtocol::setupSendConversion()
+{
+  int local_buffer_size = mJackTrip->getBufferSizeInSamples();
+  int local_sample_rate = mJackTrip->getSampleRate();
+  int send_buffer_size = mJackTrip->getSendBufferSizeInSamples();
+  int send_sample_rate = mJackTrip->getSendSampleRate();
+  if ( (send_buffer_size == local_buffer_size) && (send_sample_rate == local_sample_rate) ) {
+    return mJackTrip->getPacketSizeInBytes();
+  }
+
+  int bytes_per_sample = mJackTrip->getAudioBitResolution()/8;
+  int num_chans = mJackTrip->getNumChannels();
+  // Largest number of frames that go into the PacketReblocker at once
+  int max_frames = local_buffer_size;
+  delete mSendSampleRateConverter;
+  mSendSampleRateConverter = NULL;
+  if ( send_sample_rate != local_sample_rate ) {
+    mSendSampleRateConverter = new SampleRateConverter(num_chans, local_sample_rate,
+                                                   send_sample_rate, local_buffer_size);
+    max_frames = mSendSampleRateConverter->getMaxOutputFrames(local_buffer_size);
+    delete[] mSendConvertedPacket;
+    mSendConvertedPacket = new int8_t[max_frames * bytes_per_sample * num_chans];
+    cout << "Converting audio sent to peer from " << local_sample_rate << " to "
+         << send_sample_rate << " Hz" << endl;
+  }
+  delete mSendPacketReblocker;
+  mSendPacketReblocker = new PacketReblocker(num_chans, bytes_per_sample,
+                                         send_buffer_size, max_frames);
+  delete[] mReblockedPacket;
+  mReblockedPacket = new int8_t[mJackTrip->getSendAudioPacketSizeInBytes()];
+  cout << "Re-blocking packets sent to peer from " << local_buffer_size << " to "
+       << send_buffer_size << " samples" << endl;
+  cout << gPrintSeparator << endl;
+
+  return mJackTrip->getHeaderSizeInBytes() + mJackTrip->getSendAudioPacketSizeInBytes();
+}
+
 //*******************************************************************************
 void UdpDataProtocol::sendPacketRedundancy(QUdpSocket& UdpSocket,
                                            QHostAddress& PeerAddress,
@@ -546,7 +972,53 @@ void UdpDataProtocol::sendPacketRedundancy(QUdpSocket& UdpSocket,
                                            int full_packet_size)
 {
   mJackTrip->readAudioBuffer( mAudioPacket );
-  mJackTrip->putHeaderInPacket(mFullPacket, mAudioPacket);
+  sendLocalAudioRedundancy(UdpSocket, PeerAddress, full_redundant_packet,
+                           full_redundant_packet_size, full_packet_size);
+}
+
+
+//*******************************************************************************
+void UdpDataProtocol::sendLocalAudioRedundancy(QUdpSocket& UdpSocket,
+                                               QHostAddress& PeerAddress,
+                                               int8_t* full_redundant_packet,
+                                               int full_redundant_packet_size,
+                                               int full_packet_size)
+{
+  if ( mSendPacketReblocker == NULL ) {
+    sendAudioPacketRedundancy(UdpSocket, PeerAddress, mAudioPacket,
+                              full_redundant_packet, full_redundant_packet_size,
+                              full_packet_size);
+    return;
+  }
+
+  // The peer asked for other audio settings, convert and re-block the audio.
+  // Each local buffer can produce zero, one or more packets for the peer.
+  int8_t* audio_part = mAudioPacket;
+  int num_frames = mJackTrip->getBufferSizeInSamples();
+  if ( mSendSampleRateConverter != NULL ) {
+    num_frames = mSendSampleRateConverter->processPacket(
+        mAudioPacket, num_frames, mSendConvertedPacket,
+        static_cast<AudioInterface::audioBitResolutionT>(mJackTrip->getAudioBitResolution()/8));
+    audio_part = mSendConvertedPacket;
+  }
+  mSendPacketReblocker->insertPeerPacket(audio_part, num_frames);
+  while ( mSendPacketReblocker->readLocalSlot(mReblockedPacket) ) {
+    sendAudioPacketRedundancy(UdpSocket, PeerAddress, mReblockedPacket,
+                              full_redundant_packet, full_redundant_packet_size,
+                              full_packet_size);
+  }
+}
+
+
+//*******************************************************************************
+void UdpDataProtocol::sendAudioPacketRedundancy(QUdpSocket& UdpSocket,
+                                                QHostAddress& PeerAddress,
+                                                int8_t* audio_packet,
+                                                int8_t* full_redundant_packet,
+                                                int full_redundant_packet_size,
+                                                int full_packet_size)
+{
+  mJackTrip->putHeaderInPacket(mFullPacket, audio_packet);
 
   // Move older packets to end of array of redundant packets
   std::memmove(full_redundant_packet+full_packet_size,
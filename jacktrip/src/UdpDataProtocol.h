@@ -46,6 +46,8 @@
 #include <QMutex>
 
 #include "DataProtocol.h"
+#include "PacketReblocker.h"
+#include "SampleRateConverter.h"
 #include "jacktrip_types.h"
 #include "jacktrip_globals.h"
 
@@ -57,6 +59,10 @@
  * the <tt>bind port</tt> destination port (for incoming packets) and the <tt>peer port</tt>
  * is the source port.
  *
+ * A DUPLEX instance uses one socket and one thread to send and receive. The
+ * <tt>bind port</tt> is the source port of the packets sent and the destination
+ * port of the packets received, and the <tt>peer port</tt> the other way around.
+ *
  * The SENDER and RECEIVER socket can share the same port/address pair (for compatibility
  * with the JamLink boxes). This is achieved setting
  * the resusable property in the socket for address and port. You have to
@@ -71,7 +77,7 @@ public:
   
   /** \brief The class constructor 
    * \param jacktrip Pointer to the JackTrip class that connects all classes (mediator)
-   * \param runmode Sets the run mode, use either SENDER or RECEIVER
+   * \param runmode Sets the run mode, use either SENDER, RECEIVER or DUPLEX
    * \param bind_port Port number to bind for this socket (this is the receive or send port depending on the runmode)
    * \param peer_port Peer port number (this is the receive or send port depending on the runmode)
    * \param udp_redundancy_factor Number of redundant packets
@@ -120,6 +126,11 @@ public:
 					     QHostAddress& peerHostAddress,
                uint16_t& port);
 
+  /** \brief Wakes the DUPLEX thread up to send the buffer the audio
+   * interface just wrote (called from the audio callback, doesn't block)
+   */
+  virtual void wakeUp();
+
   /** \brief Sets the bind port number
     */
   void setBindPort(int port)
@@ -167,6 +178,27 @@ protected:
    */
   bool waitForReady(QUdpSocket& UdpSocket, int timeout_msec);
 
+  /** \brief Allocates mAudioPacket and mFullPacket (large enough for the
+   * audio sent to the peer, if it uses other settings), and puts the header
+   * in the full packet
+   * \return Size in bytes of the full packets (header+audio)
+   */
+  int setupPacketBuffers();
+
+  /** \brief Creates the PacketReblocker if the peer uses a different buffer size,
+   * and the SampleRateConverter if it uses a different sample rate, reading the
+   * peer settings from its first packet
+   * \param first_packet First full packet (header+audio) received from the peer
+   * \return Size in bytes of the full packets (header+audio) the peer sends
+   */
+  int setupReceiveConversion(int8_t* first_packet);
+
+  /** \brief Creates the SampleRateConverter and PacketReblocker if the audio
+   * is sent with other settings than the local ones (see JackTrip::setSendAudioSettings)
+   * \return Size in bytes of the full packets (header+audio) sent to the peer
+   */
+  int setupSendConversion();
+
   /** \brief Redundancy algorythm at the receiving end
     */
   virtual void receivePacketRedundancy(QUdpSocket& UdpSocket,
@@ -185,12 +217,68 @@ protected:
                                     int full_redundant_packet_size,
                                     int full_packet_size);
 
+  /** \brief Thread loop of the DUPLEX mode. It sends a packet as soon as the
+   * audio interface writes a buffer, and receives the packets that have
+   * arrived. In between, it sleeps in waitForDuplexEvent.
+   */
+  void runDuplex(QUdpSocket& UdpSocket, QHostAddress& PeerAddress);
+  /** \brief Blocks until a datagram arrives, the audio interface writes a
+   * buffer (see wakeUp) or the timeout expires
+   * \param timeout_usec Maximum wait, in microseconds
+   */
+  void waitForDuplexEvent(QUdpSocket& UdpSocket, int timeout_usec);
+
+  /// \brief Sends our hub session ID from the socket the audio is sent from,
+  /// if the server is a hub
+  void sendHubRegistration(QUdpSocket& UdpSocket, const QHostAddress& PeerAddress);
+  /// \brief Asks the hub to move our session to the address and port we send
+  /// from now (e.g., after a network change)
+  void sendHubResume(QUdpSocket& UdpSocket, const QHostAddress& PeerAddress);
+  /** \brief True if the next datagram is not an audio packet of the peer: a
+   * hub join reply (it can arrive after the join), or smaller than the header
+   */
+  bool isControlDatagram(QUdpSocket& UdpSocket);
+  /** \brief Reads a datagram smaller than an audio packet: the reply of the
+   * hub to a resume request, anything else is dropped
+   * \return -1 if the hub couldn't resume our session, 0 otherwise
+   */
+  int receiveHubReply(QUdpSocket& UdpSocket);
+
+  /** \brief Sends the local audio buffer in mAudioPacket, converted and
+   * re-blocked if the peer asked for other audio settings
+   */
+  void sendLocalAudioRedundancy(QUdpSocket& UdpSocket,
+                                QHostAddress& PeerAddress,
+                                int8_t* full_redundant_packet,
+                                int full_redundant_packet_size,
+                                int full_packet_size);
+
+  /** \brief Sends one packet for each buffer the audio interface has
+   * written, without blocking
+   * \return Number of buffers sent
+   */
+  int sendAvailableAudio(QUdpSocket& UdpSocket,
+                         QHostAddress& PeerAddress,
+                         int8_t* full_redundant_packet,
+                         int full_redundant_packet_size,
+                         int full_packet_size);
+
+  /** \brief Puts the header in the audio packet, and sends it with the
+   * redundant packets
+   */
+  void sendAudioPacketRedundancy(QUdpSocket& UdpSocket,
+                                 QHostAddress& PeerAddress,
+                                 int8_t* audio_packet,
+                                 int8_t* full_redundant_packet,
+                                 int full_redundant_packet_size,
+                                 int full_packet_size);
+
 
 private:
 
   int mBindPort; ///< Local Port number to Bind
   int mPeerPort; ///< Peer Port number
-  const runModeT mRunMode; ///< Run mode, either SENDER or RECEIVER
+  const runModeT mRunMode; ///< Run mode, either SENDER, RECEIVER or DUPLEX
 
   QHostAddress mPeerAddress; ///< The Peer Address
 
@@ -198,6 +286,15 @@ private:
   int8_t* mFullPacket; ///< Buffer to store Full Packet (audio+header)
 
   unsigned int mUdpRedundancyFactor; ///< Factor of redundancy
+  PacketReblocker* mPacketReblocker; ///< Re-blocks received packets, NULL if buffer sizes match
+  SampleRateConverter* mSampleRateConverter; ///< Converts received audio, NULL if sample rates match
+  int8_t* mConvertedPacket; ///< Audio converted by mSampleRateConverter
+  PacketReblocker* mSendPacketReblocker; ///< Re-blocks sent packets, NULL if buffer sizes match
+  SampleRateConverter* mSendSampleRateConverter; ///< Converts sent audio, NULL if sample rates match
+  int8_t* mSendConvertedPacket; ///< Audio converted by mSendSampleRateConverter
+  int8_t* mReblockedPacket; ///< Audio re-blocked to the peer buffer size (SENDER)
+  int mPeerBufferSize; ///< Peer buffer size, in samples
+  int mWakeupPipe[2]; ///< Pipe that wakes the DUPLEX thread up (read and write ends, -1 if none)
   static QMutex sUdpMutex; ///< Mutex to make thread safe the binding process
 };
 
@@ -39,25 +39,148 @@
 #include <cstdlib>
 #include <stdexcept>
 #include <cstring>
+#include <cerrno>
+#include <algorithm>
 
 #include <QTcpServer>
 #include <QTcpSocket>
 #include <QStringList>
 #include <QMutexLocker>
 
+#if defined (__LINUX__) || (__MAC_OSX__)
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __WIN_32__
+#include <winsock.h>
+typedef int socklen_t;
+#endif
+
 #include "UdpMasterListener.h"
 #include "JackTripWorker.h"
+#include "HubRoomManager.h"
+#include "PacketHeader.h"
 #include "jacktrip_globals.h"
 
 using std::cout; using std::endl;
 
+/// Time a client has to complete its handshake, in milliseconds
+const int gHandshakeTimeout = 5000;
+/// Maximum number of handshakes in progress
+const int gMaxHandshakes = 512;
+/// Maximum wait of the listener loop, to check if the thread was stopped, in milliseconds
+const int gHandshakePollTime = 100;
+/// Time between checks of a client waiting for its old session to be removed, in milliseconds
+const int gHandshakeReleasePollTime = 10;
+/// Flags of the replies (don't raise SIGPIPE if the client is gone)
+#ifdef MSG_NOSIGNAL
+const int gSendFlags = MSG_NOSIGNAL;
+#else
+const int gSendFlags = 0;
+#endif
+
+
+//*******************************************************************************
+static void setSocketNonBlocking(int socket)
+{
+#if defined (__WIN_32__)
+  u_long non_blocking = 1;
+  ioctlsocket(socket, FIONBIO, &non_blocking);
+#else
+  ::fcntl(socket, F_SETFL, ::fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+
+//*******************************************************************************
+// True if the last non-blocking call failed only because it would have blocked
+static bool socketWouldBlock()
+{
+#if defined (__WIN_32__)
+  return ( WSAGetLastError() == WSAEWOULDBLOCK );
+#else
+  return ( (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR) );
+#endif
+}
+
+
+//*******************************************************************************
+/// A socket the listener loop waits on
+struct ListenerSocket
+{
+  int Socket; ///< Native socket
+  bool Read; ///< Wait until it can be read
+  bool Write; ///< Wait until it can be written
+  bool Ready; ///< Returns if it's ready (or failed)
+};
+
+
+//*******************************************************************************
+// Waits until one of the sockets is ready, or for wait_time (in microseconds).
+// Uses poll(), so the socket numbers aren't limited to FD_SETSIZE like select()
+static void waitForSockets(QVector<ListenerSocket>& sockets, uint64_t wait_time)
+{
+#if defined (__WIN_32__)
+  // Windows sets hold up to FD_SETSIZE sockets of any number, the rest only wait
+  // for the timeout
+  fd_set read_sockets, write_sockets;
+  FD_ZERO(&read_sockets);
+  FD_ZERO(&write_sockets);
+  for (int i = 0; i < sockets.size(); i++) {
+    if ( sockets[i].Read ) { FD_SET(sockets[i].Socket, &read_sockets); }
+    if ( sockets[i].Write ) { FD_SET(sockets[i].Socket, &write_sockets); }
+  }
+  struct timeval timeout;
+  timeout.tv_sec = wait_time / 1000000;
+  timeout.tv_usec = wait_time % 1000000;
+  bool failed = ( ::select(0, &read_sockets, &write_sockets, NULL, &timeout) < 0 );
+  for (int i = 0; i < sockets.size(); i++) {
+    sockets[i].Ready = !failed && ( FD_ISSET(sockets[i].Socket, &read_sockets) ||
+                                    FD_ISSET(sockets[i].Socket, &write_sockets) );
+  }
+#else
+  QVector<struct pollfd> fds(sockets.size());
+  for (int i = 0; i < sockets.size(); i++) {
+    fds[i].fd = sockets[i].Socket;
+    fds[i].events = (sockets[i].Read ? POLLIN : 0) | (sockets[i].Write ? POLLOUT : 0);
+    fds[i].revents = 0;
+  }
+  // Interrupted, nothing is ready
+  if ( ::poll(fds.data(), fds.size(), static_cast<int>((wait_time + 999) / 1000)) < 0 ) {
+    for (int i = 0; i < fds.size(); i++) { fds[i].revents = 0; }
+  }
+  for (int i = 0; i < sockets.size(); i++) { sockets[i].Ready = ( fds[i].revents != 0 ); }
+#endif
+}
+
+
+//*******************************************************************************
+static void closeSocket(int socket)
+{
+#if defined (__WIN_32__)
+  closesocket(socket);
+#else
+  ::close(socket);
+#endif
+}
+
 
 //*******************************************************************************
 UdpMasterListener::UdpMasterListener(int server_port) :
     //mJTWorker(NULL),
+    mHubRoomManager(NULL),
     mServerPort(server_port),
+    mActiveAddresses(gMaxThreads, gHubSessionTableReaders),
     mStopped(false),
-    mTotalRunningThreads(0)
+    mTotalRunningThreads(0),
+    mNumJoins(0),
+    mJoinLatencySum(0.0),
+    mJoinLatencyMax(0.0)
 {
   // Register JackTripWorker with the master listener
   //mJTWorker = new JackTripWorker(this);
@@ -69,11 +192,8 @@ UdpMasterListener::UdpMasterListener(int server_port) :
 
   //mJTWorkers = new JackTripWorker(this);
   mThreadPool.setExpiryTimeout(3000); // msec (-1) = forever
-  // Inizialize IP addresses
-  for (int i = 0; i<gMaxThreads; i++) { 
-    mActiveAddress[i][0] = 0; // 32-bit ints
-    mActiveAddress[i][1] = 0; // 32-bit ints
-  }
+  // The workers are spawned without waiting for each other, one thread each
+  mThreadPool.setMaxThreadCount(gMaxThreads);
   // Set the base dynamic port
   // The Dynamic and/or Private Ports are those from 49152 through 65535
   // mBasePort = ( rand() % ( (65535 - gMaxThreads) - 49152 ) ) + 49152;
@@ -86,7 +206,7 @@ UdpMasterListener::UdpMasterListener(int server_port) :
 //*******************************************************************************
 UdpMasterListener::~UdpMasterListener()
 {
-  QMutexLocker lock(&mMutex);
+  delete mHubRoomManager; // stops the engine threads, they release the IDs
   mThreadPool.waitForDone();
   //delete mJTWorker;
   for (int i = 0; i<gMaxThreads; i++) {
@@ -101,209 +221,368 @@ UdpMasterListener::~UdpMasterListener()
 // the client is already on the thread pool, it means that a new connection is
 // requested (the old was desconnected). So we have to remove that thread from
 // the pool and then connect again.
+//
+// All the connections are handled at the same time: the loop waits (poll) on
+// the server socket and on the sockets of the handshakes in progress, and
+// advances the ones that are ready (see HandshakeConnection).
 void UdpMasterListener::run()
 {
   mStopped = false;
 
-  QHostAddress PeerAddress; // Object to store peer address
-  int peer_udp_port; // Peer listening port
-  int server_udp_port; // Server assigned udp port
-
   // Create and bind the TCP server
   // ------------------------------
-  QTcpServer TcpServer;
-  if ( !TcpServer.listen(QHostAddress::Any, mServerPort) ) {
-    std::cerr << "TCP Socket Server ERROR: " << TcpServer.errorString().toStdString() <<  endl;
+  int server_socket = ::socket(AF_INET, SOCK_STREAM, 0);
+  int reuse_address = 1;
+  ::setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR,
+               (char*)&reuse_address, sizeof(reuse_address));
+  struct sockaddr_in local_addr;
+  std::memset(&local_addr, 0, sizeof(local_addr));
+  local_addr.sin_family = AF_INET;
+  local_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  local_addr.sin_port = htons(mServerPort);
+  if ( (server_socket < 0) ||
+       (::bind(server_socket, (struct sockaddr *) &local_addr, sizeof(local_addr)) < 0) ||
+       (::listen(server_socket, SOMAXCONN) < 0) ) {
+    std::cerr << "TCP Socket Server ERROR: " << std::strerror(errno) <<  endl;
     std::exit(1);
   }
+  setSocketNonBlocking(server_socket);
 
-  const int tcpTimeout = 5*1000;
-
-
-  cout << "JackTrip MULTI-THREADED SERVER: TCP Server Listening in Port = " << TcpServer.serverPort() << endl;
+  cout << "JackTrip MULTI-THREADED SERVER: TCP Server Listening in Port = " << mServerPort << endl;
+  cout << "JackTrip MULTI-THREADED SERVER: Waiting for client connections..." << endl;
+  cout << "=======================================================" << endl;
+  if ( mHubRoomManager != NULL ) { mHubRoomManager->setUdpMasterListener(this); }
+  uint64_t next_rebalance = PacketHeader::usecTime() + (gHubRebalanceInterval * 1000ULL);
   while ( !mStopped )
   {
-    cout << "JackTrip MULTI-THREADED SERVER: Waiting for client connections..." << endl;
-    cout << "=======================================================" << endl;
-    while ( !TcpServer.waitForNewConnection(1000) )
-    { if (mStopped) { return; } } // block until a new connection is received
-    cout << "JackTrip MULTI-THREADED SERVER: Client Connection Received!" << endl;
-
-    // Control loop to be able to exit if UDPs or TCPs error ocurr
-    for (int dum = 0; dum<1; dum++) {
-      QTcpSocket *clientConnection = TcpServer.nextPendingConnection();
-      if ( !clientConnection->waitForConnected(tcpTimeout) ) {
-        std::cerr << clientConnection->errorString().toStdString() << endl;
-        break;
+    // Wait for new connections, client requests and space to send the replies
+    // ------------------------------------------------------------------------
+    // The server socket is the first one, then the connections in order
+    QVector<ListenerSocket> sockets(mConnections.size() + 1);
+    sockets[0].Socket = server_socket;
+    sockets[0].Read = ( mConnections.size() < gMaxHandshakes );
+    sockets[0].Write = false;
+    uint64_t now = PacketHeader::usecTime();
+    // Wake up for the rebalance, the next deadline, and to check mStopped
+    uint64_t wake_time = std::min<uint64_t>(next_rebalance, now + (gHandshakePollTime * 1000ULL));
+    for (int i = 0; i < mConnections.size(); i++) {
+      HandshakeConnection* connection = mConnections[i];
+      ListenerSocket& socket = sockets[i+1];
+      socket.Socket = connection->Socket;
+      socket.Read = ( connection->State == HandshakeConnection::READ_REQUEST );
+      socket.Write = ( connection->State == HandshakeConnection::WRITE_REPLY );
+      if ( connection->State == HandshakeConnection::WAIT_RELEASE ) {
+        // Check again soon
+        wake_time = std::min<uint64_t>(wake_time, now + (gHandshakeReleasePollTime * 1000ULL));
       }
-      PeerAddress = clientConnection->peerAddress();
-      cout << "JackTrip MULTI-THREADED SERVER: Client Connect Received from Address : "
-          << PeerAddress.toString().toStdString() << endl;
-
-      // Get UDP port from client
-      // ------------------------
-      peer_udp_port = readClientUdpPort(clientConnection);
-      if ( peer_udp_port == 0 ) { break; }
-      cout << "JackTrip MULTI-THREADED SERVER: Client UDP Port is = " << peer_udp_port << endl;
-
-      // Check is client is new or not
-      // -----------------------------
-      // Check if Address is not already in the thread pool
-      // check by comparing 32-bit addresses
-      int id = isNewAddress(PeerAddress.toIPv4Address(), peer_udp_port);
-      // If the address is not new, we need to remove the client from the pool
-      // before re-starting the connection
-      if (id == -1) {
-        int id_remove;
-        id_remove = getPoolID(PeerAddress.toIPv4Address(), peer_udp_port);
-        // stop the thread
-        mJTWorkers->at(id_remove)->stopThread();
-        // block until the thread has been removed from the pool
-        while ( isNewAddress(PeerAddress.toIPv4Address(), peer_udp_port) == -1 ) {
-          cout << "JackTrip MULTI-THREADED SERVER: Removing JackTripWorker from pool..." << endl;
-          QThread::msleep(10);
-        }
-        // Get a new ID for this client
-        //id = isNewAddress(PeerAddress.toIPv4Address(), peer_udp_port);
-        id = getPoolID(PeerAddress.toIPv4Address(), peer_udp_port);
+      wake_time = std::min<uint64_t>(wake_time, connection->StartTime + (gHandshakeTimeout * 1000ULL));
+    }
+    waitForSockets(sockets, (wake_time > now) ? (wake_time - now) : 0);
+
+    // Accept the new connections, they're advanced right away
+    // -------------------------------------------------------
+    int num_old_connections = mConnections.size();
+    if ( sockets[0].Ready ) { acceptConnections(server_socket); }
+
+    // Advance the handshakes that are ready, close the finished and timed-out ones
+    // ----------------------------------------------------------------------------
+    now = PacketHeader::usecTime();
+    // (j is the socket of the connection, they're removed from mConnections only)
+    for (int i = 0, j = 1; i < mConnections.size(); j++) {
+      HandshakeConnection* connection = mConnections[i];
+      bool keep = true;
+      if ( (i >= num_old_connections) ||
+           (connection->State == HandshakeConnection::WAIT_RELEASE) ||
+           sockets[j].Ready ) {
+        keep = processConnection(connection);
+      }
+      if ( keep && (now >= connection->StartTime + (gHandshakeTimeout * 1000ULL)) ) {
+        std::cerr << "JackTrip MULTI-THREADED SERVER: Client handshake timed out" << endl;
+        keep = false;
       }
-      // Assign server port and send it to Client
-      server_udp_port = mBasePort+id;
-      if ( sendUdpPort(clientConnection, server_udp_port) == 0 ) {
-        clientConnection->close();
-        delete clientConnection;
-        releaseThread(id);
-        break;
+      if ( keep ) { i++; }
+      else {
+        closeConnection(connection);
+        mConnections.remove(i);
       }
+    }
 
-      // Close and Delete the socket
-      // ---------------------------
-      clientConnection->close();
-      delete clientConnection;
-      cout << "JackTrip MULTI-THREADED SERVER: Client TCP Socket Closed!" << endl;
-
-      // Spawn Thread to Pool
-      // --------------------
-      // Register JackTripWorker with the master listener
-      delete mJTWorkers->at(id); // just in case the Worker was previously created
-      mJTWorkers->replace(id, new JackTripWorker(this));
-      // redirect port and spawn listener
-      cout << "---> JackTrip MULTI-THREADED SERVER: Spawning Listener..." << endl;
-      {
-        QMutexLocker lock(&mMutex);
-        mJTWorkers->at(id)->setJackTrip(id, mActiveAddress[id][0],
-                                        server_udp_port, mActiveAddress[id][1],
-                                        1); /// \todo temp default to 1 channel
+    // The rooms of the UDP joins are built here, not in the hub socket thread
+    if ( mHubRoomManager != NULL ) {
+      mHubRoomManager->createRequestedRooms();
+      // The engine threads don't write to the console
+      mHubRoomManager->printEngineEvents();
+    }
+
+    if ( now >= next_rebalance ) {
+      if ( mHubRoomManager != NULL ) {
+        mHubRoomManager->rebalance();
+        mHubRoomManager->connectTrunks();
+        mHubRoomManager->reportLevels(now);
       }
-      //send one thread to the pool
-      cout << "---> JackTrip MULTI-THREADED SERVER: Starting Thread..." << endl;
-      mThreadPool.start(mJTWorkers->at(id), QThread::TimeCriticalPriority);
-      // wait until one is complete before another spawns
-      while (mJTWorkers->at(id)->isSpawning()) { QThread::msleep(10); }
-      //mTotalRunningThreads++;
-      cout << "JackTrip MULTI-THREADED SERVER: Total Running Threads:  " << mTotalRunningThreads << endl;
-      cout << "===============================================================" << endl;
-      QThread::msleep(100);
+      next_rebalance = now + (gHubRebalanceInterval * 1000ULL);
     }
   }
 
-  /*
-  // Create objects on the stack
-  QUdpSocket MasterUdpSocket;
-  QHostAddress PeerAddress;
-  uint16_t peer_port; // Ougoing Peer port, in case they're not using the default
+  for (int i = 0; i < mConnections.size(); i++) { closeConnection(mConnections[i]); }
+  mConnections.clear();
+  closeSocket(server_socket);
+}
 
-  // Bind the socket to the well known port
-  bindUdpSocket(MasterUdpSocket, mServerPort);
 
-  char buf[1];
-  cout << "Server Listening in UDP Port: " << mServerPort << endl;
-  cout << "Waiting for client..." << endl;
-  cout << "=======================================================" << endl;
-  while ( !mStopped )
+//*******************************************************************************
+void UdpMasterListener::acceptConnections(int server_socket)
+{
+  while ( mConnections.size() < gMaxHandshakes )
   {
-    //cout << "WAITING........................." << endl;
-    while ( MasterUdpSocket.hasPendingDatagrams() )
-    {
-      cout << "Received request from Client!" << endl;
-      // Get Client IP Address and outgoing port from packet
-      int rv = MasterUdpSocket.readDatagram(buf, 1, &PeerAddress, &peer_port);
-      cout << "Peer Port in Server ==== " << peer_port << endl;
-      if (rv < 0) { std::cerr << "ERROR: Bad UDP packet read..." << endl; }
-
-      /// \todo Get number of channels in the client from header
-
-      // check by comparing 32-bit addresses
-      /// \todo Add the port number in the comparison
-      cout << "peer_portpeer_portpeer_port === " << peer_port << endl;
-      int id = isNewAddress(PeerAddress.toIPv4Address(), peer_port);
-
-      //cout << "IDIDIDIDIDDID === " << id << endl;
-
-      // If the address is new, create a new thread in the pool
-      if (id >= 0) // old address is -1
-      {
-        // redirect port and spawn listener
-        sendToPoolPrototype(id);
-        // wait until one is complete before another spawns
-        while (mJTWorker->isSpawning()) { QThread::msleep(10); }
-        mTotalRunningThreads++;
-        cout << "Total Running Threads:  " << mTotalRunningThreads << endl;
-        cout << "=======================================================" << endl;
-      }
-      //cout << "ENDDDDDDDDDDDDDDDDDd === " << id << endl;
-    }
-    QThread::msleep(100);
+    struct sockaddr_in peer_addr;
+    socklen_t peer_addr_size = sizeof(peer_addr);
+    int client_socket = ::accept(server_socket, (struct sockaddr *) &peer_addr, &peer_addr_size);
+    if ( client_socket < 0 ) { return; } // no more pending connections
+    setSocketNonBlocking(client_socket);
+
+    HandshakeConnection* connection = new HandshakeConnection;
+    connection->Socket = client_socket;
+    connection->State = HandshakeConnection::READ_REQUEST;
+    connection->Address = ntohl(peer_addr.sin_addr.s_addr);
+    connection->StartTime = PacketHeader::usecTime();
+    connection->RequestSize = 0;
+    connection->PeerUdpPort = 0;
+    connection->SessionIDRequested = false;
+    connection->ID = -1;
+    connection->Resumed = false;
+    connection->ReplySize = 0;
+    connection->ReplySent = 0;
+    mConnections.append(connection);
+    cout << "JackTrip MULTI-THREADED SERVER: Client Connect Received from Address : "
+         << QHostAddress(connection->Address).toString().toStdString() << endl;
   }
-  */
 }
 
 
 //*******************************************************************************
-// Returns 0 on error
-int UdpMasterListener::readClientUdpPort(QTcpSocket* clientConnection)
+bool UdpMasterListener::processConnection(HandshakeConnection* connection)
 {
-  // Read the size of the package
-  // ----------------------------
-  //tcpClient.waitForReadyRead();
-  cout << "Reading UDP port from Server..." << endl;
-  while (clientConnection->bytesAvailable() < (int)sizeof(uint16_t)) {
-    if (!clientConnection->waitForReadyRead()) {
-      std::cerr << "TCP Socket ERROR: " << clientConnection->errorString().toStdString() <<  endl;
-      return 0;
+  // Get UDP port (and room) from client
+  // -----------------------------------
+  if ( connection->State == HandshakeConnection::READ_REQUEST ) {
+    int request_status = 0;
+    while ( request_status == 0 ) {
+      int bytes_read = ::recv(connection->Socket, connection->Request + connection->RequestSize,
+                              sizeof(connection->Request) - connection->RequestSize, 0);
+      if ( bytes_read < 0 && socketWouldBlock() ) { return true; } // wait for more
+      if ( bytes_read <= 0 ) {
+        std::cerr << "JackTrip MULTI-THREADED SERVER: Client closed the connection" << endl;
+        return false;
+      }
+      connection->RequestSize += bytes_read;
+      request_status = parseClientRequest(connection);
+    }
+    if ( request_status < 0 ) { return false; }
+    cout << "JackTrip MULTI-THREADED SERVER: Client UDP Port is = " << connection->PeerUdpPort << endl;
+
+    // Check is client is new or not
+    // -----------------------------
+    // A hub client that reconnects to the same room keeps its session (input
+    // queue, mix and statistics). Otherwise, if the address is not new, we
+    // need to remove the client from the pool before re-starting the connection
+    int id_remove = getPoolID(connection->Address, connection->PeerUdpPort);
+    if ( (id_remove >= 0) && (mHubRoomManager != NULL) &&
+         mHubRoomManager->isSessionInRoom(id_remove, connection->Room) ) {
+      cout << "JackTrip MULTI-THREADED SERVER: Resuming session ID = " << id_remove << endl;
+      connection->ID = id_remove;
+      connection->Resumed = true;
+      setReply(connection);
+      connection->State = HandshakeConnection::WRITE_REPLY;
+    }
+    else {
+      if ( id_remove >= 0 ) {
+        cout << "JackTrip MULTI-THREADED SERVER: Removing old session from pool..." << endl;
+        if ( mHubRoomManager != NULL ) { mHubRoomManager->removeSession(id_remove); }
+        else { mJTWorkers->at(id_remove)->stopThread(); }
+      }
+      connection->State = HandshakeConnection::WAIT_RELEASE;
     }
   }
 
-  cout << "Ready To Read From Socket!" << endl;
-  // Read UDP Port Number from Server
+  // Get an ID for the client, once its old session (if any) has been removed
+  // -------------------------------------------------------------------------
+  if ( connection->State == HandshakeConnection::WAIT_RELEASE ) {
+    // The handshake can't tell whether the client mixes the packets a
+    // forwarding hub relays, those clients join by UDP (gHubJoinForwardFlag)
+    if ( (mHubRoomManager != NULL) && mHubRoomManager->isForwarding() ) {
+      std::cerr << "JackTrip MULTI-THREADED SERVER: A forwarding hub only takes UDP joins "
+                << "of clients that mix locally, client rejected" << endl;
+      return false;
+    }
+    // Admission control, a hub client that would overload its room CPU is refused
+    if ( (mHubRoomManager != NULL) && !mHubRoomManager->canAdmitSession(connection->Room) ) {
+      std::cerr << "JackTrip MULTI-THREADED SERVER: Hub is overloaded (or has too many rooms), client rejected" << endl;
+      return false;
+    }
+    int id = isNewAddress(connection->Address, connection->PeerUdpPort);
+    if ( id == -1 ) { return true; } // still in the pool
+    if ( id == -2 ) {
+      std::cerr << "JackTrip MULTI-THREADED SERVER: Pool is full, client rejected" << endl;
+      return false;
+    }
+    connection->ID = id;
+    setReply(connection);
+    connection->State = HandshakeConnection::WRITE_REPLY;
+  }
+
+  // Send server port to the client
+  // ------------------------------
+  while ( connection->ReplySent < connection->ReplySize ) {
+    int bytes_sent = ::send(connection->Socket, connection->Reply + connection->ReplySent,
+                            connection->ReplySize - connection->ReplySent, gSendFlags);
+    if ( bytes_sent < 0 && socketWouldBlock() ) { return true; } // wait for space
+    if ( bytes_sent <= 0 ) {
+      std::cerr << "JackTrip MULTI-THREADED SERVER: Could not send port to client" << endl;
+      return false;
+    }
+    connection->ReplySent += bytes_sent;
+  }
+
+  // Report the join latency and start the session
+  // ---------------------------------------------
+  double latency = (PacketHeader::usecTime() - connection->StartTime) / 1000.0;
+  mNumJoins++;
+  mJoinLatencySum += latency;
+  mJoinLatencyMax = std::max(mJoinLatencyMax, latency);
+  cout << "JackTrip MULTI-THREADED SERVER: Client joined in " << latency << " ms (mean "
+       << mJoinLatencySum / mNumJoins << " ms, max " << mJoinLatencyMax << " ms, "
+       << mNumJoins << " joins, " << mConnections.size() << " handshakes in progress)" << endl;
+  startSession(connection);
+  return false; // done, the TCP socket is closed
+}
+
+
+//*******************************************************************************
+// Returns 1 when the request is complete, 0 if more bytes are needed, -1 on error
+int UdpMasterListener::parseClientRequest(HandshakeConnection* connection)
+{
+  // Read UDP Port Number from Client
   // --------------------------------
   int udp_port;
-  int size = sizeof(udp_port);
-  char port_buf[size];
-  clientConnection->read(port_buf, size);
-  std::memcpy(&udp_port, port_buf, size);
-  return udp_port;
+  if ( connection->RequestSize < (int)sizeof(udp_port) ) { return 0; }
+  std::memcpy(&udp_port, connection->Request, sizeof(udp_port));
+
+  // Hub clients that can read their session ID after the server port
+  connection->SessionIDRequested = ( (udp_port & gHubSessionFlag) != 0 );
+  udp_port &= ~gHubSessionFlag;
+
+  // Hub clients can send a room name after the port (length byte + name)
+  connection->Room.clear();
+  if ( udp_port & gHubRoomFlag ) {
+    udp_port &= ~gHubRoomFlag;
+    if ( connection->RequestSize < (int)sizeof(udp_port) + 1 ) { return 0; }
+    uint8_t room_length = connection->Request[sizeof(udp_port)];
+    if ( connection->RequestSize < (int)sizeof(udp_port) + 1 + room_length ) { return 0; }
+    connection->Room = QString::fromUtf8(connection->Request + sizeof(udp_port) + 1, room_length);
+    cout << "JackTrip MULTI-THREADED SERVER: Client Room is = "
+         << connection->Room.toStdString() << endl;
+  }
+  if ( (udp_port <= 0) || (udp_port > 65535) ) {
+    std::cerr << "JackTrip MULTI-THREADED SERVER: Invalid client UDP port" << endl;
+    return -1;
+  }
+  connection->PeerUdpPort = udp_port;
+  return 1;
 }
 
 
 //*******************************************************************************
-int UdpMasterListener::sendUdpPort(QTcpSocket* clientConnection, int udp_port)
+void UdpMasterListener::setReply(HandshakeConnection* connection)
 {
-  // Send Port Number to Client
-  // --------------------------
-  char port_buf[sizeof(udp_port)];
-  std::memcpy(port_buf, &udp_port, sizeof(udp_port));
-  clientConnection->write(port_buf, sizeof(udp_port));
-  while ( clientConnection->bytesToWrite() > 0 ) {
-    if ( clientConnection->state() == QAbstractSocket::ConnectedState ) {
-      clientConnection->waitForBytesWritten(-1);
-    }
-    else {
-      return 0;
+  // Assign server port
+  // (hub clients all send to the hub port, and are told their session ID and cookie)
+  int udp_port;
+  int session_id = -1;
+  if ( mHubRoomManager != NULL ) {
+    udp_port = mHubRoomManager->getHubPort();
+    if ( connection->SessionIDRequested ) { session_id = connection->ID; }
+  }
+  else {
+    udp_port = mBasePort + connection->ID;
+  }
+
+  if ( session_id >= 0 ) { udp_port |= gHubSessionFlag; }
+  std::memcpy(connection->Reply, &udp_port, sizeof(udp_port));
+  connection->ReplySize = sizeof(udp_port);
+  // The session ID and cookie follow the port
+  if ( session_id >= 0 ) {
+    int32_t id = session_id;
+    std::memcpy(connection->Reply + connection->ReplySize, &id, sizeof(id));
+    connection->ReplySize += sizeof(id);
+    uint64_t cookie = mHubRoomManager->getSessionCookie(session_id, connection->Address);
+    std::memcpy(connection->Reply + connection->ReplySize, &cookie, sizeof(cookie));
+    connection->ReplySize += sizeof(cookie);
+  }
+  connection->ReplySent = 0;
+}
+
+
+//*******************************************************************************
+void UdpMasterListener::startSession(HandshakeConnection* connection)
+{
+  int id = connection->ID;
+  connection->ID = -1; // the session owns the ID now
+
+  // The session is already running
+  if ( connection->Resumed ) {
+    cout << "JackTrip MULTI-THREADED SERVER: Client ID = " << id << " resumed" << endl;
+    cout << "===============================================================" << endl;
+    return;
+  }
+
+  // Add the client to the engine of its room
+  // ----------------------------------------
+  if ( mHubRoomManager != NULL ) {
+    if ( !mHubRoomManager->addSession(connection->Room, id, connection->Address,
+                                      connection->PeerUdpPort) ) {
+      std::cerr << "JackTrip MULTI-THREADED SERVER: Room not created, the hub has "
+                << gHubMaxRooms << " rooms" << endl;
+      releaseThread(id);
+      return;
     }
+    cout << "JackTrip MULTI-THREADED SERVER: Total Running Sessions:  " << mTotalRunningThreads << endl;
+    cout << "===============================================================" << endl;
+    return;
   }
-  return 1;
-  cout << "Port sent to Client" << endl;
+
+  // Spawn Thread to Pool
+  // --------------------
+  // Register JackTripWorker with the master listener
+  delete mJTWorkers->at(id); // just in case the Worker was previously created
+  mJTWorkers->replace(id, new JackTripWorker(this));
+  // redirect port and spawn listener
+  cout << "---> JackTrip MULTI-THREADED SERVER: Spawning Listener..." << endl;
+  {
+    uint32_t address = 0;
+    uint16_t port = 0;
+    int reader = mActiveAddresses.beginRead();
+    mActiveAddresses.getSource(id, address, port);
+    mActiveAddresses.endRead(reader);
+    mJTWorkers->at(id)->setJackTrip(id, address, mBasePort+id, port,
+                                    1); /// \todo temp default to 1 channel
+  }
+  // send one thread to the pool. Each worker binds its own port, so the
+  // listener doesn't wait for it to finish spawning
+  cout << "---> JackTrip MULTI-THREADED SERVER: Starting Thread..." << endl;
+  mThreadPool.start(mJTWorkers->at(id), QThread::TimeCriticalPriority);
+  cout << "JackTrip MULTI-THREADED SERVER: Total Running Threads:  " << mTotalRunningThreads << endl;
+  cout << "===============================================================" << endl;
+}
+
+
+//*******************************************************************************
+void UdpMasterListener::closeConnection(HandshakeConnection* connection)
+{
+  closeSocket(connection->Socket);
+  // The handshake failed after the client got an ID (a resumed session keeps it)
+  if ( (connection->ID >= 0) && !connection->Resumed ) { releaseThread(connection->ID); }
+  delete connection;
 }
 
 
@@ -336,72 +615,40 @@ void UdpMasterListener::bindUdpSocket(QUdpSocket& udpsocket, int port) throw(std
 
 
 //*******************************************************************************
-// check by comparing 32-bit addresses
 int UdpMasterListener::isNewAddress(uint32_t address, uint16_t port)
 {
-  QMutexLocker lock(&mMutex);
-  bool busyAddress = false;
-  int id = 0;
-
-  /*
-  while ( !busyAddress && (id<mThreadPool.activeThreadCount()) )
-  {
-    if ( address==mActiveAddress[id][0] &&  port==mActiveAddress[id][1]) { busyAddress = true; }
-    id++;
-  }
-  */
-  for (int i = 0; i<gMaxThreads; i++) {
-    if ( address==mActiveAddress[i][0] &&  port==mActiveAddress[i][1]) {
-      id = i;
-      busyAddress = true;
-    }
-  }
-  if ( !busyAddress ) {
-    /*
-    mActiveAddress[id][0] = address;
-    mActiveAddress[id][1] = port;
-  } else {
-  */
-    id = 0;
-    bool foundEmptyAddress = false;
-    while ( !foundEmptyAddress && (id<gMaxThreads) ) {
-      if ( (mActiveAddress[id][0] == 0) &&  (mActiveAddress[id][1] == 0) ) {
-        foundEmptyAddress = true;
-        mActiveAddress[id][0] = address;
-        mActiveAddress[id][1] = port;
-      }  else {
-        id++;
-      }
-    }
-  }
-  if (!busyAddress) {
-    mTotalRunningThreads++;
-  }
-  return ((busyAddress) ? -1 : id);
+  int id = mActiveAddresses.insertNew(address, port, NULL);
+  if ( id >= 0 ) { mTotalRunningThreads.ref(); }
+  return id;
 }
 
 
 //*******************************************************************************
 int UdpMasterListener::getPoolID(uint32_t address, uint16_t port)
 {
-  QMutexLocker lock(&mMutex);
-  //for (int id = 0; id<mThreadPool.activeThreadCount(); id++ )
-  for (int id = 0; id<gMaxThreads; id++ )
-  {
-    if ( address==mActiveAddress[id][0] &&  port==mActiveAddress[id][1])
-    { return id; }
-  }
-  return -1;
+  int reader = mActiveAddresses.beginRead();
+  int id = mActiveAddresses.find(address, port);
+  mActiveAddresses.endRead(reader);
+  return id;
+}
+
+
+//*******************************************************************************
+void UdpMasterListener::moveAddress(int id, uint32_t old_address, uint32_t address, uint16_t port)
+{
+  // The session may have been released (and its ID reused) meanwhile
+  mActiveAddresses.move(id, old_address, address, port);
 }
 
 
 //*******************************************************************************
 int UdpMasterListener::releaseThread(int id)
 { 
-  QMutexLocker lock(&mMutex);
-  mActiveAddress[id][0] = 0;
-  mActiveAddress[id][1] = 0;
-  mTotalRunningThreads--;
+  // Lock-free, the engines release their sessions from the audio thread.
+  // The room forgets the session before the ID can be given again.
+  if ( mHubRoomManager != NULL ) { mHubRoomManager->sessionReleased(id); }
+  mActiveAddresses.remove(id);
+  mTotalRunningThreads.deref();
   return 0; /// \todo Check if we really need to return an argument here
 }
 
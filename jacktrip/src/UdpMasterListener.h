@@ -48,16 +48,67 @@
 #include <QTcpSocket>
 #include <QTcpServer>
 #include <QMutex>
+#include <QVector>
 
 #include "jacktrip_types.h"
 #include "jacktrip_globals.h"
+#include "HubSessionTable.h"
 class JackTripWorker; // forward declaration
+class HubRoomManager; // forward declaration
+
+
+/** \brief State of the handshake of one client on the TCP server port
+ *
+ * The listener handles all the connections at the same time, with
+ * non-blocking sockets. Each one goes through the states in order, and is
+ * closed if it's not done before its deadline.
+ */
+struct HandshakeConnection
+{
+  /// \brief Enum for the handshake state
+  enum stateT {
+    READ_REQUEST, ///< Reading the client UDP port (and room name)
+    WAIT_RELEASE, ///< Waiting for the old session of the same client to be removed
+    WRITE_REPLY ///< Sending the server UDP port (and session ID and cookie)
+  };
+
+  int Socket; ///< Native TCP socket (non-blocking)
+  stateT State; ///< Handshake state
+  uint32_t Address; ///< Client IPv4 address
+  uint64_t StartTime; ///< Time the connection was accepted, in microseconds
+  /// Client request: UDP port, room name length and room name
+  char Request[sizeof(int) + 1 + gHubMaxRoomNameLength];
+  int RequestSize; ///< Bytes of the request already read
+  int PeerUdpPort; ///< Client UDP port, from the request
+  bool SessionIDRequested; ///< The client reads its hub session ID
+  QString Room; ///< Hub room requested by the client
+  int ID; ///< Pool (session) ID, -1 until assigned
+  bool Resumed; ///< The client keeps its running hub session (same address, port and room)
+  char Reply[2*sizeof(int32_t) + sizeof(uint64_t)]; ///< Server UDP port, session ID and cookie
+  int ReplySize; ///< Size of the reply
+  int ReplySent; ///< Bytes of the reply already sent
+};
 
 
 /** \brief Master UDP listener on the Server.
  *
  * This creates a server that will listen on the well know port (the server port) and will 
  * spawn JackTrip threads into the Thread pool. Clients request a connection.
+ * The handshakes of all the clients that connect at the same time are done
+ * in parallel (see HandshakeConnection), and the join latency (from the TCP
+ * connection to the reply) is reported for each client.
+ *
+ * If a HubRoomManager is set, clients are added as sessions of the HubEngine
+ * of their room instead, and no JackTrip (nor JACK client) is created per
+ * connection. All the hub clients get the same UDP port (the HubSocket one)
+ * and, if they ask for it, their session ID and cookie. Hub clients can also
+ * join with one UDP request instead (see HubJoinRequest). A hub client that
+ * does the handshake again (e.g., after a network outage) resumes its
+ * session, if it's still running, instead of waiting for it to be removed.
+ *
+ * The active addresses are in a HubSessionTable: the engines and workers
+ * release their IDs, and the HubSocket looks up the UDP joins, without
+ * waiting for the listener.
  */
 class UdpMasterListener : public QThread
 {
@@ -76,6 +127,30 @@ public:
 
   int releaseThread(int id);
 
+  /** \brief Check if address is already handled, if not add to array (thread safe)
+   * \param IPv4 address as a number
+   * \param port Source port, 0 for an ID without a source (never busy, e.g.
+   * the stems a hub receives through a trunk)
+   * \return -1 if address is busy, -2 if the pool is full, id number if not
+   */ 
+  int isNewAddress(uint32_t address, uint16_t port);
+
+  /** \brief Returns the ID of the client in the pool. If the client
+    * is not in the pool yet, returns -1.
+    */
+  int getPoolID(uint32_t address, uint16_t port);
+
+  /** \brief Moves a client to a new address and port, if it's still at
+   * old_address (thread safe). Used when a hub session is resumed.
+   */
+  void moveAddress(int id, uint32_t old_address, uint32_t address, uint16_t port);
+
+  /** \brief Handle the clients with the HubEngine of their room instead of a
+   * JackTripWorker per client. The listener takes ownership of the manager.
+   */
+  void setHubRoomManager(HubRoomManager* hub_room_manager)
+  { mHubRoomManager = hub_room_manager; }
+
 private slots:
   void testReceive()
   { std::cout << "========= TEST RECEIVE SLOT ===========" << std::endl; }
@@ -93,8 +168,25 @@ private:
    */
   static void bindUdpSocket(QUdpSocket& udpsocket, int port) throw(std::runtime_error);
 
-  int readClientUdpPort(QTcpSocket* clientConnection);
-  int sendUdpPort(QTcpSocket* clientConnection, int udp_port);
+  /** \brief Accepts all the pending connections of the TCP server socket
+   * \param server_socket Native TCP server socket (non-blocking)
+   */
+  void acceptConnections(int server_socket);
+  /** \brief Advances the handshake of a connection as far as possible without
+   * blocking
+   * \return false when the connection is done (or failed) and has to be closed
+   */
+  bool processConnection(HandshakeConnection* connection);
+  /** \brief Parses the client UDP port, and the room name if the client sends one
+   * \return 1 if the request is complete, 0 if more bytes are needed, -1 on error
+   */
+  int parseClientRequest(HandshakeConnection* connection);
+  /// \brief Writes the server UDP port (and the session ID) in the reply buffer
+  void setReply(HandshakeConnection* connection);
+  /// \brief Adds the client to its hub room, or spawns its JackTripWorker
+  void startSession(HandshakeConnection* connection);
+  /// \brief Closes the socket of a connection, and deletes it
+  void closeConnection(HandshakeConnection* connection);
 
 
   /** \brief Send the JackTripWorker to the thread pool. This will run
@@ -103,33 +195,27 @@ private:
    */
   //void sendToPoolPrototype(int id);
 
-  /** \brief Check if address is already handled, if not add to array
-   * \param IPv4 address as a number
-   * \return -1 if address is busy, id number if not
-   */ 
-  int isNewAddress(uint32_t address, uint16_t port);
-
-  /** \brief Returns the ID of the client in the pool. If the client
-    * is not in the pool yet, returns -1.
-    */
-  int getPoolID(uint32_t address, uint16_t port);
-
   //QUdpSocket mUdpMasterSocket; ///< The UDP socket
   //QHostAddress mPeerAddress; ///< The Peer Address
 
   //JackTripWorker* mJTWorker; ///< Class that will be used as prototype
   QVector<JackTripWorker*>* mJTWorkers; ///< Vector of JackTripWorker s
-  QThreadPool mThreadPool; ///< The Thread Pool
+  QThreadPool mThreadPool; ///< The Thread Pool (--jackbridge only, the hub uses a HubScheduler)
+  HubRoomManager* mHubRoomManager; ///< Rooms of the hub, NULL to use JackTripWorker s
 
   int mServerPort; //< Server known port number
   int mBasePort;
-  uint32_t mActiveAddress[gMaxThreads][2]; ///< Active addresses pool numbers (32 bits IPv4 numbers)
+  HubSessionTable mActiveAddresses; ///< Active address and port of each pool ID (lock-free lookups and releases)
   QHash<uint32_t, uint16_t> mActiveAddresPortPair;
 
   /// Boolean stop the execution of the thread
   volatile bool mStopped;
-  int mTotalRunningThreads; ///< Number of Threads running in the pool
-  QMutex mMutex;
+  QAtomicInt mTotalRunningThreads; ///< Number of Threads running in the pool
+
+  QVector<HandshakeConnection*> mConnections; ///< Handshakes in progress
+  int mNumJoins; ///< Number of completed handshakes
+  double mJoinLatencySum; ///< Sum of the join latencies, in milliseconds
+  double mJoinLatencyMax; ///< Maximum join latency, in milliseconds
 };
 
 
@@ -77,19 +77,34 @@ win32 {
 
 # Input
 HEADERS += DataProtocol.h \
+           HubDatagramQueue.h \
+           HubEngine.h \
+           HubIngressBudget.h \
+           HubMixer.h \
+           HubRoomManager.h \
+           HubScheduler.h \
+           HubSession.h \
+           HubSessionTable.h \
+           HubSocket.h \
            JackTrip.h \
            jacktrip_globals.h \
            jacktrip_types.h \
+           JackTripSimulator.h \
            JackTripThread.h \
            JackTripWorker.h \
            JackTripWorkerMessages.h \
            LoopBack.h \
            NetKS.h \
+           NullAudioInterface.h \
            PacketHeader.h \
+           PacketClockAudioInterface.h \
+           PacketReblocker.h \
            ProcessPlugin.h \
            RingBuffer.h \
            RingBufferWavetable.h \
+           SampleRateConverter.h \
            Settings.h \
+           SimulatedLink.h \
            TestRingBuffer.h \
            ThreadPoolTest.h \
            UdpDataProtocol.h \
@@ -99,26 +114,42 @@ HEADERS += DataProtocol.h \
            #JamTest.h
 !nojack {
 SOURCES += JackAudioInterface.h
+HEADERS += HubJackBridge.h
 }
 SOURCES += DataProtocol.cpp \
+           HubDatagramQueue.cpp \
+           HubEngine.cpp \
+           HubIngressBudget.cpp \
+           HubMixer.cpp \
+           HubRoomManager.cpp \
+           HubScheduler.cpp \
+           HubSessionTable.cpp \
+           HubSocket.cpp \
            JackTrip.cpp \
            jacktrip_globals.cpp \
            jacktrip_main.cpp \
            jacktrip_tests.cpp \
+           JackTripSimulator.cpp \
            JackTripThread.cpp \
            JackTripWorker.cpp \
            LoopBack.cpp \
+           NullAudioInterface.cpp \
            PacketHeader.cpp \
+           PacketClockAudioInterface.cpp \
+           PacketReblocker.cpp \
            ProcessPlugin.cpp \
            RingBuffer.cpp \
+           SampleRateConverter.cpp \
            Settings.cpp \
+           SimulatedLink.cpp \
            #tests.cpp \
            UdpDataProtocol.cpp \
            UdpMasterListener.cpp \
            AudioInterface.cpp \
            RtAudioInterface.cpp
 !nojack {
-SOURCES += JackAudioInterface.cpp
+SOURCES += JackAudioInterface.cpp \
+           HubJackBridge.cpp
 }
 
 # RtAduio Input
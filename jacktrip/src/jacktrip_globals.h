@@ -61,6 +61,49 @@ const uint32_t gDefaultSampleRate = 48000;
 const uint32_t gDefaultBufferSizeInSamples = 128;
 const QString gDefaultLocalAddress = QString();
 const int gDefaultRedundancy = 1;
+const int gDefaultSrcTapsPerPhase = 32; ///< Sample rate converter filter taps per phase
+const double gHubGainRampTime = 0.02; ///< Hub custom mix gain ramp time, in seconds
+const int gHubRoomFlag = 0x40000000; ///< Set in the client UDP port (TCP handshake) when a room name follows
+const int gHubMaxRoomNameLength = 255; ///< Maximum length of a hub room name
+const int gHubRebalanceInterval = 1000; ///< Time between hub room rebalances, in milliseconds
+const int gHubJoinRetryTime = 200; ///< Time between hub UDP join requests until the reply arrives, in milliseconds
+const int gHubJoinCookieTime = 10000; ///< Lifetime of the hub UDP join challenge cookies, in milliseconds (a cookie is accepted for one or two lifetimes)
+const int gHubMaxRooms = 64; ///< Rooms of one hub
+const int gHubResumeTime = 500; ///< Time without audio from the hub before a client asks to resume its session, in milliseconds
+const int gHubDefaultSessionPool = 8; ///< Pre-allocated sessions per hub room
+const int gHubPoolNumChannels = 2; ///< Channels the pooled hub sessions are sized for
+const int gHubPoolBufferSize = 512; ///< Client buffer size the pooled hub sessions are sized for, in samples
+const int gHubPoolRedundancy = 2; ///< Redundancy the pooled hub sessions are sized for
+const int gHubAdmissionLoad = 750; ///< Projected CPU load (1/1000 of the period) above which the hub refuses new clients
+const int gHubDefaultSessionLoad = 10; ///< Load of a hub client until it's measured, in 1/1000 of the period
+const int gHubOverloadLoad = 900; ///< Hub engine load (1/1000 of the period) that degrades the engine one more step
+const int gHubRecoverLoad = 500; ///< Hub engine load (1/1000 of the period) that restores the engine one step
+const int gHubOverloadHoldTime = 1000; ///< Time between two hub degradation steps, in milliseconds
+const int gHubRecoverTime = 5000; ///< Time below gHubRecoverLoad before the hub restores one step, in milliseconds
+const int gHubLowSrcTapsPerPhase = 16; ///< Sample rate converter taps per phase of a degraded hub engine
+const int gHubLongPeriodFactor = 2; ///< Hub period multiplier of the last degradation step
+const int gHubIngressHeadroom = 2; ///< Hub client receive budget, times the datagrams and bytes its settings need
+const int gHubIngressExtraPackets = 2; ///< Hub client receive budget for control datagrams, per period
+const int gHubIngressBurstPeriods = 8; ///< Periods of receive budget a hub client can use at once
+const int gHubIngressDefaultPackets = 8; ///< Hub client receive budget until its settings are known, datagrams per period
+const int gHubIngressDefaultBytes = 16384; ///< Hub client receive budget until its settings are known, bytes per period
+const int gHubSessionTableReaders = 64; ///< Concurrent lookups (read sections) of the hub session tables
+const int gHubTrunkNumChannels = 2; ///< Channels of the sub-mixes and stems between trunked hubs
+const int gHubTrunkRedundancy = 2; ///< Packets per datagram of the sub-mixes between trunked hubs
+const int gHubTrunkMaxStems = 32; ///< Stems a peer hub can subscribe to over one trunk
+const int gHubStemRefreshTime = 1000; ///< Time between two stem subscriptions to a peer hub, in milliseconds
+const int gHubForwardPackets = 8; ///< Datagrams a forwarding hub relays per client and period
+const int gHubSendBatchSize = 64; ///< Datagrams the hub sends with one system call
+const int gHubAudienceMaxFormats = 8; ///< Distinct audio formats of the audience of one hub room
+const int gHubAudienceMaxListeners = 1024; ///< Audience listeners of one hub room
+const int gHubJitterMargin = 3; ///< Playout margin of a hub client, in interarrival jitter estimates
+const int gHubMeterInterval = 1000; ///< Metering interval of the hub rooms, the levels are published at its end, in milliseconds
+const int gHubMeterMaxReadings = 1024; ///< Channels (client and mix) the levels of one hub room are published for
+const int gHubMeterReadAttempts = 8; ///< Tries to copy consistent levels while a hub room publishes them
+const int gHubEventQueueSize = 16384; ///< Size of the queue of the events a hub engine prints from the listener thread, in bytes
+const char* const gHubJackBridgeName = "JackTripHub"; ///< JACK client name shared by the --jackbridge clients
+const int gHubJackBridgeRemoveTime = 1000; ///< Wait for a JACK bridge cycle when a client leaves before warning that the callback is stuck, in milliseconds
+const int gHubSessionFlag = 0x20000000; ///< Set in the UDP ports (TCP handshake) when a session ID and cookie follow the server port
 const int gTimeOutMultiThreadedServer = 5000; // seconds
 const int gWaitCounter = 60;
 //@}
@@ -97,6 +140,16 @@ const int gJackBitResolution = 32; ///< Audio Bit Resolution of the Jack Server
 //@}
 
 
+//*******************************************************************************
+/// \name Packet clock (PacketClockAudioInterface)
+//@{
+const double gPacketClockBandwidth = 0.5; ///< Bandwidth of the delay-locked loop that follows the peer packets, in Hz
+const double gPacketClockOffset = 0.5; ///< Start of the period after the expected packet arrival, in periods
+const int gPacketClockPhaseSlew = 16; ///< Periods a phase error against the packets is corrected over
+const int gPacketClockMaxGap = 8; ///< Packet timing error that restarts the delay-locked loop, in periods
+//@}
+
+
 //*******************************************************************************
 /// \name Global Functions
 
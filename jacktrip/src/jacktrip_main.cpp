@@ -68,6 +68,11 @@ int main(int argc, char** argv)
 
   if ( testing ) {
     cout << "=========TESTING=========" << endl;
+    // "test regression" runs the regression tests, they don't need an audio
+    // interface nor a network
+    if ( (argc > 2) && !strcmp(argv[2], "regression") ) {
+      return ( main_regression_tests() == 0 ) ? 0 : 1;
+    }
     //main_tests(argc, argv); // test functions
     JackTrip jacktrip;
     RtAudioInterface rtaudio(&jacktrip);
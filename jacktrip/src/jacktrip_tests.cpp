@@ -36,10 +36,18 @@
  */
 
 #include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
 
 #include <QVector>
 
 #include "JackTripThread.h"
+#include "PacketReblocker.h"
+#include "SampleRateConverter.h"
+#include "HubMixer.h"
+#include "HubSessionTable.h"
 
 using std::cout; using std::endl;
 
@@ -50,6 +58,13 @@ const int base_port = 4464;
 void main_tests(int argc, char** argv);
 void test_threads_server();
 void test_threads_client(const char* peer_address);
+int main_regression_tests();
+bool test_check(bool condition, const char* name);
+bool test_packet_reblocker();
+bool test_sample_rate_converter();
+bool test_hub_mixer();
+bool test_hub_session_table();
+void test_count_deletion(void* counter);
 
 
 void main_tests(int /*argc*/, char** argv)
@@ -101,3 +116,250 @@ void test_threads_client(const char* peer_address)
       //sleep(1);
     }
 }
+
+
+// Deterministic tests of the audio code (no audio interface nor network
+// needed), returns the number of failed tests
+int main_regression_tests()
+{
+  int failed = 0;
+  if ( !test_packet_reblocker() ) { failed++; }
+  if ( !test_sample_rate_converter() ) { failed++; }
+  if ( !test_hub_mixer() ) { failed++; }
+  if ( !test_hub_session_table() ) { failed++; }
+  cout << "Regression tests: " << failed << " failed" << endl;
+  return failed;
+}
+
+
+// Prints the result of a test
+bool test_check(bool condition, const char* name)
+{
+  cout << (condition ? "PASSED: " : "FAILED: ") << name << endl;
+  return condition;
+}
+
+
+// Peer packets re-blocked to the local size keep every sample, in order,
+// and only hold back less than one local buffer
+bool test_packet_reblocker()
+{
+  const int num_chans = 2;
+  const int sizes[3][2] = { {32, 256}, {256, 32}, {48, 128} }; // local, peer
+  bool passed = true;
+  for (int t = 0; t < 3; t++)
+    {
+      const int local_frames = sizes[t][0];
+      const int peer_frames = sizes[t][1];
+      PacketReblocker reblocker(num_chans, sizeof(int16_t), local_frames, peer_frames);
+      QVector<int16_t> packet(num_chans * peer_frames);
+      QVector<int16_t> slot(num_chans * local_frames);
+      int in_frame = 0;
+      int out_frame = 0;
+      for (int n = 0; n < 100; n++)
+        {
+          // Channel after channel, each frame has its own value
+          for (int c = 0; c < num_chans; c++) {
+            for (int f = 0; f < peer_frames; f++) {
+              packet[c*peer_frames + f] = static_cast<int16_t>( ((in_frame + f) % 30000) * (c ? -1 : 1) );
+            }
+          }
+          in_frame += peer_frames;
+          reblocker.insertPeerPacket(reinterpret_cast<int8_t*>(packet.data()), peer_frames);
+          while ( reblocker.readLocalSlot(reinterpret_cast<int8_t*>(slot.data())) ) {
+            for (int c = 0; c < num_chans; c++) {
+              for (int f = 0; f < local_frames; f++) {
+                if ( slot[c*local_frames + f] !=
+                     static_cast<int16_t>( ((out_frame + f) % 30000) * (c ? -1 : 1) ) ) {
+                  passed = false; }
+              }
+            }
+            out_frame += local_frames;
+          }
+          if ( (in_frame - out_frame) >= local_frames ) { passed = false; }
+          if ( reblocker.getStagedFrames() != (in_frame - out_frame) ) { passed = false; }
+        }
+    }
+  return test_check(passed, "PacketReblocker keeps all the samples in order");
+}
+
+
+// Converted audio has the output rate, the DC level and the level of a tone
+// (the filter passband is flat)
+bool test_sample_rate_converter()
+{
+  const uint32_t rates[2][2] = { {48000, 44100}, {44100, 48000} }; // in, out
+  const int in_frames = 128;
+  bool passed = true;
+  for (int t = 0; t < 2; t++)
+    {
+      const uint32_t in_rate = rates[t][0];
+      const uint32_t out_rate = rates[t][1];
+      SampleRateConverter converter(1, in_rate, out_rate, in_frames);
+      QVector<sample_t> input(in_frames);
+      QVector<sample_t> output(converter.getMaxOutputFrames(in_frames));
+      const sample_t* in_channels[1] = { input.data() };
+      sample_t* out_channels[1] = { output.data() };
+      long total_in = 0;
+      long total_out = 0;
+      double dc_error = 0.0;
+      double sum_squares = 0.0;
+      long num_squares = 0;
+      for (int b = 0; b < 1000; b++)
+        {
+          // DC for the first half, then a 1 kHz tone
+          for (int i = 0; i < in_frames; i++) {
+            input[i] = (b < 500) ? 0.5 : 0.5 * std::sin(2.0*M_PI*1000.0*(total_in + i)/in_rate);
+          }
+          int out_frames = converter.process(in_channels, in_frames, out_channels);
+          total_in += in_frames;
+          total_out += out_frames;
+          // Never more than one frame from the exact ratio
+          if ( std::labs(total_out - (total_in * static_cast<long>(out_rate)) / in_rate) > 1 ) {
+            passed = false; }
+          // (skip the filter transients)
+          for (int i = 0; i < out_frames; i++) {
+            if ( (b > 10) && (b < 500) ) {
+              dc_error = std::max(dc_error, std::fabs(output[i] - 0.5)); }
+            if ( b > 510 ) {
+              sum_squares += output[i] * output[i];
+              num_squares++;
+            }
+          }
+        }
+      double rms = std::sqrt(sum_squares / num_squares);
+      if ( (dc_error > 1e-3) || (std::fabs(rms - 0.5/std::sqrt(2.0)) > 0.0035) ) { passed = false; }
+    }
+  return test_check(passed, "SampleRateConverter keeps the rate and the levels");
+}
+
+
+// The mix-minus feeds match a naive mix of the other clients, also with a
+// custom gain, in wire format and with the levels measured while mixing
+bool test_hub_mixer()
+{
+  // Not a multiple of 4 frames, so the SSE loops and their tails both run
+  const int buffer_size = 67;
+  const int num_clients = 3;
+  const int num_chans[num_clients] = { 2, 2, 1 }; // the mono client is heard on both channels
+  const sample_t tolerance = 1e-5;
+  HubMixer mixer(buffer_size);
+  QVector< QVector<sample_t> > inputs(num_clients);
+  for (int k = 0; k < num_clients; k++) {
+    inputs[k].resize(num_chans[k] * buffer_size);
+    for (int i = 0; i < inputs[k].size(); i++) {
+      inputs[k][i] = ( ((k*7919 + i*104729) % 2001) - 1000 ) / 4000.0;
+    }
+  }
+
+  HubLevel input_levels[2] = { {0.0, 0.0}, {0.0, 0.0} };
+  HubLevel bus_levels[2] = { {0.0, 0.0}, {0.0, 0.0} };
+  mixer.clearBus(2);
+  for (int k = 0; k < num_clients; k++) {
+    mixer.addToBus(inputs[k].data(), num_chans[k], (k == 0) ? input_levels : NULL,
+                   (k == num_clients-1) ? bus_levels : NULL);
+  }
+
+  bool passed = true;
+  QVector<sample_t> feed(2 * buffer_size);
+  sample_t input_peak = 0.0;
+  sample_t bus_peak = 0.0;
+  for (int k = 0; k < num_clients; k++)
+    {
+      mixer.computeMixMinus(inputs[k].data(), num_chans[k], feed.data());
+      for (int c = 0; c < num_chans[k]; c++) {
+        for (int f = 0; f < buffer_size; f++) {
+          sample_t expected = 0.0;
+          for (int j = 0; j < num_clients; j++) {
+            if ( j != k ) { expected += inputs[j][(c % num_chans[j])*buffer_size + f]; }
+          }
+          if ( std::fabs(feed[c*buffer_size + f] - expected) > tolerance ) { passed = false; }
+          if ( k == 0 ) {
+            input_peak = std::max(input_peak, std::fabs(inputs[0][c*buffer_size + f]));
+            bus_peak = std::max(bus_peak, std::fabs(expected + inputs[0][c*buffer_size + f]));
+          }
+        }
+      }
+    }
+  if ( (std::fabs(input_levels[0].Peak - input_peak) > tolerance) ||
+       (std::fabs(std::max(bus_levels[0].Peak, bus_levels[1].Peak) - bus_peak) > tolerance) ) {
+    passed = false; }
+
+  // Client 0 hears client 1 at half gain: the custom mix holds (gain-1)*input
+  int custom_mix = mixer.createCustomMix();
+  const sample_t* sources[1] = { inputs[1].data() };
+  const sample_t gains[1] = { 0.5 - 1.0 };
+  mixer.addToCustomMix(custom_mix, sources, num_chans + 1, gains, gains, 1);
+  mixer.computeMixMinus(inputs[0].data(), num_chans[0], feed.data(), custom_mix);
+  for (int c = 0; c < num_chans[0]; c++) {
+    for (int f = 0; f < buffer_size; f++) {
+      sample_t expected = 0.5 * inputs[1][c*buffer_size + f] + inputs[2][f];
+      if ( std::fabs(feed[c*buffer_size + f] - expected) > tolerance ) { passed = false; }
+    }
+  }
+
+  // The feed encoded straight into a packet is the encoded feed
+  QVector<int8_t> packet(2 * buffer_size * AudioInterface::BIT16);
+  QVector<int8_t> expected_packet(packet.size());
+  QVector<sample_t> scratch(buffer_size);
+  mixer.computeMixMinus(inputs[1].data(), num_chans[1], feed.data());
+  HubMixer::encodeAudioPacket(feed.data(), buffer_size, buffer_size, num_chans[1],
+                              expected_packet.data(), AudioInterface::BIT16);
+  mixer.computeMixMinusPacket(inputs[1].data(), num_chans[1], packet.data(),
+                              AudioInterface::BIT16, scratch.data());
+  if ( std::memcmp(packet.data(), expected_packet.data(), packet.size()) != 0 ) { passed = false; }
+
+  return test_check(passed, "HubMixer mix-minus feeds match the naive mix");
+}
+
+
+// Deleter of the session table test, the retired objects are counters
+void test_count_deletion(void* counter)
+{
+  (*static_cast<int*>(counter))++;
+}
+
+
+// Sessions are found by source and by ID, and the retired objects are only
+// deleted once the readers that started before their retirement are done
+bool test_hub_session_table()
+{
+  HubSessionTable table(8, 4);
+  int values[3] = { 0, 0, 0 };
+  bool passed = true;
+
+  if ( !table.insert(3, 0x7f000001, 4464, values) ) { passed = false; }
+  if ( table.insertNew(0x7f000001, 4465, values + 1) != 0 ) { passed = false; }
+  if ( table.insertNew(0x7f000001, 4464, values + 2) != -1 ) { passed = false; } // source used
+  int reader = table.beginRead();
+  void* value = NULL;
+  if ( (table.find(0x7f000001, 4464, &value) != 3) || (value != values) ) { passed = false; }
+  if ( (table.find(0x7f000001, 4465) != 0) || (table.getValue(0) != values + 1) ) { passed = false; }
+  table.endRead(reader);
+
+  // Moved and removed sessions aren't found anymore
+  if ( !table.move(0, 0x7f000001, 0x7f000002, 5000) ) { passed = false; }
+  if ( table.remove(3, values + 1) != NULL ) { passed = false; } // other value
+  if ( table.remove(3) != values ) { passed = false; }
+  reader = table.beginRead();
+  if ( (table.find(0x7f000001, 4464) != -1) || (table.find(0x7f000001, 4465) != -1) ||
+       (table.find(0x7f000002, 5000) != 0) || (table.getValue(3) != NULL) ) { passed = false; }
+  table.endRead(reader);
+
+  // Epoch based reclamation
+  int deleted = 0;
+  int old_reader = table.beginRead();
+  table.retire(&deleted, test_count_deletion);
+  int new_reader = table.beginRead();
+  table.reclaim();
+  if ( deleted != 0 ) { passed = false; } // the old reader can still use it
+  table.endRead(old_reader);
+  table.reclaim();
+  if ( deleted != 1 ) { passed = false; } // the new reader can't see it
+  table.endRead(new_reader);
+  table.retire(&deleted, test_count_deletion);
+  table.reclaim();
+  if ( deleted != 2 ) { passed = false; } // no readers
+
+  return test_check(passed, "HubSessionTable frees the retired objects after their readers");
+}